@@ -14,7 +14,7 @@ Graphics4::IndexBuffer* IndexBufferImpl::_current = nullptr;
 
 IndexBufferImpl::IndexBufferImpl(int count) : myCount(count) {}
 
-Graphics4::IndexBuffer::IndexBuffer(int count) : IndexBufferImpl(count) {
+Graphics4::IndexBuffer::IndexBuffer(int count, Usage usage) : IndexBufferImpl(count) {
 	indices = new int[count];
 
 	D3D11_BUFFER_DESC bufferDesc;
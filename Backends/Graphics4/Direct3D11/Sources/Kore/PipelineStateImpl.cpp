@@ -431,3 +431,13 @@ void Graphics4::PipelineState::compile() {
 		device->CreateBlendState(&blendDesc, &blendState);
 	}
 }
+
+void Graphics4::PipelineState::compileAsync() {
+	compile();
+}
+
+bool Graphics4::PipelineState::isReady() {
+	return true;
+}
+
+void Graphics4::PipelineState::waitUntilReady() {}
@@ -5,6 +5,8 @@
 #include <Kore/Math/Random.h>
 #include <Kore/SystemMicrosoft.h>
 
+#include <string.h>
+
 using namespace Kore;
 
 namespace {
@@ -62,6 +64,8 @@ void Graphics4::Texture::init(const char* format, bool readable) {
 	texWidth = width;
 	texHeight = height;
 	rowPitch = 0;
+	dynamic = false;
+	lockData = nullptr;
 	bool isHdr = this->format == Graphics4::Image::RGBA128 || this->format == Graphics4::Image::RGBA64 || this->format == Graphics4::Image::A32 ||
 	             this->format == Graphics4::Image::A16;
 
@@ -102,6 +106,11 @@ void Graphics4::Texture::init(const char* format, bool readable) {
 
 void Graphics4::Texture::init3D(bool readable) {
 	setId();
+	texture = nullptr;
+	view = nullptr;
+	computeView = nullptr;
+	dynamic = false;
+	lockData = nullptr;
 }
 
 Graphics4::Texture::Texture(int width, int height, Image::Format format, bool readable) : Image(width, height, format, readable) {
@@ -109,6 +118,8 @@ Graphics4::Texture::Texture(int width, int height, Image::Format format, bool re
 	mipmap = true;
 	texWidth = width;
 	texHeight = height;
+	rowPitch = 0;
+	lockData = nullptr;
 
 	D3D11_TEXTURE2D_DESC desc;
 	desc.Width = width;
@@ -123,12 +134,14 @@ Graphics4::Texture::Texture(int width, int height, Image::Format format, bool re
 		desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 		desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
 		desc.CPUAccessFlags = 0;
+		dynamic = false;
 	}
 	else {
 		desc.Format = format == Image::RGBA32 ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8_UNORM;
 		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		desc.Usage = D3D11_USAGE_DYNAMIC;
 		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		dynamic = true;
 	}
 
 	texture = nullptr;
@@ -158,6 +171,7 @@ TextureImpl::~TextureImpl() {
 	if (computeView != nullptr) {
 		computeView->Release();
 	}
+	delete[] lockData;
 }
 
 void TextureImpl::unmipmap() {
@@ -184,6 +198,12 @@ void TextureImpl::unset() {
 }
 
 u8* Graphics4::Texture::lock() {
+	if (!dynamic) {
+		rowPitch = width * sizeOf(format);
+		if (data != nullptr) return data;
+		if (lockData == nullptr) lockData = new u8[rowPitch * height];
+		return lockData;
+	}
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	context->Map(texture, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 	rowPitch = mappedResource.RowPitch;
@@ -191,9 +211,45 @@ u8* Graphics4::Texture::lock() {
 }
 
 void Graphics4::Texture::unlock() {
+	if (!dynamic) {
+		context->UpdateSubresource(texture, 0, nullptr, data != nullptr ? data : lockData, rowPitch, 0);
+		return;
+	}
 	context->Unmap(texture, 0);
 }
 
+void Graphics4::Texture::uploadRegion(int x, int y, int width, int height, u8* data, int stride) {
+	int pixelSize = sizeOf(format);
+	if (this->data != nullptr) {
+		for (int row = 0; row < height; ++row) memcpy(&this->data[(y + row) * this->width * pixelSize + x * pixelSize], &data[row * stride], width * pixelSize);
+	}
+
+	if (dynamic) {
+		// dynamic textures can only be rewritten as a whole, switch to a default texture which keeps the current content
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.CPUAccessFlags = 0;
+		ID3D11Texture2D* updatable = nullptr;
+		Microsoft::affirm(device->CreateTexture2D(&desc, nullptr, &updatable));
+		context->CopyResource(updatable, texture);
+		view->Release();
+		texture->Release();
+		texture = updatable;
+		Microsoft::affirm(device->CreateShaderResourceView(texture, nullptr, &view));
+		dynamic = false;
+	}
+
+	D3D11_BOX box;
+	box.left = x;
+	box.right = x + width;
+	box.top = y;
+	box.bottom = y + height;
+	box.front = 0;
+	box.back = 1;
+	context->UpdateSubresource(texture, 0, &box, data, stride, 0);
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {}
 
 int Graphics4::Texture::stride() {
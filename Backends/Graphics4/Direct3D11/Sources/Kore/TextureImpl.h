@@ -23,5 +23,8 @@ namespace Kore {
 		ID3D11ShaderResourceView* view;
 		ID3D11UnorderedAccessView* computeView;
 		int rowPitch;
+		// dynamic textures are mapped by lock, the others are updated from lockData or the image data in unlock
+		bool dynamic;
+		u8* lockData;
 	};
 }
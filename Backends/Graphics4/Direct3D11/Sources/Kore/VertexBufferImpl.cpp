@@ -7,9 +7,9 @@
 
 using namespace Kore;
 
-VertexBufferImpl::VertexBufferImpl(int count) : myCount(count) {}
+VertexBufferImpl::VertexBufferImpl(int count) : myCount(count), lockStart(0), lockCount(count) {}
 
-Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate) : VertexBufferImpl(count) {
+Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate, Usage usage) : VertexBufferImpl(count) {
 	myStride = 0;
 	for (int i = 0; i < structure.size; ++i) {
 		switch (structure.elements[i].data) {
@@ -57,12 +57,28 @@ float* Graphics4::VertexBuffer::lock() {
 }
 
 float* Graphics4::VertexBuffer::lock(int start, int count) {
+	lockStart = start;
+	lockCount = count;
 	return &vertices[start * myStride / 4];
 }
 
 void Graphics4::VertexBuffer::unlock() {
+	unlock(lockCount);
+}
 
-	context->UpdateSubresource(_vb, 0, nullptr, vertices, 0, 0);
+void Graphics4::VertexBuffer::unlock(int count) {
+	if (lockStart == 0 && count == myCount) {
+		context->UpdateSubresource(_vb, 0, nullptr, vertices, 0, 0);
+		return;
+	}
+	D3D11_BOX box;
+	box.left = lockStart * myStride;
+	box.right = (lockStart + count) * myStride;
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+	context->UpdateSubresource(_vb, 0, &box, &vertices[lockStart * myStride / 4], 0, 0);
 }
 
 int Graphics4::VertexBuffer::_set(int offset) {
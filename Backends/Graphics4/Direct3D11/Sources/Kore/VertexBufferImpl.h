@@ -16,5 +16,7 @@ namespace Kore {
 		VertexBufferImpl(int count);
 		int myCount;
 		float* vertices;
+		int lockStart;
+		int lockCount;
 	};
 }
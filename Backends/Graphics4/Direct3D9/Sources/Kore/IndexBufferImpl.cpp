@@ -11,7 +11,7 @@ Graphics4::IndexBuffer* IndexBufferImpl::_current = nullptr;
 
 IndexBufferImpl::IndexBufferImpl(int count) : myCount(count) {}
 
-Graphics4::IndexBuffer::IndexBuffer(int count) : IndexBufferImpl(count) {
+Graphics4::IndexBuffer::IndexBuffer(int count, Usage usage) : IndexBufferImpl(count) {
 	DWORD usage = 0;
 #ifdef KORE_WINDOWS
 	usage = D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY;
@@ -156,6 +156,16 @@ void Graphics4::PipelineState::compile() {
 	halfPixelLocation = vertexShader->constants["gl_HalfPixel"].regindex;
 }
 
+void Graphics4::PipelineState::compileAsync() {
+	compile();
+}
+
+bool Graphics4::PipelineState::isReady() {
+	return true;
+}
+
+void Graphics4::PipelineState::waitUntilReady() {}
+
 void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
 	affirm(device->SetVertexShader((IDirect3DVertexShader9*)pipeline->vertexShader->shader));
 	affirm(device->SetPixelShader((IDirect3DPixelShader9*)pipeline->fragmentShader->shader));
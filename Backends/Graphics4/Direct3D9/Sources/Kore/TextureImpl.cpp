@@ -6,6 +6,8 @@
 #include <Kore/IO/BufferReader.h>
 #include <Kore/WinError.h>
 
+#include <string.h>
+
 using namespace Kore;
 
 namespace {
@@ -102,6 +104,15 @@ void Graphics4::Texture::unlock() {
 	affirm(texture->UnlockRect(0));
 }
 
+void Graphics4::Texture::uploadRegion(int x, int y, int width, int height, u8* data, int stride) {
+	RECT region = {x, y, x + width, y + height};
+	D3DLOCKED_RECT rect;
+	affirm(texture->LockRect(0, &rect, &region, 0));
+	int rowSize = width * sizeOf(format);
+	for (int row = 0; row < height; ++row) memcpy((u8*)rect.pBits + row * rect.Pitch, &data[row * stride], rowSize);
+	affirm(texture->UnlockRect(0));
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {}
 
 int Graphics4::Texture::stride() {
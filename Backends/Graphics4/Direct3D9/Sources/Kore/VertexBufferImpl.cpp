@@ -12,7 +12,8 @@ Graphics4::VertexBuffer* VertexBufferImpl::_current = nullptr;
 
 VertexBufferImpl::VertexBufferImpl(int count, int instanceDataStepRate) : myCount(count), instanceDataStepRate(instanceDataStepRate) {}
 
-Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate) : VertexBufferImpl(count, instanceDataStepRate) {
+Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate, Usage usage)
+    : VertexBufferImpl(count, instanceDataStepRate) {
 	DWORD usage = D3DUSAGE_WRITEONLY;
 #ifdef KORE_WINDOWS
 	usage = D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY;
@@ -63,6 +64,10 @@ void Graphics4::VertexBuffer::unlock() {
 	affirm(vb->Unlock());
 }
 
+void Graphics4::VertexBuffer::unlock(int count) {
+	unlock();
+}
+
 int Graphics4::VertexBuffer::_set(int offset) {
 	_offset = offset;
 	if (instanceDataStepRate == 0) {
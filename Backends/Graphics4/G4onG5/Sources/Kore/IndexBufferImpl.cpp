@@ -12,7 +12,7 @@ extern Graphics5::CommandList* commandList;
 
 Kore::IndexBufferImpl::IndexBufferImpl(int count) : _buffer(count, true) {}
 
-Graphics4::IndexBuffer::IndexBuffer(int count) : IndexBufferImpl(count) {}
+Graphics4::IndexBuffer::IndexBuffer(int count, Usage usage) : IndexBufferImpl(count) {}
 
 Graphics4::IndexBuffer::~IndexBuffer() {}
 
@@ -24,20 +24,39 @@ Graphics4::TextureUnit Graphics4::PipelineState::getTextureUnit(const char* name
 	return unit;
 }
 
-void Graphics4::PipelineState::compile() {
-	for (int i = 0; i < 16; ++i) {
-		_pipeline->inputLayout[i] = inputLayout[i];
+namespace {
+	void copyState(Graphics4::PipelineState* from, Graphics5::PipelineState* to) {
+		for (int i = 0; i < 16; ++i) {
+			to->inputLayout[i] = from->inputLayout[i];
+		}
+		to->vertexShader = &from->vertexShader->_shader;
+		to->fragmentShader = &from->fragmentShader->_shader;
+		to->geometryShader = from->geometryShader != nullptr ? &from->geometryShader->_shader : nullptr;
+		to->tessellationControlShader = from->tessellationControlShader != nullptr ? &from->tessellationControlShader->_shader : nullptr;
+		to->tessellationEvaluationShader = from->tessellationEvaluationShader != nullptr ? &from->tessellationEvaluationShader->_shader : nullptr;
+		to->blendSource = (Graphics5::BlendingOperation)from->blendSource;
+		to->blendDestination = (Graphics5::BlendingOperation)from->blendDestination;
+		to->alphaBlendSource = (Graphics5::BlendingOperation)from->alphaBlendSource;
+		to->alphaBlendDestination = (Graphics5::BlendingOperation)from->alphaBlendDestination;
+		to->depthMode = (Graphics5::ZCompareMode)from->depthMode;
+		to->depthWrite = from->depthWrite;
 	}
-	_pipeline->vertexShader = &vertexShader->_shader;
-	_pipeline->fragmentShader = &fragmentShader->_shader;
-	_pipeline->geometryShader = geometryShader != nullptr ? &geometryShader->_shader : nullptr;
-	_pipeline->tessellationControlShader = tessellationControlShader != nullptr ? &tessellationControlShader->_shader : nullptr;
-	_pipeline->tessellationEvaluationShader = tessellationEvaluationShader != nullptr ? &tessellationEvaluationShader->_shader : nullptr;
-	_pipeline->blendSource = (Graphics5::BlendingOperation)blendSource;
-	_pipeline->blendDestination = (Graphics5::BlendingOperation)blendDestination;
-	_pipeline->alphaBlendSource = (Graphics5::BlendingOperation)alphaBlendSource;
-	_pipeline->alphaBlendDestination = (Graphics5::BlendingOperation)alphaBlendDestination;
-	_pipeline->depthMode = (Graphics5::ZCompareMode)depthMode;
-	_pipeline->depthWrite = depthWrite;
+}
+
+void Graphics4::PipelineState::compile() {
+	copyState(this, _pipeline);
 	_pipeline->compile();
 }
+
+void Graphics4::PipelineState::compileAsync() {
+	copyState(this, _pipeline);
+	_pipeline->compileAsync();
+}
+
+bool Graphics4::PipelineState::isReady() {
+	return _pipeline->isReady();
+}
+
+void Graphics4::PipelineState::waitUntilReady() {
+	_pipeline->waitUntilReady();
+}
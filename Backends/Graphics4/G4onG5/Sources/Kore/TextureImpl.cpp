@@ -6,6 +6,8 @@
 
 #include "TextureImpl.h"
 
+#include <string.h>
+
 using namespace Kore;
 
 Graphics4::Texture::Texture(Kore::Reader& reader, const char* format, bool readable) : Image(reader, format, readable) {
@@ -119,6 +121,13 @@ void Graphics4::Texture::unlock() {
 	_texture->unlock();
 }
 
+void Graphics4::Texture::uploadRegion(int x, int y, int width, int height, u8* data, int stride) {
+	u8* pixels = _texture->lock();
+	int pixelSize = sizeOf(format);
+	for (int row = 0; row < height; ++row) memcpy(&pixels[(y + row) * _texture->stride() + x * pixelSize], &data[row * stride], width * pixelSize);
+	_texture->unlock();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
 	_texture->clear(x, y, z, width, height, depth, color);
 }
@@ -16,7 +16,7 @@ extern bool waitAfterNextDraw;
 Kore::VertexBufferImpl::VertexBufferImpl(int count, const Graphics4::VertexStructure& structure, int instanceDataStepRate)
     : _multiple(multiple), _buffer(count * multiple, structure, false, instanceDataStepRate), _lastFrameNumber(0), _currentIndex(0), myCount(count) {}
 
-Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate)
+Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate, Usage usage)
     : VertexBufferImpl(count, structure, instanceDataStepRate) {}
 
 Graphics4::VertexBuffer::~VertexBuffer() {}
@@ -51,6 +51,10 @@ void Graphics4::VertexBuffer::unlock() {
 	_buffer.unlock();
 }
 
+void Graphics4::VertexBuffer::unlock(int count) {
+	unlock();
+}
+
 int Graphics4::VertexBuffer::count() {
 	return myCount;
 }
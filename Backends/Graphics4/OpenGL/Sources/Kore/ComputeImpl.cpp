@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "ComputeImpl.h"
+#include "StateCache.h"
 #include "ogl.h"
 
 #include <Kore/Compute/Compute.h>
@@ -56,30 +57,30 @@ namespace {
 	}
 
 	void setTextureAddressingInternal(GLenum target, ComputeTextureUnit unit, Graphics4::TexDir dir, Graphics4::TextureAddressing addressing) {
-		glActiveTexture(GL_TEXTURE0 + unit.unit);
+		OpenGL::activeTexture(unit.unit);
 		GLenum texDir = dir == Graphics4::U ? GL_TEXTURE_WRAP_S : (Graphics4::V ? GL_TEXTURE_WRAP_T : GL_TEXTURE_WRAP_R);
 		switch (addressing) {
 		case Graphics4::Clamp:
-			glTexParameteri(target, texDir, GL_CLAMP_TO_EDGE);
+			OpenGL::texParameteri(target, texDir, GL_CLAMP_TO_EDGE);
 			break;
 		case Graphics4::Repeat:
 		default:
-			glTexParameteri(target, texDir, GL_REPEAT);
+			OpenGL::texParameteri(target, texDir, GL_REPEAT);
 			break;
 		}
 		glCheckErrors();
 	}
 
 	void setTextureMagnificationFilterInternal(GLenum target, ComputeTextureUnit unit, Graphics4::TextureFilter filter) {
-		glActiveTexture(GL_TEXTURE0 + unit.unit);
+		OpenGL::activeTexture(unit.unit);
 		switch (filter) {
 		case Graphics4::PointFilter:
-			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			OpenGL::texParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			break;
 		case Graphics4::LinearFilter:
 		case Graphics4::AnisotropicFilter:
 		default:
-			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			OpenGL::texParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			break;
 		}
 		glCheckErrors();
@@ -89,18 +90,18 @@ namespace {
 	Graphics4::MipmapFilter mipFilters[32] = {Graphics4::NoMipFilter};
 
 	void setMinMipFilters(GLenum target, int unit) {
-		glActiveTexture(GL_TEXTURE0 + unit);
+		OpenGL::activeTexture(unit);
 		switch (minFilters[unit]) {
 		case Graphics4::PointFilter:
 			switch (mipFilters[unit]) {
 			case Graphics4::NoMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 				break;
 			case Graphics4::PointMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
 				break;
 			case Graphics4::LinearMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
 				break;
 			}
 			break;
@@ -108,19 +109,19 @@ namespace {
 		case Graphics4::AnisotropicFilter:
 			switch (mipFilters[unit]) {
 			case Graphics4::NoMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 				break;
 			case Graphics4::PointMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
 				break;
 			case Graphics4::LinearMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 				break;
 			}
 			if (minFilters[unit] == Graphics4::AnisotropicFilter) {
 				float maxAniso = 0.0f;
 				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAniso);
-				glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAniso);
+				OpenGL::texParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAniso);
 			}
 			break;
 		}
@@ -182,6 +183,7 @@ ComputeShaderImpl::~ComputeShaderImpl() {
 	_source = nullptr;
 #ifdef HAS_COMPUTE
 	glDeleteProgram(_programid);
+	OpenGL::forgetProgram(_programid);
 	glDeleteShader(_id);
 #endif
 }
@@ -327,7 +329,7 @@ void Compute::setBuffer(ShaderStorageBuffer* buffer, int index) {
 
 void Compute::setTexture(ComputeTextureUnit unit, Graphics4::Texture* texture, Access access) {
 #ifdef HAS_COMPUTE
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors2();
 	GLenum glaccess = access == Read ? GL_READ_ONLY : (access == Write ? GL_WRITE_ONLY : GL_READ_WRITE);
 	glBindImageTexture(unit.unit, texture->texture, 0, GL_FALSE, 0, glaccess, convertInternalFormat(texture->format));
@@ -337,7 +339,7 @@ void Compute::setTexture(ComputeTextureUnit unit, Graphics4::Texture* texture, A
 
 void Compute::setTexture(ComputeTextureUnit unit, Graphics4::RenderTarget* target, Access access) {
 #ifdef HAS_COMPUTE
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors2();
 	GLenum glaccess = access == Read ? GL_READ_ONLY : (access == Write ? GL_WRITE_ONLY : GL_READ_WRITE);
 	glBindImageTexture(unit.unit, target->_texture, 0, GL_FALSE, 0, glaccess, convertInternalFormat((Graphics4::RenderTargetFormat)target->format));
@@ -347,28 +349,28 @@ void Compute::setTexture(ComputeTextureUnit unit, Graphics4::RenderTarget* targe
 
 void Compute::setSampledTexture(ComputeTextureUnit unit, Graphics4::Texture* texture) {
 #ifdef HAS_COMPUTE
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors2();
 	GLenum gltarget = texture->depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
-	glBindTexture(gltarget, texture->texture);
+	OpenGL::bindTexture(gltarget, texture->texture);
 	glCheckErrors2();
 #endif
 }
 
 void Compute::setSampledTexture(ComputeTextureUnit unit, Graphics4::RenderTarget* target) {
 #ifdef HAS_COMPUTE
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors2();
-	glBindTexture(target->isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, target->_texture);
+	OpenGL::bindTexture(target->isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, target->_texture);
 	glCheckErrors2();
 #endif
 }
 
 void Compute::setSampledDepthTexture(ComputeTextureUnit unit, Graphics4::RenderTarget* target) {
 #ifdef HAS_COMPUTE
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors2();
-	glBindTexture(target->isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, target->_depthTexture);
+	OpenGL::bindTexture(target->isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, target->_depthTexture);
 	glCheckErrors2();
 #endif
 }
@@ -427,7 +429,7 @@ void Compute::setTexture3DMipmapFilter(ComputeTextureUnit unit, Graphics4::Mipma
 
 void Compute::setShader(ComputeShader* shader) {
 #ifdef HAS_COMPUTE
-	glUseProgram(shader->_programid);
+	OpenGL::useProgram(shader->_programid);
 	glCheckErrors2();
 #endif
 }
@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include "StateCache.h"
 #include "ogl.h"
 
 #include <Kore/Graphics4/Graphics.h>
@@ -8,9 +9,10 @@ using namespace Kore;
 
 Graphics4::IndexBuffer* IndexBufferImpl::current = nullptr;
 
-IndexBufferImpl::IndexBufferImpl(int count) : myCount(count) {}
+IndexBufferImpl::IndexBufferImpl(int count) : myCount(count), allocated(false) {}
 
-Graphics4::IndexBuffer::IndexBuffer(int indexCount) : IndexBufferImpl(indexCount) {
+Graphics4::IndexBuffer::IndexBuffer(int indexCount, Usage usage) : IndexBufferImpl(indexCount) {
+	dynamic = usage == DynamicUsage;
 	glGenBuffers(1, &bufferId);
 	glCheckErrors();
 	data = new int[indexCount];
@@ -21,7 +23,12 @@ Graphics4::IndexBuffer::IndexBuffer(int indexCount) : IndexBufferImpl(indexCount
 
 Graphics4::IndexBuffer::~IndexBuffer() {
 	unset();
+	glDeleteBuffers(1, &bufferId);
+	OpenGL::forgetBuffer(bufferId);
 	delete[] data;
+#if defined(KORE_ANDROID) || defined(KORE_PI)
+	delete[] shortData;
+#endif
 }
 
 int* Graphics4::IndexBuffer::lock() {
@@ -32,22 +39,32 @@ void Graphics4::IndexBuffer::unlock() {
 #if defined(KORE_ANDROID) || defined(KORE_PI)
 	for (int i = 0; i < myCount; ++i) shortData[i] = (u16)data[i];
 #endif
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
+	OpenGL::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
 	glCheckErrors();
 #if defined(KORE_ANDROID) || defined(KORE_PI)
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, myCount * 2, shortData, GL_STATIC_DRAW);
-	glCheckErrors();
+	void* indices = shortData;
+	int size = myCount * 2;
 #else
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, myCount * 4, data, GL_STATIC_DRAW);
-	glCheckErrors();
+	void* indices = data;
+	int size = myCount * 4;
 #endif
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (dynamic || !allocated) {
+		// dynamic buffers orphan their old storage instead of waiting for the GPU to release it
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+		glCheckErrors();
+		allocated = true;
+	}
+	else {
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, indices);
+		glCheckErrors();
+	}
+	OpenGL::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glCheckErrors();
 }
 
 void Graphics4::IndexBuffer::_set() {
 	current = this;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
+	OpenGL::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
 	glCheckErrors();
 }
 
@@ -17,6 +17,8 @@ namespace Kore {
 		int* data;
 		int myCount;
 		uint bufferId;
+		bool dynamic;
+		bool allocated;
 
 	public:
 		static Graphics4::IndexBuffer* current;
@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 
 #include "OpenGL.h"
+#include "StateCache.h"
 #include "VertexBufferImpl.h"
 #include "ogl.h"
 
@@ -42,6 +43,9 @@ namespace Kore {
 	extern bool programUsesTessellation;
 #endif
 	bool supportsConservativeRaster = false;
+	bool supportsBufferStorage = false;
+	bool supportsProgramBinary = false;
+	bool supportsParallelShaderCompile = false;
 }
 
 namespace {
@@ -68,6 +72,7 @@ namespace {
 	bool renderToBackbuffer;
 
 	Graphics4::PipelineState* lastPipeline = nullptr;
+	int lastContext = -1;
 
 #if defined(KORE_OPENGL_ES) && defined(KORE_ANDROID) && KORE_ANDROID_API >= 18
 	void* glesDrawBuffers;
@@ -189,8 +194,9 @@ void Graphics4::init(int windowId, int depthBufferBits, int stencilBufferBits, b
 #endif
 
 #ifndef VR_RIFT
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	OpenGL::invalidateState();
+	OpenGL::enable(GL_BLEND, true);
+	OpenGL::blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glViewport(0, 0, System::windowWidth(windowId), System::windowHeight(windowId));
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &originalFramebuffer[windowId]);
 
@@ -238,10 +244,28 @@ void Graphics4::init(int windowId, int depthBufferBits, int stencilBufferBits, b
 		if (extension != nullptr && strcmp(extension, "GL_NV_conservative_raster") == 0) {
 			supportsConservativeRaster = true;
 		}
+		if (extension != nullptr && strcmp(extension, "GL_ARB_buffer_storage") == 0) {
+			supportsBufferStorage = true;
+		}
+		if (extension != nullptr && strcmp(extension, "GL_ARB_get_program_binary") == 0) {
+			supportsProgramBinary = true;
+		}
+		if (extension != nullptr && (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)) {
+			supportsParallelShaderCompile = true;
+		}
 	}
+#ifdef KORE_OPENGL_PROGRAM_BINARY
+	// drivers may support the extension without offering any binary format
+	if (supportsProgramBinary) {
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		supportsProgramBinary = formats > 0;
+	}
+#endif
 #endif
 
 	lastPipeline = nullptr;
+	lastContext = windowId;
 }
 
 void Graphics4::changeResolution(int width, int height) {
@@ -401,6 +425,11 @@ void Graphics4::begin(int contextId) {
 
 	// System::setCurrentDevice(contextId);
 	System::makeCurrent(contextId);
+	if (contextId != lastContext) {
+		// the cache only knows the state of one context
+		OpenGL::invalidateState();
+		lastContext = contextId;
+	}
 
 	glViewport(0, 0, _width, _height);
 
@@ -420,17 +449,17 @@ void Graphics4::viewport(int x, int y, int width, int height) {
 }
 
 void Graphics4::scissor(int x, int y, int width, int height) {
-	glEnable(GL_SCISSOR_TEST);
+	OpenGL::enable(GL_SCISSOR_TEST, true);
 	if (renderToBackbuffer) {
-		glScissor(x, _renderTargetHeight - y - height, width, height);
+		OpenGL::scissor(x, _renderTargetHeight - y - height, width, height);
 	}
 	else {
-		glScissor(x, y, width, height);
+		OpenGL::scissor(x, y, width, height);
 	}
 }
 
 void Graphics4::disableScissor() {
-	glDisable(GL_SCISSOR_TEST);
+	OpenGL::enable(GL_SCISSOR_TEST, false);
 }
 
 /*void glCheckErrors() {
@@ -483,15 +512,13 @@ void Graphics4::end(int windowId) {
 }
 
 void Graphics4::clear(uint flags, uint color, float depth, int stencil) {
-	glColorMask(true, true, true, true);
-	glCheckErrors();
+	OpenGL::colorMask(true, true, true, true);
 	glClearColor(((color & 0x00ff0000) >> 16) / 255.0f, ((color & 0x0000ff00) >> 8) / 255.0f, (color & 0x000000ff) / 255.0f,
 	             ((color & 0xff000000) >> 24) / 255.0f);
 	glCheckErrors();
 	if (flags & ClearDepthFlag) {
-		glEnable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glCheckErrors();
+		OpenGL::enable(GL_DEPTH_TEST, true);
+		OpenGL::depthMask(true);
 	}
 #ifdef KORE_OPENGL_ES
 	glClearDepthf(depth);
@@ -499,8 +526,7 @@ void Graphics4::clear(uint flags, uint color, float depth, int stencil) {
 	glClearDepth(depth);
 #endif
 	glCheckErrors();
-	glStencilMask(0xff);
-	glCheckErrors();
+	OpenGL::stencilMask(0xff);
 	glClearStencil(stencil);
 	glCheckErrors();
 	GLbitfield oglflags = ((flags & ClearColorFlag) ? GL_COLOR_BUFFER_BIT : 0) | ((flags & ClearDepthFlag) ? GL_DEPTH_BUFFER_BIT : 0) |
@@ -514,11 +540,9 @@ void Graphics4::clear(uint flags, uint color, float depth, int stencil) {
 
 void Graphics4::setVertexBuffers(VertexBuffer** vertexBuffers, int count) {
 #if defined(KORE_IOS)
-	glBindVertexArrayOES(arrayId[0]);
-	glCheckErrors();
+	OpenGL::bindVertexArray(arrayId[0]);
 #elif !defined(KORE_ANDROID) && !defined(KORE_HTML5) && !defined(KORE_TIZEN) && !defined(KORE_PI)
-	glBindVertexArray(arrayId[System::currentDevice()]);
-	glCheckErrors();
+	OpenGL::bindVertexArray(arrayId[System::currentDevice()]);
 #endif
 
 	int offset = 0;
@@ -541,7 +565,7 @@ void Graphics4::setImageTexture(TextureUnit unit, Texture* texture) {
 
 namespace {
 	void setTextureAddressingInternal(GLenum target, Graphics4::TextureUnit unit, Graphics4::TexDir dir, Graphics4::TextureAddressing addressing) {
-		glActiveTexture(GL_TEXTURE0 + unit.unit);
+		OpenGL::activeTexture(unit.unit);
 		GLenum texDir;
 		switch (dir) {
 		case Graphics4::U:
@@ -558,18 +582,18 @@ namespace {
 		}
 		switch (addressing) {
 		case Graphics4::Clamp:
-			glTexParameteri(target, texDir, GL_CLAMP_TO_EDGE);
+			OpenGL::texParameteri(target, texDir, GL_CLAMP_TO_EDGE);
 			break;
 		case Graphics4::Repeat:
-			glTexParameteri(target, texDir, GL_REPEAT);
+			OpenGL::texParameteri(target, texDir, GL_REPEAT);
 			break;
 		case Graphics4::Border:
 			// unsupported
-			glTexParameteri(target, texDir, GL_CLAMP_TO_EDGE);
+			OpenGL::texParameteri(target, texDir, GL_CLAMP_TO_EDGE);
 			break;
 		case Graphics4::Mirror:
 			// unsupported
-			glTexParameteri(target, texDir, GL_REPEAT);
+			OpenGL::texParameteri(target, texDir, GL_REPEAT);
 			break;
 		}
 		glCheckErrors();
@@ -588,15 +612,15 @@ void Graphics4::setTexture3DAddressing(TextureUnit unit, TexDir dir, TextureAddr
 
 namespace {
 	void setTextureMagnificationFilterInternal(GLenum target, Graphics4::TextureUnit texunit, Graphics4::TextureFilter filter) {
-		glActiveTexture(GL_TEXTURE0 + texunit.unit);
+		OpenGL::activeTexture(texunit.unit);
 		glCheckErrors();
 		switch (filter) {
 		case Graphics4::PointFilter:
-			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			OpenGL::texParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			break;
 		case Graphics4::LinearFilter:
 		case Graphics4::AnisotropicFilter:
-			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			OpenGL::texParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			break;
 		}
 		glCheckErrors();
@@ -615,19 +639,19 @@ void Graphics4::setTexture3DMagnificationFilter(TextureUnit texunit, TextureFilt
 
 namespace {
 	void setMinMipFilters(GLenum target, int unit) {
-		glActiveTexture(GL_TEXTURE0 + unit);
+		OpenGL::activeTexture(unit);
 		glCheckErrors();
 		switch (minFilters[System::currentDevice()][unit]) {
 		case Graphics4::PointFilter:
 			switch (mipFilters[System::currentDevice()][unit]) {
 			case Graphics4::NoMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 				break;
 			case Graphics4::PointMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
 				break;
 			case Graphics4::LinearMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
 				break;
 			}
 			break;
@@ -635,19 +659,19 @@ namespace {
 		case Graphics4::AnisotropicFilter:
 			switch (mipFilters[System::currentDevice()][unit]) {
 			case Graphics4::NoMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 				break;
 			case Graphics4::PointMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
 				break;
 			case Graphics4::LinearMipFilter:
-				glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				OpenGL::texParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 				break;
 			}
 			if (minFilters[System::currentDevice()][unit] == Graphics4::AnisotropicFilter) {
 				float maxAniso = 0.0f;
 				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAniso);
-				glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAniso);
+				OpenGL::texParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAniso);
 			}
 			break;
 		}
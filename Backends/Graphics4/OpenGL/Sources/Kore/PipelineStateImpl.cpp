@@ -1,11 +1,13 @@
 #include "pch.h"
 
+#include "StateCache.h"
 #include "ogl.h"
 
 #include <Kore/Graphics4/Graphics.h>
 #include <Kore/Graphics4/PipelineState.h>
 #include <Kore/Graphics4/Shader.h>
 #include <Kore/Log.h>
+#include <Kore/System.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,8 +19,14 @@ namespace Kore {
 	bool programUsesTessellation = false;
 #endif
 	extern bool supportsConservativeRaster;
+	extern bool supportsProgramBinary;
+	extern bool supportsParallelShaderCompile;
 }
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace {
 	GLenum convert(Graphics4::StencilAction action) {
 		switch (action) {
@@ -70,7 +78,7 @@ namespace {
 	}
 }
 
-PipelineStateImpl::PipelineStateImpl() : textureCount(0) {
+PipelineStateImpl::PipelineStateImpl() : textureCount(0), assignedTextures(0), linking(false), cacheKey(0) {
 	// TODO: Get rid of allocations
 	textures = new char*[16];
 	for (int i = 0; i < 16; ++i) {
@@ -90,6 +98,7 @@ PipelineStateImpl::~PipelineStateImpl() {
 	delete[] textures;
 	delete[] textureValues;
 	glDeleteProgram(programId);
+	OpenGL::forgetProgram(programId);
 }
 
 namespace {
@@ -116,95 +125,279 @@ namespace {
 		glCheckErrors();
 		glShaderSource(id, 1, (const GLchar**)&source, 0);
 		glCompileShader(id);
+	}
 
+	// Querying the status waits for the compiler, so it is only done once all shaders were submitted
+	void checkShader(Graphics4::Shader* shader) {
+		if (shader == nullptr || shader->_glid == 0) return;
 		int result;
-		glGetShaderiv(id, GL_COMPILE_STATUS, &result);
+		glGetShaderiv(shader->_glid, GL_COMPILE_STATUS, &result);
 		if (result != GL_TRUE) {
 			int length;
-			glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+			glGetShaderiv(shader->_glid, GL_INFO_LOG_LENGTH, &length);
 			char* errormessage = new char[length];
-			glGetShaderInfoLog(id, length, nullptr, errormessage);
+			glGetShaderInfoLog(shader->_glid, length, nullptr, errormessage);
 			printf("GLSL compiler error: %s\n", errormessage);
 			delete[] errormessage;
 		}
 	}
-}
 
-void Graphics4::PipelineState::compile() {
-	compileShader(vertexShader->_glid, vertexShader->source, vertexShader->length, VertexShader);
-	compileShader(fragmentShader->_glid, fragmentShader->source, fragmentShader->length, FragmentShader);
+	// Compiles the shaders from source and starts linking them without waiting for either
+	void startLink(Graphics4::PipelineState* pipeline) {
+		uint programId = pipeline->programId;
+		Graphics4::Shader* vertexShader = pipeline->vertexShader;
+		Graphics4::Shader* fragmentShader = pipeline->fragmentShader;
+		compileShader(vertexShader->_glid, vertexShader->source, vertexShader->length, Graphics4::VertexShader);
+		compileShader(fragmentShader->_glid, fragmentShader->source, fragmentShader->length, Graphics4::FragmentShader);
 #ifndef OPENGLES
-	if (geometryShader != nullptr) compileShader(geometryShader->_glid, geometryShader->source, geometryShader->length, GeometryShader);
-	if (tessellationControlShader != nullptr)
-		compileShader(tessellationControlShader->_glid, tessellationControlShader->source, tessellationControlShader->length, TessellationControlShader);
-	if (tessellationEvaluationShader != nullptr)
-		compileShader(tessellationEvaluationShader->_glid, tessellationEvaluationShader->source, tessellationEvaluationShader->length,
-		              TessellationEvaluationShader);
+		Graphics4::Shader* geometryShader = pipeline->geometryShader;
+		Graphics4::Shader* tessellationControlShader = pipeline->tessellationControlShader;
+		Graphics4::Shader* tessellationEvaluationShader = pipeline->tessellationEvaluationShader;
+		if (geometryShader != nullptr) compileShader(geometryShader->_glid, geometryShader->source, geometryShader->length, Graphics4::GeometryShader);
+		if (tessellationControlShader != nullptr)
+			compileShader(tessellationControlShader->_glid, tessellationControlShader->source, tessellationControlShader->length,
+			              Graphics4::TessellationControlShader);
+		if (tessellationEvaluationShader != nullptr)
+			compileShader(tessellationEvaluationShader->_glid, tessellationEvaluationShader->source, tessellationEvaluationShader->length,
+			              Graphics4::TessellationEvaluationShader);
 #endif
-	glAttachShader(programId, vertexShader->_glid);
-	glAttachShader(programId, fragmentShader->_glid);
+		glAttachShader(programId, vertexShader->_glid);
+		glAttachShader(programId, fragmentShader->_glid);
 #ifndef OPENGLES
-	if (geometryShader != nullptr) glAttachShader(programId, geometryShader->_glid);
-	if (tessellationControlShader != nullptr) glAttachShader(programId, tessellationControlShader->_glid);
-	if (tessellationEvaluationShader != nullptr) glAttachShader(programId, tessellationEvaluationShader->_glid);
+		if (geometryShader != nullptr) glAttachShader(programId, geometryShader->_glid);
+		if (tessellationControlShader != nullptr) glAttachShader(programId, tessellationControlShader->_glid);
+		if (tessellationEvaluationShader != nullptr) glAttachShader(programId, tessellationEvaluationShader->_glid);
 #endif
-	glCheckErrors();
+		glCheckErrors();
 
-	int index = 0;
-	for (int i1 = 0; inputLayout[i1] != nullptr; ++i1) {
-		for (int i2 = 0; i2 < inputLayout[i1]->size; ++i2) {
-			VertexElement element = inputLayout[i1]->elements[i2];
-			glBindAttribLocation(programId, index, element.name);
-			glCheckErrors();
-			if (element.data == Float4x4VertexData) {
-				index += 4;
+		int index = 0;
+		for (int i1 = 0; pipeline->inputLayout[i1] != nullptr; ++i1) {
+			for (int i2 = 0; i2 < pipeline->inputLayout[i1]->size; ++i2) {
+				Graphics4::VertexElement element = pipeline->inputLayout[i1]->elements[i2];
+				glBindAttribLocation(programId, index, element.name);
+				glCheckErrors();
+				if (element.data == Graphics4::Float4x4VertexData) {
+					index += 4;
+				}
+				else {
+					++index;
+				}
 			}
-			else {
-				++index;
+		}
+
+		glLinkProgram(programId);
+	}
+
+	// Waits for startLink, returns whether linking succeeded
+	bool finishLink(Graphics4::PipelineState* pipeline) {
+		checkShader(pipeline->vertexShader);
+		checkShader(pipeline->fragmentShader);
+#ifndef OPENGLES
+		checkShader(pipeline->geometryShader);
+		checkShader(pipeline->tessellationControlShader);
+		checkShader(pipeline->tessellationEvaluationShader);
+#endif
+
+		uint programId = pipeline->programId;
+		int result;
+		glGetProgramiv(programId, GL_LINK_STATUS, &result);
+		if (result != GL_TRUE) {
+			int length;
+			glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &length);
+			char* errormessage = new char[length];
+			glGetProgramInfoLog(programId, length, nullptr, errormessage);
+			printf("GLSL linker error: %s\n", errormessage);
+			delete[] errormessage;
+			return false;
+		}
+		return true;
+	}
+
+#ifdef KORE_OPENGL_PROGRAM_BINARY
+	// Linked programs are cached in the save directory, one file per program:
+	// char magic[4] = "KPGB", int version, u64 key, u32 binaryFormat, int binaryLength, u8 binary[binaryLength]
+	const int programCacheVersion = 1;
+	// a cache which can not be written is reported once and not for every pipeline
+	bool cacheWarned = false;
+
+	u64 hash(u64 hash, const void* data, int size) {
+		const u8* bytes = (const u8*)data;
+		for (int i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	u64 hashString(u64 key, const char* text) {
+		if (text == nullptr) text = "";
+		return hash(key, text, (int)strlen(text) + 1);
+	}
+
+	u64 hashShader(u64 key, Graphics4::Shader* shader) {
+		int length = shader != nullptr ? shader->length : -1;
+		key = hash(key, &length, sizeof(length));
+		if (shader != nullptr) key = hash(key, shader->source, shader->length);
+		return key;
+	}
+
+	// Binaries depend on the shaders, the attribute locations of the vertex layout and the driver which compiled them
+	u64 hashProgram(Graphics4::PipelineState* pipeline) {
+		u64 key = 14695981039346656037ull;
+		key = hashString(key, (const char*)glGetString(GL_VENDOR));
+		key = hashString(key, (const char*)glGetString(GL_RENDERER));
+		key = hashString(key, (const char*)glGetString(GL_VERSION));
+		key = hashShader(key, pipeline->vertexShader);
+		key = hashShader(key, pipeline->fragmentShader);
+		key = hashShader(key, pipeline->geometryShader);
+		key = hashShader(key, pipeline->tessellationControlShader);
+		key = hashShader(key, pipeline->tessellationEvaluationShader);
+		for (int i1 = 0; pipeline->inputLayout[i1] != nullptr; ++i1) {
+			for (int i2 = 0; i2 < pipeline->inputLayout[i1]->size; ++i2) {
+				Graphics4::VertexElement& element = pipeline->inputLayout[i1]->elements[i2];
+				key = hashString(key, element.name);
+				key = hash(key, &element.data, sizeof(element.data));
 			}
+			key = hash(key, "|", 1);
 		}
+		return key;
+	}
+
+	FILE* openCacheFile(u64 key, const char* mode) {
+		char path[1024];
+		snprintf(path, sizeof(path), "%sprogram-%016llx.glbin", System::savePath(), (unsigned long long)key);
+		return fopen(path, mode);
 	}
 
-	glLinkProgram(programId);
-
-	int result;
-	glGetProgramiv(programId, GL_LINK_STATUS, &result);
-	if (result != GL_TRUE) {
-		int length;
-		glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &length);
-		char* errormessage = new char[length];
-		glGetProgramInfoLog(programId, length, nullptr, errormessage);
-		printf("GLSL linker error: %s\n", errormessage);
-		delete[] errormessage;
+	bool loadProgram(uint programId, u64 key) {
+		FILE* file = openCacheFile(key, "rb");
+		if (file == nullptr) return false;
+
+		char magic[4];
+		int version = 0;
+		u64 fileKey = 0;
+		u32 format = 0;
+		int length = 0;
+		bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, "KPGB", 4) == 0 && fread(&version, sizeof(version), 1, file) == 1 &&
+		             version == programCacheVersion && fread(&fileKey, sizeof(fileKey), 1, file) == 1 && fileKey == key &&
+		             fread(&format, sizeof(format), 1, file) == 1 && fread(&length, sizeof(length), 1, file) == 1 && length > 0;
+		u8* binary = nullptr;
+		if (valid) {
+			binary = new u8[length];
+			valid = fread(binary, 1, length, file) == (size_t)length;
+		}
+		fclose(file);
+
+		int result = GL_FALSE;
+		if (valid) {
+			glProgramBinary(programId, format, binary, length);
+			glGetProgramiv(programId, GL_LINK_STATUS, &result);
+		}
+		delete[] binary;
+		// stale binaries are rejected by the driver, the program is linked from source and the file is replaced
+		return result == GL_TRUE;
+	}
+
+	void saveProgram(uint programId, u64 key) {
+		int length = 0;
+		glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+		u8* binary = new u8[length];
+		GLenum format = 0;
+		glGetProgramBinary(programId, length, &length, &format, binary);
+
+		FILE* file = openCacheFile(key, "wb");
+		if (file == nullptr) {
+			if (!cacheWarned) log(Warning, "Could not write the program cache to %s.", System::savePath());
+			cacheWarned = true;
+		}
+		else {
+			u32 fileFormat = format;
+			fwrite("KPGB", 1, 4, file);
+			fwrite(&programCacheVersion, sizeof(programCacheVersion), 1, file);
+			fwrite(&key, sizeof(key), 1, file);
+			fwrite(&fileFormat, sizeof(fileFormat), 1, file);
+			fwrite(&length, sizeof(length), 1, file);
+			fwrite(binary, 1, length, file);
+			fclose(file);
+		}
+		delete[] binary;
 	}
+#endif
+
+	// Waits for compileAsync and stores the program binary
+	void finishCompile(Graphics4::PipelineState* pipeline) {
+		if (!pipeline->linking) return;
+		pipeline->linking = false;
+		bool linked = finishLink(pipeline);
+#ifdef KORE_OPENGL_PROGRAM_BINARY
+		if (linked && supportsProgramBinary) saveProgram(pipeline->programId, pipeline->cacheKey);
+#else
+		(void)linked;
+#endif
 
 #ifndef KORE_OPENGL_ES
 #ifndef KORE_LINUX
-	if (tessellationControlShader != nullptr) {
-		glPatchParameteri(GL_PATCH_VERTICES, 3);
-		glCheckErrors();
-	}
+		if (pipeline->tessellationControlShader != nullptr) {
+			glPatchParameteri(GL_PATCH_VERTICES, 3);
+			glCheckErrors();
+		}
 #endif
 #endif
+	}
+}
+
+void Graphics4::PipelineState::compile() {
+	compileAsync();
+	finishCompile(this);
+}
+
+void Graphics4::PipelineState::compileAsync() {
+	if (linking) return;
+#ifdef KORE_OPENGL_PROGRAM_BINARY
+	if (supportsProgramBinary) {
+		cacheKey = hashProgram(this);
+		if (loadProgram(programId, cacheKey)) return;
+		glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+#endif
+	startLink(this);
+	linking = true;
+}
+
+bool Graphics4::PipelineState::isReady() {
+	if (!linking) return true;
+	// without GL_KHR_parallel_shader_compile there is no way to ask, so this waits for the driver
+	if (supportsParallelShaderCompile) {
+		int completed = GL_FALSE;
+		glGetProgramiv(programId, GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed != GL_TRUE) return false;
+	}
+	finishCompile(this);
+	return true;
+}
+
+// Querying the link status waits for the driver instead of polling GL_COMPLETION_STATUS_KHR
+void Graphics4::PipelineState::waitUntilReady() {
+	finishCompile(this);
 }
 
 void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
+	finishCompile(pipeline);
 #ifndef KORE_OPENGL_ES
 	programUsesTessellation = pipeline->tessellationControlShader != nullptr;
 #endif
-	glUseProgram(programId);
-	glCheckErrors();
-	for (int index = 0; index < textureCount; ++index) {
+	OpenGL::useProgram(programId);
+	// sampler uniforms are stored in the program, each one only has to be assigned once
+	for (int index = assignedTextures; index < textureCount; ++index) {
 		glUniform1i(textureValues[index], index);
 		glCheckErrors();
 	}
+	assignedTextures = textureCount;
 
 	if (pipeline->stencilMode == Graphics4::ZCompareAlways && pipeline->stencilBothPass == Graphics4::Keep && pipeline->stencilDepthFail == Graphics4::Keep &&
 	    pipeline->stencilFail == Graphics4::Keep) {
-		glDisable(GL_STENCIL_TEST);
+		OpenGL::enable(GL_STENCIL_TEST, false);
 	}
 	else {
-		glEnable(GL_STENCIL_TEST);
+		OpenGL::enable(GL_STENCIL_TEST, true);
 		int stencilFunc = 0;
 		switch (pipeline->stencilMode) {
 		case Graphics4::ZCompareAlways:
@@ -232,20 +425,15 @@ void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
 			stencilFunc = GL_NOTEQUAL;
 			break;
 		}
-		glStencilMask(pipeline->stencilWriteMask);
-		glStencilOp(convert(pipeline->stencilFail), convert(pipeline->stencilDepthFail), convert(pipeline->stencilBothPass));
-		glStencilFunc(stencilFunc, pipeline->stencilReferenceValue, pipeline->stencilReadMask);
+		OpenGL::stencilMask(pipeline->stencilWriteMask);
+		OpenGL::stencilOp(convert(pipeline->stencilFail), convert(pipeline->stencilDepthFail), convert(pipeline->stencilBothPass));
+		OpenGL::stencilFunc(stencilFunc, pipeline->stencilReferenceValue, pipeline->stencilReadMask);
 	}
 
-	glColorMask(pipeline->colorWriteMaskRed, pipeline->colorWriteMaskGreen, pipeline->colorWriteMaskBlue, pipeline->colorWriteMaskAlpha);
+	OpenGL::colorMask(pipeline->colorWriteMaskRed, pipeline->colorWriteMaskGreen, pipeline->colorWriteMaskBlue, pipeline->colorWriteMaskAlpha);
 
 	if (supportsConservativeRaster) {
-		if (pipeline->conservativeRasterization) {
-			glEnable(0x9346); // GL_CONSERVATIVE_RASTERIZATION_NV
-		}
-		else {
-			glDisable(0x9346);
-		}
+		OpenGL::enable(0x9346, pipeline->conservativeRasterization); // GL_CONSERVATIVE_RASTERIZATION_NV
 	}
 
 	glCheckErrors();
@@ -272,19 +460,8 @@ void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
 	throw Exception();
 	}*/
 
-	if (pipeline->depthWrite) {
-		glDepthMask(GL_TRUE);
-	}
-	else {
-		glDepthMask(GL_FALSE);
-	}
-
-	if (pipeline->depthMode != Graphics4::ZCompareAlways) {
-		glEnable(GL_DEPTH_TEST);
-	}
-	else {
-		glDisable(GL_DEPTH_TEST);
-	}
+	OpenGL::depthMask(pipeline->depthWrite);
+	OpenGL::enable(GL_DEPTH_TEST, pipeline->depthMode != Graphics4::ZCompareAlways);
 
 	GLenum func = GL_ALWAYS;
 	switch (pipeline->depthMode) {
@@ -314,22 +491,22 @@ void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
 		func = GL_GEQUAL;
 		break;
 	}
-	glDepthFunc(func);
+	OpenGL::depthFunc(func);
 	glCheckErrors();
 
 	switch (pipeline->cullMode) {
 	case Graphics4::Clockwise:
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		OpenGL::enable(GL_CULL_FACE, true);
+		OpenGL::cullFace(GL_BACK);
 		glCheckErrors();
 		break;
 	case Graphics4::CounterClockwise:
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
+		OpenGL::enable(GL_CULL_FACE, true);
+		OpenGL::cullFace(GL_FRONT);
 		glCheckErrors();
 		break;
 	case Graphics4::NoCulling:
-		glDisable(GL_CULL_FACE);
+		OpenGL::enable(GL_CULL_FACE, false);
 		glCheckErrors();
 		break;
 	default:
@@ -365,20 +542,16 @@ void PipelineStateImpl::set(Graphics4::PipelineState* pipeline) {
 	throw Exception();
 	}*/
 
-	if (pipeline->blendSource != Graphics4::BlendOne || pipeline->blendDestination != Graphics4::BlendZero ||
-	    pipeline->alphaBlendSource != Graphics4::BlendOne || pipeline->alphaBlendDestination != Graphics4::BlendZero) {
-		glEnable(GL_BLEND);
-	}
-	else {
-		glDisable(GL_BLEND);
-	}
+	OpenGL::enable(GL_BLEND, pipeline->blendSource != Graphics4::BlendOne || pipeline->blendDestination != Graphics4::BlendZero ||
+	                             pipeline->alphaBlendSource != Graphics4::BlendOne || pipeline->alphaBlendDestination != Graphics4::BlendZero);
 
 	// glBlendFunc(convert(pipeline->blendSource), convert(pipeline->blendDestination));
-	glBlendFuncSeparate(convert(pipeline->blendSource), convert(pipeline->blendDestination), convert(pipeline->alphaBlendSource),
-	                    convert(pipeline->alphaBlendDestination));
+	OpenGL::blendFuncSeparate(convert(pipeline->blendSource), convert(pipeline->blendDestination), convert(pipeline->alphaBlendSource),
+	                          convert(pipeline->alphaBlendDestination));
 }
 
 Graphics4::ConstantLocation Graphics4::PipelineState::getConstantLocation(const char* name) {
+	finishCompile(this);
 	ConstantLocation location;
 	location.location = glGetUniformLocation(programId, name);
 	location.type = GL_FLOAT;
@@ -413,6 +586,7 @@ int PipelineStateImpl::findTexture(const char* name) {
 }
 
 Graphics4::TextureUnit Graphics4::PipelineState::getTextureUnit(const char* name) {
+	finishCompile(this);
 	int index = findTexture(name);
 	if (index < 0) {
 		int location = glGetUniformLocation(programId, name);
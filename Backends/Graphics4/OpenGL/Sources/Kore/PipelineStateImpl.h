@@ -16,6 +16,10 @@ namespace Kore {
 		char** textures;
 		int* textureValues;
 		int textureCount;
+		int assignedTextures;
+		// set by compileAsync until the link status was queried
+		bool linking;
+		u64 cacheKey;
 		void set(Graphics4::PipelineState* pipeline);
 	};
 }
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "RenderTargetImpl.h"
+#include "StateCache.h"
 #include "ogl.h"
 
 #include <Kore/Graphics4/Graphics.h>
@@ -94,14 +95,14 @@ void RenderTargetImpl::setupDepthStencil(GLenum texType, int depthBufferBits, in
 		// Texture
 		glGenTextures(1, &_depthTexture);
 		glCheckErrors();
-		glBindTexture(texType, _depthTexture);
+		OpenGL::bindTexture(texType, _depthTexture);
 		glCheckErrors();
 		glTexImage2D(texType, 0, internalFormat, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
 		glCheckErrors();
-		glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(texType, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(texType, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		OpenGL::texParameteri(texType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(texType, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		OpenGL::texParameteri(texType, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glCheckErrors();
 		glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
 		glCheckErrors();
@@ -127,15 +128,15 @@ void RenderTargetImpl::setupDepthStencil(GLenum texType, int depthBufferBits, in
 		// Texture
 		glGenTextures(1, &_depthTexture);
 		glCheckErrors();
-		glBindTexture(texType, _depthTexture);
+		OpenGL::bindTexture(texType, _depthTexture);
 		glCheckErrors();
 		GLint format = depthBufferBits == 16 ? GL_DEPTH_COMPONENT16 : GL_DEPTH_COMPONENT;
 		glTexImage2D(texType, 0, format, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
 		glCheckErrors();
-		glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(texType, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(texType, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		OpenGL::texParameteri(texType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(texType, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		OpenGL::texParameteri(texType, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glCheckErrors();
 		glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
 		glCheckErrors();
@@ -167,16 +168,16 @@ Graphics4::RenderTarget::RenderTarget(int width, int height, int depthBufferBits
 
 	glGenTextures(1, &_texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, _texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D, _texture);
 	glCheckErrors();
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
 
 	switch (format) {
@@ -196,8 +197,8 @@ Graphics4::RenderTarget::RenderTarget(int width, int height, int depthBufferBits
 		break;
 	case Target16BitDepth:
 #ifdef KORE_OPENGL_ES
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 #endif
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, texWidth, texHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
 		break;
@@ -239,7 +240,7 @@ Graphics4::RenderTarget::RenderTarget(int width, int height, int depthBufferBits
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, 0);
+	OpenGL::bindTexture(GL_TEXTURE_2D, 0);
 	glCheckErrors();
 }
 
@@ -265,16 +266,16 @@ Graphics4::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool
 
 	glGenTextures(1, &_texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _texture);
+	OpenGL::bindTexture(GL_TEXTURE_CUBE_MAP, _texture);
 	glCheckErrors();
 
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
 
 	switch (format) {
@@ -294,8 +295,8 @@ Graphics4::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool
 		break;
 	case Target16BitDepth:
 #ifdef KORE_OPENGL_ES
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		OpenGL::texParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 #endif
 		for (int i = 0; i < 6; i++)
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT16, texWidth, texHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
@@ -325,7 +326,7 @@ Graphics4::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	OpenGL::bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	glCheckErrors();
 }
 
@@ -333,26 +334,28 @@ Graphics4::RenderTarget::~RenderTarget() {
 	{
 		GLuint textures[] = {_texture};
 		glDeleteTextures(1, textures);
+		OpenGL::forgetTexture(_texture);
 	}
 	if (_hasDepth) {
 		GLuint textures[] = {_depthTexture};
 		glDeleteTextures(1, textures);
+		OpenGL::forgetTexture(_depthTexture);
 	}
 	GLuint framebuffers[] = {_framebuffer};
 	glDeleteFramebuffers(1, framebuffers);
 }
 
 void Graphics4::RenderTarget::useColorAsTexture(TextureUnit unit) {
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors();
-	glBindTexture(isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _texture);
+	OpenGL::bindTexture(isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _texture);
 	glCheckErrors();
 }
 
 void Graphics4::RenderTarget::useDepthAsTexture(TextureUnit unit) {
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors();
-	glBindTexture(isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _depthTexture);
+	OpenGL::bindTexture(isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _depthTexture);
 	glCheckErrors();
 }
 
@@ -386,7 +389,7 @@ void Graphics4::RenderTarget::getPixels(u8* data) {
 }
 
 void Graphics4::RenderTarget::generateMipmaps(int levels) {
-	glBindTexture(GL_TEXTURE_2D, _texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D, _texture);
 	glCheckErrors();
 	glGenerateMipmap(GL_TEXTURE_2D);
 	glCheckErrors();
@@ -1,3 +1,4 @@
+#include "StateCache.h"
 #include "ogl.h"
 #include "pch.h"
 #include <Kore/Compute/Compute.h>
@@ -52,7 +53,7 @@ int* ShaderStorageBuffer::lock() {
 
 void ShaderStorageBuffer::unlock() {
 #ifdef HAS_COMPUTE
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+	OpenGL::bindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
 	glCheckErrors();
 	glBufferData(GL_SHADER_STORAGE_BUFFER, myCount * myStride, data, GL_STATIC_DRAW);
 	glCheckErrors();
@@ -62,7 +63,7 @@ void ShaderStorageBuffer::unlock() {
 void ShaderStorageBuffer::_set() {
 	current = this;
 #ifdef HAS_COMPUTE
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+	OpenGL::bindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
 	glCheckErrors();
 #endif
 }
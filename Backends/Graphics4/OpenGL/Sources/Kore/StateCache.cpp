@@ -0,0 +1,326 @@
+#include "pch.h"
+
+#include "StateCache.h"
+
+#include <vector>
+
+using namespace Kore;
+
+namespace {
+	const int maxUnits = 32;
+	// texture parameters are kept in an array indexed by texture name, larger names are not cached
+	const GLuint maxCachedTexture = 4096;
+
+	enum TextureTarget { Target2D, Target3D, TargetCube, Target2DArray, TargetExternal, TargetCount };
+	enum TextureParameter { MinFilter, MagFilter, WrapS, WrapT, WrapR, ParameterCount };
+	enum Capability { Blend, DepthTest, StencilTest, CullFace, ScissorTest, ConservativeRaster, CapabilityCount };
+
+	// -1 marks state which is not known
+	struct TextureParameters {
+		GLint values[ParameterCount];
+		GLfloat anisotropy;
+	};
+
+	OpenGL::StateCounters counters = {0, 0};
+
+	long long program;
+	long long vertexArray;
+	long long arrayBuffer;
+	long long elementBuffer;
+	int activeUnit;
+	long long textures[maxUnits][TargetCount];
+	std::vector<TextureParameters> textureParameters;
+
+	int capabilities[CapabilityCount];
+	long long blend[4];
+	int depthWrite;
+	long long depthCompare;
+	int colorWrite;
+	long long cullMode;
+	long long stencilWriteMask;
+	long long stencilOperations[3];
+	long long stencilTest[3];
+	int scissorRect[4];
+	bool scissorKnown;
+
+	// counts the call and tells whether it can be skipped
+	bool redundant(bool unchanged) {
+		if (unchanged) {
+			++counters.skipped;
+			return true;
+		}
+		++counters.issued;
+		return false;
+	}
+
+	int textureTarget(GLenum target) {
+		switch (target) {
+		case GL_TEXTURE_2D:
+			return Target2D;
+		case GL_TEXTURE_CUBE_MAP:
+			return TargetCube;
+#ifdef GL_TEXTURE_3D
+		case GL_TEXTURE_3D:
+			return Target3D;
+#endif
+#ifdef GL_TEXTURE_2D_ARRAY
+		case GL_TEXTURE_2D_ARRAY:
+			return Target2DArray;
+#endif
+#ifdef GL_TEXTURE_EXTERNAL_OES
+		case GL_TEXTURE_EXTERNAL_OES:
+			return TargetExternal;
+#endif
+		default:
+			return -1;
+		}
+	}
+
+	int textureParameter(GLenum name) {
+		switch (name) {
+		case GL_TEXTURE_MIN_FILTER:
+			return MinFilter;
+		case GL_TEXTURE_MAG_FILTER:
+			return MagFilter;
+		case GL_TEXTURE_WRAP_S:
+			return WrapS;
+		case GL_TEXTURE_WRAP_T:
+			return WrapT;
+#ifdef GL_TEXTURE_WRAP_R
+		case GL_TEXTURE_WRAP_R:
+			return WrapR;
+#endif
+		default:
+			return -1;
+		}
+	}
+
+	int capability(GLenum name) {
+		switch (name) {
+		case GL_BLEND:
+			return Blend;
+		case GL_DEPTH_TEST:
+			return DepthTest;
+		case GL_STENCIL_TEST:
+			return StencilTest;
+		case GL_CULL_FACE:
+			return CullFace;
+		case GL_SCISSOR_TEST:
+			return ScissorTest;
+		case 0x9346: // GL_CONSERVATIVE_RASTERIZATION_NV
+			return ConservativeRaster;
+		default:
+			return -1;
+		}
+	}
+
+	void forget(TextureParameters& parameters) {
+		for (int i = 0; i < ParameterCount; ++i) parameters.values[i] = -1;
+		parameters.anisotropy = -1.0f;
+	}
+
+	// Parameters of the texture bound to target in the active unit or nullptr if that is not known
+	TextureParameters* boundParameters(GLenum target) {
+		int index = textureTarget(target);
+		if (activeUnit < 0 || index < 0) return nullptr;
+		long long texture = textures[activeUnit][index];
+		if (texture < 0 || texture >= maxCachedTexture) return nullptr;
+		while ((long long)textureParameters.size() <= texture) {
+			TextureParameters parameters;
+			forget(parameters);
+			textureParameters.push_back(parameters);
+		}
+		return &textureParameters[(size_t)texture];
+	}
+}
+
+OpenGL::StateCounters OpenGL::stateCounters() {
+	return counters;
+}
+
+void OpenGL::resetStateCounters() {
+	counters.issued = 0;
+	counters.skipped = 0;
+}
+
+void OpenGL::invalidateState() {
+	program = vertexArray = arrayBuffer = elementBuffer = -1;
+	activeUnit = -1;
+	for (int unit = 0; unit < maxUnits; ++unit) {
+		for (int target = 0; target < TargetCount; ++target) textures[unit][target] = -1;
+	}
+	for (size_t i = 0; i < textureParameters.size(); ++i) forget(textureParameters[i]);
+	for (int i = 0; i < CapabilityCount; ++i) capabilities[i] = -1;
+	for (int i = 0; i < 4; ++i) blend[i] = -1;
+	depthWrite = colorWrite = -1;
+	depthCompare = cullMode = stencilWriteMask = -1;
+	for (int i = 0; i < 3; ++i) stencilOperations[i] = stencilTest[i] = -1;
+	scissorKnown = false;
+}
+
+void OpenGL::useProgram(GLuint program) {
+	if (redundant(::program == program)) return;
+	glUseProgram(program);
+	glCheckErrors();
+	::program = program;
+}
+
+void OpenGL::forgetProgram(GLuint program) {
+	if (::program == program) ::program = -1;
+}
+
+void OpenGL::bindVertexArray(GLuint array) {
+	if (redundant(vertexArray == array)) return;
+#if defined(KORE_IOS)
+	glBindVertexArrayOES(array);
+	glCheckErrors();
+#elif !defined(KORE_ANDROID) && !defined(KORE_HTML5) && !defined(KORE_TIZEN) && !defined(KORE_PI)
+	glBindVertexArray(array);
+	glCheckErrors();
+#endif
+	vertexArray = array;
+	// the index buffer binding is part of the vertex array
+	elementBuffer = -1;
+}
+
+void OpenGL::bindBuffer(GLenum target, GLuint buffer) {
+	long long* bound = target == GL_ARRAY_BUFFER ? &arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? &elementBuffer : nullptr;
+	if (redundant(bound != nullptr && *bound == buffer)) return;
+	glBindBuffer(target, buffer);
+	glCheckErrors();
+	if (bound != nullptr) *bound = buffer;
+}
+
+void OpenGL::forgetBuffer(GLuint buffer) {
+	// deleted buffers are unbound by GL
+	if (arrayBuffer == buffer) arrayBuffer = 0;
+	if (elementBuffer == buffer) elementBuffer = 0;
+}
+
+void OpenGL::activeTexture(int unit) {
+	if (redundant(activeUnit == unit)) return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glCheckErrors();
+	activeUnit = unit < maxUnits ? unit : -1;
+}
+
+void OpenGL::bindTexture(GLenum target, GLuint texture) {
+	int index = textureTarget(target);
+	long long* bound = activeUnit >= 0 && index >= 0 ? &textures[activeUnit][index] : nullptr;
+	if (redundant(bound != nullptr && *bound == texture)) return;
+	glBindTexture(target, texture);
+	glCheckErrors();
+	if (bound != nullptr) *bound = texture;
+}
+
+void OpenGL::texParameteri(GLenum target, GLenum name, GLint value) {
+	int parameter = textureParameter(name);
+	TextureParameters* parameters = parameter >= 0 ? boundParameters(target) : nullptr;
+	if (redundant(parameters != nullptr && parameters->values[parameter] == value)) return;
+	glTexParameteri(target, name, value);
+	glCheckErrors();
+	if (parameters != nullptr) parameters->values[parameter] = value;
+}
+
+void OpenGL::texParameterf(GLenum target, GLenum name, GLfloat value) {
+	bool anisotropy = name == 0x84FE; // GL_TEXTURE_MAX_ANISOTROPY_EXT
+	TextureParameters* parameters = anisotropy ? boundParameters(target) : nullptr;
+	if (redundant(parameters != nullptr && parameters->anisotropy == value)) return;
+	glTexParameterf(target, name, value);
+	glCheckErrors();
+	if (parameters != nullptr) parameters->anisotropy = value;
+}
+
+void OpenGL::forgetTexture(GLuint texture) {
+	// deleted textures are unbound by GL
+	for (int unit = 0; unit < maxUnits; ++unit) {
+		for (int target = 0; target < TargetCount; ++target) {
+			if (textures[unit][target] == texture) textures[unit][target] = 0;
+		}
+	}
+	if (texture < textureParameters.size()) forget(textureParameters[texture]);
+}
+
+void OpenGL::enable(GLenum capability, bool enabled) {
+	int index = ::capability(capability);
+	if (redundant(index >= 0 && capabilities[index] == (int)enabled)) return;
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+	glCheckErrors();
+	if (index >= 0) capabilities[index] = enabled;
+}
+
+void OpenGL::blendFuncSeparate(GLenum source, GLenum destination, GLenum alphaSource, GLenum alphaDestination) {
+	if (redundant(blend[0] == source && blend[1] == destination && blend[2] == alphaSource && blend[3] == alphaDestination)) return;
+	glBlendFuncSeparate(source, destination, alphaSource, alphaDestination);
+	glCheckErrors();
+	blend[0] = source;
+	blend[1] = destination;
+	blend[2] = alphaSource;
+	blend[3] = alphaDestination;
+}
+
+void OpenGL::depthMask(bool write) {
+	if (redundant(depthWrite == (int)write)) return;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	glCheckErrors();
+	depthWrite = write;
+}
+
+void OpenGL::depthFunc(GLenum func) {
+	if (redundant(depthCompare == func)) return;
+	glDepthFunc(func);
+	glCheckErrors();
+	depthCompare = func;
+}
+
+void OpenGL::colorMask(bool red, bool green, bool blue, bool alpha) {
+	int mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+	if (redundant(colorWrite == mask)) return;
+	glColorMask(red, green, blue, alpha);
+	glCheckErrors();
+	colorWrite = mask;
+}
+
+void OpenGL::cullFace(GLenum face) {
+	if (redundant(cullMode == face)) return;
+	glCullFace(face);
+	glCheckErrors();
+	cullMode = face;
+}
+
+void OpenGL::stencilMask(GLuint mask) {
+	if (redundant(stencilWriteMask == mask)) return;
+	glStencilMask(mask);
+	glCheckErrors();
+	stencilWriteMask = mask;
+}
+
+void OpenGL::stencilOp(GLenum fail, GLenum depthFail, GLenum pass) {
+	if (redundant(stencilOperations[0] == fail && stencilOperations[1] == depthFail && stencilOperations[2] == pass)) return;
+	glStencilOp(fail, depthFail, pass);
+	glCheckErrors();
+	stencilOperations[0] = fail;
+	stencilOperations[1] = depthFail;
+	stencilOperations[2] = pass;
+}
+
+void OpenGL::stencilFunc(GLenum func, GLint reference, GLuint mask) {
+	if (redundant(stencilTest[0] == func && stencilTest[1] == reference && stencilTest[2] == mask)) return;
+	glStencilFunc(func, reference, mask);
+	glCheckErrors();
+	stencilTest[0] = func;
+	stencilTest[1] = reference;
+	stencilTest[2] = mask;
+}
+
+void OpenGL::scissor(int x, int y, int width, int height) {
+	if (redundant(scissorKnown && scissorRect[0] == x && scissorRect[1] == y && scissorRect[2] == width && scissorRect[3] == height)) return;
+	glScissor(x, y, width, height);
+	glCheckErrors();
+	scissorRect[0] = x;
+	scissorRect[1] = y;
+	scissorRect[2] = width;
+	scissorRect[3] = height;
+	scissorKnown = true;
+}
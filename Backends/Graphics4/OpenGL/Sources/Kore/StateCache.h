@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ogl.h"
+
+namespace Kore {
+	namespace OpenGL {
+		// Shadow copy of the GL state which the Graphics4 backend sets.
+		// Calls which would not change anything are skipped, all others are forwarded to GL.
+		// Everything in the backend has to go through these functions, otherwise invalidateState has to be called.
+
+		struct StateCounters {
+			int issued;
+			int skipped;
+		};
+
+		// Number of cached GL calls which were forwarded to GL and which were skipped since the last reset
+		StateCounters stateCounters();
+		void resetStateCounters();
+
+		// Forgets all cached state, called when a context becomes current
+		void invalidateState();
+
+		void useProgram(GLuint program);
+		void forgetProgram(GLuint program);
+
+		void bindVertexArray(GLuint array);
+		void bindBuffer(GLenum target, GLuint buffer);
+		void forgetBuffer(GLuint buffer);
+
+		void activeTexture(int unit);
+		void bindTexture(GLenum target, GLuint texture);
+		// Parameters of the texture which is bound to target in the active unit
+		void texParameteri(GLenum target, GLenum name, GLint value);
+		void texParameterf(GLenum target, GLenum name, GLfloat value);
+		void forgetTexture(GLuint texture);
+
+		void enable(GLenum capability, bool enabled);
+		void blendFuncSeparate(GLenum source, GLenum destination, GLenum alphaSource, GLenum alphaDestination);
+		void depthMask(bool write);
+		void depthFunc(GLenum func);
+		void colorMask(bool red, bool green, bool blue, bool alpha);
+		void cullFace(GLenum face);
+		void stencilMask(GLuint mask);
+		void stencilOp(GLenum fail, GLenum depthFail, GLenum pass);
+		void stencilFunc(GLenum func, GLint reference, GLuint mask);
+		void scissor(int x, int y, int width, int height);
+	}
+}
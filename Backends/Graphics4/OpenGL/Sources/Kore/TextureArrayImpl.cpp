@@ -2,6 +2,7 @@
 
 #include <Kore/Graphics4/TextureArray.h>
 
+#include <Kore/StateCache.h>
 #include <Kore/ogl.h>
 
 using namespace Kore;
@@ -10,7 +11,7 @@ using namespace Kore::Graphics4;
 TextureArray::TextureArray(Image** textures, int count) {
 #ifdef GL_VERSION_4_2
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D_ARRAY, texture);
 	// glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, textures[0]->width, textures[0]->height, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, textures[0]->width, textures[0]->height, count);
 	for (int i = 0; i < count; ++i) {
@@ -21,7 +22,7 @@ TextureArray::TextureArray(Image** textures, int count) {
 
 void TextureArrayImpl::set(TextureUnit unit) {
 #ifdef GL_VERSION_4_2
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	OpenGL::activeTexture(unit.unit);
+	OpenGL::bindTexture(GL_TEXTURE_2D_ARRAY, texture);
 #endif
 }
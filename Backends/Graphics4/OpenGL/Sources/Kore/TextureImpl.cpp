@@ -1,12 +1,15 @@
 #include "pch.h"
 
 #include "TextureImpl.h"
+#include "StateCache.h"
 #include "ogl.h"
 
 #include <Kore/Graphics4/Graphics.h>
 #include <Kore/Graphics1/Image.h>
 #include <Kore/Log.h>
 
+#include <string.h>
+
 using namespace Kore;
 
 #ifndef GL_TEXTURE_3D
@@ -294,7 +297,7 @@ void Graphics4::Texture::init(const char* format, bool readable) {
 	glCheckErrors();
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D, texture);
 	glCheckErrors();
 
 	int convertedType = convertType(this->format);
@@ -325,13 +328,13 @@ void Graphics4::Texture::init(const char* format, bool readable) {
 		glCheckErrors();
 		break;
 	}
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	if (toPow2) {
 		delete[] conversionBuffer;
@@ -369,7 +372,7 @@ void Graphics4::Texture::init3D(bool readable) {
 	glCheckErrors();
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_3D, texture);
+	OpenGL::bindTexture(GL_TEXTURE_3D, texture);
 	glCheckErrors();
 
 	int convertedType = convertType(this->format);
@@ -380,15 +383,15 @@ void Graphics4::Texture::init3D(bool readable) {
 	glTexImage3D(GL_TEXTURE_3D, 0, convertInternalFormat(this->format), texWidth, texHeight, texDepth, 0, convertFormat(this->format), convertedType, texdata);
 	glCheckErrors();
 
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
 
 	if (!readable) {
@@ -432,11 +435,11 @@ Graphics4::Texture::Texture(int width, int height, Image::Format format, bool re
 	glCheckErrors();
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D, texture);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
 
 	if (convertType(format) == GL_FLOAT) {
@@ -461,12 +464,12 @@ Graphics4::Texture::Texture(int width, int height, int depth, Image::Format form
 	
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_3D, texture);
+	OpenGL::bindTexture(GL_TEXTURE_3D, texture);
 	glCheckErrors();
 
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	OpenGL::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
 
 	glTexImage3D(GL_TEXTURE_3D, 0, convertInternalFormat(this->format), width, height, depth, 0, convertFormat(this->format), GL_UNSIGNED_BYTE, data);
@@ -485,24 +488,25 @@ Graphics4::Texture::Texture(unsigned texid) : Image(1023, 684, Image::RGBA32, fa
 
 TextureImpl::~TextureImpl() {
 	glDeleteTextures(1, &texture);
+	OpenGL::forgetTexture(texture);
 	glFlush();
 }
 
 void Graphics4::Texture::_set(TextureUnit unit) {
 	GLenum target = depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	OpenGL::activeTexture(unit.unit);
 	glCheckErrors();
 #ifdef KORE_ANDROID
 	if (external_oes) {
-		glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+		OpenGL::bindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
 		glCheckErrors();
 	}
 	else {
-		glBindTexture(target, texture);
+		OpenGL::bindTexture(target, texture);
 		glCheckErrors();
 	}
 #else
-	glBindTexture(target, texture);
+	OpenGL::bindTexture(target, texture);
 	glCheckErrors();
 #endif
 }
@@ -526,7 +530,7 @@ u8* Graphics4::Texture::lock() {
 /*void Texture::unlock() {
     if (conversionBuffer != nullptr) {
         convertImageToPow2(format, (u8*)data, width, height, conversionBuffer, texWidth, texHeight);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        OpenGL::bindTexture(GL_TEXTURE_2D, texture);
 #ifndef GL_LUMINANCE
 #define GL_LUMINANCE GL_RED
 #endif
@@ -540,7 +544,7 @@ void Graphics4::Texture::unlock() {
 	void* texdata = data;
 	bool isHdr = convertType(format) == GL_FLOAT;
 	if (isHdr) texdata = hdrData;
-	glBindTexture(target, texture);
+	OpenGL::bindTexture(target, texture);
 	glCheckErrors();
 	if (depth > 1) {
 #ifndef KORE_OPENGL_ES
@@ -553,6 +557,26 @@ void Graphics4::Texture::unlock() {
 	glCheckErrors();
 }
 
+void Graphics4::Texture::uploadRegion(int x, int y, int width, int height, u8* data, int stride) {
+	int pixelSize = sizeOf(format);
+	if (this->data != nullptr) {
+		for (int row = 0; row < height; ++row) memcpy(&this->data[(y + row) * this->stride() + x * pixelSize], &data[row * stride], width * pixelSize);
+	}
+	OpenGL::bindTexture(GL_TEXTURE_2D, texture);
+	glCheckErrors();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(KORE_OPENGL_ES)
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / pixelSize);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, convertFormat(format), convertType(format), data);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#else
+	for (int row = 0; row < height; ++row) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y + row, width, 1, convertFormat(format), convertType(format), &data[row * stride]);
+	}
+#endif
+	glCheckErrors();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
 #ifdef GL_VERSION_4_4
 	static float clearColor[4];
@@ -561,14 +585,14 @@ void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int d
 	clearColor[2] = (color & 0x000000ff) / 255.0f;
 	clearColor[3] = ((color & 0xff000000) >> 24) / 255.0f;
 	GLenum target = depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
-	glBindTexture(target, texture);
+	OpenGL::bindTexture(target, texture);
 	glClearTexSubImage(texture, 0, x, y, z, width, height, depth, convertFormat(format), convertType(format), clearColor);
 #endif
 }
 
 #if defined(KORE_IOS) || defined(KORE_MACOS)
 void Graphics4::Texture::upload(u8* data, int stride) {
-	glBindTexture(GL_TEXTURE_2D, texture);
+	OpenGL::bindTexture(GL_TEXTURE_2D, texture);
 	glCheckErrors();
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, convertFormat(format), GL_UNSIGNED_BYTE, data);
@@ -579,7 +603,7 @@ void Graphics4::Texture::upload(u8* data, int stride) {
 
 void Graphics4::Texture::generateMipmaps(int levels) {
 	GLenum target = depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
-	glBindTexture(target, texture);
+	OpenGL::bindTexture(target, texture);
 	glCheckErrors();
 	glGenerateMipmap(target);
 	glCheckErrors();
@@ -589,7 +613,7 @@ void Graphics4::Texture::setMipmap(Texture* mipmap, int level) {
 	int convertedType = convertType(mipmap->format);
 	bool isHdr = convertedType == GL_FLOAT;
 	GLenum target = depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
-	glBindTexture(target, texture);
+	OpenGL::bindTexture(target, texture);
 	glCheckErrors();
 	if (isHdr) {
 		glTexImage2D(target, level, convertInternalFormat(mipmap->format), mipmap->texWidth, mipmap->texHeight, 0, convertFormat(mipmap->format), convertedType, mipmap->hdrData);
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "ShaderImpl.h"
+#include "StateCache.h"
 #include "VertexBufferImpl.h"
 #include "ogl.h"
 
@@ -9,15 +10,21 @@
 
 using namespace Kore;
 
+namespace Kore {
+	extern bool supportsBufferStorage;
+}
+
 Graphics4::VertexBuffer* VertexBufferImpl::current = nullptr;
 
-VertexBufferImpl::VertexBufferImpl(int count, int instanceDataStepRate) : myCount(count), instanceDataStepRate(instanceDataStepRate) {
+VertexBufferImpl::VertexBufferImpl(int count, int instanceDataStepRate)
+    : myCount(count), instanceDataStepRate(instanceDataStepRate), allocated(false), lockStart(0), lockCount(count), ring(nullptr), ringSize(0), ringOffset(0),
+      ringHead(0), pendingStart(0), pendingEnd(0), ringFenceCount(0) {
 #ifndef NDEBUG
 	initialized = false;
 #endif
 }
 
-Graphics4::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& structure, int instanceDataStepRate)
+Graphics4::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& structure, int instanceDataStepRate, Usage usage)
     : VertexBufferImpl(vertexCount, instanceDataStepRate) {
 	myStride = 0;
 	for (int i = 0; i < structure.size; ++i) {
@@ -46,33 +53,123 @@ Graphics4::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& st
 		}
 	}
 	this->structure = structure;
+	dynamic = usage == DynamicUsage;
 
 	glGenBuffers(1, &bufferId);
 	glCheckErrors();
-	data = new float[vertexCount * myStride / 4];
+	data = nullptr;
+#ifdef KORE_OPENGL_BUFFER_STORAGE
+	if (dynamic && supportsBufferStorage) {
+		ringSize = 3 * myStride * myCount;
+		OpenGL::bindBuffer(GL_ARRAY_BUFFER, bufferId);
+		glCheckErrors();
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, ringSize, nullptr, flags);
+		glCheckErrors();
+		ring = (u8*)glMapBufferRange(GL_ARRAY_BUFFER, 0, ringSize, flags);
+		glCheckErrors();
+		allocated = true;
+	}
+#endif
+	if (ring == nullptr) data = new float[vertexCount * myStride / 4];
 }
 
 Graphics4::VertexBuffer::~VertexBuffer() {
 	unset();
+#ifdef KORE_OPENGL_BUFFER_STORAGE
+	if (ring != nullptr) {
+		for (int i = 0; i < ringFenceCount; ++i) glDeleteSync((GLsync)ringFences[i].sync);
+		OpenGL::bindBuffer(GL_ARRAY_BUFFER, bufferId);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+#endif
+	glDeleteBuffers(1, &bufferId);
+	OpenGL::forgetBuffer(bufferId);
 	delete[] data;
 }
 
 float* Graphics4::VertexBuffer::lock() {
-	return data;
+	return lock(0, myCount);
 }
 
 float* Graphics4::VertexBuffer::lock(int start, int count) {
-	u8* u8data = (u8*)data;
-	return (float*)&u8data[start * stride()];
+	lockStart = start;
+	lockCount = count;
+	if (ring == nullptr) {
+		u8* u8data = (u8*)data;
+		return (float*)&u8data[start * stride()];
+	}
+
+	// draws that use the previous lock were issued by now
+	fenceRing();
+	int size = (start + count) * myStride;
+	ringOffset = ringHead + size > ringSize ? 0 : ringHead;
+	waitForRing(ringOffset, ringOffset + size);
+	return (float*)&ring[ringOffset + start * myStride];
 }
 
 void Graphics4::VertexBuffer::unlock() {
-	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
-	glCheckErrors();
-	glBufferData(GL_ARRAY_BUFFER, myStride * myCount, data, GL_STATIC_DRAW);
-	glCheckErrors();
+	unlock(lockCount);
+}
+
+void Graphics4::VertexBuffer::unlock(int count) {
 #ifndef NDEBUG
 	initialized = true;
+#endif
+	if (ring != nullptr) {
+		// the mapping is coherent, the writes are visible to every following draw
+		pendingStart = ringOffset + lockStart * myStride;
+		pendingEnd = ringOffset + (lockStart + count) * myStride;
+		ringHead = pendingEnd;
+		return;
+	}
+
+	OpenGL::bindBuffer(GL_ARRAY_BUFFER, bufferId);
+	glCheckErrors();
+	if (!allocated || (!dynamic && lockStart == 0 && count == myCount)) {
+		glBufferData(GL_ARRAY_BUFFER, myStride * myCount, data, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+		glCheckErrors();
+		allocated = true;
+		return;
+	}
+	if (dynamic) {
+		// orphan the old storage so the driver does not wait for draws still using it
+		glBufferData(GL_ARRAY_BUFFER, myStride * myCount, nullptr, GL_DYNAMIC_DRAW);
+		glCheckErrors();
+	}
+	u8* u8data = (u8*)data;
+	glBufferSubData(GL_ARRAY_BUFFER, lockStart * myStride, count * myStride, &u8data[lockStart * myStride]);
+	glCheckErrors();
+}
+
+void VertexBufferImpl::fenceRing() {
+#ifdef KORE_OPENGL_BUFFER_STORAGE
+	if (pendingStart == pendingEnd) return;
+	if (ringFenceCount == maxRingFences) waitForRing(ringFences[0].start, ringFences[0].end);
+	RingFence& fence = ringFences[ringFenceCount++];
+	fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glCheckErrors();
+	fence.start = pendingStart;
+	fence.end = pendingEnd;
+	pendingStart = pendingEnd = 0;
+#endif
+}
+
+void VertexBufferImpl::waitForRing(int start, int end) {
+#ifdef KORE_OPENGL_BUFFER_STORAGE
+	int last = -1;
+	for (int i = 0; i < ringFenceCount; ++i) {
+		if (ringFences[i].start < end && start < ringFences[i].end) last = i;
+	}
+	if (last < 0) return;
+
+	// the GPU finishes commands in order, so every older fence is signaled as well
+	GLsync sync = (GLsync)ringFences[last].sync;
+	while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+	}
+	for (int i = 0; i <= last; ++i) glDeleteSync((GLsync)ringFences[i].sync);
+	for (int i = last + 1; i < ringFenceCount; ++i) ringFences[i - last - 1] = ringFences[i];
+	ringFenceCount -= last + 1;
 #endif
 }
 
@@ -102,7 +199,7 @@ namespace {
 #endif
 
 int VertexBufferImpl::setVertexAttributes(int offset) {
-	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+	OpenGL::bindBuffer(GL_ARRAY_BUFFER, bufferId);
 	glCheckErrors();
 
 	int internaloffset = 0;
@@ -140,7 +237,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 			while (subsize > 0) {
 				glEnableVertexAttribArray(offset + actualIndex);
 				glCheckErrors();
-				glVertexAttribPointer(offset + actualIndex, 4, type, false, myStride, reinterpret_cast<void*>(internaloffset + addonOffset));
+				glVertexAttribPointer(offset + actualIndex, 4, type, false, myStride, reinterpret_cast<void*>(ringOffset + internaloffset + addonOffset));
 				glCheckErrors();
 #ifndef KORE_OPENGL_ES
 				if (attribDivisorUsed || instanceDataStepRate != 0) {
@@ -157,7 +254,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 		else {
 			glEnableVertexAttribArray(offset + actualIndex);
 			glCheckErrors();
-			glVertexAttribPointer(offset + actualIndex, size, type, false, myStride, reinterpret_cast<void*>(internaloffset));
+			glVertexAttribPointer(offset + actualIndex, size, type, false, myStride, reinterpret_cast<void*>(ringOffset + internaloffset));
 			glCheckErrors();
 #ifndef KORE_OPENGL_ES
 			if (attribDivisorUsed || instanceDataStepRate != 0) {
@@ -20,6 +20,30 @@ namespace Kore {
 		//#endif
 		int instanceDataStepRate;
 		int setVertexAttributes(int offset);
+		bool dynamic;
+		bool allocated;
+		int lockStart;
+		int lockCount;
+
+		// Dynamic buffers are streamed through a persistently mapped ring of three times
+		// their size when the driver supports it. Every lock takes the next free part of the ring,
+		// fences keep it from overwriting parts the GPU still reads from.
+		struct RingFence {
+			void* sync;
+			int start;
+			int end;
+		};
+		static const int maxRingFences = 16;
+		u8* ring;
+		int ringSize;
+		int ringOffset; // start of the current lock in bytes, the vertex attributes point there
+		int ringHead;
+		int pendingStart;
+		int pendingEnd;
+		RingFence ringFences[maxRingFences];
+		int ringFenceCount;
+		void fenceRing();
+		void waitForRing(int start, int end);
 #ifndef NDEBUG
 		bool initialized;
 #endif
@@ -15,6 +15,13 @@
 
 using namespace Kore;
 
+namespace Kore {
+	namespace OpenGL {
+		// declared in StateCache.h, which can not be mixed with the GL headers of the Oculus SDK
+		void invalidateState();
+	}
+}
+
 namespace {
 	SensorState sensorStates[2];
 }
@@ -58,6 +65,7 @@ struct TextureBuffer {
 					GLuint chainTexId;
 					ovr_GetTextureSwapChainBufferGL(Session, TextureChain, i, &chainTexId);
 					glBindTexture(GL_TEXTURE_2D, chainTexId);
+					OpenGL::invalidateState();
 
 					OVRRenderTarget = new Graphics4::RenderTarget(texSize.w, texSize.h, 1);
 				}
@@ -270,6 +278,7 @@ struct OGL {
 		glEnable(GL_DEPTH_TEST);
 		glFrontFace(GL_CW);
 		glEnable(GL_CULL_FACE);
+		OpenGL::invalidateState();
 
 		return true;
 	}
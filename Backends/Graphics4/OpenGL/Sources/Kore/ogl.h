@@ -53,6 +53,16 @@
 #include <gl2.h>
 #endif
 
+#if !defined(KORE_OPENGL_ES) && !defined(KORE_MACOS)
+// glBufferStorage (GL 4.4 / ARB_buffer_storage) can be called, check supportsBufferStorage before doing so
+#define KORE_OPENGL_BUFFER_STORAGE
+#endif
+
+#if !defined(KORE_OPENGL_ES) && !defined(KORE_MACOS) && !defined(KORE_OPENGL_NO_PROGRAM_CACHE)
+// glGetProgramBinary and glProgramBinary (GL 4.1 / ARB_get_program_binary) can be called, check supportsProgramBinary before doing so
+#define KORE_OPENGL_PROGRAM_BINARY
+#endif
+
 #include <Kore/Log.h>
 
 #if defined(NDEBUG) || defined(KORE_OSX) || defined(KORE_IOS) || defined(KORE_ANDROID) || 1 // Calling glGetError too early means trouble
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "IndexBufferImpl.h"
+#include "RenderTargetImpl.h"
+#include "TextureImpl.h"
+#include "VertexBufferImpl.h"
@@ -0,0 +1,38 @@
+#include "pch.h"
+
+#include "IndexBufferImpl.h"
+
+#include <Kore/Graphics4/Graphics.h>
+
+using namespace Kore;
+
+Graphics4::IndexBuffer* IndexBufferImpl::current = nullptr;
+
+IndexBufferImpl::IndexBufferImpl(int count) : myCount(count) {}
+
+Graphics4::IndexBuffer::IndexBuffer(int indexCount, Usage usage) : IndexBufferImpl(indexCount) {
+	data = new int[indexCount];
+}
+
+Graphics4::IndexBuffer::~IndexBuffer() {
+	unset();
+	delete[] data;
+}
+
+int* Graphics4::IndexBuffer::lock() {
+	return data;
+}
+
+void Graphics4::IndexBuffer::unlock() {}
+
+void Graphics4::IndexBuffer::_set() {
+	current = this;
+}
+
+void IndexBufferImpl::unset() {
+	if ((void*)current == (void*)this) current = nullptr;
+}
+
+int Graphics4::IndexBuffer::count() {
+	return myCount;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace Kore {
+	namespace Graphics4 {
+		class IndexBuffer;
+	}
+
+	class IndexBufferImpl {
+	public:
+		IndexBufferImpl(int count);
+		void unset();
+
+		int* data;
+		int myCount;
+
+		static Graphics4::IndexBuffer* current;
+	};
+}
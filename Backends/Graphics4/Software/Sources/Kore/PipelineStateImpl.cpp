@@ -0,0 +1,101 @@
+#include "pch.h"
+
+#include "PipelineStateImpl.h"
+
+#include <Kore/Graphics4/PipelineState.h>
+#include <Kore/Graphics4/Shader.h>
+#include <Kore/Log.h>
+
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	int floatCount(Graphics4::VertexData data) {
+		switch (data) {
+		case Graphics4::ColorVertexData:
+		case Graphics4::Float1VertexData:
+			return 1;
+		case Graphics4::Float2VertexData:
+			return 2;
+		case Graphics4::Float3VertexData:
+			return 3;
+		case Graphics4::Float4VertexData:
+			return 4;
+		case Graphics4::Float4x4VertexData:
+			return 16;
+		case Graphics4::NoVertexData:
+			break;
+		}
+		return 0;
+	}
+}
+
+PipelineStateImpl::PipelineStateImpl() : positionOffset(-1), positionSize(0), texCoordOffset(-1), colorOffset(-1), packedColor(false), slotOffset(-1), textureCount(0) {
+	for (int i = 0; i < 16; ++i) transform[i] = i % 5 == 0 ? 1.0f : 0.0f;
+}
+
+void Graphics4::PipelineState::compile() {
+	positionOffset = texCoordOffset = colorOffset = slotOffset = -1;
+	VertexStructure* structure = inputLayout[0];
+	if (structure == nullptr) return;
+	if (inputLayout[1] != nullptr) {
+		log(Warning, "The software renderer only reads the first vertex buffer.");
+	}
+
+	int offset = 0;
+	for (int i = 0; i < structure->size; ++i) {
+		VertexData data = structure->elements[i].data;
+		if (i == 0) {
+			positionOffset = offset;
+			positionSize = floatCount(data) < 4 ? floatCount(data) : 4;
+		}
+		else if (texCoordOffset < 0 && data == Float2VertexData) {
+			texCoordOffset = offset;
+		}
+		else if (colorOffset < 0 && (data == Float4VertexData || data == ColorVertexData)) {
+			colorOffset = offset;
+			packedColor = data == ColorVertexData;
+		}
+		else if (slotOffset < 0 && data == Float1VertexData) {
+			slotOffset = offset;
+		}
+		offset += floatCount(data);
+	}
+}
+
+void Graphics4::PipelineState::compileAsync() {
+	compile();
+}
+
+bool Graphics4::PipelineState::isReady() {
+	return true;
+}
+
+void Graphics4::PipelineState::waitUntilReady() {}
+
+Graphics4::ConstantLocation Graphics4::PipelineState::getConstantLocation(const char* name) {
+	ConstantLocation location;
+	location.location = 0;
+	return location;
+}
+
+int PipelineStateImpl::findTexture(const char* name) {
+	for (int index = 0; index < textureCount; ++index) {
+		if (strcmp(textures[index], name) == 0) return index;
+	}
+	return -1;
+}
+
+Graphics4::TextureUnit Graphics4::PipelineState::getTextureUnit(const char* name) {
+	int index = findTexture(name);
+	if (index < 0 && textureCount < 16) {
+		index = textureCount;
+		strncpy(textures[index], name, sizeof(textures[index]) - 1);
+		textures[index][sizeof(textures[index]) - 1] = 0;
+		++textureCount;
+	}
+	TextureUnit unit;
+	unit.unit = index < 0 ? 0 : index;
+	return unit;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+namespace Kore {
+	namespace Graphics4 {
+		class PipelineState;
+	}
+
+	// Every pipeline runs the same built-in program, which covers the Graphics1 and Graphics2 painters:
+	// The first vertex element is the position, it is multiplied with the last 4x4 matrix that was set.
+	// The first float2 element is the texture coordinate and the first float4 or color element the vertex color.
+	// Pixels are the vertex color multiplied with texture unit 0 (when the pipeline asked for a texture unit),
+	// premultiplied by the vertex alpha when the pipeline blends with One and InverseSourceAlpha.
+	// A float1 element selects the texture per triangle like the Graphics2 batch shader does:
+	// 0 is untextured, 1 to 4 sample units 0 to 3 and 5 to 8 use the alpha of units 0 to 3 as coverage.
+	class PipelineStateImpl {
+	public:
+		PipelineStateImpl();
+		int findTexture(const char* name);
+
+		// in floats, -1 when the vertex structure lacks the element
+		int positionOffset;
+		int positionSize;
+		int texCoordOffset;
+		int colorOffset;
+		bool packedColor;
+		int slotOffset;
+		// column major
+		float transform[16];
+		char textures[16][64];
+		int textureCount;
+	};
+}
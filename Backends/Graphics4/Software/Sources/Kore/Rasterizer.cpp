@@ -0,0 +1,471 @@
+#include "pch.h"
+
+#include "Rasterizer.h"
+
+#include <Kore/Math/Core.h>
+#include <Kore/Simd/float32x4.h>
+#include <Kore/Threads/JobSystem.h>
+
+#include <math.h>
+#include <vector>
+
+using namespace Kore;
+using namespace Kore::Software;
+
+namespace {
+	const int tileSize = 64;
+	// positions are snapped to 1/16 pixel so edge functions at pixel centers are multiples of 1/256
+	const float subpixels = 16.0f;
+	// pushes pixels lying exactly on an edge which is neither a top nor a left edge outside
+	const float edgeBias = 1.0f / 512.0f;
+	const float nearW = 1e-5f;
+
+	struct Triangle {
+		// e(x, y) = a * x + b * y + c relative to the origin pixel, positive inside
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		int originX, originY;
+		int minX, minY, maxX, maxY;
+		// u / w, v / w, z, 1 / w at the origin pixel and their derivatives
+		float attributes[4];
+		float attributesDx[4];
+		float attributesDy[4];
+		// rgba / w
+		float color[4];
+		float colorDx[4];
+		float colorDy[4];
+		const Surface* texture;
+		const Sampler* sampler;
+		// use the texture alpha for all channels
+		bool coverage;
+	};
+
+	struct ScreenVertex {
+		float x, y;
+		float32x4 attributes;
+		float32x4 color;
+	};
+
+	const DrawState* state;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<int>> bins;
+	std::vector<int> activeTiles;
+	int tilesX = 0;
+	int tilesY = 0;
+
+	float32x4 unpack(u32 pixel) {
+		return mul(load((float)(pixel & 0xff), (float)((pixel >> 8) & 0xff), (float)((pixel >> 16) & 0xff), (float)(pixel >> 24)), loadAll(1.0f / 255.0f));
+	}
+
+	u32 pack(float32x4 color) {
+		color = add(mul(min(max(color, loadAll(0.0f)), loadAll(1.0f)), loadAll(255.0f)), loadAll(0.5f));
+		return (u32)get(color, 0) | (u32)get(color, 1) << 8 | (u32)get(color, 2) << 16 | (u32)get(color, 3) << 24;
+	}
+
+	float32x4 lerp(float32x4 a, float32x4 b, float t) {
+		return add(a, mul(sub(b, a), loadAll(t)));
+	}
+
+	int address(int coordinate, int size, Graphics4::TextureAddressing addressing) {
+		switch (addressing) {
+		case Graphics4::Repeat:
+			coordinate %= size;
+			return coordinate < 0 ? coordinate + size : coordinate;
+		case Graphics4::Mirror: {
+			int period = size * 2;
+			coordinate %= period;
+			if (coordinate < 0) coordinate += period;
+			return coordinate < size ? coordinate : period - 1 - coordinate;
+		}
+		case Graphics4::Border:
+			return coordinate < 0 || coordinate >= size ? -1 : coordinate;
+		case Graphics4::Clamp:
+		default:
+			return coordinate < 0 ? 0 : (coordinate >= size ? size - 1 : coordinate);
+		}
+	}
+
+	float32x4 texel(const Surface* texture, const Sampler& sampler, int x, int y) {
+		x = address(x, texture->width, sampler.addressU);
+		y = address(y, texture->height, sampler.addressV);
+		if (x < 0 || y < 0) return loadAll(0.0f);
+		return unpack(texture->pixels[y * texture->width + x]);
+	}
+
+	float32x4 sample(const Surface* texture, const Sampler& sampler, float u, float v) {
+		float x = u * texture->width;
+		float y = v * texture->height;
+		// keeps broken coordinates from overflowing the integer conversion
+		if (!(x > -1e6f && x < 1e6f)) x = 0.0f;
+		if (!(y > -1e6f && y < 1e6f)) y = 0.0f;
+		if (!sampler.linear) return texel(texture, sampler, (int)floorf(x), (int)floorf(y));
+
+		x -= 0.5f;
+		y -= 0.5f;
+		float left = floorf(x);
+		float top = floorf(y);
+		int ix = (int)left;
+		int iy = (int)top;
+		float32x4 upper = lerp(texel(texture, sampler, ix, iy), texel(texture, sampler, ix + 1, iy), x - left);
+		float32x4 lower = lerp(texel(texture, sampler, ix, iy + 1), texel(texture, sampler, ix + 1, iy + 1), x - left);
+		return lerp(upper, lower, y - top);
+	}
+
+	float32x4 blendFactor(Graphics4::BlendingOperation operation, float32x4 source, float32x4 destination) {
+		switch (operation) {
+		case Graphics4::BlendOne:
+			return loadAll(1.0f);
+		case Graphics4::BlendZero:
+			return loadAll(0.0f);
+		case Graphics4::SourceAlpha:
+			return loadAll(get(source, 3));
+		case Graphics4::DestinationAlpha:
+			return loadAll(get(destination, 3));
+		case Graphics4::InverseSourceAlpha:
+			return loadAll(1.0f - get(source, 3));
+		case Graphics4::InverseDestinationAlpha:
+			return loadAll(1.0f - get(destination, 3));
+		case Graphics4::SourceColor:
+			return source;
+		case Graphics4::DestinationColor:
+			return destination;
+		case Graphics4::InverseSourceColor:
+			return sub(loadAll(1.0f), source);
+		case Graphics4::InverseDestinationColor:
+			return sub(loadAll(1.0f), destination);
+		}
+		return loadAll(1.0f);
+	}
+
+	float32x4 blend(float32x4 source, float32x4 destination) {
+		float32x4 color = add(mul(source, blendFactor(state->blendSource, source, destination)),
+		                      mul(destination, blendFactor(state->blendDestination, source, destination)));
+		float alpha = get(source, 3) * get(blendFactor(state->alphaBlendSource, source, destination), 3) +
+		              get(destination, 3) * get(blendFactor(state->alphaBlendDestination, source, destination), 3);
+		return load(get(color, 0), get(color, 1), get(color, 2), alpha);
+	}
+
+	bool depthPasses(float depth, float stored) {
+		switch (state->depthMode) {
+		case Graphics4::ZCompareAlways:
+			return true;
+		case Graphics4::ZCompareNever:
+			return false;
+		case Graphics4::ZCompareEqual:
+			return depth == stored;
+		case Graphics4::ZCompareNotEqual:
+			return depth != stored;
+		case Graphics4::ZCompareLess:
+			return depth < stored;
+		case Graphics4::ZCompareLessEqual:
+			return depth <= stored;
+		case Graphics4::ZCompareGreater:
+			return depth > stored;
+		case Graphics4::ZCompareGreaterEqual:
+			return depth >= stored;
+		}
+		return true;
+	}
+
+	void shade(const Triangle& triangle, u32* pixel, float* depth, float32x4 attributes, float32x4 color) {
+		if (depth != nullptr) {
+			float z = get(attributes, 2);
+			if (!depthPasses(z, *depth)) return;
+			if (state->depthWrite) *depth = z;
+		}
+
+		float w = 1.0f / get(attributes, 3);
+		float32x4 fragment = mul(color, loadAll(w));
+		float vertexAlpha = get(fragment, 3);
+		if (triangle.texture != nullptr) {
+			float32x4 texel = sample(triangle.texture, *triangle.sampler, get(attributes, 0) * w, get(attributes, 1) * w);
+			fragment = mul(fragment, triangle.coverage ? loadAll(get(texel, 3)) : texel);
+		}
+		if (state->premultiply) {
+			fragment = mul(fragment, load(vertexAlpha, vertexAlpha, vertexAlpha, 1.0f));
+		}
+
+		u32 destination = *pixel;
+		if (state->blending) {
+			fragment = blend(fragment, unpack(destination));
+		}
+		*pixel = (destination & ~state->writeMask) | (pack(fragment) & state->writeMask);
+	}
+
+	void rasterize(const Triangle& triangle, int minX, int minY, int maxX, int maxY) {
+		const float32x4 steps = load(0.0f, 1.0f, 2.0f, 3.0f);
+		float32x4 edgeStep[3];
+		float32x4 edgeGroupStep[3];
+		for (int i = 0; i < 3; ++i) {
+			edgeStep[i] = mul(loadAll(triangle.edgeA[i]), steps);
+			edgeGroupStep[i] = loadAll(triangle.edgeA[i] * 4.0f);
+		}
+		float32x4 attributesDx = loadUnaligned(triangle.attributesDx);
+		float32x4 attributesDy = loadUnaligned(triangle.attributesDy);
+		float32x4 colorDx = loadUnaligned(triangle.colorDx);
+		float32x4 colorDy = loadUnaligned(triangle.colorDy);
+		Surface* target = state->target;
+		bool depthTest = state->depthTest && target->depth != nullptr;
+
+		for (int y = minY; y <= maxY; ++y) {
+			float fx = (float)(minX - triangle.originX);
+			float fy = (float)(y - triangle.originY);
+			float32x4 edges[3];
+			for (int i = 0; i < 3; ++i) {
+				edges[i] = add(loadAll(triangle.edgeA[i] * fx + triangle.edgeB[i] * fy + triangle.edgeC[i]), edgeStep[i]);
+			}
+			float32x4 attributes = add(loadUnaligned(triangle.attributes), add(mul(attributesDx, loadAll(fx)), mul(attributesDy, loadAll(fy))));
+			float32x4 color = add(loadUnaligned(triangle.color), add(mul(colorDx, loadAll(fx)), mul(colorDy, loadAll(fy))));
+			u32* pixels = &target->pixels[y * target->width];
+			float* depths = depthTest ? &target->depth[y * target->width] : nullptr;
+
+			for (int x = minX; x <= maxX; x += 4) {
+				float32x4 inside = min(min(edges[0], edges[1]), edges[2]);
+				for (int lane = 0; lane < 4 && x + lane <= maxX; ++lane) {
+					if (get(inside, lane) >= 0.0f) {
+						float32x4 offset = loadAll((float)lane);
+						shade(triangle, &pixels[x + lane], depths != nullptr ? &depths[x + lane] : nullptr, add(attributes, mul(attributesDx, offset)),
+						      add(color, mul(colorDx, offset)));
+					}
+				}
+				for (int i = 0; i < 3; ++i) {
+					edges[i] = add(edges[i], edgeGroupStep[i]);
+				}
+				attributes = add(attributes, mul(attributesDx, loadAll(4.0f)));
+				color = add(color, mul(colorDx, loadAll(4.0f)));
+			}
+		}
+	}
+
+	void rasterizeTiles(int start, int end, void*) {
+		for (int i = start; i < end; ++i) {
+			int tile = activeTiles[i];
+			int tileX = (tile % tilesX) * tileSize;
+			int tileY = (tile / tilesX) * tileSize;
+			const std::vector<int>& bin = bins[tile];
+			for (size_t j = 0; j < bin.size(); ++j) {
+				const Triangle& triangle = triangles[bin[j]];
+				int minX = triangle.minX > tileX ? triangle.minX : tileX;
+				int minY = triangle.minY > tileY ? triangle.minY : tileY;
+				int maxX = triangle.maxX < tileX + tileSize - 1 ? triangle.maxX : tileX + tileSize - 1;
+				int maxY = triangle.maxY < tileY + tileSize - 1 ? triangle.maxY : tileY + tileSize - 1;
+				rasterize(triangle, minX, minY, maxX, maxY);
+			}
+		}
+	}
+
+	ScreenVertex toScreen(const Vertex& vertex) {
+		float invW = 1.0f / vertex.w;
+		ScreenVertex screen;
+		float x = state->viewportX + (vertex.x * invW * 0.5f + 0.5f) * state->viewportWidth;
+		float y = state->viewportY + (0.5f - vertex.y * invW * 0.5f) * state->viewportHeight;
+		screen.x = floorf(x * subpixels + 0.5f) / subpixels;
+		screen.y = floorf(y * subpixels + 0.5f) / subpixels;
+		screen.attributes = load(vertex.u * invW, vertex.v * invW, vertex.z * invW * 0.5f + 0.5f, invW);
+		screen.color = mul(load(vertex.r, vertex.g, vertex.b, vertex.a), loadAll(invW));
+		return screen;
+	}
+
+	void setup(const Vertex& vertex0, const Vertex& vertex1, const Vertex& vertex2) {
+		ScreenVertex v[3] = {toScreen(vertex0), toScreen(vertex1), toScreen(vertex2)};
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (area == 0.0f) return;
+		// positive areas are clockwise on screen, which is counter clockwise with y pointing up
+		if (state->cullMode == Graphics4::Clockwise && area > 0.0f) return;
+		if (state->cullMode == Graphics4::CounterClockwise && area < 0.0f) return;
+		if (area < 0.0f) {
+			ScreenVertex swap = v[1];
+			v[1] = v[2];
+			v[2] = swap;
+			area = -area;
+		}
+
+		float left = (float)state->clipX;
+		float top = (float)state->clipY;
+		float right = (float)(state->clipX + state->clipWidth - 1);
+		float bottom = (float)(state->clipY + state->clipHeight - 1);
+		Triangle triangle;
+		triangle.minX = (int)floorf(Kore::clamp(Kore::min(v[0].x, Kore::min(v[1].x, v[2].x)), left, right + 1.0f));
+		triangle.minY = (int)floorf(Kore::clamp(Kore::min(v[0].y, Kore::min(v[1].y, v[2].y)), top, bottom + 1.0f));
+		triangle.maxX = (int)floorf(Kore::clamp(Kore::max(v[0].x, Kore::max(v[1].x, v[2].x)), left - 1.0f, right));
+		triangle.maxY = (int)floorf(Kore::clamp(Kore::max(v[0].y, Kore::max(v[1].y, v[2].y)), top - 1.0f, bottom));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+		triangle.originX = triangle.minX;
+		triangle.originY = triangle.minY;
+
+		int slot = 1;
+		triangle.coverage = false;
+		if (state->textureSlots) {
+			// flat, the first vertex decides
+			slot = (int)(vertex0.slot + 0.5f);
+			if (slot > maxSlots) {
+				slot -= maxSlots;
+				triangle.coverage = true;
+			}
+		}
+		triangle.texture = slot >= 1 && slot <= maxSlots ? state->textures[slot - 1] : nullptr;
+		triangle.sampler = triangle.texture != nullptr ? &state->samplers[slot - 1] : nullptr;
+
+		float originX = triangle.originX + 0.5f;
+		float originY = triangle.originY + 0.5f;
+		for (int i = 0; i < 3; ++i) {
+			const ScreenVertex& a = v[i];
+			const ScreenVertex& b = v[(i + 1) % 3];
+			triangle.edgeA[i] = a.y - b.y;
+			triangle.edgeB[i] = b.x - a.x;
+			triangle.edgeC[i] = (b.x - a.x) * (originY - a.y) - (b.y - a.y) * (originX - a.x);
+			bool topLeft = b.y < a.y || (b.y == a.y && b.x > a.x);
+			if (!topLeft) triangle.edgeC[i] -= edgeBias;
+		}
+
+		float dx1 = v[1].x - v[0].x;
+		float dy1 = v[1].y - v[0].y;
+		float dx2 = v[2].x - v[0].x;
+		float dy2 = v[2].y - v[0].y;
+		float32x4 invArea = loadAll(1.0f / area);
+		float32x4 offsetX = loadAll(originX - v[0].x);
+		float32x4 offsetY = loadAll(originY - v[0].y);
+
+		float32x4 delta1 = sub(v[1].attributes, v[0].attributes);
+		float32x4 delta2 = sub(v[2].attributes, v[0].attributes);
+		float32x4 dx = mul(sub(mul(delta1, loadAll(dy2)), mul(delta2, loadAll(dy1))), invArea);
+		float32x4 dy = mul(sub(mul(delta2, loadAll(dx1)), mul(delta1, loadAll(dx2))), invArea);
+		storeUnaligned(triangle.attributes, add(v[0].attributes, add(mul(dx, offsetX), mul(dy, offsetY))));
+		storeUnaligned(triangle.attributesDx, dx);
+		storeUnaligned(triangle.attributesDy, dy);
+
+		delta1 = sub(v[1].color, v[0].color);
+		delta2 = sub(v[2].color, v[0].color);
+		dx = mul(sub(mul(delta1, loadAll(dy2)), mul(delta2, loadAll(dy1))), invArea);
+		dy = mul(sub(mul(delta2, loadAll(dx1)), mul(delta1, loadAll(dx2))), invArea);
+		storeUnaligned(triangle.color, add(v[0].color, add(mul(dx, offsetX), mul(dy, offsetY))));
+		storeUnaligned(triangle.colorDx, dx);
+		storeUnaligned(triangle.colorDy, dy);
+
+		int index = (int)triangles.size();
+		triangles.push_back(triangle);
+		for (int tileY = triangle.minY / tileSize; tileY <= triangle.maxY / tileSize; ++tileY) {
+			for (int tileX = triangle.minX / tileSize; tileX <= triangle.maxX / tileSize; ++tileX) {
+				int tile = tileY * tilesX + tileX;
+				if (bins[tile].empty()) activeTiles.push_back(tile);
+				bins[tile].push_back(index);
+			}
+		}
+	}
+
+	Vertex interpolate(const Vertex& a, const Vertex& b, float t) {
+		Vertex vertex;
+		const float* from = &a.x;
+		const float* to = &b.x;
+		float* result = &vertex.x;
+		for (int i = 0; i < 11; ++i) {
+			result[i] = from[i] + (to[i] - from[i]) * t;
+		}
+		return vertex;
+	}
+
+	// Clips against the near plane, the viewport clips everything else
+	void clipAndSetup(const Vertex& a, const Vertex& b, const Vertex& c) {
+		if (a.w >= nearW && b.w >= nearW && c.w >= nearW) {
+			setup(a, b, c);
+			return;
+		}
+		if (a.w < nearW && b.w < nearW && c.w < nearW) return;
+
+		const Vertex* input[3] = {&a, &b, &c};
+		Vertex output[4];
+		int count = 0;
+		for (int i = 0; i < 3; ++i) {
+			const Vertex& current = *input[i];
+			const Vertex& next = *input[(i + 1) % 3];
+			if (current.w >= nearW) output[count++] = current;
+			if ((current.w >= nearW) != (next.w >= nearW)) {
+				output[count++] = interpolate(current, next, (nearW - current.w) / (next.w - current.w));
+			}
+		}
+		for (int i = 1; i + 1 < count; ++i) {
+			setup(output[0], output[i], output[i + 1]);
+		}
+	}
+
+	struct ClearJob {
+		Surface* surface;
+		int x, width;
+		int y;
+		bool color;
+		u32 pixel;
+		bool depth;
+		float depthValue;
+	};
+
+	void clearRows(int start, int end, void* data) {
+		ClearJob* job = (ClearJob*)data;
+		for (int y = job->y + start; y < job->y + end; ++y) {
+			if (job->color) {
+				u32* pixels = &job->surface->pixels[y * job->surface->width + job->x];
+				for (int x = 0; x < job->width; ++x) pixels[x] = job->pixel;
+			}
+			if (job->depth) {
+				float* depths = &job->surface->depth[y * job->surface->width + job->x];
+				for (int x = 0; x < job->width; ++x) depths[x] = job->depthValue;
+			}
+		}
+	}
+}
+
+void Software::drawTriangles(const DrawState& drawState, const Vertex* vertices, const int* indices, int indexCount, int baseVertex) {
+	if (drawState.clipWidth <= 0 || drawState.clipHeight <= 0) return;
+	state = &drawState;
+
+	int newTilesX = (drawState.target->width + tileSize - 1) / tileSize;
+	int newTilesY = (drawState.target->height + tileSize - 1) / tileSize;
+	if (newTilesX != tilesX || newTilesY != tilesY) {
+		tilesX = newTilesX;
+		tilesY = newTilesY;
+		bins.clear();
+		bins.resize(tilesX * tilesY);
+	}
+
+	for (int i = 0; i + 2 < indexCount; i += 3) {
+		clipAndSetup(vertices[indices[i] - baseVertex], vertices[indices[i + 1] - baseVertex], vertices[indices[i + 2] - baseVertex]);
+	}
+
+	JobSystem::parallelFor((int)activeTiles.size(), 1, rasterizeTiles, nullptr);
+
+	for (size_t i = 0; i < activeTiles.size(); ++i) {
+		bins[activeTiles[i]].clear();
+	}
+	activeTiles.clear();
+	triangles.clear();
+	state = nullptr;
+}
+
+void Software::clear(Surface* surface, int x, int y, int width, int height, bool color, u32 pixel, bool depth, float depthValue) {
+	if (x < 0) {
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		height += y;
+		y = 0;
+	}
+	if (x + width > surface->width) width = surface->width - x;
+	if (y + height > surface->height) height = surface->height - y;
+	if (width <= 0 || height <= 0) return;
+
+	ClearJob job;
+	job.surface = surface;
+	job.x = x;
+	job.width = width;
+	job.y = y;
+	job.color = color;
+	job.pixel = pixel;
+	job.depth = depth && surface->depth != nullptr;
+	job.depthValue = depthValue;
+	JobSystem::parallelFor(height, 16, clearRows, &job);
+}
+
+u32 Software::pixelFromColor(uint color) {
+	return (color & 0xff00ff00) | ((color >> 16) & 0xff) | ((color & 0xff) << 16);
+}
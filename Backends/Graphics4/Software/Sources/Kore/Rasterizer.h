@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Software.h"
+
+#include <Kore/Graphics4/Graphics.h>
+
+namespace Kore {
+	namespace Software {
+		// Output of the vertex stage
+		struct Vertex {
+			float x, y, z, w; // clip space
+			float u, v;
+			float r, g, b, a;
+			float slot; // see PipelineStateImpl.h
+		};
+
+		struct Sampler {
+			Graphics4::TextureAddressing addressU;
+			Graphics4::TextureAddressing addressV;
+			bool linear;
+		};
+
+		const int maxSlots = 4;
+
+		struct DrawState {
+			Surface* target;
+			// nullptr for untextured pipelines, only the first one is used without textureSlots
+			Surface* textures[maxSlots];
+			Sampler samplers[maxSlots];
+			bool textureSlots;
+			int viewportX, viewportY, viewportWidth, viewportHeight;
+			// viewport, scissor and target bounds combined
+			int clipX, clipY, clipWidth, clipHeight;
+			Graphics4::CullMode cullMode;
+			bool depthTest;
+			bool depthWrite;
+			Graphics4::ZCompareMode depthMode;
+			bool blending;
+			Graphics4::BlendingOperation blendSource;
+			Graphics4::BlendingOperation blendDestination;
+			Graphics4::BlendingOperation alphaBlendSource;
+			Graphics4::BlendingOperation alphaBlendDestination;
+			bool premultiply;
+			u32 writeMask;
+		};
+
+		// Splits the target into tiles, bins the triangles and rasterizes the tiles on the JobSystem workers.
+		// Triangles keep their submission order inside every tile. indices[i] - baseVertex indexes vertices.
+		void drawTriangles(const DrawState& state, const Vertex* vertices, const int* indices, int indexCount, int baseVertex);
+		void clear(Surface* surface, int x, int y, int width, int height, bool color, u32 pixel, bool depth, float depthValue);
+		// color is 0xAARRGGBB
+		u32 pixelFromColor(uint color);
+	}
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+
+#include "Rasterizer.h"
+
+#include <Kore/Graphics4/Graphics.h>
+#include <Kore/Log.h>
+
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	void allocate(RenderTargetImpl* target, int width, int height, int depthBufferBits, Graphics4::RenderTargetFormat format) {
+		if (format != Graphics4::Target32Bit && format != Graphics4::Target8BitRed && format != Graphics4::Target32BitRedFloat &&
+		    format != Graphics4::Target128BitFloat) {
+			log(Warning, "The software renderer stores render target format %i with eight bits per channel.", (int)format);
+		}
+		target->format = (int)format;
+		target->surface.width = width;
+		target->surface.height = height;
+		target->surface.pixels = new u32[width * height];
+		target->surface.depth = depthBufferBits > 0 ? new float[width * height] : nullptr;
+		target->ownsDepth = true;
+		Software::clear(&target->surface, 0, 0, width, height, true, 0, true, 1.0f);
+	}
+
+	float channel(u32 pixel, int index) {
+		return ((pixel >> (index * 8)) & 0xff) / 255.0f;
+	}
+}
+
+Graphics4::RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits,
+                                      int contextId)
+    : width(width), height(height), texWidth(width), texHeight(height), contextId(contextId), isCubeMap(false), isDepthAttachment(false) {
+	allocate(this, width, height, depthBufferBits, format);
+}
+
+Graphics4::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits,
+                                      int contextId)
+    : width(cubeMapSize), height(cubeMapSize), texWidth(cubeMapSize), texHeight(cubeMapSize), contextId(contextId), isCubeMap(true),
+      isDepthAttachment(false) {
+	log(Warning, "Cube map render targets are not supported by the software renderer, all faces share one image.");
+	allocate(this, width, height, depthBufferBits, format);
+}
+
+Graphics4::RenderTarget::~RenderTarget() {
+	delete[] surface.pixels;
+	if (ownsDepth) delete[] surface.depth;
+}
+
+void Graphics4::RenderTarget::useColorAsTexture(TextureUnit unit) {
+	Software::bindTexture(unit.unit, &surface);
+}
+
+void Graphics4::RenderTarget::useDepthAsTexture(TextureUnit unit) {
+	log(Warning, "Depth textures are not supported by the software renderer.");
+	Software::bindTexture(unit.unit, nullptr);
+}
+
+void Graphics4::RenderTarget::setDepthStencilFrom(RenderTarget* source) {
+	if (source->width != width || source->height != height) {
+		log(Warning, "Render targets of different sizes can not share a depth buffer.");
+		return;
+	}
+	if (ownsDepth) delete[] surface.depth;
+	surface.depth = source->surface.depth;
+	ownsDepth = false;
+}
+
+void Graphics4::RenderTarget::getPixels(u8* data) {
+	int count = texWidth * texHeight;
+	float* floats = (float*)data;
+	switch ((RenderTargetFormat)format) {
+	case Target128BitFloat:
+		for (int i = 0; i < count; ++i) {
+			for (int c = 0; c < 4; ++c) floats[i * 4 + c] = channel(surface.pixels[i], c);
+		}
+		break;
+	case Target32BitRedFloat:
+		for (int i = 0; i < count; ++i) floats[i] = channel(surface.pixels[i], 0);
+		break;
+	case Target8BitRed:
+		for (int i = 0; i < count; ++i) data[i] = (u8)(surface.pixels[i] & 0xff);
+		break;
+	case Target32Bit:
+	default:
+		memcpy(data, surface.pixels, count * 4);
+	}
+}
+
+void Graphics4::RenderTarget::generateMipmaps(int levels) {}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Software.h"
+
+namespace Kore {
+	class RenderTargetImpl {
+	public:
+		Software::Surface surface;
+		int format;
+		bool ownsDepth;
+	};
+}
@@ -0,0 +1,15 @@
+#include "pch.h"
+
+#include <Kore/Graphics4/Shader.h>
+
+using namespace Kore;
+
+ShaderImpl::ShaderImpl() {}
+
+Graphics4::Shader::Shader(void* data, int length, ShaderType type) {
+	setId();
+}
+
+Graphics4::Shader::Shader(const char* source, ShaderType type) {
+	setId();
+}
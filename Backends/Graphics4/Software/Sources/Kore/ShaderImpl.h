@@ -0,0 +1,14 @@
+#pragma once
+
+namespace Kore {
+	// Shaders can not be executed on the cpu, pipelines run a built-in program instead (see PipelineStateImpl.h)
+	class ShaderImpl {
+	public:
+		ShaderImpl();
+	};
+
+	class ConstantLocationImpl {
+	public:
+		int location;
+	};
+}
@@ -0,0 +1,414 @@
+#include "pch.h"
+
+#include "Rasterizer.h"
+
+#include <Kore/Graphics4/Graphics.h>
+#include <Kore/Graphics4/PipelineState.h>
+#include <Kore/Graphics4/TextureArray.h>
+#include <Kore/Log.h>
+#include <Kore/Simd/float32x4.h>
+#include <Kore/System.h>
+#include <Kore/Threads/JobSystem.h>
+
+#include <limits.h>
+#include <vector>
+
+using namespace Kore;
+
+namespace {
+	struct SamplerState {
+		Graphics4::TextureAddressing addressU;
+		Graphics4::TextureAddressing addressV;
+		Graphics4::TextureFilter filter;
+	};
+
+	Software::Surface backbufferSurface;
+	Software::Surface* target = &backbufferSurface;
+	Software::Surface* textures[Software::maxTextureUnits];
+	SamplerState samplers[Software::maxTextureUnits];
+	Graphics4::PipelineState* pipeline = nullptr;
+	int viewportX, viewportY, viewportWidth, viewportHeight;
+	bool scissorEnabled = false;
+	int scissorX, scissorY, scissorWidth, scissorHeight;
+	std::vector<Software::Vertex> vertices;
+
+	void resizeBackbuffer(int width, int height, bool depth) {
+		delete[] backbufferSurface.pixels;
+		delete[] backbufferSurface.depth;
+		backbufferSurface.width = width;
+		backbufferSurface.height = height;
+		backbufferSurface.pixels = new u32[width * height];
+		backbufferSurface.depth = depth ? new float[width * height] : nullptr;
+		Software::clear(&backbufferSurface, 0, 0, width, height, true, 0xff000000, true, 1.0f);
+	}
+
+	void resetViewport() {
+		viewportX = viewportY = 0;
+		viewportWidth = target->width;
+		viewportHeight = target->height;
+		scissorEnabled = false;
+	}
+
+	struct FetchJob {
+		const float* data;
+		int stride;
+		int first;
+		const PipelineStateImpl* pipeline;
+	};
+
+	// The built-in vertex program, see PipelineStateImpl.h
+	void fetchVertices(int start, int end, void* data) {
+		FetchJob* job = (FetchJob*)data;
+		const PipelineStateImpl* pipeline = job->pipeline;
+		float32x4 column0 = loadUnaligned(&pipeline->transform[0]);
+		float32x4 column1 = loadUnaligned(&pipeline->transform[4]);
+		float32x4 column2 = loadUnaligned(&pipeline->transform[8]);
+		float32x4 column3 = loadUnaligned(&pipeline->transform[12]);
+
+		for (int i = start; i < end; ++i) {
+			const float* vertex = &job->data[(job->first + i) * job->stride];
+			Software::Vertex& out = vertices[i];
+
+			const float* position = &vertex[pipeline->positionOffset];
+			float x = position[0];
+			float y = pipeline->positionSize > 1 ? position[1] : 0.0f;
+			float z = pipeline->positionSize > 2 ? position[2] : 0.0f;
+			float w = pipeline->positionSize > 3 ? position[3] : 1.0f;
+			float32x4 clip = add(add(mul(column0, loadAll(x)), mul(column1, loadAll(y))), add(mul(column2, loadAll(z)), mul(column3, loadAll(w))));
+			storeUnaligned(&out.x, clip);
+
+			if (pipeline->texCoordOffset >= 0) {
+				out.u = vertex[pipeline->texCoordOffset];
+				out.v = vertex[pipeline->texCoordOffset + 1];
+			}
+			else {
+				out.u = out.v = 0.0f;
+			}
+
+			if (pipeline->colorOffset < 0) {
+				out.r = out.g = out.b = out.a = 1.0f;
+			}
+			else if (pipeline->packedColor) {
+				const u8* color = (const u8*)&vertex[pipeline->colorOffset];
+				out.r = color[0] / 255.0f;
+				out.g = color[1] / 255.0f;
+				out.b = color[2] / 255.0f;
+				out.a = color[3] / 255.0f;
+			}
+			else {
+				storeUnaligned(&out.r, loadUnaligned(&vertex[pipeline->colorOffset]));
+			}
+
+			out.slot = pipeline->slotOffset >= 0 ? vertex[pipeline->slotOffset] : 0.0f;
+		}
+	}
+
+	void intersect(int& x, int& y, int& width, int& height, int otherX, int otherY, int otherWidth, int otherHeight) {
+		int right = Kore::min(x + width, otherX + otherWidth);
+		int bottom = Kore::min(y + height, otherY + otherHeight);
+		x = Kore::max(x, otherX);
+		y = Kore::max(y, otherY);
+		width = right - x;
+		height = bottom - y;
+	}
+
+	void setupDrawState(Software::DrawState& state) {
+		state.target = target;
+		for (int i = 0; i < Software::maxSlots; ++i) {
+			state.textures[i] = i < pipeline->textureCount ? textures[i] : nullptr;
+			state.samplers[i].addressU = samplers[i].addressU;
+			state.samplers[i].addressV = samplers[i].addressV;
+			state.samplers[i].linear = samplers[i].filter != Graphics4::PointFilter;
+		}
+		state.textureSlots = pipeline->slotOffset >= 0;
+
+		state.viewportX = viewportX;
+		state.viewportY = viewportY;
+		state.viewportWidth = viewportWidth;
+		state.viewportHeight = viewportHeight;
+		state.clipX = viewportX;
+		state.clipY = viewportY;
+		state.clipWidth = viewportWidth;
+		state.clipHeight = viewportHeight;
+		intersect(state.clipX, state.clipY, state.clipWidth, state.clipHeight, 0, 0, target->width, target->height);
+		if (scissorEnabled) intersect(state.clipX, state.clipY, state.clipWidth, state.clipHeight, scissorX, scissorY, scissorWidth, scissorHeight);
+
+		state.cullMode = pipeline->cullMode;
+		state.depthTest = pipeline->depthMode != Graphics4::ZCompareAlways || pipeline->depthWrite;
+		state.depthWrite = pipeline->depthWrite;
+		state.depthMode = pipeline->depthMode;
+		state.blendSource = pipeline->blendSource;
+		state.blendDestination = pipeline->blendDestination;
+		state.alphaBlendSource = pipeline->alphaBlendSource;
+		state.alphaBlendDestination = pipeline->alphaBlendDestination;
+		state.blending = pipeline->blendSource != Graphics4::BlendOne || pipeline->blendDestination != Graphics4::BlendZero ||
+		                 pipeline->alphaBlendSource != Graphics4::BlendOne || pipeline->alphaBlendDestination != Graphics4::BlendZero;
+		state.premultiply = pipeline->blendSource == Graphics4::BlendOne && pipeline->blendDestination == Graphics4::InverseSourceAlpha;
+		state.writeMask = (pipeline->colorWriteMaskRed ? 0xff : 0) | (pipeline->colorWriteMaskGreen ? 0xff00 : 0) |
+		                  (pipeline->colorWriteMaskBlue ? 0xff0000 : 0) | (pipeline->colorWriteMaskAlpha ? 0xff000000 : 0);
+	}
+}
+
+const Software::Surface& Software::backbuffer() {
+	return backbufferSurface;
+}
+
+void Software::bindTexture(int unit, Surface* surface) {
+	if (unit >= 0 && unit < maxTextureUnits) textures[unit] = surface;
+}
+
+void Graphics4::init(int windowId, int depthBufferBits, int stencilBufferBits, bool vsync) {
+	// does nothing when the application started the job system itself
+	JobSystem::init();
+	for (int i = 0; i < Software::maxTextureUnits; ++i) {
+		textures[i] = nullptr;
+		samplers[i].addressU = samplers[i].addressV = Clamp;
+		samplers[i].filter = LinearFilter;
+	}
+	resizeBackbuffer(System::windowWidth(windowId), System::windowHeight(windowId), depthBufferBits > 0);
+	target = &backbufferSurface;
+	resetViewport();
+}
+
+void Graphics4::destroy(int windowId) {
+	delete[] backbufferSurface.pixels;
+	backbufferSurface.pixels = nullptr;
+	delete[] backbufferSurface.depth;
+	backbufferSurface.depth = nullptr;
+}
+
+void Graphics4::changeResolution(int width, int height) {
+	resizeBackbuffer(width, height, backbufferSurface.depth != nullptr);
+	if (target == &backbufferSurface) resetViewport();
+}
+
+unsigned Graphics4::refreshRate() {
+	return 60;
+}
+
+bool Graphics4::vsynced() {
+	return false;
+}
+
+void Graphics4::setBool(ConstantLocation location, bool value) {}
+
+void Graphics4::setInt(ConstantLocation location, int value) {}
+
+void Graphics4::setFloat(ConstantLocation location, float value) {}
+
+void Graphics4::setFloat2(ConstantLocation location, float value1, float value2) {}
+
+void Graphics4::setFloat3(ConstantLocation location, float value1, float value2, float value3) {}
+
+void Graphics4::setFloat4(ConstantLocation location, float value1, float value2, float value3, float value4) {}
+
+void Graphics4::setFloats(ConstantLocation location, float* values, int count) {}
+
+void Graphics4::setMatrix(ConstantLocation location, const mat4& value) {
+	if (pipeline == nullptr) return;
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			pipeline->transform[column * 4 + row] = value.get(row, column);
+		}
+	}
+}
+
+void Graphics4::setMatrix(ConstantLocation location, const mat3& value) {}
+
+void Graphics4::drawIndexedVertices() {
+	if (IndexBuffer::current != nullptr) drawIndexedVertices(0, IndexBuffer::current->count());
+}
+
+void Graphics4::drawIndexedVertices(int start, int count) {
+	VertexBuffer* vertexBuffer = VertexBuffer::current;
+	IndexBuffer* indexBuffer = IndexBuffer::current;
+	if (pipeline == nullptr || vertexBuffer == nullptr || indexBuffer == nullptr || pipeline->positionOffset < 0) return;
+	if (target->pixels == nullptr) return;
+	if (start + count > indexBuffer->count()) count = indexBuffer->count() - start;
+	if (count < 3) return;
+
+	const int* indices = &indexBuffer->data[start];
+	int first = INT_MAX;
+	int last = -1;
+	for (int i = 0; i < count; ++i) {
+		first = Kore::min(first, indices[i]);
+		last = Kore::max(last, indices[i]);
+	}
+	if (first < 0 || last >= vertexBuffer->count()) {
+		log(Warning, "Index out of range.");
+		return;
+	}
+
+	vertices.resize(last - first + 1);
+	FetchJob job;
+	job.data = vertexBuffer->data;
+	job.stride = vertexBuffer->stride() / 4;
+	job.first = first;
+	job.pipeline = pipeline;
+	JobSystem::parallelFor(last - first + 1, 1024, fetchVertices, &job);
+
+	Software::DrawState state;
+	setupDrawState(state);
+	Software::drawTriangles(state, &vertices[0], indices, count, first);
+}
+
+void Graphics4::drawIndexedVerticesInstanced(int instanceCount) {
+	if (IndexBuffer::current != nullptr) drawIndexedVerticesInstanced(instanceCount, 0, IndexBuffer::current->count());
+}
+
+void Graphics4::drawIndexedVerticesInstanced(int instanceCount, int start, int count) {
+	static bool warned = false;
+	if (!warned) {
+		log(Warning, "Instancing is not supported by the software renderer, drawing a single instance.");
+		warned = true;
+	}
+	drawIndexedVertices(start, count);
+}
+
+bool Graphics4::swapBuffers(int windowId) {
+	return true;
+}
+
+void Graphics4::makeCurrent(int windowId) {}
+
+void Graphics4::begin(int windowId) {}
+
+void Graphics4::end(int windowId) {}
+
+void Graphics4::viewport(int x, int y, int width, int height) {
+	viewportX = x;
+	viewportY = y;
+	viewportWidth = width;
+	viewportHeight = height;
+}
+
+void Graphics4::scissor(int x, int y, int width, int height) {
+	scissorEnabled = true;
+	scissorX = x;
+	scissorY = y;
+	scissorWidth = width;
+	scissorHeight = height;
+}
+
+void Graphics4::disableScissor() {
+	scissorEnabled = false;
+}
+
+void Graphics4::clear(uint flags, uint color, float depth, int stencil) {
+	if (target->pixels == nullptr) return;
+	int x = 0;
+	int y = 0;
+	int width = target->width;
+	int height = target->height;
+	if (scissorEnabled) intersect(x, y, width, height, scissorX, scissorY, scissorWidth, scissorHeight);
+	Software::clear(target, x, y, width, height, (flags & ClearColorFlag) != 0, Software::pixelFromColor(color), (flags & ClearDepthFlag) != 0, depth);
+}
+
+void Graphics4::setVertexBuffers(VertexBuffer** vertexBuffers, int count) {
+	int offset = 0;
+	for (int i = 0; i < count; ++i) {
+		offset += vertexBuffers[i]->_set(offset);
+	}
+}
+
+void Graphics4::setIndexBuffer(IndexBuffer& indexBuffer) {
+	indexBuffer._set();
+}
+
+void Graphics4::setTexture(TextureUnit unit, Texture* texture) {
+	if (texture == nullptr) {
+		Software::bindTexture(unit.unit, nullptr);
+	}
+	else {
+		texture->_set(unit);
+	}
+}
+
+void Graphics4::setImageTexture(TextureUnit unit, Texture* texture) {
+	texture->_setImage(unit);
+}
+
+void Graphics4::setTextureArray(TextureUnit unit, TextureArray* array) {
+	array->set(unit);
+}
+
+void Graphics4::setTextureAddressing(TextureUnit unit, TexDir dir, TextureAddressing addressing) {
+	if (unit.unit < 0 || unit.unit >= Software::maxTextureUnits) return;
+	if (dir == U) samplers[unit.unit].addressU = addressing;
+	else if (dir == V) samplers[unit.unit].addressV = addressing;
+}
+
+void Graphics4::setTexture3DAddressing(TextureUnit unit, TexDir dir, TextureAddressing addressing) {
+	setTextureAddressing(unit, dir, addressing);
+}
+
+// textures have no mipmaps, so the magnification filter is used for everything
+void Graphics4::setTextureMagnificationFilter(TextureUnit texunit, TextureFilter filter) {
+	if (texunit.unit >= 0 && texunit.unit < Software::maxTextureUnits) samplers[texunit.unit].filter = filter;
+}
+
+void Graphics4::setTexture3DMagnificationFilter(TextureUnit texunit, TextureFilter filter) {
+	setTextureMagnificationFilter(texunit, filter);
+}
+
+void Graphics4::setTextureMinificationFilter(TextureUnit texunit, TextureFilter filter) {}
+
+void Graphics4::setTexture3DMinificationFilter(TextureUnit texunit, TextureFilter filter) {}
+
+void Graphics4::setTextureMipmapFilter(TextureUnit texunit, MipmapFilter filter) {}
+
+void Graphics4::setTexture3DMipmapFilter(TextureUnit texunit, MipmapFilter filter) {}
+
+void Graphics4::setTextureOperation(TextureOperation operation, TextureArgument arg1, TextureArgument arg2) {}
+
+void Graphics4::setRenderTargets(RenderTarget** targets, int count) {
+	if (count > 1) {
+		static bool warned = false;
+		if (!warned) {
+			log(Warning, "The software renderer only draws into the first render target.");
+			warned = true;
+		}
+	}
+	target = &targets[0]->surface;
+	resetViewport();
+}
+
+void Graphics4::setRenderTargetFace(RenderTarget* texture, int face) {
+	setRenderTarget(texture);
+}
+
+void Graphics4::restoreRenderTarget() {
+	target = &backbufferSurface;
+	resetViewport();
+}
+
+bool Graphics4::renderTargetsInvertedY() {
+	return false;
+}
+
+bool Graphics4::nonPow2TexturesSupported() {
+	return true;
+}
+
+bool Graphics4::initOcclusionQuery(uint* occlusionQuery) {
+	return false;
+}
+
+void Graphics4::deleteOcclusionQuery(uint occlusionQuery) {}
+
+void Graphics4::renderOcclusionQuery(uint occlusionQuery, int triangles) {}
+
+bool Graphics4::isQueryResultsAvailable(uint occlusionQuery) {
+	return true;
+}
+
+void Graphics4::getQueryResults(uint occlusionQuery, uint* pixelCount) {
+	*pixelCount = 0;
+}
+
+// every draw call is finished when it returns
+void Graphics4::flush() {}
+
+void Graphics4::setPipeline(PipelineState* pipeline) {
+	::pipeline = pipeline;
+}
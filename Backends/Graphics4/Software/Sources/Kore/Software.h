@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Kore {
+	namespace Software {
+		// RGBA8 pixels with red in the lowest byte and an optional depth buffer, rows run from top to bottom
+		struct Surface {
+			u32* pixels;
+			float* depth;
+			int width;
+			int height;
+		};
+
+		const int maxTextureUnits = 16;
+
+		// What the renderer drew into the window, read it after swapBuffers to look at a frame
+		const Surface& backbuffer();
+		void bindTexture(int unit, Surface* surface);
+	}
+}
@@ -0,0 +1,13 @@
+#include "pch.h"
+
+#include <Kore/Graphics4/TextureArray.h>
+#include <Kore/Log.h>
+
+using namespace Kore;
+using namespace Kore::Graphics4;
+
+TextureArray::TextureArray(Image** textures, int count) {
+	log(Warning, "Texture arrays are not supported by the software renderer.");
+}
+
+void TextureArrayImpl::set(TextureUnit unit) {}
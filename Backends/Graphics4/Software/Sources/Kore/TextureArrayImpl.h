@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Kore/Graphics4/Graphics.h>
+
+class TextureArrayImpl {
+public:
+	void set(Kore::Graphics4::TextureUnit unit);
+};
@@ -0,0 +1,216 @@
+#include "pch.h"
+
+#include "Rasterizer.h"
+
+#include <Kore/Graphics4/Graphics.h>
+#include <Kore/Log.h>
+
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	u32 rgba(int red, int green, int blue, int alpha) {
+		return (u32)alpha << 24 | (u32)blue << 16 | (u32)green << 8 | (u32)red;
+	}
+
+	int toByte(float value) {
+		if (!(value > 0.0f)) return 0;
+		if (value >= 1.0f) return 255;
+		return (int)(value * 255.0f + 0.5f);
+	}
+
+	float halfToFloat(u16 half) {
+		u32 sign = (u32)(half & 0x8000) << 16;
+		u32 exponent = (half >> 10) & 0x1f;
+		u32 mantissa = half & 0x3ff;
+		u32 bits;
+		if (exponent == 0) {
+			if (mantissa == 0) {
+				bits = sign;
+			}
+			else {
+				// denormals become normalized floats
+				exponent = 127 - 15 + 1;
+				while ((mantissa & 0x400) == 0) {
+					mantissa <<= 1;
+					--exponent;
+				}
+				bits = sign | exponent << 23 | (mantissa & 0x3ff) << 13;
+			}
+		}
+		else if (exponent == 31) {
+			bits = sign | 0x7f800000 | mantissa << 13;
+		}
+		else {
+			bits = sign | (exponent + 127 - 15) << 23 | mantissa << 13;
+		}
+		float value;
+		memcpy(&value, &bits, 4);
+		return value;
+	}
+
+	void allocate(Software::Surface& surface, int width, int height) {
+		surface.width = width;
+		surface.height = height;
+		surface.pixels = new u32[width * height];
+		surface.depth = nullptr;
+	}
+
+	// Converts the first slice of the image into the surface
+	void convert(Graphics4::Texture* texture) {
+		Software::Surface& surface = texture->surface;
+		int count = surface.width * surface.height;
+		u8* data = texture->data;
+		float* hdrData = texture->hdrData;
+		u16* halfData = (u16*)hdrData;
+		if (data == nullptr && hdrData == nullptr) return;
+
+		switch (texture->format) {
+		case Graphics1::Image::RGBA32:
+			memcpy(surface.pixels, data, count * 4);
+			break;
+		case Graphics1::Image::BGRA32:
+			for (int i = 0; i < count; ++i) surface.pixels[i] = rgba(data[i * 4 + 2], data[i * 4 + 1], data[i * 4 + 0], data[i * 4 + 3]);
+			break;
+		case Graphics1::Image::RGB24:
+			for (int i = 0; i < count; ++i) surface.pixels[i] = rgba(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2], 255);
+			break;
+		case Graphics1::Image::Grey8:
+			for (int i = 0; i < count; ++i) surface.pixels[i] = rgba(255, 255, 255, data[i]);
+			break;
+		case Graphics1::Image::RGBA128:
+			for (int i = 0; i < count; ++i) {
+				surface.pixels[i] = rgba(toByte(hdrData[i * 4 + 0]), toByte(hdrData[i * 4 + 1]), toByte(hdrData[i * 4 + 2]), toByte(hdrData[i * 4 + 3]));
+			}
+			break;
+		case Graphics1::Image::RGBA64:
+			for (int i = 0; i < count; ++i) {
+				surface.pixels[i] = rgba(toByte(halfToFloat(halfData[i * 4 + 0])), toByte(halfToFloat(halfData[i * 4 + 1])),
+				                         toByte(halfToFloat(halfData[i * 4 + 2])), toByte(halfToFloat(halfData[i * 4 + 3])));
+			}
+			break;
+		case Graphics1::Image::A32:
+			for (int i = 0; i < count; ++i) surface.pixels[i] = rgba(255, 255, 255, toByte(hdrData[i]));
+			break;
+		case Graphics1::Image::A16:
+			for (int i = 0; i < count; ++i) surface.pixels[i] = rgba(255, 255, 255, toByte(halfToFloat(halfData[i])));
+			break;
+		}
+	}
+
+	bool isHdr(Graphics1::Image::Format format) {
+		return format == Graphics1::Image::RGBA128 || format == Graphics1::Image::RGBA64 || format == Graphics1::Image::A32 ||
+		       format == Graphics1::Image::A16;
+	}
+}
+
+TextureImpl::TextureImpl() {
+	surface.pixels = nullptr;
+	surface.depth = nullptr;
+	surface.width = surface.height = 0;
+}
+
+TextureImpl::~TextureImpl() {
+	delete[] surface.pixels;
+}
+
+void Graphics4::Texture::init(const char* format, bool readable) {
+	setId();
+	texWidth = width;
+	texHeight = height;
+	texDepth = 1;
+	allocate(surface, texWidth, texHeight);
+
+	if (compression == Graphics1::ImageCompressionNone) {
+		convert(this);
+	}
+	else {
+		log(Warning, "Compressed textures are not supported by the software renderer.");
+		for (int i = 0; i < texWidth * texHeight; ++i) surface.pixels[i] = 0xffffffff;
+	}
+
+	if (!readable) {
+		if (isHdr(this->format)) {
+			delete[] hdrData;
+			hdrData = nullptr;
+		}
+		else {
+			delete[] data;
+			data = nullptr;
+		}
+	}
+}
+
+void Graphics4::Texture::init3D(bool readable) {
+	log(Warning, "3D textures are not supported by the software renderer, only the first slice is used.");
+	init("", readable);
+	texDepth = depth;
+}
+
+Graphics4::Texture::Texture(int width, int height, Image::Format format, bool readable) : Image(width, height, format, readable) {
+	setId();
+	texWidth = width;
+	texHeight = height;
+	texDepth = 1;
+	allocate(surface, texWidth, texHeight);
+	convert(this);
+}
+
+Graphics4::Texture::Texture(int width, int height, int depth, Image::Format format, bool readable) : Image(width, height, depth, format, readable) {
+	log(Warning, "3D textures are not supported by the software renderer, only the first slice is used.");
+	setId();
+	texWidth = width;
+	texHeight = height;
+	texDepth = depth;
+	allocate(surface, texWidth, texHeight);
+	convert(this);
+}
+
+void Graphics4::Texture::_set(TextureUnit unit) {
+	Software::bindTexture(unit.unit, &surface);
+}
+
+void Graphics4::Texture::_setImage(TextureUnit unit) {
+	log(Warning, "Image textures are not supported by the software renderer.");
+}
+
+int Graphics4::Texture::stride() {
+	return texWidth * sizeOf(format);
+}
+
+u8* Graphics4::Texture::lock() {
+	// If data is nullptr then it must be a float image
+	return (data ? data : reinterpret_cast<u8*>(hdrData));
+}
+
+void Graphics4::Texture::unlock() {
+	convert(this);
+}
+
+void Graphics4::Texture::uploadRegion(int x, int y, int width, int height, u8* data, int stride) {
+	int pixelSize = sizeOf(format);
+	for (int row = 0; row < height; ++row) memcpy(&this->data[(y + row) * this->stride() + x * pixelSize], &data[row * stride], width * pixelSize);
+	convert(this);
+}
+
+void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
+	Software::clear(&surface, x, y, width, height, true, Software::pixelFromColor(color), false, 0.0f);
+}
+
+#if defined(KORE_IOS) || defined(KORE_MACOS)
+// stride is in pixels
+void Graphics4::Texture::upload(u8* data, int stride) {
+	if (this->data == nullptr) return;
+	int rowSize = texWidth * sizeOf(format);
+	for (int y = 0; y < texHeight; ++y) {
+		memcpy(&this->data[y * rowSize], &data[y * stride * sizeOf(format)], rowSize);
+	}
+	convert(this);
+}
+#endif
+
+// there are no mipmaps, textures are always sampled at full resolution
+void Graphics4::Texture::generateMipmaps(int levels) {}
+
+void Graphics4::Texture::setMipmap(Texture* mipmap, int level) {}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Software.h"
+
+#include <Kore/Graphics1/Image.h>
+
+namespace Kore {
+	class TextureUnitImpl {
+	public:
+		int unit;
+	};
+
+	class TextureImpl {
+	public:
+		TextureImpl();
+		~TextureImpl();
+		// The texels converted to RGBA8, single channel formats become white with the channel as alpha
+		Software::Surface surface;
+	};
+}
@@ -0,0 +1,79 @@
+#include "pch.h"
+
+#include "VertexBufferImpl.h"
+
+#include <Kore/Graphics4/Graphics.h>
+
+using namespace Kore;
+
+Graphics4::VertexBuffer* VertexBufferImpl::current = nullptr;
+
+VertexBufferImpl::VertexBufferImpl(int count, int instanceDataStepRate) : myCount(count), instanceDataStepRate(instanceDataStepRate) {}
+
+Graphics4::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& structure, int instanceDataStepRate, Usage usage)
+    : VertexBufferImpl(vertexCount, instanceDataStepRate) {
+	myStride = 0;
+	for (int i = 0; i < structure.size; ++i) {
+		VertexElement element = structure.elements[i];
+		switch (element.data) {
+		case ColorVertexData:
+			myStride += 1 * 4;
+			break;
+		case Float1VertexData:
+			myStride += 1 * 4;
+			break;
+		case Float2VertexData:
+			myStride += 2 * 4;
+			break;
+		case Float3VertexData:
+			myStride += 3 * 4;
+			break;
+		case Float4VertexData:
+			myStride += 4 * 4;
+			break;
+		case Float4x4VertexData:
+			myStride += 4 * 4 * 4;
+			break;
+		case NoVertexData:
+			break;
+		}
+	}
+	this->structure = structure;
+	data = new float[vertexCount * myStride / 4];
+}
+
+Graphics4::VertexBuffer::~VertexBuffer() {
+	unset();
+	delete[] data;
+}
+
+float* Graphics4::VertexBuffer::lock() {
+	return data;
+}
+
+float* Graphics4::VertexBuffer::lock(int start, int count) {
+	u8* u8data = (u8*)data;
+	return (float*)&u8data[start * stride()];
+}
+
+// the rasterizer reads the vertices straight from data
+void Graphics4::VertexBuffer::unlock() {}
+
+void Graphics4::VertexBuffer::unlock(int count) {}
+
+int Graphics4::VertexBuffer::_set(int offset) {
+	if (offset == 0) current = this;
+	return structure.size;
+}
+
+void VertexBufferImpl::unset() {
+	if ((void*)current == (void*)this) current = nullptr;
+}
+
+int Graphics4::VertexBuffer::count() {
+	return myCount;
+}
+
+int Graphics4::VertexBuffer::stride() {
+	return myStride;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Kore/Graphics4/VertexStructure.h>
+
+namespace Kore {
+	namespace Graphics4 {
+		class VertexBuffer;
+	}
+
+	class VertexBufferImpl {
+	protected:
+		VertexBufferImpl(int count, int instanceDataStepRate);
+		void unset();
+
+	public:
+		float* data;
+		int myCount;
+		int myStride;
+		Graphics4::VertexStructure structure;
+		int instanceDataStepRate;
+
+		static Graphics4::VertexBuffer* current;
+	};
+}
@@ -240,3 +240,13 @@ void Graphics5::PipelineState::compile() {
 
 	device->CreateGraphicsPipelineState(&psoDesc, IID_GRAPHICS_PPV_ARGS(&pso));
 }
+
+void Graphics5::PipelineState::compileAsync() {
+	compile();
+}
+
+bool Graphics5::PipelineState::isReady() {
+	return true;
+}
+
+void Graphics5::PipelineState::waitUntilReady() {}
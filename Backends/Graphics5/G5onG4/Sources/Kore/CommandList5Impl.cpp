@@ -1,133 +1,381 @@
 #include "pch.h"
 
 #include <Kore/Graphics5/CommandList.h>
+#include <Kore/Graphics5/ConstantBuffer.h>
 #include <Kore/Graphics5/PipelineState.h>
 
 #include <Kore/Graphics4/Graphics.h>
+#include <Kore/Log.h>
+
+#ifdef KORE_OPENGL
+#include <Kore/ogl.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
 
 using namespace Kore;
 using namespace Kore::Graphics5;
 
 namespace {
-	enum Commands { Clear, Draw, SetViewport, SetScissor, SetPipeline, SetVertexBuffer, SetIndexBuffer, SetRenderTarget };
-}
+	// Every command starts with its opcode, followed by the number of s64 arguments listed behind it
+	enum Commands {
+		Clear,                    // flags, color, depth, stencil
+		Draw,                     // start, count
+		SetViewport,              // x, y, width, height
+		SetScissor,               // x, y, width, height
+		DisableScissor,           //
+		SetPipeline,              // pipeline
+		SetVertexBuffers,         // count, count * (buffer, offset)
+		SetIndexBuffer,           // buffer
+		SetRenderTargets,         // count, count * target
+		SetVertexConstantBuffer,  // buffer, offset
+		SetFragmentConstantBuffer // buffer, offset
+	};
 
-CommandList::CommandList() {}
+	const int chunkCapacity = 1024;
+	const int maxVertexBuffers = 16;
+	const int maxRenderTargets = 8;
 
-CommandList::~CommandList() {}
+	s64 floatBits(float value) {
+		s32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
 
-void CommandList::begin() {
-	commandIndex = 0;
-}
+	float bitsFloat(s64 value) {
+		s32 bits = (s32)value;
+		float result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
 
-void CommandList::end() {
-	int index = 0;
-	while (index < commandIndex) {
-		switch (commands[index]) {
-		case Clear:
-			Graphics4::clear((uint)commands[index + 1], (uint)commands[index + 2]);
-			index += 3;
+	// Hands one constant slot to Graphics4 with the setter which matches the type of the constant
+	void uploadConstant(Graphics4::ConstantLocation& location, u8* data) {
+#if defined(KORE_OPENGL)
+		float* floats = reinterpret_cast<float*>(data);
+		switch (location.type) {
+		case GL_FLOAT:
+			Graphics4::setFloat(location, floats[0]);
 			break;
-		case Draw:
-			Graphics4::drawIndexedVertices((int)commands[index + 1], (int)commands[index + 2]);
-			index += 3;
+		case GL_FLOAT_VEC2:
+			Graphics4::setFloat2(location, floats[0], floats[1]);
 			break;
-		case SetViewport:
-			Graphics4::viewport((int)commands[index + 1], (int)commands[index + 2], (int)commands[index + 3], (int)commands[index + 4]);
-			index += 5;
+		case GL_FLOAT_VEC3:
+			Graphics4::setFloat3(location, floats[0], floats[1], floats[2]);
 			break;
-		case SetScissor:
-			Graphics4::scissor((int)commands[index + 1], (int)commands[index + 2], (int)commands[index + 3], (int)commands[index + 4]);
-			index += 5;
+		case GL_FLOAT_VEC4:
+			Graphics4::setFloat4(location, floats[0], floats[1], floats[2], floats[3]);
 			break;
-		case SetPipeline: {
-			PipelineState* pipeline = (PipelineState*)commands[index + 1];
-			Graphics4::setPipeline(pipeline->state);
-			index += 2;
+		case GL_FLOAT_MAT3: {
+			// rows are padded to four floats like in ConstantBuffer::setMatrix
+			mat3 value;
+			for (int y = 0; y < 3; ++y) {
+				for (int x = 0; x < 3; ++x) value.Set(y, x, floats[x + y * 4]);
+			}
+			Graphics4::setMatrix(location, value);
 			break;
 		}
-		case SetVertexBuffer: {
-			VertexBuffer* vb = (VertexBuffer*)commands[index + 1];
-			Graphics4::setVertexBuffer(*vb->buffer);
-			index += 2;
+		case GL_FLOAT_MAT4: {
+			mat4 value;
+			for (int y = 0; y < 4; ++y) {
+				for (int x = 0; x < 4; ++x) value.Set(y, x, floats[x + y * 4]);
+			}
+			Graphics4::setMatrix(location, value);
 			break;
 		}
-		case SetIndexBuffer: {
-			IndexBuffer* ib = (IndexBuffer*)commands[index + 1];
-			Graphics4::setIndexBuffer(*ib->buffer);
-			index += 2;
+		case GL_INT:
+		case GL_BOOL:
+			Graphics4::setInt(location, *reinterpret_cast<int*>(data));
 			break;
+		default:
+			break;
+		}
+#elif defined(KORE_DIRECT3D11)
+		float* floats = reinterpret_cast<float*>(data);
+		int size = location.vertexSize > location.fragmentSize ? location.vertexSize : location.fragmentSize;
+		if (size > PipelineState5Impl::constantSlotSize) size = PipelineState5Impl::constantSlotSize;
+		Graphics4::setFloats(location, floats, size / 4);
+#else
+		static bool warned = false;
+		if (!warned) {
+			log(Warning, "Constant buffers are not supported on this Graphics4 backend.");
+			warned = true;
+		}
+#endif
+	}
+
+	// Graphics4 knows one set of constants per pipeline. The vertex constant buffer supplies them,
+	// the fragment constant buffer is only used while no vertex constant buffer is bound.
+	void uploadConstants(PipelineState* pipeline, ConstantBuffer* buffer, int offset) {
+		if (pipeline == nullptr || buffer == nullptr) return;
+		for (size_t i = 0; i < pipeline->constants.size(); ++i) {
+			int start = offset + pipeline->constants[i].offset;
+			if (start + PipelineState5Impl::constantSlotSize > buffer->size()) continue;
+			uploadConstant(*pipeline->constants[i].location, &buffer->_data[start]);
 		}
-		case SetRenderTarget:
+	}
+}
 
-			index += 2;
-			break;
-		default:
-			return;
+CommandList5Impl::CommandList5Impl() : _currentPipeline(nullptr), _indexCount(0), deferred(false), firstChunk(nullptr), currentChunk(nullptr), closed(false) {}
+
+CommandList5Impl::~CommandList5Impl() {
+	CommandChunk* chunk = firstChunk;
+	while (chunk != nullptr) {
+		CommandChunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+// Returns room for count consecutive values, reuses the chunks of earlier recordings and adds chunks when they run out
+s64* CommandList5Impl::reserve(int count) {
+	if (currentChunk == nullptr || currentChunk->count + count > currentChunk->capacity) {
+		CommandChunk* next = currentChunk == nullptr ? firstChunk : currentChunk->next;
+		if (next == nullptr || next->capacity < count) {
+			int capacity = count > chunkCapacity ? count : chunkCapacity;
+			CommandChunk* chunk = (CommandChunk*)malloc(sizeof(CommandChunk) + (capacity - 1) * sizeof(s64));
+			chunk->capacity = capacity;
+			chunk->next = next;
+			if (currentChunk == nullptr) firstChunk = chunk;
+			else currentChunk->next = chunk;
+			next = chunk;
+		}
+		next->count = 0;
+		currentChunk = next;
+	}
+	s64* commands = &currentChunk->commands[currentChunk->count];
+	currentChunk->count += count;
+	return commands;
+}
+
+void CommandList5Impl::replay() {
+	if (currentChunk == nullptr) return;
+	PipelineState* pipeline = nullptr;
+	ConstantBuffer* vertexConstants = nullptr;
+	ConstantBuffer* fragmentConstants = nullptr;
+	int vertexConstantsOffset = 0;
+	int fragmentConstantsOffset = 0;
+	bool constantsChanged = false;
+
+	for (CommandChunk* chunk = firstChunk;; chunk = chunk->next) {
+		s64* commands = chunk->commands;
+		int index = 0;
+		while (index < chunk->count) {
+			switch (commands[index]) {
+			case Clear:
+				Graphics4::clear((uint)commands[index + 1], (uint)commands[index + 2], bitsFloat(commands[index + 3]), (int)commands[index + 4]);
+				index += 5;
+				break;
+			case Draw:
+				if (constantsChanged) {
+					if (vertexConstants != nullptr) uploadConstants(pipeline, vertexConstants, vertexConstantsOffset);
+					else uploadConstants(pipeline, fragmentConstants, fragmentConstantsOffset);
+					constantsChanged = false;
+				}
+				Graphics4::drawIndexedVertices((int)commands[index + 1], (int)commands[index + 2]);
+				index += 3;
+				break;
+			case SetViewport:
+				Graphics4::viewport((int)commands[index + 1], (int)commands[index + 2], (int)commands[index + 3], (int)commands[index + 4]);
+				index += 5;
+				break;
+			case SetScissor:
+				Graphics4::scissor((int)commands[index + 1], (int)commands[index + 2], (int)commands[index + 3], (int)commands[index + 4]);
+				index += 5;
+				break;
+			case DisableScissor:
+				Graphics4::disableScissor();
+				index += 1;
+				break;
+			case SetPipeline:
+				pipeline = (PipelineState*)commands[index + 1];
+				Graphics4::setPipeline(pipeline->state);
+				constantsChanged = true;
+				index += 2;
+				break;
+			case SetVertexBuffers: {
+				// Graphics4 has no vertex buffer offsets, they are recorded but not applied
+				int count = (int)commands[index + 1];
+				Graphics4::VertexBuffer* buffers[maxVertexBuffers];
+				for (int i = 0; i < count; ++i) buffers[i] = ((VertexBuffer*)commands[index + 2 + i * 2])->buffer;
+				Graphics4::setVertexBuffers(buffers, count);
+				index += 2 + count * 2;
+				break;
+			}
+			case SetIndexBuffer:
+				Graphics4::setIndexBuffer(*((IndexBuffer*)commands[index + 1])->buffer);
+				index += 2;
+				break;
+			case SetRenderTargets: {
+				int count = (int)commands[index + 1];
+				if (count == 0 || commands[index + 2] == 0) {
+					Graphics4::restoreRenderTarget();
+				}
+				else {
+					Graphics4::RenderTarget* targets[maxRenderTargets];
+					for (int i = 0; i < count; ++i) targets[i] = ((RenderTarget*)commands[index + 2 + i])->renderTarget;
+					Graphics4::setRenderTargets(targets, count);
+				}
+				index += 2 + count;
+				break;
+			}
+			case SetVertexConstantBuffer:
+				vertexConstants = (ConstantBuffer*)commands[index + 1];
+				vertexConstantsOffset = (int)commands[index + 2];
+				constantsChanged = true;
+				index += 3;
+				break;
+			case SetFragmentConstantBuffer:
+				fragmentConstants = (ConstantBuffer*)commands[index + 1];
+				fragmentConstantsOffset = (int)commands[index + 2];
+				constantsChanged = true;
+				index += 3;
+				break;
+			default:
+				log(Error, "Unknown command %i in command list.", (int)commands[index]);
+				return;
+			}
 		}
+		if (chunk == currentChunk) break;
+	}
+}
+
+CommandList::CommandList() {}
+
+CommandList::~CommandList() {}
+
+void CommandList::begin() {
+	currentChunk = nullptr;
+	closed = false;
+}
+
+void CommandList::end() {
+	closed = true;
+	if (!deferred) replay();
+}
+
+void CommandList::execute() {
+	if (!closed) {
+		log(Warning, "Command lists have to be ended before they are executed.");
+		return;
 	}
+	replay();
+}
+
+void CommandList::executeAndWait() {
+	execute();
+	Graphics4::flush();
 }
 
 void CommandList::clear(RenderTarget* renderTarget, uint flags, uint color, float depth, int stencil) {
-	commands[commandIndex++] = Clear;
-	commands[commandIndex++] = flags;
-	commands[commandIndex++] = color;
+	s64* command = reserve(5);
+	command[0] = Clear;
+	command[1] = flags;
+	command[2] = color;
+	command[3] = floatBits(depth);
+	command[4] = stencil;
 }
 
 void CommandList::renderTargetToFramebufferBarrier(RenderTarget* renderTarget) {}
 
 void CommandList::framebufferToRenderTargetBarrier(RenderTarget* renderTarget) {}
 
+void CommandList::textureToRenderTargetBarrier(RenderTarget* renderTarget) {}
+
+void CommandList::renderTargetToTextureBarrier(RenderTarget* renderTarget) {}
+
 void CommandList::drawIndexedVertices() {
-	commands[commandIndex++] = Draw;
-	commands[commandIndex++] = 0;
-	commands[commandIndex++] = _indexCount;
+	drawIndexedVertices(0, _indexCount);
 }
 
 void CommandList::drawIndexedVertices(int start, int count) {
-	commands[commandIndex++] = Draw;
-	commands[commandIndex++] = start;
-	commands[commandIndex++] = count;
+	s64* command = reserve(3);
+	command[0] = Draw;
+	command[1] = start;
+	command[2] = count;
 }
 
 void CommandList::viewport(int x, int y, int width, int height) {
-	commands[commandIndex++] = SetViewport;
-	commands[commandIndex++] = x;
-	commands[commandIndex++] = y;
-	commands[commandIndex++] = width;
-	commands[commandIndex++] = height;
+	s64* command = reserve(5);
+	command[0] = SetViewport;
+	command[1] = x;
+	command[2] = y;
+	command[3] = width;
+	command[4] = height;
 }
 
 void CommandList::scissor(int x, int y, int width, int height) {
-	commands[commandIndex++] = SetScissor;
-	commands[commandIndex++] = x;
-	commands[commandIndex++] = y;
-	commands[commandIndex++] = width;
-	commands[commandIndex++] = height;
+	s64* command = reserve(5);
+	command[0] = SetScissor;
+	command[1] = x;
+	command[2] = y;
+	command[3] = width;
+	command[4] = height;
 }
 
-void CommandList::disableScissor() {}
+void CommandList::disableScissor() {
+	s64* command = reserve(1);
+	command[0] = DisableScissor;
+}
 
 void CommandList::setPipeline(PipelineState* pipeline) {
-	commands[commandIndex++] = SetPipeline;
-	commands[commandIndex++] = (s64)pipeline;
+	_currentPipeline = pipeline;
+	s64* command = reserve(2);
+	command[0] = SetPipeline;
+	command[1] = (s64)pipeline;
 }
 
+void CommandList::setPipelineLayout() {}
+
 void CommandList::setVertexBuffers(VertexBuffer** buffers, int* offsets, int count) {
-	commands[commandIndex++] = SetVertexBuffer;
-	commands[commandIndex++] = (s64)buffers[0];
+	if (count > maxVertexBuffers) {
+		log(Warning, "Only %i vertex buffers can be set at once.", maxVertexBuffers);
+		count = maxVertexBuffers;
+	}
+	s64* command = reserve(2 + count * 2);
+	command[0] = SetVertexBuffers;
+	command[1] = count;
+	for (int i = 0; i < count; ++i) {
+		command[2 + i * 2] = (s64)buffers[i];
+		command[3 + i * 2] = offsets != nullptr ? offsets[i] : 0;
+	}
 }
 
 void CommandList::setIndexBuffer(IndexBuffer& buffer) {
-	commands[commandIndex++] = SetIndexBuffer;
-	commands[commandIndex++] = (s64)&buffer;
+	_indexCount = buffer.count();
+	s64* command = reserve(2);
+	command[0] = SetIndexBuffer;
+	command[1] = (s64)&buffer;
 }
 
 void CommandList::setRenderTargets(RenderTarget** targets, int count) {
-	commands[commandIndex++] = SetRenderTarget;
-	commands[commandIndex++] = (s64)targets[0];
+	if (count > maxRenderTargets) {
+		log(Warning, "Only %i render targets can be set at once.", maxRenderTargets);
+		count = maxRenderTargets;
+	}
+	s64* command = reserve(2 + count);
+	command[0] = SetRenderTargets;
+	command[1] = count;
+	for (int i = 0; i < count; ++i) command[2 + i] = (s64)targets[i];
+}
+
+void CommandList::setVertexConstantBuffer(ConstantBuffer* buffer, int offset) {
+	s64* command = reserve(3);
+	command[0] = SetVertexConstantBuffer;
+	command[1] = (s64)buffer;
+	command[2] = offset;
+}
+
+void CommandList::setFragmentConstantBuffer(ConstantBuffer* buffer, int offset) {
+	s64* command = reserve(3);
+	command[0] = SetFragmentConstantBuffer;
+	command[1] = (s64)buffer;
+	command[2] = offset;
 }
 
 void CommandList::upload(IndexBuffer* buffer) {}
 
+void CommandList::upload(VertexBuffer* buffer) {}
+
 void CommandList::upload(Texture* texture) {}
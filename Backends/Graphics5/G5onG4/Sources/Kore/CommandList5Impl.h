@@ -10,9 +10,28 @@ class CommandList5Impl {
 public:
 	Kore::Graphics5::PipelineState* _currentPipeline;
 	int _indexCount;
-	Kore::s64 commands[1024];
-	int commandIndex;
+
+	// Deferred lists are only recorded between begin and end, which is safe on any thread when every list is used by one thread at a time.
+	// They are replayed by execute on the graphics thread, other lists are replayed right away by end.
+	bool deferred;
 
 protected:
+	CommandList5Impl();
+	~CommandList5Impl();
+
+	// Commands never cross chunks, chunks are kept and reused by the next begin
+	struct CommandChunk {
+		CommandChunk* next;
+		int count;
+		int capacity;
+		Kore::s64 commands[1];
+	};
+
+	CommandChunk* firstChunk;
+	CommandChunk* currentChunk;
+
+	Kore::s64* reserve(int count);
+	void replay();
+
 	bool closed;
 };
@@ -2,25 +2,35 @@
 
 #include <Kore/Graphics5/ConstantBuffer.h>
 
+#include <string.h>
+
 using namespace Kore;
 
 ConstantBuffer5Impl::ConstantBuffer5Impl() : transposeMat3(false), transposeMat4(false) {}
 
 Graphics5::ConstantBuffer::ConstantBuffer(int size) {
 	mySize = size;
+	_data = new u8[size];
+	memset(_data, 0, size);
 	data = nullptr;
 }
 
-Graphics5::ConstantBuffer::~ConstantBuffer() {}
+Graphics5::ConstantBuffer::~ConstantBuffer() {
+	delete[] _data;
+}
 
 void Graphics5::ConstantBuffer::lock() {
 	lock(0, size());
 }
 
-void Graphics5::ConstantBuffer::lock(int start, int count) {}
+void Graphics5::ConstantBuffer::lock(int start, int count) {
+	lastStart = start;
+	lastCount = count;
+	// offsets of the setters are relative to the locked range
+	data = &_data[start];
+}
 
 void Graphics5::ConstantBuffer::unlock() {
-
 	data = nullptr;
 }
 
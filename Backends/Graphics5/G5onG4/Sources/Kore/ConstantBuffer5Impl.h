@@ -4,6 +4,8 @@ namespace Kore {
 	class ConstantBuffer5Impl {
 	public:
 		ConstantBuffer5Impl();
+		// Constants are kept in memory and handed to Graphics4 when a command list is replayed
+		u8* _data;
 
 	protected:
 		int lastStart;
@@ -11,7 +11,7 @@ using namespace Kore;
 IndexBuffer5Impl* IndexBuffer5Impl::_current = nullptr;
 
 IndexBuffer5Impl::IndexBuffer5Impl(int count, bool gpuMemory) : myCount(count) {
-	buffer = new Graphics4::IndexBuffer(count);
+	buffer = new Graphics4::IndexBuffer(count, gpuMemory ? Graphics4::StaticUsage : Graphics4::DynamicUsage);
 }
 
 Graphics5::IndexBuffer::IndexBuffer(int count, bool gpuMemory) : IndexBuffer5Impl(count, gpuMemory) {}
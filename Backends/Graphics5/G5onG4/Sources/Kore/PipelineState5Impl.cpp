@@ -9,13 +9,31 @@
 
 using namespace Kore;
 
-PipelineState5Impl::PipelineState5Impl() {
+PipelineState5Impl::PipelineState5Impl() : constantSize(0) {
 	state = new Graphics4::PipelineState();
 }
 
+PipelineState5Impl::~PipelineState5Impl() {
+	for (size_t i = 0; i < constants.size(); ++i) delete constants[i].location;
+	delete state;
+}
+
 Graphics5::ConstantLocation Graphics5::PipelineState::getConstantLocation(const char* name) {
+	size_t index = 0;
+	while (index < constants.size() && constants[index].name != name) ++index;
+	if (index == constants.size()) {
+		ConstantSlot slot;
+		slot.name = name;
+		slot.location = new Graphics4::ConstantLocation(state->getConstantLocation(name));
+		slot.offset = constantSize;
+		constantSize += constantSlotSize;
+		constants.push_back(slot);
+	}
+
 	ConstantLocation location;
-	location.location = new Graphics4::ConstantLocation(state->getConstantLocation(name));
+	location.location = constants[index].location;
+	location.vertexOffset = constants[index].offset;
+	location.fragmentOffset = constants[index].offset;
 	return location;
 }
 
@@ -31,3 +49,18 @@ void Graphics5::PipelineState::compile() {
 	state->fragmentShader = fragmentShader->shader;
 	state->compile();
 }
+
+void Graphics5::PipelineState::compileAsync() {
+	state->inputLayout[0] = inputLayout[0];
+	state->vertexShader = vertexShader->shader;
+	state->fragmentShader = fragmentShader->shader;
+	state->compileAsync();
+}
+
+bool Graphics5::PipelineState::isReady() {
+	return state->isReady();
+}
+
+void Graphics5::PipelineState::waitUntilReady() {
+	state->waitUntilReady();
+}
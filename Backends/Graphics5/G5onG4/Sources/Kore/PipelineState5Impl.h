@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 namespace Kore {
 	namespace Graphics4 {
 		class ConstantLocation;
@@ -14,12 +17,26 @@ namespace Kore {
 	class PipelineState5Impl {
 	public:
 		PipelineState5Impl();
+		~PipelineState5Impl();
 		Graphics4::PipelineState* state;
+
+		// Every constant which is asked for gets a slot of constantSlotSize bytes in the constant buffers
+		struct ConstantSlot {
+			std::string name;
+			Graphics4::ConstantLocation* location;
+			int offset;
+		};
+
+		static const int constantSlotSize = 64;
+		std::vector<ConstantSlot> constants;
+		int constantSize;
 	};
 
 	class ConstantLocation5Impl {
 	public:
 		Graphics4::ConstantLocation* location;
+		int vertexOffset;
+		int fragmentOffset;
 	};
 
 	class AttributeLocation5Impl {};
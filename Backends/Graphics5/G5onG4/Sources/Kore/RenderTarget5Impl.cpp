@@ -2,6 +2,7 @@
 
 #include "RenderTarget5Impl.h"
 
+#include <Kore/Graphics4/Graphics.h>
 #include <Kore/Graphics5/Graphics.h>
 #include <Kore/Log.h>
 
@@ -9,17 +10,36 @@ using namespace Kore;
 
 Graphics5::RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits,
                                       int contextId) {
-	this->texWidth = this->width = width;
-	this->texHeight = this->height = height;
+	renderTarget = new Graphics4::RenderTarget(width, height, depthBufferBits, antialiasing, (Graphics4::RenderTargetFormat)format, stencilBufferBits, contextId);
+	this->texWidth = renderTarget->texWidth;
+	this->width = width;
+	this->texHeight = renderTarget->texHeight;
+	this->height = height;
+	this->contextId = contextId;
+	isCubeMap = false;
+	isDepthAttachment = false;
 }
 
 Graphics5::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits,
-                                      int contextId) {}
+                                      int contextId) {
+	renderTarget = new Graphics4::RenderTarget(cubeMapSize, depthBufferBits, antialiasing, (Graphics4::RenderTargetFormat)format, stencilBufferBits, contextId);
+	this->texWidth = renderTarget->texWidth;
+	this->width = cubeMapSize;
+	this->texHeight = renderTarget->texHeight;
+	this->height = cubeMapSize;
+	this->contextId = contextId;
+	isCubeMap = true;
+	isDepthAttachment = false;
+}
 
-Graphics5::RenderTarget::~RenderTarget() {}
+Graphics5::RenderTarget::~RenderTarget() {
+	delete renderTarget;
+}
 
 void Graphics5::RenderTarget::useColorAsTexture(TextureUnit unit) {}
 
 void Graphics5::RenderTarget::useDepthAsTexture(TextureUnit unit) {}
 
-void Graphics5::RenderTarget::setDepthStencilFrom(RenderTarget* source) {}
+void Graphics5::RenderTarget::setDepthStencilFrom(RenderTarget* source) {
+	renderTarget->setDepthStencilFrom(source->renderTarget);
+}
@@ -1,8 +1,13 @@
 #pragma once
 
 namespace Kore {
+	namespace Graphics4 {
+		class RenderTarget;
+	}
+
 	class RenderTarget5Impl {
 	public:
 		int stage;
+		Graphics4::RenderTarget* renderTarget;
 	};
 }
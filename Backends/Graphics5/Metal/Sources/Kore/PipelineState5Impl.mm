@@ -67,6 +67,16 @@ void Graphics5::PipelineState::compile() {
 	this->reflection = reflection;
 }
 
+void Graphics5::PipelineState::compileAsync() {
+	compile();
+}
+
+bool Graphics5::PipelineState::isReady() {
+	return true;
+}
+
+void Graphics5::PipelineState::waitUntilReady() {}
+
 void PipelineState5Impl::_set() {
 	id<MTLRenderCommandEncoder> encoder = getMetalEncoder();
 	[encoder setRenderPipelineState:pipeline];
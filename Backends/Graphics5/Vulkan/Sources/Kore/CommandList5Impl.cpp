@@ -1,10 +1,13 @@
 #include "pch.h"
 
 #include <Kore/Graphics5/CommandList.h>
+#include <Kore/Graphics5/ConstantBuffer.h>
 #include <Kore/Graphics5/PipelineState.h>
 #include <Kore/System.h>
 
 #include <assert.h>
+#include <map>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
@@ -22,6 +25,7 @@ extern VkRenderPass render_pass;
 extern VkDescriptorSet desc_set;
 extern Graphics5::Texture* vulkanTextures[8];
 extern Graphics5::RenderTarget* vulkanRenderTargets[8];
+void writeDescriptorSet(VkDescriptorSet desc_set, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkBuffer* bufVertex, VkBuffer* bufFragment);
 
 struct SwapchainBuffers {
 	VkImage image;
@@ -35,6 +39,131 @@ namespace {
 	VkCommandBuffer setup_cmd;
 	bool began = false;
 	bool onBackBuffer = false;
+
+	struct ConstantBufferSetKey {
+		VkDescriptorSet set;
+		VkBuffer vertex;
+		VkBuffer fragment;
+
+		bool operator<(const ConstantBufferSetKey& other) const {
+			if (set != other.set) return set < other.set;
+			if (vertex != other.vertex) return vertex < other.vertex;
+			return fragment < other.fragment;
+		}
+	};
+
+	struct ConstantBufferSet {
+		VkDescriptorSet set;
+		VkDescriptorPool pool;
+	};
+
+	// A set which was bound in a command buffer must not be updated while the command buffer is pending.
+	// So every combination of texture set and constant buffers (like the buffers of a ConstantBufferRing) gets a set of its own.
+	std::map<ConstantBufferSetKey, ConstantBufferSet> constantBufferSets;
+	std::vector<VkDescriptorPool> constantBufferPools;
+	const uint32_t setsPerPool = 64;
+
+	ConstantBufferSet allocateConstantBufferSet(VkDescriptorSetLayout layout) {
+		ConstantBufferSet result;
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &layout;
+		if (!constantBufferPools.empty()) {
+			result.pool = alloc_info.descriptorPool = constantBufferPools.back();
+			if (vkAllocateDescriptorSets(device, &alloc_info, &result.set) == VK_SUCCESS) return result;
+		}
+
+		// the last pool is full
+		VkDescriptorPoolSize typeCounts[2];
+		typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		typeCounts[0].descriptorCount = 2 * setsPerPool;
+		typeCounts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		typeCounts[1].descriptorCount = 6 * setsPerPool;
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		pool_info.maxSets = setsPerPool;
+		pool_info.poolSizeCount = 2;
+		pool_info.pPoolSizes = typeCounts;
+		VkDescriptorPool pool;
+		VkResult err = vkCreateDescriptorPool(device, &pool_info, nullptr, &pool);
+		assert(!err);
+		constantBufferPools.push_back(pool);
+
+		result.pool = alloc_info.descriptorPool = pool;
+		err = vkAllocateDescriptorSets(device, &alloc_info, &result.set);
+		assert(!err);
+		return result;
+	}
+
+	void bindDescriptorSet(CommandList5Impl* list) {
+		if (list->_currentPipeline == nullptr) return;
+
+		VkDescriptorSet set;
+		Graphics5::Texture* texture = nullptr;
+		Graphics5::RenderTarget* renderTarget = nullptr;
+		if (vulkanRenderTargets[0] != nullptr) {
+			renderTarget = vulkanRenderTargets[0];
+			set = renderTarget->desc_set;
+		}
+		else if (vulkanTextures[0] != nullptr) {
+			texture = vulkanTextures[0];
+			set = texture->desc_set;
+		}
+		else {
+			set = desc_set;
+		}
+
+		VkBuffer vertex = list->_vertexConstantBuffer != nullptr ? list->_vertexConstantBuffer->buf : VK_NULL_HANDLE;
+		VkBuffer fragment = list->_fragmentConstantBuffer != nullptr ? list->_fragmentConstantBuffer->buf : VK_NULL_HANDLE;
+		// both bindings need a valid buffer
+		if (vertex == VK_NULL_HANDLE) vertex = fragment;
+		if (fragment == VK_NULL_HANDLE) fragment = vertex;
+		if (vertex != VK_NULL_HANDLE) {
+			ConstantBufferSetKey key;
+			key.set = set;
+			key.vertex = vertex;
+			key.fragment = fragment;
+			std::map<ConstantBufferSetKey, ConstantBufferSet>::iterator it = constantBufferSets.find(key);
+			if (it == constantBufferSets.end()) {
+				ConstantBufferSet constantSet = allocateConstantBufferSet(list->_currentPipeline->desc_layout);
+				writeDescriptorSet(constantSet.set, texture, renderTarget, &vertex, &fragment);
+				it = constantBufferSets.insert(std::make_pair(key, constantSet)).first;
+			}
+			set = it->second.set;
+		}
+
+		uint32_t offsets[2] = {(uint32_t)list->_vertexConstantOffset, (uint32_t)list->_fragmentConstantOffset};
+		vkCmdBindDescriptorSets(list->_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, list->_currentPipeline->pipeline_layout, 0, 1, &set, 2, offsets);
+	}
+}
+
+// Called when a constant buffer is destroyed, its handle could be reused by a new buffer
+void releaseConstantBufferSets(VkBuffer buffer) {
+	for (std::map<ConstantBufferSetKey, ConstantBufferSet>::iterator it = constantBufferSets.begin(); it != constantBufferSets.end();) {
+		if (it->first.vertex == buffer || it->first.fragment == buffer) {
+			vkFreeDescriptorSets(device, it->second.pool, 1, &it->second.set);
+			constantBufferSets.erase(it++);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+// Called when a texture or render target is destroyed, the cached sets still point to its image
+void releaseTextureSets(VkDescriptorSet set) {
+	for (std::map<ConstantBufferSetKey, ConstantBufferSet>::iterator it = constantBufferSets.begin(); it != constantBufferSets.end();) {
+		if (it->first.set == set) {
+			vkFreeDescriptorSets(device, it->second.pool, 1, &it->second.set);
+			constantBufferSets.erase(it++);
+		}
+		else {
+			++it;
+		}
+	}
 }
 
 void demo_set_image_layout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout, VkImageLayout new_image_layout) {
@@ -165,6 +294,11 @@ CommandList::CommandList() {
 	assert(!err);
 
 	_indexCount = 0;
+	_currentPipeline = nullptr;
+	_vertexConstantBuffer = nullptr;
+	_fragmentConstantBuffer = nullptr;
+	_vertexConstantOffset = 0;
+	_fragmentConstantOffset = 0;
 
 	depthStencil = 1.0;
 	depthIncrement = -0.01f;
@@ -367,16 +501,11 @@ void CommandList::disableScissor() {
 }
 
 void CommandList::setPipeline(PipelineState* pipeline) {
+	JobSystem::wait(&pipeline->compiling);
 	_currentPipeline = pipeline;
 		
 	vkCmdBindPipeline(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _currentPipeline->pipeline);
-
-	if (vulkanRenderTargets[0] != nullptr)
-		vkCmdBindDescriptorSets(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _currentPipeline->pipeline_layout, 0, 1, &vulkanRenderTargets[0]->desc_set, 0, nullptr);
-	else if (vulkanTextures[0] != nullptr)
-		vkCmdBindDescriptorSets(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _currentPipeline->pipeline_layout, 0, 1, &vulkanTextures[0]->desc_set, 0, nullptr);
-	else
-		vkCmdBindDescriptorSets(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _currentPipeline->pipeline_layout, 0, 1, &desc_set, 0, nullptr);
+	bindDescriptorSet(this);
 }
 
 void CommandList::setVertexBuffers(VertexBuffer** vertexBuffers, int* offsets_, int count) {
@@ -572,11 +701,15 @@ void CommandList::renderTargetToTextureBarrier(RenderTarget* renderTarget) {
 }
 
 void CommandList::setVertexConstantBuffer(ConstantBuffer* buffer, int offset) {
-	
+	_vertexConstantBuffer = buffer;
+	_vertexConstantOffset = offset;
+	bindDescriptorSet(this);
 }
 
 void CommandList::setFragmentConstantBuffer(ConstantBuffer* buffer, int offset) {
-	
+	_fragmentConstantBuffer = buffer;
+	_fragmentConstantOffset = offset;
+	bindDescriptorSet(this);
 }
 
 void CommandList::setPipelineLayout() {
@@ -4,6 +4,7 @@
 
 namespace Kore {
 	namespace Graphics5 {
+		class ConstantBuffer;
 		class PipelineState;
 	}
 }
@@ -13,6 +14,10 @@ public:
 	Kore::Graphics5::PipelineState* _currentPipeline;
 	int _indexCount;
 	VkCommandBuffer _buffer;
+	Kore::Graphics5::ConstantBuffer* _vertexConstantBuffer;
+	Kore::Graphics5::ConstantBuffer* _fragmentConstantBuffer;
+	int _vertexConstantOffset;
+	int _fragmentConstantOffset;
 
 protected:
 	bool closed;
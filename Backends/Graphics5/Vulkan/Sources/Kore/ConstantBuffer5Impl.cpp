@@ -8,14 +8,16 @@ using namespace Kore;
 
 extern VkDevice device;
 bool memory_type_from_properties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex);
+void releaseConstantBufferSets(VkBuffer buffer);
 
 namespace {
-	void createUniformBuffer(VkBuffer& buf, VkMemoryAllocateInfo& mem_alloc, VkDeviceMemory& mem, VkDescriptorBufferInfo& buffer_info) {
+	void createUniformBuffer(VkBuffer& buf, VkMemoryAllocateInfo& mem_alloc, VkDeviceMemory& mem, VkDescriptorBufferInfo& buffer_info, int size) {
 		VkBufferCreateInfo buf_info;
 		memset(&buf_info, 0, sizeof(buf_info));
 		buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-		buf_info.size = sizeof(float) * 256;
+		// descriptors always cover constantRange bytes, the padding keeps every dynamic offset inside of the buffer
+		buf_info.size = size + ConstantBuffer5Impl::constantRange;
 		VkResult err = vkCreateBuffer(device, &buf_info, NULL, &buf);
 		assert(!err);
 
@@ -27,7 +29,8 @@ namespace {
 		mem_alloc.allocationSize = mem_reqs.size;
 		mem_alloc.memoryTypeIndex = 0;
 
-		bool pass = memory_type_from_properties(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mem_alloc.memoryTypeIndex);
+		bool pass = memory_type_from_properties(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                                        &mem_alloc.memoryTypeIndex);
 		assert(pass);
 
 		err = vkAllocateMemory(device, &mem_alloc, NULL, &mem);
@@ -38,7 +41,7 @@ namespace {
 
 		buffer_info.buffer = buf;
 		buffer_info.offset = 0;
-		buffer_info.range = sizeof(float) * 256;
+		buffer_info.range = ConstantBuffer5Impl::constantRange;
 	}
 }
 
@@ -46,25 +49,32 @@ Graphics5::ConstantBuffer::ConstantBuffer(int size) {
 	mySize = size;
 	data = nullptr;
 
-	createUniformBuffer(buf, mem_alloc, mem, buffer_info);
+	createUniformBuffer(buf, mem_alloc, mem, buffer_info, size);
 
-	uint8_t* data;
-	VkResult err = vkMapMemory(device, mem, 0, mem_alloc.allocationSize, 0, (void**)&data);
+	// the memory is coherent so it can stay mapped
+	VkResult err = vkMapMemory(device, mem, 0, mem_alloc.allocationSize, 0, (void**)&mapped);
 	assert(!err);
-	memcpy(data, &data, sizeof(data));
-	vkUnmapMemory(device, mem);
+	memset(mapped, 0, (size_t)mem_alloc.allocationSize);
 }
 
-Graphics5::ConstantBuffer::~ConstantBuffer() {}
+Graphics5::ConstantBuffer::~ConstantBuffer() {
+	releaseConstantBufferSets(buf);
+	vkUnmapMemory(device, mem);
+	vkDestroyBuffer(device, buf, nullptr);
+	vkFreeMemory(device, mem, nullptr);
+}
 
 void Graphics5::ConstantBuffer::lock() {
 	lock(0, size());
 }
 
-void Graphics5::ConstantBuffer::lock(int start, int count) {}
+void Graphics5::ConstantBuffer::lock(int start, int count) {
+	lastStart = start;
+	lastCount = count;
+	data = &mapped[start];
+}
 
 void Graphics5::ConstantBuffer::unlock() {
-
 	data = nullptr;
 }
 
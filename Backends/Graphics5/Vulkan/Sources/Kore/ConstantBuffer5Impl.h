@@ -17,11 +17,15 @@
 namespace Kore {
 	class ConstantBuffer5Impl {
 	public:
-		float data[256];
+		// Bytes which are visible to a shader from the offset of a constant buffer binding
+		static const int constantRange = 256 * sizeof(float);
+
 		VkBuffer buf;
 		VkDescriptorBufferInfo buffer_info;
 		VkMemoryAllocateInfo mem_alloc;
 		VkDeviceMemory mem;
+		// mapped from construction to destruction
+		u8* mapped;
 
 	protected:
 		int lastStart;
@@ -2,6 +2,7 @@
 
 #include "PipelineState5Impl.h"
 
+#include <Kore/Graphics5/ConstantBuffer.h>
 #include <Kore/Graphics5/Shader.h>
 #include <Kore/Graphics5/PipelineState.h>
 
@@ -15,6 +16,7 @@ extern VkDescriptorSet desc_set;
 bool memory_type_from_properties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex);
 void createDescriptorLayout(PipelineState5Impl* pipeline);
 void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkDescriptorSet& desc_set, VkBuffer* bufVertex, VkBuffer* bufFragment);
+void writeDescriptorSet(VkDescriptorSet desc_set, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkBuffer* bufVertex, VkBuffer* bufFragment);
 
 Graphics5::PipelineState* PipelineState5Impl::current;
 
@@ -128,6 +130,11 @@ namespace {
 		frag_shader_module = demo_prepare_shader_module(fragmentShader->source, fragmentShader->length);
 		return frag_shader_module;
 	}
+
+	// compile only creates objects of its own pipeline, so it can run on any thread
+	void compileJob(void* data) {
+		((Graphics5::PipelineState*)data)->compile();
+	}
 }
 
 PipelineState5Impl::PipelineState5Impl() : vertexShader(nullptr), fragmentShader(nullptr), geometryShader(nullptr), tessEvalShader(nullptr), tessControlShader(nullptr) {
@@ -136,6 +143,7 @@ PipelineState5Impl::PipelineState5Impl() : vertexShader(nullptr), fragmentShader
 }
 
 Graphics5::ConstantLocation Graphics5::PipelineState::getConstantLocation(const char* name) {
+	JobSystem::wait(&compiling);
 	ConstantLocation location;
 	location.vertexOffset = -1;
 	location.fragmentOffset = -1;
@@ -149,6 +157,7 @@ Graphics5::ConstantLocation Graphics5::PipelineState::getConstantLocation(const
 }
 
 Graphics5::TextureUnit Graphics5::PipelineState::getTextureUnit(const char* name) {
+	JobSystem::wait(&compiling);
 	TextureUnit unit;
 	unit.binding = textureBindings[name];
 	return unit;
@@ -367,6 +376,19 @@ void Graphics5::PipelineState::compile() {
 	vkDestroyShaderModule(device, vert_shader_module, nullptr);
 }
 
+// The JobSystem fans the compiles out to its workers, without workers the pipeline is compiled right away
+void Graphics5::PipelineState::compileAsync() {
+	JobSystem::run(compileJob, this, &compiling);
+}
+
+bool Graphics5::PipelineState::isReady() {
+	return JobSystem::isDone(&compiling);
+}
+
+void Graphics5::PipelineState::waitUntilReady() {
+	JobSystem::wait(&compiling);
+}
+
 extern VkDescriptorPool desc_pool;
 
 void createDescriptorLayout(PipelineState5Impl* pipeline) {
@@ -374,13 +396,13 @@ void createDescriptorLayout(PipelineState5Impl* pipeline) {
 	memset(layoutBindings, 0, sizeof(layoutBindings));
 
 	layoutBindings[0].binding = 0;
-	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindings[0].descriptorCount = 1;
 	layoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindings[0].pImmutableSamplers = nullptr;
 
 	layoutBindings[1].binding = 1;
-	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindings[1].descriptorCount = 1;
 	layoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	layoutBindings[1].pImmutableSamplers = nullptr;
@@ -405,10 +427,10 @@ void createDescriptorLayout(PipelineState5Impl* pipeline) {
 	VkDescriptorPoolSize typeCounts[8];
 	memset(typeCounts, 0, sizeof(typeCounts));
 
-	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[0].descriptorCount = 1;
 
-	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[1].descriptorCount = 1;
 
 	for (int i = 2; i < 8; ++i) {
@@ -429,8 +451,6 @@ void createDescriptorLayout(PipelineState5Impl* pipeline) {
 
 void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkDescriptorSet& desc_set, VkBuffer* bufVertex, VkBuffer* bufFragment) {
 	// VkDescriptorImageInfo tex_descs[DEMO_TEXTURE_COUNT];
-	VkDescriptorBufferInfo buffer_descs[2];
-
 	VkDescriptorSetAllocateInfo alloc_info = {};
 	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	alloc_info.pNext = NULL;
@@ -440,19 +460,24 @@ void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* textu
 	VkResult err = vkAllocateDescriptorSets(device, &alloc_info, &desc_set);
 	assert(!err);
 
+	writeDescriptorSet(desc_set, texture, renderTarget, bufVertex, bufFragment);
+}
+
+void writeDescriptorSet(VkDescriptorSet desc_set, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkBuffer* bufVertex, VkBuffer* bufFragment) {
+	VkDescriptorBufferInfo buffer_descs[2];
 	memset(&buffer_descs, 0, sizeof(buffer_descs));
 
 	if (bufVertex != nullptr) {
 		buffer_descs[0].buffer = *bufVertex;
 	}
 	buffer_descs[0].offset = 0;
-	buffer_descs[0].range = 256 * sizeof(float);
+	buffer_descs[0].range = ConstantBuffer5Impl::constantRange;
 	
 	if (bufFragment != nullptr) {
 		buffer_descs[1].buffer = *bufFragment;
 	}
 	buffer_descs[1].offset = 0;
-	buffer_descs[1].range = 256 * sizeof(float);
+	buffer_descs[1].range = ConstantBuffer5Impl::constantRange;
 	
 	VkDescriptorImageInfo tex_desc;
 	memset(&tex_desc, 0, sizeof(tex_desc));
@@ -474,14 +499,14 @@ void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* textu
 	writes[0].dstSet = desc_set;
 	writes[0].dstBinding = 0;
 	writes[0].descriptorCount = 1;
-	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	writes[0].pBufferInfo = &buffer_descs[0];
 
 	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	writes[1].dstSet = desc_set;
 	writes[1].dstBinding = 1;
 	writes[1].descriptorCount = 1;
-	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	writes[1].pBufferInfo = &buffer_descs[1];
 
 	for (int i = 2; i < 8; ++i) {
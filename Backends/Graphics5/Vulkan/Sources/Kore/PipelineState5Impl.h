@@ -3,6 +3,8 @@
 #include <map>
 #include <string>
 
+#include <Kore/Threads/JobSystem.h>
+
 #include <vulkan/vulkan.h>
 
 #ifdef min
@@ -52,6 +54,9 @@ namespace Kore {
 
 		VkDescriptorSetLayout desc_layout;
 
+		// counts the compile job started by compileAsync
+		JobSystem::Counter compiling;
+
 		static Graphics5::PipelineState* current;
 	};
 
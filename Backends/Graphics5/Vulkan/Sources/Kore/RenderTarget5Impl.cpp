@@ -37,6 +37,7 @@ extern Graphics5::RenderTarget* vulkanRenderTargets[8];
 void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkDescriptorSet& desc_set,
                          VkBuffer* bufVertex, VkBuffer* bufFragment);
 bool memory_type_from_properties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex);
+void releaseTextureSets(VkDescriptorSet set);
 
 void setImageLayout(VkCommandBuffer _buffer, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout, VkImageLayout newImageLayout) {
 	VkImageMemoryBarrier imageMemoryBarrier = {};
@@ -84,6 +85,7 @@ Graphics5::RenderTarget::RenderTarget(int width, int height, int depthBufferBits
     : width(width), height(height) {
 	texWidth = width;
 	texHeight = height;
+	desc_set = VK_NULL_HANDLE;
 	/**{
 	    VkFormatProperties formatProperties;
 	    VkResult err;
@@ -334,9 +336,13 @@ Graphics5::RenderTarget::RenderTarget(int width, int height, int depthBufferBits
 }
 
 Graphics5::RenderTarget::RenderTarget(int cubeMapSize, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits,
-                                      int contextId) {}
+                                      int contextId) {
+	desc_set = VK_NULL_HANDLE;
+}
 
-Graphics5::RenderTarget::~RenderTarget() {}
+Graphics5::RenderTarget::~RenderTarget() {
+	if (desc_set != VK_NULL_HANDLE) releaseTextureSets(desc_set);
+}
 
 void Graphics5::RenderTarget::useColorAsTexture(Graphics5::TextureUnit unit) {
 	vulkanRenderTargets[unit.binding - 2] = this;
@@ -22,6 +22,7 @@ extern bool use_staging_buffer;
 bool memory_type_from_properties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex);
 void createDescriptorSet(PipelineState5Impl* pipeline, Graphics5::Texture* texture, Graphics5::RenderTarget* renderTarget, VkDescriptorSet& desc_set,
                          VkBuffer* bufVertex, VkBuffer* bufFragment);
+void releaseTextureSets(VkDescriptorSet set);
 
 namespace {
 	void demo_flush_init_cmd() {
@@ -302,11 +303,17 @@ void Graphics5::Texture::_init(const char* format, bool readable) {
 	createDescriptorSet(nullptr, this, nullptr, desc_set, nullptr, nullptr); // TODO
 }
 
-Graphics5::Texture::Texture(int width, int height, Image::Format format, bool readable) : Image(width, height, format, readable) {}
+Graphics5::Texture::Texture(int width, int height, Image::Format format, bool readable) : Image(width, height, format, readable) {
+	desc_set = VK_NULL_HANDLE;
+}
 
-Graphics5::Texture::Texture(int width, int height, int depth, Image::Format format, bool readable) : Image(width, height, depth, format, readable) {}
+Graphics5::Texture::Texture(int width, int height, int depth, Image::Format format, bool readable) : Image(width, height, depth, format, readable) {
+	desc_set = VK_NULL_HANDLE;
+}
 
-Texture5Impl::~Texture5Impl() {}
+Texture5Impl::~Texture5Impl() {
+	if (desc_set != VK_NULL_HANDLE) releaseTextureSets(desc_set);
+}
 
 void Graphics5::Texture::_set(TextureUnit unit) {}
 
@@ -16,29 +16,23 @@ struct IOS_Thread {
 	void* param;
 	void (*thread)(void* param);
 	pthread_t pthread;
+	volatile bool finished;
 };
-IOS_Thread tt[MAX_THREADS];
-// IndexAllocator ia;
-uint threadindex = 0;
-Mutex mutex;
 
 static void* ThreadProc(void* arg) {
 	@autoreleasepool {
 		IOS_Thread* t = (IOS_Thread*)arg;
 		t->thread(t->param);
+		t->finished = true;
 		pthread_exit(NULL);
 	}
 }
 
 Thread* Kore::createAndRunThread(void (*thread)(void* param), void* param) {
-	mutex.lock();
-
-	uint i = threadindex++; // ia.AllocateIndex();
-	// ktassert_d(i != 0xFFFFFFFF);
-
-	IOS_Thread* t = &tt[i];
+	IOS_Thread* t = new IOS_Thread;
 	t->param = param;
 	t->thread = thread;
+	t->finished = false;
 	pthread_attr_t attr;
 	pthread_attr_init(&attr);
 	pthread_attr_setstacksize(&attr, 1024 * 64);
@@ -46,42 +40,31 @@ Thread* Kore::createAndRunThread(void (*thread)(void* param), void* param) {
 	memset(&sp, 0, sizeof(sp));
 	sp.sched_priority = 0;
 	pthread_attr_setschedparam(&attr, &sp);
-	// int ret =
-	pthread_create(&t->pthread, &attr, &ThreadProc, t);
-	// Kt::affirmD(ret == 0);
+	int ret = pthread_create(&t->pthread, &attr, &ThreadProc, t);
 	pthread_attr_destroy(&attr);
-
-	mutex.unlock();
-
+	if (ret != 0) {
+		delete t;
+		return nullptr;
+	}
 	return (Thread*)t;
 }
 
-/*
-void SR_StopThread(SR_Thread *sr) {
-    mutex.Lock();
-    Thread *t = (Thread*)sr;
-    CloseHandle(t->handle);
-    mutex.Unlock();
-}
-*/
-
 void Kore::waitForThreadStopThenFree(Thread* sr) {
-	mutex.lock();
 	IOS_Thread* t = (IOS_Thread*)sr;
 Again:;
 	int ret = pthread_join(t->pthread, NULL);
 	if (ret != 0) goto Again;
-	mutex.unlock();
-	// int ti = static_cast<int>(((upint)t - (upint)&tt[0]) / sizeof(IOS_Thread));
-	// ia.DeallocateIndex(ti);
+	delete t;
 }
 
-void Kore::threadsInit() {
-	mutex.create();
-	// ia.Create(1);//SR_MAX_THREADS32);
+bool Kore::isThreadStoppedThenFree(Thread* sr) {
+	IOS_Thread* t = (IOS_Thread*)sr;
+	if (!t->finished) return false;
+	pthread_join(t->pthread, NULL);
+	delete t;
+	return true;
 }
 
-void Kore::threadsQuit() {
-	mutex.destroy();
-	// ia.Free();
-}
+void Kore::threadsInit() {}
+
+void Kore::threadsQuit() {}
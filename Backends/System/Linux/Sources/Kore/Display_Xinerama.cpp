@@ -9,7 +9,7 @@
 #ifdef KORE_OPENGL
 #include <X11/X.h>
 #include <X11/extensions/Xinerama.h>
-#else
+#elif defined(KORE_VULKAN)
 #include <vulkan/vulkan.h>
 #endif
 
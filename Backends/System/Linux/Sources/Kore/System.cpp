@@ -10,9 +10,13 @@
 #include "Display.h"
 
 #include <cstring>
+#include <fcntl.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/stat.h>
 #include <X11/Xatom.h>
 
 #ifdef KORE_OPENGL
@@ -45,7 +49,6 @@ namespace {
 #define MWM_HINTS_DECORATIONS (1L << 1)
 	Display* dpy;
 	GLboolean doubleBuffer = GL_TRUE;
-#endif
 	Window win;
 	Atom XdndDrop;
 	Atom XdndFinished;
@@ -56,6 +59,7 @@ namespace {
 	Atom utf8;
 	Atom xseldata;
 	Window XdndSourceWindow = None;
+#endif
 
 	void fatalError(const char* message) {
 		printf("main: %s\n", message);
@@ -90,8 +94,16 @@ namespace windowimpl {
 }
 #endif
 
+namespace {
+	// _wakeUp writes to this pipe to end a _waitForMessages
+	int wakeUpPipe[2] = {-1, -1};
+}
+
 void Kore::System::setup() {
 	Display::enumerate();
+	if (wakeUpPipe[0] < 0 && pipe2(wakeUpPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+		log(Warning, "Could not create the wake up pipe, idle mode will not wait.");
+	}
 }
 
 bool Kore::System::isFullscreen() {
@@ -99,12 +111,14 @@ bool Kore::System::isFullscreen() {
 	return false;
 }
 
-#ifndef KORE_OPENGL
+#if !defined(KORE_OPENGL) && !defined(KORE_SOFTWARE)
 xcb_connection_t* connection;
 xcb_screen_t* screen;
 xcb_window_t window;
 xcb_intern_atom_reply_t* atom_wm_delete_window;
+#endif
 
+#ifndef KORE_OPENGL
 namespace {
 	int windowWidth;
 	int windowHeight;
@@ -291,6 +305,11 @@ int createWindow(const char* title, int x, int y, int width, int height, Kore::W
 	::windowWidth = width;
 	::windowHeight = height;
 
+#ifdef KORE_SOFTWARE
+	// the software renderer draws into memory and opens no window
+	return 0;
+#else
+
 	const xcb_setup_t* setup;
 	xcb_screen_iterator_t iter;
 	int scr;
@@ -338,6 +357,7 @@ int createWindow(const char* title, int x, int y, int width, int height, Kore::W
 	xcb_flush(connection);
 	return 1;
 #endif
+#endif
 }
 
 namespace Kore {
@@ -672,7 +692,7 @@ bool Kore::System::handleMessages() {
 			break;
 		}
 	}
-#else
+#elif !defined(KORE_SOFTWARE)
 	xcb_generic_event_t* event = xcb_poll_for_event(connection);
 	while (event != nullptr) {
 		switch (event->response_type & 0x7f) {
@@ -811,9 +831,15 @@ namespace {
 
 const char* Kore::System::savePath() {
 	if (!saveInitialized) {
-		strcpy(save, "Ķ~/.");
-		strcat(save, name());
-		strcat(save, "/");
+		// ~ is only expanded by shells
+		const char* home = getenv("HOME");
+		if (home == nullptr) {
+			passwd* user = getpwuid(getuid());
+			home = user != nullptr ? user->pw_dir : ".";
+		}
+		snprintf(save, sizeof(save), "%s/.%s/", home, name());
+		// files can only be written once the directory exists
+		mkdir(save, 0755);
 		saveInitialized = true;
 	}
 	return save;
@@ -827,17 +853,53 @@ const char** Kore::System::videoFormats() {
 	return ::videoFormats;
 }
 
-#include <sys/time.h>
+#include <poll.h>
 #include <time.h>
 
+void Kore::System::_waitForMessages(double seconds) {
+	if (wakeUpPipe[0] < 0) return;
+
+	pollfd fds[2];
+	int fdCount = 0;
+	fds[fdCount].fd = wakeUpPipe[0];
+	fds[fdCount].events = POLLIN;
+	++fdCount;
+#ifdef KORE_OPENGL
+	// XPending also flushes the requests of the last frame
+	if (XPending(dpy) > 0) return;
+	fds[fdCount].fd = ConnectionNumber(dpy);
+	fds[fdCount].events = POLLIN;
+	++fdCount;
+#elif !defined(KORE_SOFTWARE)
+	xcb_flush(connection);
+	fds[fdCount].fd = xcb_get_file_descriptor(connection);
+	fds[fdCount].events = POLLIN;
+	++fdCount;
+#endif
+
+	poll(fds, fdCount, seconds < 0.0 ? -1 : (int)(seconds * 1000.0));
+
+	char buffer[64];
+	while (read(wakeUpPipe[0], buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+void Kore::System::_wakeUp() {
+	if (wakeUpPipe[1] < 0) return;
+	char wake = 1;
+	// a full pipe already wakes the waiter
+	ssize_t written = write(wakeUpPipe[1], &wake, 1);
+	(void)written;
+}
+
 double Kore::System::frequency() {
-	return 1000000.0;
+	return 1000000000.0;
 }
 
 Kore::System::ticks Kore::System::timestamp() {
-	timeval now;
-	gettimeofday(&now, NULL);
-	return static_cast<ticks>(now.tv_sec) * 1000000 + static_cast<ticks>(now.tv_usec);
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<ticks>(now.tv_sec) * 1000000000 + static_cast<ticks>(now.tv_nsec);
 }
 
 extern
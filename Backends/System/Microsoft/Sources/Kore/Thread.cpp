@@ -27,7 +27,7 @@ Kore::Thread* Kore::createAndRunThread(void (*thread)(void* param), void* param)
 	ThreadData* data = new ThreadData;
 	data->param = param;
 	data->thread = thread;
-	HANDLE handle = CreateThread(0, 65536, ThreadProc, data, 0, 0);
+	data->handle = CreateThread(0, 65536, ThreadProc, data, 0, 0);
 	return (Thread*)data;
 }
 
@@ -56,3 +56,9 @@ bool Kore::isThreadStoppedThenFree(Thread* thread) {
 void Kore::threadsInit() {}
 
 void Kore::threadsQuit() {}
+
+int Kore::cpuCores() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
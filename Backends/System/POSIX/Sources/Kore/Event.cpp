@@ -1,19 +1,61 @@
 #include "pch.h"
 
+#include "Futex.h"
+
+#include <Kore/Threads/Atomic.h>
 #include <Kore/Threads/Event.h>
 
 using namespace Kore;
 
-void Event::create() {}
+// Events reset automatically like the events of the Windows backend, every signal releases one wait.
+
+void Event::create() {
+	state = 0;
+	waiters = 0;
+}
 
 void Event::destroy() {}
 
-void Event::signal() {}
+void Event::signal() {
+	if (KORE_ATOMIC_EXCHANGE(&state, 1) == 0 && waiters > 0) {
+		POSIX::futexWake(&state, 1);
+	}
+}
+
+// deadline < 0 waits forever
+bool EventImpl::waitUntil(double deadline) {
+	for (int spin = 0; spin < POSIX::spinCount; ++spin) {
+		if (KORE_ATOMIC_COMPARE_EXCHANGE(&state, 1, 0)) return true;
+		POSIX::spinPause();
+	}
+
+	KORE_ATOMIC_INCREMENT(&waiters);
+	bool signaled = false;
+	for (;;) {
+		if (KORE_ATOMIC_COMPARE_EXCHANGE(&state, 1, 0)) {
+			signaled = true;
+			break;
+		}
+		double remaining = -1.0;
+		if (deadline >= 0.0) {
+			remaining = deadline - POSIX::now();
+			if (remaining <= 0.0) break;
+		}
+		POSIX::futexWait(&state, 0, remaining);
+	}
+	KORE_ATOMIC_DECREMENT(&waiters);
+	return signaled;
+}
 
-void Event::wait() {}
+void Event::wait() {
+	waitUntil(-1.0);
+}
 
 bool Event::tryToWait(double seconds) {
-	return true;
+	if (seconds <= 0.0) return KORE_ATOMIC_COMPARE_EXCHANGE(&state, 1, 0);
+	return waitUntil(POSIX::now() + seconds);
 }
 
-void Event::reset() {}
+void Event::reset() {
+	KORE_ATOMIC_EXCHANGE(&state, 0);
+}
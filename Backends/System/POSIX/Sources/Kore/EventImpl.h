@@ -3,5 +3,9 @@
 namespace Kore {
 	class EventImpl {
 	protected:
+		// 1 while signaled, a wait consumes the signal
+		volatile int state;
+		volatile int waiters;
+		bool waitUntil(double deadline);
 	};
 }
@@ -0,0 +1,121 @@
+#include "pch.h"
+
+#include "Futex.h"
+
+#include <time.h>
+
+#if defined(KORE_LINUX) || defined(KORE_ANDROID)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#ifdef KORE_MACOS
+#include <mach/mach_time.h>
+#endif
+
+using namespace Kore;
+
+namespace {
+	timespec toTimespec(double seconds) {
+		timespec time;
+		time.tv_sec = (time_t)seconds;
+		time.tv_nsec = (long)((seconds - (double)time.tv_sec) * 1000000000.0);
+		if (time.tv_nsec >= 1000000000) {
+			++time.tv_sec;
+			time.tv_nsec -= 1000000000;
+		}
+		return time;
+	}
+
+#if !defined(KORE_LINUX) && !defined(KORE_ANDROID)
+	// Platforms without futexes park threads in buckets which are selected by the waited for address.
+	// Buckets are shared so every wake wakes all waiters of a bucket.
+	const int bucketCount = 64;
+
+	struct Bucket {
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+	};
+
+	Bucket buckets[bucketCount];
+	pthread_once_t bucketsOnce = PTHREAD_ONCE_INIT;
+
+	void initBuckets() {
+		for (int i = 0; i < bucketCount; ++i) {
+			pthread_mutex_init(&buckets[i].mutex, nullptr);
+			pthread_cond_init(&buckets[i].condition, nullptr);
+		}
+	}
+
+	Bucket& bucket(volatile int* address) {
+		pthread_once(&bucketsOnce, initBuckets);
+		return buckets[((size_t)address >> 2) % bucketCount];
+	}
+#endif
+}
+
+void POSIX::spinPause() {
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+double POSIX::now() {
+#ifdef KORE_MACOS
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0) mach_timebase_info(&timebase);
+	return (double)mach_absolute_time() * timebase.numer / timebase.denom / 1000000000.0;
+#else
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double)time.tv_sec + (double)time.tv_nsec / 1000000000.0;
+#endif
+}
+
+#if defined(KORE_LINUX) || defined(KORE_ANDROID)
+
+void POSIX::futexWait(volatile int* address, int expected, double seconds) {
+	// the timeout of FUTEX_WAIT is relative
+	timespec timeout = toTimespec(seconds);
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, seconds >= 0.0 ? &timeout : nullptr, nullptr, 0);
+}
+
+void POSIX::futexWake(volatile int* address, int count) {
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+#else
+
+void POSIX::futexWait(volatile int* address, int expected, double seconds) {
+	Bucket& bucket = ::bucket(address);
+	pthread_mutex_lock(&bucket.mutex);
+	if (*address == expected) {
+		if (seconds >= 0.0) {
+			// condition variables wait for an absolute time of the realtime clock
+			timeval current;
+			gettimeofday(&current, nullptr);
+			timespec deadline = toTimespec((double)current.tv_sec + (double)current.tv_usec / 1000000.0 + seconds);
+			pthread_cond_timedwait(&bucket.condition, &bucket.mutex, &deadline);
+		}
+		else {
+			pthread_cond_wait(&bucket.condition, &bucket.mutex);
+		}
+	}
+	pthread_mutex_unlock(&bucket.mutex);
+}
+
+void POSIX::futexWake(volatile int* address, int count) {
+	Bucket& bucket = ::bucket(address);
+	// taking the lock orders the wake after a waiter's check of *address
+	pthread_mutex_lock(&bucket.mutex);
+	pthread_cond_broadcast(&bucket.condition);
+	pthread_mutex_unlock(&bucket.mutex);
+}
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Kore {
+	namespace POSIX {
+		// Number of polls before a waiting thread is put to sleep
+		const int spinCount = 128;
+
+		// Hints the CPU that the calling thread is spinning
+		void spinPause();
+
+		// Seconds of a monotonic clock
+		double now();
+
+		// Sleeps while *address == expected, for at most seconds when seconds >= 0.
+		// Can return early or spuriously, callers have to check their condition again.
+		void futexWait(volatile int* address, int expected, double seconds = -1.0);
+		void futexWake(volatile int* address, int count);
+	}
+}
@@ -1,17 +1,71 @@
 #include "pch.h"
 
+#include "Futex.h"
+
+#include <Kore/Log.h>
+#include <Kore/Threads/Atomic.h>
 #include <Kore/Threads/Semaphore.h>
 
 using namespace Kore;
 
-void Semaphore::create(int current, int max) {}
+void Semaphore::create(int current, int max) {
+	count = current;
+	waiters = 0;
+	this->max = max;
+}
 
 void Semaphore::destroy() {}
 
-void Semaphore::release(int count) {}
+void Semaphore::release(int count) {
+	for (;;) {
+		int old = this->count;
+		if (old + count > max) {
+			log(Warning, "Semaphore released above its maximum count.");
+			return;
+		}
+		if (KORE_ATOMIC_COMPARE_EXCHANGE(&this->count, old, old + count)) break;
+	}
+	if (waiters > 0) POSIX::futexWake(&this->count, count);
+}
+
+bool SemaphoreImpl::tryToTake() {
+	for (;;) {
+		int old = count;
+		if (old <= 0) return false;
+		if (KORE_ATOMIC_COMPARE_EXCHANGE(&count, old, old - 1)) return true;
+	}
+}
 
-void Semaphore::acquire() {}
+// deadline < 0 waits forever
+bool SemaphoreImpl::acquireUntil(double deadline) {
+	for (int spin = 0; spin < POSIX::spinCount; ++spin) {
+		if (tryToTake()) return true;
+		POSIX::spinPause();
+	}
+
+	KORE_ATOMIC_INCREMENT(&waiters);
+	bool acquired = false;
+	for (;;) {
+		if (tryToTake()) {
+			acquired = true;
+			break;
+		}
+		double remaining = -1.0;
+		if (deadline >= 0.0) {
+			remaining = deadline - POSIX::now();
+			if (remaining <= 0.0) break;
+		}
+		POSIX::futexWait(&count, 0, remaining);
+	}
+	KORE_ATOMIC_DECREMENT(&waiters);
+	return acquired;
+}
+
+void Semaphore::acquire() {
+	acquireUntil(-1.0);
+}
 
 bool Semaphore::tryToAcquire(double seconds) {
-	return true;
+	if (seconds <= 0.0) return tryToTake();
+	return acquireUntil(POSIX::now() + seconds);
 }
@@ -3,5 +3,10 @@
 namespace Kore {
 	class SemaphoreImpl {
 	protected:
+		volatile int count;
+		volatile int waiters;
+		int max;
+		bool tryToTake();
+		bool acquireUntil(double deadline);
 	};
 }
@@ -4,12 +4,18 @@
 
 using namespace Kore;
 
-void ThreadLocal::create() {}
+void ThreadLocal::create() {
+	pthread_key_create(&key, nullptr);
+}
 
-void ThreadLocal::destroy() {}
+void ThreadLocal::destroy() {
+	pthread_key_delete(key);
+}
 
 void* ThreadLocal::get() {
-	return nullptr;
+	return pthread_getspecific(key);
 }
 
-void ThreadLocal::set(void* data) {}
+void ThreadLocal::set(void* data) {
+	pthread_setspecific(key, data);
+}
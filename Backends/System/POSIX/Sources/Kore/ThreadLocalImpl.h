@@ -1,7 +1,10 @@
 #pragma once
 
+#include <pthread.h>
+
 namespace Kore {
 	class ThreadLocalImpl {
 	protected:
+		pthread_key_t key;
 	};
 }
@@ -20,6 +20,9 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <linux/input.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <X11/Xlib.h>
 
@@ -558,9 +561,15 @@ namespace {
 
 const char* Kore::System::savePath() {
 	if (!saveInitialized) {
-		strcpy(save, "Ķ~/.");
-		strcat(save, name());
-		strcat(save, "/");
+		// ~ is only expanded by shells
+		const char* home = getenv("HOME");
+		if (home == nullptr) {
+			passwd* user = getpwuid(getuid());
+			home = user != nullptr ? user->pw_dir : ".";
+		}
+		snprintf(save, sizeof(save), "%s/.%s/", home, name());
+		// files can only be written once the directory exists
+		mkdir(save, 0755);
 		saveInitialized = true;
 	}
 	return save;
@@ -21,4 +21,8 @@ void Kore::threadsInit() {}
 
 void Kore::threadsQuit() {}
 
+int Kore::cpuCores() {
+	return 1;
+}
+
 void ThreadYield() {}
@@ -3,30 +3,244 @@
 #include "Audio.h"
 
 #include <Kore/Audio2/Audio.h>
+#include <Kore/Log.h>
 #include <Kore/Math/Core.h>
-#include <Kore/Threads/Mutex.h>
-#if 0
-#include <xmmintrin.h>
-#endif
+#include <Kore/Profiler.h>
+#include <Kore/Simd/float32x4.h>
+#include <Kore/Threads/Atomic.h>
 #include <Kore/VideoSoundStream.h>
 
+#include <vector>
+
 using namespace Kore;
 
 namespace {
-	Mutex mutex;
+	struct Channel {
+		Sound* sound;
+		float position;
+		bool loop;
+		float volume;
+		float pitch;
+		u32 generation;
+	};
+
+	struct StreamChannel {
+		SoundStream* stream;
+		int position;
+	};
+
+	struct VideoChannel {
+		VideoSoundStream* stream;
+		int position;
+	};
 
 	const int channelCount = 16;
-	Audio1::Channel channels[channelCount];
-	Audio1::StreamChannel streams[channelCount];
-	Audio1::VideoChannel videos[channelCount];
+	// owned by the audio thread
+	Channel channels[channelCount];
+	StreamChannel streams[channelCount];
+	VideoChannel videos[channelCount];
+
+	// the game thread's view of the channels, a slot is only
+	// handed out again after the audio thread reported it finished
+	struct Slot {
+		Sound* sound;
+		u32 generation;
+		bool used;
+	};
+	Slot slots[channelCount];
+
+	enum CommandType { PlaySound, StopChannel, SetVolume, SetPitch, SetLoop, PlayStream, StopStream, PlayVideo, StopVideo };
+
+	struct Command {
+		CommandType type;
+		int index;
+		u32 generation;
+		void* object;
+		float value;
+		bool flag;
+	};
+
+	struct Finished {
+		int index;
+		u32 generation;
+	};
+
+	// single producer, single consumer
+	template <class T, int size> struct RingBuffer {
+		T items[size];
+		volatile u32 readIndex;
+		volatile u32 writeIndex;
+
+		bool push(const T& item) {
+			u32 write = writeIndex;
+			if (write - readIndex >= (u32)size) return false;
+			items[write % size] = item;
+			KORE_MEMORY_BARRIER();
+			writeIndex = write + 1;
+			return true;
+		}
+
+		bool pop(T& item) {
+			u32 read = readIndex;
+			if (read == writeIndex) return false;
+			KORE_MEMORY_BARRIER();
+			item = items[read % size];
+			KORE_MEMORY_BARRIER();
+			readIndex = read + 1;
+			return true;
+		}
+	};
+
+	// game thread -> audio thread
+	RingBuffer<Command, 256> commands;
+	// audio thread -> game thread, one entry per finished generation at most
+	RingBuffer<Finished, channelCount> finished;
+
+	// game thread only, commands which did not fit into the ring while the audio thread fell behind
+	std::vector<Command> pending;
+	bool pendingWarned = false;
+
+	void flushPending() {
+		size_t sent = 0;
+		while (sent < pending.size() && commands.push(pending[sent])) ++sent;
+		if (sent > 0) pending.erase(pending.begin(), pending.begin() + sent);
+	}
+
+	void send(CommandType type, int index = -1, u32 generation = 0, void* object = nullptr, float value = 0, bool flag = false) {
+		Command command;
+		command.type = type;
+		command.index = index;
+		command.generation = generation;
+		command.object = object;
+		command.value = value;
+		command.flag = flag;
+		flushPending();
+		if (pending.empty() && commands.push(command)) return;
+
+		if (!pendingWarned) {
+			log(Warning, "The audio command queue is full, commands are held back until the audio thread catches up.");
+			pendingWarned = true;
+		}
+		// only the latest value of a setting matters
+		if (type == SetVolume || type == SetPitch || type == SetLoop) {
+			for (size_t i = 0; i < pending.size(); ++i) {
+				if (pending[i].type == type && pending[i].index == index && pending[i].generation == generation) {
+					pending[i] = command;
+					return;
+				}
+			}
+		}
+		pending.push_back(command);
+	}
+
+	void collectFinished() {
+		flushPending();
+		Finished entry;
+		while (finished.pop(entry)) {
+			if (slots[entry.index].generation == entry.generation) {
+				slots[entry.index].used = false;
+				slots[entry.index].sound = nullptr;
+			}
+		}
+	}
+
+	bool valid(Audio1::ChannelHandle channel) {
+		return channel.index >= 0 && channel.index < channelCount && slots[channel.index].used && slots[channel.index].generation == channel.generation;
+	}
+
+	void finishChannel(int index) {
+		Finished entry;
+		entry.index = index;
+		entry.generation = channels[index].generation;
+		channels[index].sound = nullptr;
+		channels[index].position = 0;
+		finished.push(entry);
+	}
+
+	void applyCommand(const Command& command) {
+		switch (command.type) {
+		case PlaySound: {
+			Channel& channel = channels[command.index];
+			channel.sound = (Sound*)command.object;
+			channel.generation = command.generation;
+			channel.position = 0;
+			channel.loop = command.flag;
+			channel.pitch = command.value;
+			channel.volume = 1.0f;
+			break;
+		}
+		case StopChannel:
+			if (channels[command.index].sound != nullptr && channels[command.index].generation == command.generation) finishChannel(command.index);
+			break;
+		case SetVolume:
+			if (channels[command.index].generation == command.generation) channels[command.index].volume = command.value;
+			break;
+		case SetPitch:
+			if (channels[command.index].generation == command.generation) channels[command.index].pitch = command.value;
+			break;
+		case SetLoop:
+			if (channels[command.index].generation == command.generation) channels[command.index].loop = command.flag;
+			break;
+		case PlayStream:
+			for (int i = 0; i < channelCount; ++i) {
+				if (streams[i].stream == command.object) {
+					streams[i].stream = nullptr;
+					streams[i].position = 0;
+					break;
+				}
+			}
+			for (int i = 0; i < channelCount; ++i) {
+				if (streams[i].stream == nullptr) {
+					streams[i].stream = (SoundStream*)command.object;
+					streams[i].position = 0;
+					break;
+				}
+			}
+			break;
+		case StopStream:
+			for (int i = 0; i < channelCount; ++i) {
+				if (streams[i].stream == command.object) {
+					streams[i].stream = nullptr;
+					streams[i].position = 0;
+					break;
+				}
+			}
+			break;
+		case PlayVideo:
+			for (int i = 0; i < channelCount; ++i) {
+				if (videos[i].stream == nullptr) {
+					videos[i].stream = (VideoSoundStream*)command.object;
+					videos[i].position = 0;
+					break;
+				}
+			}
+			break;
+		case StopVideo:
+			for (int i = 0; i < channelCount; ++i) {
+				if (videos[i].stream == command.object) {
+					videos[i].stream = nullptr;
+					videos[i].position = 0;
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	// frames per block, a multiple of 4
+	const int blockSize = 512;
+	float leftBlock[blockSize];
+	float rightBlock[blockSize];
+	// the right sample of the last frame when a callback asked for an odd number of samples,
+	// it is written first by the next one so that the channels stay in order
+	float carriedSample;
+	bool sampleCarried = false;
 
-	float sampleLinear(s16* data, float position) {
+	float sampleLinear(s16* data, float position, int size) {
 		int pos1 = (int)position;
-		int pos2 = (int)(position + 1);
-		float sample1 = data[pos1] / 32767.0f;
-		float sample2 = data[pos2] / 32767.0f;
+		int pos2 = pos1 + 1 < size ? pos1 + 1 : size - 1;
 		float a = position - pos1;
-		return sample1 * (1 - a) + sample2 * a;
+		return data[pos1] * (1 - a) + data[pos2] * a;
 	}
 
 	/*float sampleHermite4pt3oX(s16* data, float position) {
@@ -44,183 +258,244 @@ namespace {
 	    float c3 = 0.5f * (s3 - s0) + 1.5f * (s1 - s2);
 	    return ((c3 * x + c2) * x + c1) * x + c0;
 	}*/
-}
 
-void Audio1::mix(int samples) {
-	for (int i = 0; i < samples; ++i) {
-		bool left = (i % 2) == 0;
-		float value = 0;
-#if 0
-		__m128 sseSamples[4];
-		for (int i = 0; i < channelCount; i += 4) {
-			s16 data[4];
-			for (int i2 = 0; i2 < 4; ++i2) {
-				if (channels[i + i2].sound != nullptr) {
-					data[i2] = *(s16*)&channels[i + i2].sound->data[channels[i + i2].position];
-					channels[i + i2].position += 2;
-					if (channels[i + i2].position >= channels[i + i2].sound->size) channels[i + i2].sound = nullptr;
+	void clearBlock(int frames) {
+		float32x4 zero = loadAll(0.0f);
+		for (int i = 0; i < frames; i += 4) {
+			storeUnaligned(&leftBlock[i], zero);
+			storeUnaligned(&rightBlock[i], zero);
+		}
+	}
+
+	void mixChannel(Channel& channel, int frames) {
+		Sound* sound = channel.sound;
+		const int size = sound->size;
+		const float step = channel.pitch / sound->sampleRatePos;
+		const float gain = channel.volume * sound->volume() / 32767.0f;
+		const float32x4 volume = loadAll(gain);
+		const float32x4 one = loadAll(1.0f);
+		float position = channel.position;
+
+		int frame = 0;
+		while (frame < frames) {
+			// four frames at once as long as all interpolation partners are inside the sound
+			if (frame + 4 <= frames && position + step * 3 < size - 1) {
+				float p0 = position;
+				float p1 = position + step;
+				float p2 = position + step * 2;
+				float p3 = position + step * 3;
+				int i0 = (int)p0;
+				int i1 = (int)p1;
+				int i2 = (int)p2;
+				int i3 = (int)p3;
+				float32x4 a = load(p0 - i0, p1 - i1, p2 - i2, p3 - i3);
+				float32x4 b = sub(one, a);
+
+				s16* data = sound->left;
+				float32x4 left = add(mul(load(data[i0], data[i1], data[i2], data[i3]), b), mul(load(data[i0 + 1], data[i1 + 1], data[i2 + 1], data[i3 + 1]), a));
+				storeUnaligned(&leftBlock[frame], add(loadUnaligned(&leftBlock[frame]), mul(left, volume)));
+
+				data = sound->right;
+				float32x4 right = add(mul(load(data[i0], data[i1], data[i2], data[i3]), b), mul(load(data[i0 + 1], data[i1 + 1], data[i2 + 1], data[i3 + 1]), a));
+				storeUnaligned(&rightBlock[frame], add(loadUnaligned(&rightBlock[frame]), mul(right, volume)));
+
+				position = p3 + step;
+				frame += 4;
+			}
+			else {
+				leftBlock[frame] += sampleLinear(sound->left, position, size) * gain;
+				rightBlock[frame] += sampleLinear(sound->right, position, size) * gain;
+				position += step;
+				++frame;
+			}
+			if (position >= size) {
+				if (channel.loop) {
+					position = 0;
 				}
 				else {
-					data[i2] = 0;
-				}
-			}
-			sseSamples[i / 4] = _mm_set_ps(data[3] / 32767.0f, data[2] / 32767.0f, data[1] / 32767.0f, data[0] / 32767.0f);
-		}
-		__m128 a = _mm_add_ps(sseSamples[0], sseSamples[1]);
-		__m128 b = _mm_add_ps(sseSamples[2], sseSamples[3]);
-		__m128 c = _mm_add_ps(a, b);
-		value = c.m128_f32[0] + c.m128_f32[1] + c.m128_f32[2] + c.m128_f32[3];
-		value = max(min(value, 1.0f), -1.0f);
-#else
-		mutex.lock();
-		for (int i = 0; i < channelCount; ++i) {
-			if (channels[i].sound != nullptr) {
-				// value += *(s16*)&channels[i].sound->data[(int)channels[i].position] / 32767.0f * channels[i].sound->volume();
-				if (left)
-					value += sampleLinear(channels[i].sound->left, channels[i].position) * channels[i].volume * channels[i].sound->volume();
-				else
-					value += sampleLinear(channels[i].sound->right, channels[i].position) * channels[i].volume * channels[i].sound->volume();
-				value = max(min(value, 1.0f), -1.0f);
-				if (!left) channels[i].position += channels[i].pitch / channels[i].sound->sampleRatePos;
-				// channels[i].position += 2;
-				if (channels[i].position >= channels[i].sound->size) {
-					if (channels[i].loop) {
-						channels[i].position = 0;
-					}
-					else {
-						channels[i].sound = nullptr;
-					}
+					channel.sound = nullptr;
+					break;
 				}
 			}
 		}
-		for (int i = 0; i < channelCount; ++i) {
-			if (streams[i].stream != nullptr) {
-				value += streams[i].stream->nextSample() * streams[i].stream->volume();
-				value = max(min(value, 1.0f), -1.0f);
-				if (streams[i].stream->ended()) streams[i].stream = nullptr;
+		channel.position = position;
+	}
+
+	void mixStream(StreamChannel& channel, int frames) {
+		SoundStream* stream = channel.stream;
+		float volume = stream->volume();
+		for (int frame = 0; frame < frames; ++frame) {
+			leftBlock[frame] += stream->nextSample() * volume;
+			rightBlock[frame] += stream->nextSample() * volume;
+			if (stream->ended()) {
+				channel.stream = nullptr;
+				break;
 			}
 		}
-		for (int i = 0; i < channelCount; ++i) {
-			if (videos[i].stream != nullptr) {
-				value += videos[i].stream->nextSample();
-				value = max(min(value, 1.0f), -1.0f);
-				if (videos[i].stream->ended()) videos[i].stream = nullptr;
+	}
+
+	void mixVideo(VideoChannel& channel, int frames) {
+		VideoSoundStream* stream = channel.stream;
+		for (int frame = 0; frame < frames; ++frame) {
+			leftBlock[frame] += stream->nextSample();
+			rightBlock[frame] += stream->nextSample();
+			if (stream->ended()) {
+				channel.stream = nullptr;
+				break;
 			}
 		}
-		mutex.unlock();
-#endif
+	}
+
+	void writeSample(float value) {
 		*(float*)&Audio2::buffer.data[Audio2::buffer.writeLocation] = value;
 		Audio2::buffer.writeLocation += 4;
 		if (Audio2::buffer.writeLocation >= Audio2::buffer.dataSize) Audio2::buffer.writeLocation = 0;
 	}
+
+	void writeBlock(int samples) {
+		float32x4 minimum = loadAll(-1.0f);
+		float32x4 maximum = loadAll(1.0f);
+		for (int i = 0; i < samples; i += 8) {
+			storeUnaligned(&leftBlock[i / 2], max(min(loadUnaligned(&leftBlock[i / 2]), maximum), minimum));
+			storeUnaligned(&rightBlock[i / 2], max(min(loadUnaligned(&rightBlock[i / 2]), maximum), minimum));
+		}
+		for (int i = 0; i < samples; ++i) {
+			writeSample((i % 2) == 0 ? leftBlock[i / 2] : rightBlock[i / 2]);
+		}
+		if (samples % 2 != 0) {
+			carriedSample = rightBlock[samples / 2];
+			sampleCarried = true;
+		}
+	}
+}
+
+void Audio1::mix(int samples) {
+	KORE_PROFILE_ZONE("Audio1::mix");
+	Command command;
+	while (commands.pop(command)) {
+		applyCommand(command);
+	}
+
+	if (sampleCarried && samples > 0) {
+		writeSample(carriedSample);
+		sampleCarried = false;
+		--samples;
+	}
+
+	while (samples > 0) {
+		int blockSamples = samples < blockSize * 2 ? samples : blockSize * 2;
+		int frames = (blockSamples + 1) / 2;
+		int paddedFrames = (frames + 3) & ~3;
+		clearBlock(paddedFrames);
+
+		for (int i = 0; i < channelCount; ++i) {
+			if (channels[i].sound != nullptr) {
+				mixChannel(channels[i], frames);
+				if (channels[i].sound == nullptr) finishChannel(i);
+			}
+		}
+		for (int i = 0; i < channelCount; ++i) {
+			if (streams[i].stream != nullptr) mixStream(streams[i], frames);
+		}
+		for (int i = 0; i < channelCount; ++i) {
+			if (videos[i].stream != nullptr) mixVideo(videos[i], frames);
+		}
+
+		writeBlock(blockSamples);
+		samples -= blockSamples;
+	}
 }
 
 void Audio1::init() {
 	for (int i = 0; i < channelCount; ++i) {
 		channels[i].sound = nullptr;
 		channels[i].position = 0;
+		channels[i].generation = 0;
+		slots[i].sound = nullptr;
+		slots[i].generation = 0;
+		slots[i].used = false;
 	}
 	for (int i = 0; i < channelCount; ++i) {
 		streams[i].stream = nullptr;
 		streams[i].position = 0;
+		videos[i].stream = nullptr;
+		videos[i].position = 0;
 	}
-	mutex.create();
+	commands.readIndex = commands.writeIndex = 0;
+	pending.clear();
+	sampleCarried = false;
+	finished.readIndex = finished.writeIndex = 0;
 	Audio2::audioCallback = mix;
 }
 
-Audio1::Channel* Audio1::play(Sound* sound, bool loop, float pitch, bool unique) {
-	Channel* channel = nullptr;
-	mutex.lock();
-	bool found = false;
-	for (int i = 0; i < channelCount; ++i) {
-		if (channels[i].sound == sound) {
-			found = true;
-			break;
+Audio1::ChannelHandle Audio1::play(Sound* sound, bool loop, float pitch, bool unique) {
+	ChannelHandle channel;
+	channel.index = -1;
+	channel.generation = 0;
+	collectFinished();
+	if (unique) {
+		for (int i = 0; i < channelCount; ++i) {
+			if (slots[i].used && slots[i].sound == sound) return channel;
 		}
 	}
-	if (!found || !unique) {
-		for (int i = 0; i < channelCount; ++i) {
-			if (channels[i].sound == nullptr) {
-				channels[i].sound = sound;
-				channels[i].position = 0;
-				channels[i].loop = loop;
-				channels[i].pitch = pitch;
-				channels[i].volume = 1.0f;
-				channel = &channels[i];
-				break;
-			}
+	for (int i = 0; i < channelCount; ++i) {
+		if (!slots[i].used) {
+			u32 generation = slots[i].generation + 1;
+			send(PlaySound, i, generation, sound, pitch, loop);
+			slots[i].used = true;
+			slots[i].sound = sound;
+			slots[i].generation = generation;
+			channel.index = i;
+			channel.generation = generation;
+			break;
 		}
 	}
-	mutex.unlock();
 	return channel;
 }
 
 void Audio1::stop(Sound* sound) {
-	mutex.lock();
+	collectFinished();
 	for (int i = 0; i < channelCount; ++i) {
-		if (channels[i].sound == sound) {
-			channels[i].sound = nullptr;
-			channels[i].position = 0;
+		if (slots[i].used && slots[i].sound == sound) {
+			send(StopChannel, i, slots[i].generation);
 			break;
 		}
 	}
-	mutex.unlock();
 }
 
-void Audio1::play(SoundStream* stream) {
-	mutex.lock();
+void Audio1::stop(ChannelHandle channel) {
+	if (valid(channel)) send(StopChannel, channel.index, channel.generation);
+}
 
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == stream) {
-			streams[i].stream = nullptr;
-			streams[i].position = 0;
-			break;
-		}
-	}
+bool Audio1::isPlaying(ChannelHandle channel) {
+	collectFinished();
+	return valid(channel);
+}
 
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == nullptr) {
-			streams[i].stream = stream;
-			streams[i].position = 0;
-			break;
-		}
-	}
+void Audio1::setVolume(ChannelHandle channel, float volume) {
+	if (valid(channel)) send(SetVolume, channel.index, channel.generation, nullptr, volume);
+}
 
-	mutex.unlock();
+void Audio1::setPitch(ChannelHandle channel, float pitch) {
+	if (valid(channel)) send(SetPitch, channel.index, channel.generation, nullptr, pitch);
+}
+
+void Audio1::setLoop(ChannelHandle channel, bool loop) {
+	if (valid(channel)) send(SetLoop, channel.index, channel.generation, nullptr, 0, loop);
+}
+
+void Audio1::play(SoundStream* stream) {
+	send(PlayStream, -1, 0, stream);
 }
 
 void Audio1::stop(SoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == stream) {
-			streams[i].stream = nullptr;
-			streams[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	send(StopStream, -1, 0, stream);
 }
 
 void Audio1::play(VideoSoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (videos[i].stream == nullptr) {
-			videos[i].stream = stream;
-			videos[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	send(PlayVideo, -1, 0, stream);
 }
 
 void Audio1::stop(VideoSoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (videos[i].stream == stream) {
-			videos[i].stream = nullptr;
-			videos[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	send(StopVideo, -1, 0, stream);
 }
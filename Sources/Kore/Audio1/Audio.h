@@ -7,27 +7,25 @@ namespace Kore {
 	class VideoSoundStream;
 
 	namespace Audio1 {
-		struct Channel {
-			Sound* sound;
-			float position;
-			bool loop;
-			float volume;
-			float pitch;
-		};
-
-		struct StreamChannel {
-			SoundStream* stream;
-			int position;
-		};
-
-		struct VideoChannel {
-			VideoSoundStream* stream;
-			int position;
+		// Identifies one playback of a sound. Channels are recycled,
+		// handles to a channel which was reused are silently ignored.
+		struct ChannelHandle {
+			int index;
+			u32 generation;
 		};
 
+		// Everything but mix is meant to be called from one thread only,
+		// requests are handed to the audio thread without locking and
+		// applied at the start of the next mix. When the audio thread
+		// falls behind they are held back and handed over by later calls.
 		void init();
-		Channel* play(Sound* sound, bool loop = false, float pitch = 1.0f, bool unique = false);
+		ChannelHandle play(Sound* sound, bool loop = false, float pitch = 1.0f, bool unique = false);
 		void stop(Sound* sound);
+		void stop(ChannelHandle channel);
+		bool isPlaying(ChannelHandle channel);
+		void setVolume(ChannelHandle channel, float volume);
+		void setPitch(ChannelHandle channel, float pitch);
+		void setLoop(ChannelHandle channel, bool loop);
 		void play(SoundStream* stream);
 		void stop(SoundStream* stream);
 		void play(VideoSoundStream* stream);
@@ -4,6 +4,7 @@
 
 #include <Kore/Graphics3/Graphics.h>
 #include <Kore/IO/FileReader.h>
+#include <Kore/Profiler.h>
 #include <Kore/Simd/float32x4.h>
 
 #include <string.h>
@@ -76,7 +77,7 @@ void Graphics2::ImageShaderPainter::initShaders() {
 }
 
 void Graphics2::ImageShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure, 0, Graphics4::DynamicUsage);
 	rectVertices = rectVertexBuffer->lock();
 
 	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
@@ -92,66 +93,9 @@ void Graphics2::ImageShaderPainter::initBuffers() {
 	indexBuffer->unlock();
 }
 
-void Graphics2::ImageShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
-                                         float bottomrightx, float bottomrighty) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 0] = bottomleftx;
-	rectVertices[baseIndex + 1] = bottomlefty;
-	rectVertices[baseIndex + 2] = -5.f; // TODO: should be 0?
-
-	rectVertices[baseIndex + 9] = topleftx;
-	rectVertices[baseIndex + 10] = toplefty;
-	rectVertices[baseIndex + 11] = -5.f;
-
-	rectVertices[baseIndex + 18] = toprightx;
-	rectVertices[baseIndex + 19] = toprighty;
-	rectVertices[baseIndex + 20] = -5.f;
-
-	rectVertices[baseIndex + 27] = bottomrightx;
-	rectVertices[baseIndex + 28] = bottomrighty;
-	rectVertices[baseIndex + 29] = -5.f;
-}
-
-void Graphics2::ImageShaderPainter::setRectTexCoords(float left, float top, float right, float bottom) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 3] = left;
-	rectVertices[baseIndex + 4] = bottom;
-
-	rectVertices[baseIndex + 12] = left;
-	rectVertices[baseIndex + 13] = top;
-
-	rectVertices[baseIndex + 21] = right;
-	rectVertices[baseIndex + 22] = top;
-
-	rectVertices[baseIndex + 30] = right;
-	rectVertices[baseIndex + 31] = bottom;
-}
-
-void Graphics2::ImageShaderPainter::setRectColor(float r, float g, float b, float a) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 5] = r;
-	rectVertices[baseIndex + 6] = g;
-	rectVertices[baseIndex + 7] = b;
-	rectVertices[baseIndex + 8] = a;
-
-	rectVertices[baseIndex + 14] = r;
-	rectVertices[baseIndex + 15] = g;
-	rectVertices[baseIndex + 16] = b;
-	rectVertices[baseIndex + 17] = a;
-
-	rectVertices[baseIndex + 23] = r;
-	rectVertices[baseIndex + 24] = g;
-	rectVertices[baseIndex + 25] = b;
-	rectVertices[baseIndex + 26] = a;
-
-	rectVertices[baseIndex + 32] = r;
-	rectVertices[baseIndex + 33] = g;
-	rectVertices[baseIndex + 34] = b;
-	rectVertices[baseIndex + 35] = a;
-}
-
 void Graphics2::ImageShaderPainter::drawBuffer() {
-	rectVertexBuffer->unlock();
+	KORE_PROFILE_ZONE("ImageShaderPainter::drawBuffer");
+	rectVertexBuffer->unlock(bufferIndex * 4);
 	Graphics4::setPipeline(myPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
 	Graphics4::setIndexBuffer(*indexBuffer);
@@ -188,96 +132,22 @@ void Graphics2::ImageShaderPainter::setBilinearMipmapFilter(bool bilinear) {
 	this->bilinearMipmaps = bilinear;
 }
 
-inline void Graphics2::ImageShaderPainter::drawImage(Graphics4::Texture* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
-                                          float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
-
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(0, 0, tex->width / (float)tex->texWidth, tex->height / (float)tex->texHeight);
-	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
-
-	++bufferIndex;
-	lastTexture = tex;
-	lastRenderTarget = nullptr;
-}
-
-inline void Graphics2::ImageShaderPainter::drawImage2(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
-                                           float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
-                                           uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
-
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
-	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
-
-	++bufferIndex;
-	lastTexture = tex;
-	lastRenderTarget = nullptr;
-}
-
-inline void Graphics2::ImageShaderPainter::drawImageScale(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
-	float opacity, uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
-
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, opacity);
-	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
-	setRectVertices(left, bottom, left, top, right, top, right, bottom);
-
-	++bufferIndex;
-	lastTexture = tex;
-	lastRenderTarget = nullptr;
-}
-
-inline void Graphics2::ImageShaderPainter::drawImage(Graphics4::RenderTarget* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
-	float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color) {
-	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
-
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(0, 0, tex->width / (float)tex->texWidth, tex->height / (float)tex->texHeight);
-	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
-
-	++bufferIndex;
-	lastRenderTarget = tex;
-	lastTexture = nullptr;
-}
-
-inline void Graphics2::ImageShaderPainter::drawImage2(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
-	float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
-	uint color) {
-	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
-
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
-	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
-
-	++bufferIndex;
-	lastRenderTarget = tex;
-	lastTexture = nullptr;
-}
-
-inline void Graphics2::ImageShaderPainter::drawImageScale(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
-                                               float opacity, uint color) {
-	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
+void Graphics2::ImageShaderPainter::drawImages(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, const Quad* quads, int count,
+                                               const mat3& transformation, float opacity, uint color) {
+	if (bufferIndex > 0 && (texture != lastTexture || renderTarget != lastRenderTarget)) drawBuffer();
+	lastTexture = texture;
+	lastRenderTarget = renderTarget;
 
+	const QuadFormat format = {9, 3, 5, -1};
 	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, opacity);
-	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
-	setRectVertices(left, bottom, left, top, right, top, right, bottom);
-
-	++bufferIndex;
-	lastRenderTarget = tex;
-	lastTexture = nullptr;
+	while (count > 0) {
+		if (bufferIndex >= bufferSize) drawBuffer();
+		int added = bufferSize - bufferIndex < count ? bufferSize - bufferIndex : count;
+		emitQuads(transformation, quads, added, format, c.R, c.G, c.B, c.A * opacity, 0.0f, &rectVertices[bufferIndex * vertexSize * 4]);
+		bufferIndex += added;
+		quads += added;
+		count -= added;
+	}
 }
 
 void Graphics2::ImageShaderPainter::end() {
@@ -352,7 +222,7 @@ void Graphics2::ColoredShaderPainter::initShaders() {
 }
 
 void Graphics2::ColoredShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure, 0, Graphics4::DynamicUsage);
 	rectVertices = rectVertexBuffer->lock();
 
 	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
@@ -367,7 +237,7 @@ void Graphics2::ColoredShaderPainter::initBuffers() {
 	}
 	indexBuffer->unlock();
 
-	triangleVertexBuffer = new Graphics4::VertexBuffer(triangleBufferSize * 3, structure);
+	triangleVertexBuffer = new Graphics4::VertexBuffer(triangleBufferSize * 3, structure, 0, Graphics4::DynamicUsage);
 	triangleVertices = triangleVertexBuffer->lock();
 
 	triangleIndexBuffer = new Graphics4::IndexBuffer(triangleBufferSize * 3);
@@ -469,9 +339,10 @@ void Graphics2::ColoredShaderPainter::setTriColors(float opacity, uint color) {
 }
 
 void Graphics2::ColoredShaderPainter::drawBuffer(bool trisDone) {
+	KORE_PROFILE_ZONE("ColoredShaderPainter::drawBuffer");
 	if (!trisDone) endTris(true);
 
-	rectVertexBuffer->unlock();
+	rectVertexBuffer->unlock(bufferIndex * 4);
 
 	Graphics4::setPipeline(myPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
@@ -494,7 +365,7 @@ void Graphics2::ColoredShaderPainter::drawBuffer(bool trisDone) {
 void Graphics2::ColoredShaderPainter::drawTriBuffer(bool rectsDone) {
 	if (!rectsDone) endRects(true);
 
-	triangleVertexBuffer->unlock();
+	triangleVertexBuffer->unlock(triangleBufferIndex * 3);
 
 	Graphics4::setPipeline(myPipeline);
 	Graphics4::setVertexBuffer(*triangleVertexBuffer);
@@ -525,6 +396,21 @@ void Graphics2::ColoredShaderPainter::fillRect(float opacity, uint color, float
 	++bufferIndex;
 }
 
+void Graphics2::ColoredShaderPainter::fillQuads(const Quad* quads, int count, const mat3& transformation, float opacity, uint color) {
+	if (triangleBufferIndex > 0) drawTriBuffer(true); // Flush other buffer for right render order
+
+	const QuadFormat format = {7, -1, 3, -1};
+	Color c = Color(color);
+	while (count > 0) {
+		if (bufferIndex >= bufferSize) drawBuffer(false);
+		int added = bufferSize - bufferIndex < count ? bufferSize - bufferIndex : count;
+		emitQuads(transformation, quads, added, format, c.R, c.G, c.B, c.A * opacity, 0.0f, &rectVertices[bufferIndex * vertexSize * 4]);
+		bufferIndex += added;
+		quads += added;
+		count -= added;
+	}
+}
+
 void Graphics2::ColoredShaderPainter::fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3) {
 	if (bufferIndex > 0) drawBuffer(true); // Flush other buffer for right render order
 
@@ -614,7 +500,7 @@ void Graphics2::TextShaderPainter::initShaders() {
 }
 
 void Graphics2::TextShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure, 0, Graphics4::DynamicUsage);
 	rectVertices = rectVertexBuffer->lock();
 
 	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
@@ -630,72 +516,22 @@ void Graphics2::TextShaderPainter::initBuffers() {
 	indexBuffer->unlock();
 }
 
-void Graphics2::TextShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
-                                        float bottomrightx, float bottomrighty) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 0] = bottomleftx;
-	rectVertices[baseIndex + 1] = bottomlefty;
-	rectVertices[baseIndex + 2] = -5.0f; // TODO: should be 0?
-
-	rectVertices[baseIndex + 9] = topleftx;
-	rectVertices[baseIndex + 10] = toplefty;
-	rectVertices[baseIndex + 11] = -5.0;
-
-	rectVertices[baseIndex + 18] = toprightx;
-	rectVertices[baseIndex + 19] = toprighty;
-	rectVertices[baseIndex + 20] = -5.0;
-
-	rectVertices[baseIndex + 27] = bottomrightx;
-	rectVertices[baseIndex + 28] = bottomrighty;
-	rectVertices[baseIndex + 29] = -5.0;
-}
-
-void Graphics2::TextShaderPainter::setRectTexCoords(float left, float top, float right, float bottom) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 3] = left;
-	rectVertices[baseIndex + 4] = bottom;
-
-	rectVertices[baseIndex + 12] = left;
-	rectVertices[baseIndex + 13] = top;
-
-	rectVertices[baseIndex + 21] = right;
-	rectVertices[baseIndex + 22] = top;
-
-	rectVertices[baseIndex + 30] = right;
-	rectVertices[baseIndex + 31] = bottom;
-}
-
-void Graphics2::TextShaderPainter::setRectColors(float opacity, uint color) {
+void Graphics2::TextShaderPainter::addQuads(const Quad* quads, int count, const mat3& transformation, float opacity, uint color) {
+	const QuadFormat format = {9, 3, 5, -1};
 	Color c = Color(color);
-	float r = c.R;
-	float g = c.G;
-	float b = c.B;
-	float a = c.A * opacity;
-
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 5] = r;
-	rectVertices[baseIndex + 6] = g;
-	rectVertices[baseIndex + 7] = b;
-	rectVertices[baseIndex + 8] = a;
-
-	rectVertices[baseIndex + 14] = r;
-	rectVertices[baseIndex + 15] = g;
-	rectVertices[baseIndex + 16] = b;
-	rectVertices[baseIndex + 17] = a;
-
-	rectVertices[baseIndex + 23] = r;
-	rectVertices[baseIndex + 24] = g;
-	rectVertices[baseIndex + 25] = b;
-	rectVertices[baseIndex + 26] = a;
-
-	rectVertices[baseIndex + 32] = r;
-	rectVertices[baseIndex + 33] = g;
-	rectVertices[baseIndex + 34] = b;
-	rectVertices[baseIndex + 35] = a;
+	while (count > 0) {
+		if (bufferIndex >= bufferSize) drawBuffer();
+		int added = bufferSize - bufferIndex < count ? bufferSize - bufferIndex : count;
+		emitQuads(transformation, quads, added, format, c.R, c.G, c.B, c.A * opacity, 0.0f, &rectVertices[bufferIndex * vertexSize * 4]);
+		bufferIndex += added;
+		quads += added;
+		count -= added;
+	}
 }
 
 void Graphics2::TextShaderPainter::drawBuffer() {
-	rectVertexBuffer->unlock();
+	KORE_PROFILE_ZONE("TextShaderPainter::drawBuffer");
+	rectVertexBuffer->unlock(bufferIndex * 4);
 	Graphics4::setPipeline(shaderPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
 	Graphics4::setIndexBuffer(*indexBuffer);
@@ -741,27 +577,29 @@ int Graphics2::TextShaderPainter::findIndex(int charcode, int* fontGlyphs, int g
 }
 
 void Graphics2::TextShaderPainter::drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation, int* fontGlyphs) {
-	Graphics4::Texture* tex = font->getTexture();
+	drawRun(font->layout(text + start, length), opacity, color, x, y, transformation);
+}
+
+void Graphics2::TextShaderPainter::drawRun(const TextRun& run, float opacity, uint color, float x, float y, const mat3& transformation) {
+	Graphics4::Texture* tex = run.font->getTexture();
 	if (lastTexture != nullptr && tex != lastTexture) drawBuffer();
 	lastTexture = tex;
-
-	float xpos = x;
-	float ypos = y;
-	for (int i = start; i < start + length; ++i) {
-		AlignedQuad q = font->getBakedQuad(text[i] - 32, xpos, ypos);
-		if (q.x0 >= 0) {
-			if (bufferIndex + 1 >= bufferSize) drawBuffer();
-			setRectColors(1.0f, color);
-			setRectTexCoords(q.s0 * tex->width / tex->texWidth, q.t0 * tex->height / tex->texHeight, q.s1 * tex->width / tex->texWidth,
-			                 q.t1 * tex->height / tex->texHeight);
-			vec3 p0 = transformation * vec3(q.x0, q.y1, 1.0f); // bottom-left
-			vec3 p1 = transformation * vec3(q.x0, q.y0, 1.0f); // top-left
-			vec3 p2 = transformation * vec3(q.x1, q.y0, 1.0f); // top-right
-			vec3 p3 = transformation * vec3(q.x1, q.y1, 1.0f); // bottom-right
-			setRectVertices(p0.x(), p0.y(), p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
-			xpos += q.xadvance;
-			++bufferIndex;
+	run.font->uploadGlyphs();
+
+	// the quads are snapped to pixels relative to the origin
+	mat3 origin = transformation * mat3::Translation(Kore::floor(x + 0.5f), Kore::floor(y + 0.5f));
+	float scaleS = (float)tex->width / tex->texWidth;
+	float scaleT = (float)tex->height / tex->texHeight;
+	const int chunkSize = 64;
+	Quad quads[chunkSize];
+	for (size_t first = 0; first < run.quads.size(); first += chunkSize) {
+		int count = run.quads.size() - first < chunkSize ? (int)(run.quads.size() - first) : chunkSize;
+		for (int i = 0; i < count; ++i) {
+			const AlignedQuad& q = run.quads[first + i];
+			setQuadRect(quads[i], q.x0, q.y0, q.x1, q.y1);
+			setQuadTexCoords(quads[i], q.s0 * scaleS, q.t0 * scaleT, q.s1 * scaleS, q.t1 * scaleT);
 		}
+		addQuads(quads, count, origin, opacity, color);
 	}
 }
 
@@ -776,11 +614,228 @@ Graphics2::TextShaderPainter::~TextShaderPainter() {
 	delete indexBuffer;
 }
 
+//==========
+// BatchPainter
+//==========
+
+Graphics2::BatchPainter::BatchPainter(int capacity)
+    : bufferSize(capacity), bufferIndex(0), vertexSize(10), textureCount(0), bilinear(false), shaderPipeline(nullptr) {
+	// quads are indexed from one vertex buffer, some platforms only support 16 bit indices
+	if (bufferSize > 16384) bufferSize = 16384;
+	if (bufferSize < 1) bufferSize = 1;
+	initShaders();
+	initBuffers();
+}
+
+void Graphics2::BatchPainter::setProjection(mat4 projectionMatrix) {
+	this->projectionMatrix = projectionMatrix;
+}
+
+void Graphics2::BatchPainter::initShaders() {
+	if (shaderPipeline != nullptr) return;
+
+	structure.add("vertexPosition", Graphics4::Float3VertexData);
+	structure.add("texPosition", Graphics4::Float2VertexData);
+	structure.add("vertexColor", Graphics4::Float4VertexData);
+	structure.add("texSlot", Graphics4::Float1VertexData);
+
+	FileReader fs("painter-batch.frag");
+	FileReader vs("painter-batch.vert");
+	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
+	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
+
+	shaderPipeline = new Graphics4::PipelineState();
+	shaderPipeline->fragmentShader = fragmentShader;
+	shaderPipeline->vertexShader = vertexShader;
+
+	// the shader premultiplies images, text and colors alike
+	shaderPipeline->blendSource = Graphics4::BlendOne;
+	shaderPipeline->blendDestination = Graphics4::InverseSourceAlpha;
+	shaderPipeline->alphaBlendSource = Graphics4::SourceAlpha;
+	shaderPipeline->alphaBlendDestination = Graphics4::InverseSourceAlpha;
+
+	shaderPipeline->inputLayout[0] = &structure;
+	shaderPipeline->inputLayout[1] = nullptr;
+	shaderPipeline->compile();
+
+	projectionLocation = shaderPipeline->getConstantLocation("projectionMatrix");
+	textureLocations[0] = shaderPipeline->getTextureUnit("tex0");
+	textureLocations[1] = shaderPipeline->getTextureUnit("tex1");
+	textureLocations[2] = shaderPipeline->getTextureUnit("tex2");
+	textureLocations[3] = shaderPipeline->getTextureUnit("tex3");
+}
+
+void Graphics2::BatchPainter::initBuffers() {
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure, 0, Graphics4::DynamicUsage);
+	rectVertices = rectVertexBuffer->lock();
+
+	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
+	int* indices = indexBuffer->lock();
+	for (int i = 0; i < bufferSize; ++i) {
+		indices[i * 3 * 2 + 0] = i * 4 + 0;
+		indices[i * 3 * 2 + 1] = i * 4 + 1;
+		indices[i * 3 * 2 + 2] = i * 4 + 2;
+		indices[i * 3 * 2 + 3] = i * 4 + 0;
+		indices[i * 3 * 2 + 4] = i * 4 + 2;
+		indices[i * 3 * 2 + 5] = i * 4 + 3;
+	}
+	indexBuffer->unlock();
+}
+
+// Returns the slot of the texture in the current batch, 1 to 4, and starts a new batch when all slots are taken
+float Graphics2::BatchPainter::textureSlot(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget) {
+	for (int i = 0; i < textureCount; ++i) {
+		if (textures[i] == texture && renderTargets[i] == renderTarget) return i + 1.0f;
+	}
+	if (textureCount >= maxTextures) drawBuffer();
+	textures[textureCount] = texture;
+	renderTargets[textureCount] = renderTarget;
+	++textureCount;
+	return (float)textureCount;
+}
+
+void Graphics2::BatchPainter::addQuad(float slot, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
+                                      float bottomrightx, float bottomrighty, float left, float top, float right, float bottom, float opacity, uint color) {
+	Color c = Color(color);
+	float a = c.A * opacity;
+	float positions[8] = {bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty};
+	float texCoords[8] = {left, bottom, left, top, right, top, right, bottom};
+
+	float* vertex = &rectVertices[bufferIndex * vertexSize * 4];
+	for (int i = 0; i < 4; ++i) {
+		vertex[0] = positions[i * 2 + 0];
+		vertex[1] = positions[i * 2 + 1];
+		vertex[2] = -5.0f;
+		vertex[3] = texCoords[i * 2 + 0];
+		vertex[4] = texCoords[i * 2 + 1];
+		vertex[5] = c.R;
+		vertex[6] = c.G;
+		vertex[7] = c.B;
+		vertex[8] = a;
+		vertex[9] = slot;
+		vertex += vertexSize;
+	}
+	++bufferIndex;
+}
+
+void Graphics2::BatchPainter::drawBuffer() {
+	KORE_PROFILE_ZONE("BatchPainter::drawBuffer");
+	rectVertexBuffer->unlock(bufferIndex * 4);
+	Graphics4::setPipeline(shaderPipeline);
+	Graphics4::setVertexBuffer(*rectVertexBuffer);
+	Graphics4::setIndexBuffer(*indexBuffer);
+	for (int i = 0; i < textureCount; ++i) {
+		Graphics4::TextureUnit unit = textureLocations[i];
+		if (renderTargets[i] != nullptr) renderTargets[i]->useColorAsTexture(unit);
+		else Graphics4::setTexture(unit, textures[i]);
+		Graphics4::setTextureAddressing(unit, Graphics4::U, Graphics4::Clamp);
+		Graphics4::setTextureAddressing(unit, Graphics4::V, Graphics4::Clamp);
+		Graphics4::setTextureMinificationFilter(unit, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
+		Graphics4::setTextureMagnificationFilter(unit, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
+		Graphics4::setTextureMipmapFilter(unit, Graphics4::NoMipFilter);
+	}
+	Graphics4::setMatrix(projectionLocation, projectionMatrix);
+
+	Graphics4::drawIndexedVertices(0, bufferIndex * 2 * 3);
+
+	bufferIndex = 0;
+	textureCount = 0;
+	rectVertices = rectVertexBuffer->lock();
+}
+
+void Graphics2::BatchPainter::setBilinearFilter(bool bilinear) {
+	if (bilinear == this->bilinear) return;
+	end();
+	this->bilinear = bilinear;
+}
+
+void Graphics2::BatchPainter::drawImage(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
+                                        float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color) {
+	if (bufferIndex >= bufferSize) drawBuffer();
+	float slot = textureSlot(img, nullptr);
+	addQuad(slot, bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty, sx / (float)img->texWidth,
+	        sy / (float)img->texHeight, (sx + sw) / (float)img->texWidth, (sy + sh) / (float)img->texHeight, opacity, color);
+}
+
+void Graphics2::BatchPainter::drawImage(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty,
+                                        float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
+                                        uint color) {
+	if (bufferIndex >= bufferSize) drawBuffer();
+	float slot = textureSlot(nullptr, img);
+	addQuad(slot, bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty, sx / (float)img->texWidth,
+	        sy / (float)img->texHeight, (sx + sw) / (float)img->texWidth, (sy + sh) / (float)img->texHeight, opacity, color);
+}
+
+void Graphics2::BatchPainter::fillRect(float opacity, uint color, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
+                                       float toprighty, float bottomrightx, float bottomrighty) {
+	if (bufferIndex >= bufferSize) drawBuffer();
+	addQuad(0.0f, bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty, 0, 0, 0, 0, opacity, color);
+}
+
+// A quad with the last corner repeated, the second triangle of it has no area
+void Graphics2::BatchPainter::fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3) {
+	if (bufferIndex >= bufferSize) drawBuffer();
+	addQuad(0.0f, x1, y1, x2, y2, x3, y3, x3, y3, 0, 0, 0, 0, opacity, color);
+}
+
+void Graphics2::BatchPainter::drawQuads(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, bool coverage, const Quad* quads, int count,
+                                        const mat3& transformation, float opacity, uint color) {
+	const QuadFormat format = {10, 3, 5, 9};
+	Color c = Color(color);
+	while (count > 0) {
+		if (bufferIndex >= bufferSize) drawBuffer();
+		// font textures only store coverage, the slots above maxTextures tell the shader to read it
+		float slot = texture == nullptr && renderTarget == nullptr ? 0.0f : textureSlot(texture, renderTarget) + (coverage ? maxTextures : 0);
+		int added = bufferSize - bufferIndex < count ? bufferSize - bufferIndex : count;
+		emitQuads(transformation, quads, added, format, c.R, c.G, c.B, c.A * opacity, slot, &rectVertices[bufferIndex * vertexSize * 4]);
+		bufferIndex += added;
+		quads += added;
+		count -= added;
+	}
+}
+
+void Graphics2::BatchPainter::drawString(Kravur* font, const char* text, int start, int length, float opacity, uint color, float x, float y,
+                                         const mat3& transformation) {
+	drawRun(font->layout(text + start, length), opacity, color, x, y, transformation);
+}
+
+void Graphics2::BatchPainter::drawRun(const TextRun& run, float opacity, uint color, float x, float y, const mat3& transformation) {
+	Graphics4::Texture* tex = run.font->getTexture();
+	run.font->uploadGlyphs();
+
+	// the quads are snapped to pixels relative to the origin
+	mat3 origin = transformation * mat3::Translation(Kore::floor(x + 0.5f), Kore::floor(y + 0.5f));
+	float scaleS = (float)tex->width / tex->texWidth;
+	float scaleT = (float)tex->height / tex->texHeight;
+	const int chunkSize = 64;
+	Quad quads[chunkSize];
+	for (size_t first = 0; first < run.quads.size(); first += chunkSize) {
+		int count = run.quads.size() - first < chunkSize ? (int)(run.quads.size() - first) : chunkSize;
+		for (int i = 0; i < count; ++i) {
+			const AlignedQuad& q = run.quads[first + i];
+			setQuadRect(quads[i], q.x0, q.y0, q.x1, q.y1);
+			setQuadTexCoords(quads[i], q.s0 * scaleS, q.t0 * scaleT, q.s1 * scaleS, q.t1 * scaleT);
+		}
+		drawQuads(tex, nullptr, true, quads, count, origin, opacity, color);
+	}
+}
+
+void Graphics2::BatchPainter::end() {
+	if (bufferIndex > 0) drawBuffer();
+	textureCount = 0;
+}
+
+Graphics2::BatchPainter::~BatchPainter() {
+	delete shaderPipeline;
+	delete rectVertexBuffer;
+	delete indexBuffer;
+}
+
 //==========
 // Graphics2
 //==========
 
-Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets): 
+Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets, int batchCapacity): 
 	screenWidth(width), 
 	screenHeight(height), 
 	renderTargets(rTargets), 
@@ -800,6 +855,7 @@ Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets):
 	coloredPainter = new ColoredShaderPainter();
 	textPainter = new TextShaderPainter();
 	textPainter->fontSize = fontSize;
+	batchPainter = new BatchPainter(batchCapacity);
 
 	setProjection();
 
@@ -863,122 +919,69 @@ void Graphics2::Graphics2::setProjection() {
 	imagePainter->setProjection(projectionMatrix);
 	coloredPainter->setProjection(projectionMatrix);
 	textPainter->setProjection(projectionMatrix);
+	batchPainter->setProjection(projectionMatrix);
 }
 
 void Graphics2::Graphics2::drawImage(Graphics4::Texture* img, float x, float y) {
-	coloredPainter->end();
-	textPainter->end();
-
-	float xw = x + img->width;
-	float yh = y + img->height;
-
-	float32x4 xx = load(x, x, xw, xw);
-	float32x4 yy = load(yh, y, y, yh);
-
-	float32x4 _00 = loadAll(transformation.get(0, 0));
-	float32x4 _01 = loadAll(transformation.get(1, 0));
-	float32x4 _02 = loadAll(transformation.get(2, 0));
-	float32x4 _10 = loadAll(transformation.get(0, 1));
-	float32x4 _11 = loadAll(transformation.get(1, 1));
-	float32x4 _12 = loadAll(transformation.get(2, 1));
-	float32x4 _20 = loadAll(transformation.get(0, 2));
-	float32x4 _21 = loadAll(transformation.get(1, 2));
-	float32x4 _22 = loadAll(transformation.get(2, 2));
-
-	// matrix multiply
-	float32x4 w = add(add(mul(_02, xx), mul(_12, yy)), _22);
-	float32x4 px = div(add(add(mul(_00, xx), mul(_10, yy)), _20), w);
-	float32x4 py = div(add(add(mul(_01, xx), mul(_11, yy)), _21), w);
-
-	imagePainter->drawImage(img, get(px, 0), get(py, 0), get(px, 1), get(py, 1), get(px, 2), get(py, 2), get(px, 3), get(py, 3), opacity, color);
+	drawScaledSubImage(img, 0, 0, (float)img->width, (float)img->height, x, y, (float)img->width, (float)img->height);
 }
 
 void Graphics2::Graphics2::drawScaledSubImage(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh) {
 	coloredPainter->end();
 	textPainter->end();
-	vec2 p1 = transformation * vec3(dx, dy + dh, 1.0f);
-	vec2 p2 = transformation * vec3(dx, dy, 1.0f);
-	vec2 p3 = transformation * vec3(dx + dw, dy, 1.0f);
-	vec2 p4 = transformation * vec3(dx + dw, dy + dh, 1.0f);
+	Quad quad;
+	setQuadRect(quad, dx, dy, dx + dw, dy + dh);
+	setQuadTexCoords(quad, sx / img->texWidth, sy / img->texHeight, (sx + sw) / img->texWidth, (sy + sh) / img->texHeight);
 
-	imagePainter->drawImage2(img, sx, sy, sw, sh, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y(), opacity, color);
+	if (lastPipeline == nullptr) batchPainter->drawQuads(img, nullptr, false, &quad, 1, transformation, opacity, color);
+	else imagePainter->drawImages(img, nullptr, &quad, 1, transformation, opacity, color);
 }
 
 void Graphics2::Graphics2::drawImage(Graphics4::RenderTarget* img, float x, float y) {
-	coloredPainter->end();
-	textPainter->end();
-
-	float xw = x + img->width;
-	float yh = y + img->height;
-
-	float32x4 xx = load(x, x, xw, xw);
-	float32x4 yy = load(yh, y, y, yh);
-
-	float32x4 _00 = loadAll(transformation.get(0, 0));
-	float32x4 _01 = loadAll(transformation.get(1, 0));
-	float32x4 _02 = loadAll(transformation.get(2, 0));
-	float32x4 _10 = loadAll(transformation.get(0, 1));
-	float32x4 _11 = loadAll(transformation.get(1, 1));
-	float32x4 _12 = loadAll(transformation.get(2, 1));
-	float32x4 _20 = loadAll(transformation.get(0, 2));
-	float32x4 _21 = loadAll(transformation.get(1, 2));
-	float32x4 _22 = loadAll(transformation.get(2, 2));
-
-	// matrix multiply
-	float32x4 w = add(add(mul(_02, xx), mul(_12, yy)), _22);
-	float32x4 px = div(add(add(mul(_00, xx), mul(_10, yy)), _20), w);
-	float32x4 py = div(add(add(mul(_01, xx), mul(_11, yy)), _21), w);
-
-	imagePainter->drawImage(img, get(px, 0), get(py, 0), get(px, 1), get(py, 1), get(px, 2), get(py, 2), get(px, 3), get(py, 3), opacity, color);
+	drawScaledSubImage(img, 0, 0, (float)img->width, (float)img->height, x, y, (float)img->width, (float)img->height);
 }
 
 void Graphics2::Graphics2::drawScaledSubImage(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh) {
 	coloredPainter->end();
 	textPainter->end();
-	vec2 p1 = transformation * vec3(dx, dy + dh, 1.0f);
-	vec2 p2 = transformation * vec3(dx, dy, 1.0f);
-	vec2 p3 = transformation * vec3(dx + dw, dy, 1.0f);
-	vec2 p4 = transformation * vec3(dx + dw, dy + dh, 1.0f);
+	Quad quad;
+	setQuadRect(quad, dx, dy, dx + dw, dy + dh);
+	setQuadTexCoords(quad, sx / img->texWidth, sy / img->texHeight, (sx + sw) / img->texWidth, (sy + sh) / img->texHeight);
 
-	imagePainter->drawImage2(img, sx, sy, sw, sh, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y(), opacity, color);
+	if (lastPipeline == nullptr) batchPainter->drawQuads(nullptr, img, false, &quad, 1, transformation, opacity, color);
+	else imagePainter->drawImages(nullptr, img, &quad, 1, transformation, opacity, color);
 }
 
 void Graphics2::Graphics2::drawRect(float x, float y, float width, float height, float strength) {
 	imagePainter->end();
 	textPainter->end();
 
-	vec2 p1 = transformation * vec3(x - strength / 2, y + strength / 2, 1.0f);                                // bottom-left
-	vec2 p2 = transformation * vec3(x - strength / 2, y - strength / 2, 1.0f);                                // top-left
-	vec2 p3 = transformation * vec3(x + width + strength / 2, y - strength / 2, 1.0f);                        // top-right
-	vec2 p4 = transformation * vec3(x + width + strength / 2, y + strength / 2, 1.0f);                        // bottom-right
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // top
-
-	p1 = transformation * vec3(x - strength / 2, y + height + strength / 2, 1.0f);
-	p3 = transformation * vec3(x + strength / 2, y - strength / 2, 1.0f);
-	p4 = transformation * vec3(x + strength / 2, y + height + strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // left
-
-	p2 = transformation * vec3(x - strength / 2, y + height - strength / 2, 1.0f);
-	p3 = transformation * vec3(x + width + strength / 2, y + height - strength / 2, 1.0f);
-	p4 = transformation * vec3(x + width + strength / 2, y + height + strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // bottom
-
-	p1 = transformation * vec3(x + width - strength / 2, y + height + strength / 2, 1.0f);
-	p2 = transformation * vec3(x + width - strength / 2, y - strength / 2, 1.0f);
-	p3 = transformation * vec3(x + width + strength / 2, y - strength / 2, 1.0f);
-	p4 = transformation * vec3(x + width + strength / 2, y + height + strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // right
+	float half = strength / 2;
+	Quad quads[4];
+	setQuadRect(quads[0], x - half, y - half, x + width + half, y + half);                  // top
+	setQuadRect(quads[1], x - half, y - half, x + half, y + height + half);                 // left
+	setQuadRect(quads[2], x - half, y + height - half, x + width + half, y + height + half); // bottom
+	setQuadRect(quads[3], x + width - half, y - half, x + width + half, y + height + half); // right
+	fillQuads(quads, 4);
 }
 
 void Graphics2::Graphics2::fillRect(float x, float y, float width, float height) {
 	imagePainter->end();
 	textPainter->end();
 
-	vec2 p1 = transformation * vec3(x, y + height, 1.0f);
-	vec2 p2 = transformation * vec3(x, y, 1.0f);
-	vec2 p3 = transformation * vec3(x + width, y, 1.0f);
-	vec2 p4 = transformation * vec3(x + width, y + height, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y());
+	Quad quad;
+	setQuadRect(quad, x, y, x + width, y + height);
+	fillQuads(&quad, 1);
+}
+
+void Graphics2::Graphics2::fillQuads(const Quad* quads, int count) {
+	if (lastPipeline == nullptr) batchPainter->drawQuads(nullptr, nullptr, false, quads, count, transformation, opacity, color);
+	else coloredPainter->fillQuads(quads, count, transformation, opacity, color);
+}
+
+void Graphics2::Graphics2::fillTriangleVertices(float x1, float y1, float x2, float y2, float x3, float y3) {
+	if (lastPipeline == nullptr) batchPainter->fillTriangle(opacity, color, x1, y1, x2, y2, x3, y3);
+	else coloredPainter->fillTriangle(opacity, color, x1, y1, x2, y2, x3, y3);
 }
 
 void Graphics2::Graphics2::drawString(const char* text, float x, float y) {
@@ -994,7 +997,8 @@ void Graphics2::Graphics2::drawString(const char* text, int start, int length, f
 	imagePainter->end();
 	coloredPainter->end();
 
-	textPainter->drawString(text, start, length, opacity, fontColor, x, y, transformation, fontGlyphs);
+	if (lastPipeline == nullptr) batchPainter->drawString(font, text, start, length, opacity, fontColor, x, y, transformation);
+	else textPainter->drawString(text, start, length, opacity, fontColor, x, y, transformation, fontGlyphs);
 }
 
 void Graphics2::Graphics2::drawLine(float x1, float y1, float x2, float y2, float strength) {
@@ -1012,13 +1016,18 @@ void Graphics2::Graphics2::drawLine(float x1, float y1, float x2, float y2, floa
 	vec3 p3 = vec3(p1.x() - vec.x(), p1.y() - vec.y(), 1.0f);
 	vec3 p4 = vec3(p2.x() - vec.x(), p2.y() - vec.y(), 1.0f);
 
-	p1 = transformation * p1;
-	p2 = transformation * p2;
-	p3 = transformation * p3;
-	p4 = transformation * p4;
-
-	coloredPainter->fillTriangle(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
-	coloredPainter->fillTriangle(opacity, color, p3.x(), p3.y(), p2.x(), p2.y(), p4.x(), p4.y());
+	// both sides of the line as one quad
+	Quad quad;
+	quad.x[0] = p1.x();
+	quad.y[0] = p1.y();
+	quad.x[1] = p2.x();
+	quad.y[1] = p2.y();
+	quad.x[2] = p4.x();
+	quad.y[2] = p4.y();
+	quad.x[3] = p3.x();
+	quad.y[3] = p3.y();
+	setQuadTexCoords(quad, 0, 0, 0, 0);
+	fillQuads(&quad, 1);
 }
 
 void Graphics2::Graphics2::fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3) {
@@ -1028,7 +1037,7 @@ void Graphics2::Graphics2::fillTriangle(float x1, float y1, float x2, float y2,
 	vec2 p1 = transformation * vec3(x1, y1, 1.0f);
 	vec2 p2 = transformation * vec3(x2, y2, 1.0f);
 	vec2 p3 = transformation * vec3(x3, y3, 1.0f);
-	coloredPainter->fillTriangle(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
+	fillTriangleVertices(p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
 }
 
 Graphics2::ImageScaleQuality Graphics2::Graphics2::getImageScaleQuality() const {
@@ -1038,6 +1047,7 @@ Graphics2::ImageScaleQuality Graphics2::Graphics2::getImageScaleQuality() const
 void Graphics2::Graphics2::setImageScaleQuality(Kore::Graphics2::ImageScaleQuality value) {
 	imagePainter->setBilinearFilter(value == High);
 	textPainter->setBilinearFilter(value == High);
+	batchPainter->setBilinearFilter(value == High);
 	myImageScaleQuality = value;
 }
 
@@ -1087,12 +1097,16 @@ void Graphics2::Graphics2::clear(uint color) {
 }
 
 void Graphics2::Graphics2::flush() {
+	KORE_PROFILE_ZONE("Graphics2::flush");
+	batchPainter->end();
 	imagePainter->end();
 	textPainter->end();
 	coloredPainter->end();
+	Kravur::nextGeneration();
 }
 
 void Graphics2::Graphics2::end() {
+	KORE_PROFILE_ZONE("Graphics2::end");
 	flush();
 	//    Graphics::end();
 }
@@ -1150,6 +1164,7 @@ Graphics2::Graphics2::~Graphics2() {
 	delete imagePainter;
 	delete coloredPainter;
 	delete textPainter;
+	delete batchPainter;
 	delete videoPipeline;
 }
 
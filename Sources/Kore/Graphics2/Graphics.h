@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Kravur.h"
+#include "Quads.h"
 #include <Kore/Graphics1/Color.h>
 #include <Kore/Graphics4/PipelineState.h>
 #include <Kore/Math/Matrix.h>
@@ -41,10 +42,6 @@ namespace Kore {
 			void initShaders();
 			void initBuffers();
 
-			void setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
-			                     float bottomrighty);
-			void setRectTexCoords(float left, float top, float right, float bottom);
-			void setRectColor(float r, float g, float b, float a);
 			void drawBuffer();
 
 		public:
@@ -59,19 +56,9 @@ namespace Kore {
 			void setBilinearFilter(bool bilinear);
 			void setBilinearMipmapFilter(bool bilinear);
 
-			inline void drawImage(Graphics4::Texture* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
-			                      float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
-			inline void drawImage2(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
-			                       float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
-			inline void drawImageScale(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
-			                           float opacity, uint color);
-
-			inline void drawImage(Graphics4::RenderTarget* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
-			                      float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
-			inline void drawImage2(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
-			                       float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
-			inline void drawImageScale(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
-			                           float opacity, uint color);
+			// Either texture or renderTarget is set
+			void drawImages(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, const Quad* quads, int count, const mat3& transformation,
+			                float opacity, uint color);
 
 			void end();
 		};
@@ -124,6 +111,7 @@ namespace Kore {
 
 			void fillRect(float opacity, uint color, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
 			              float bottomrightx, float bottomrighty);
+			void fillQuads(const Quad* quads, int count, const mat3& transformation, float opacity, uint color);
 			void fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3);
 
 			inline void endTris(bool rectsDone);
@@ -161,10 +149,7 @@ namespace Kore {
 			void initShaders();
 			void initBuffers();
 
-			void setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
-			                     float bottomrighty);
-			void setRectTexCoords(float left, float top, float right, float bottom);
-			void setRectColors(float opacity, uint color);
+			void addQuads(const Quad* quads, int count, const mat3& transformation, float opacity, uint color);
 			void drawBuffer();
 
 			char* text;
@@ -188,6 +173,69 @@ namespace Kore {
 			void setFont(Kravur* font);
 
 			void drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation, int* fontGlyphs);
+			void drawRun(const TextRun& run, float opacity, uint color, float x, float y, const mat3& transformation);
+
+			void end();
+		};
+
+		// Collects images, text, rectangles and triangles in one vertex stream.
+		// Every vertex carries a texture slot, so a batch is only drawn when it is full,
+		// needs a fifth texture or when the filter setting changes.
+		class BatchPainter {
+		private:
+			static const int maxTextures = 4;
+
+			mat4 projectionMatrix;
+			Graphics4::PipelineState* shaderPipeline;
+			Graphics4::VertexStructure structure;
+			Graphics4::ConstantLocation projectionLocation;
+			Graphics4::TextureUnit textureLocations[maxTextures];
+
+			int bufferSize;
+			int bufferIndex;
+			int vertexSize;
+			Graphics4::VertexBuffer* rectVertexBuffer;
+			float* rectVertices;
+			Graphics4::IndexBuffer* indexBuffer;
+
+			Graphics4::Texture* textures[maxTextures];
+			Graphics4::RenderTarget* renderTargets[maxTextures];
+			int textureCount;
+
+			bool bilinear;
+
+			void initShaders();
+			void initBuffers();
+
+			float textureSlot(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget);
+			void addQuad(float slot, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
+			             float bottomrighty, float left, float top, float right, float bottom, float opacity, uint color);
+			void drawBuffer();
+
+		public:
+			BatchPainter(int capacity);
+			~BatchPainter();
+
+			void setProjection(mat4 projectionMatrix);
+
+			void setBilinearFilter(bool bilinear);
+
+			void drawImage(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx, float toplefty,
+			               float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
+			void drawImage(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
+			               float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
+
+			void fillRect(float opacity, uint color, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
+			              float bottomrightx, float bottomrighty);
+			void fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3);
+
+			// Colored quads when neither texture nor renderTarget is set, coverage marks font textures
+			void drawQuads(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, bool coverage, const Quad* quads, int count,
+			               const mat3& transformation, float opacity, uint color);
+
+			void drawString(Kravur* font, const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation);
+			// Draws a laid out run with its origin at x, y, only the origin and the axes are transformed
+			void drawRun(const TextRun& run, float opacity, uint color, float x, float y, const mat3& transformation);
 
 			void end();
 		};
@@ -216,6 +264,7 @@ namespace Kore {
 			ImageShaderPainter* imagePainter;
 			ColoredShaderPainter* coloredPainter;
 			TextShaderPainter* textPainter;
+			BatchPainter* batchPainter;
 
 			Graphics4::PipelineState* videoPipeline;
 			Graphics4::PipelineState* lastPipeline;
@@ -226,10 +275,14 @@ namespace Kore {
 			int upperPowerOfTwo(int v);
 			void setProjection();
 
+			void fillQuads(const Quad* quads, int count);
+			void fillTriangleVertices(float x1, float y1, float x2, float y2, float x3, float y3);
+
 			void initShaders();
 
 		public:
-			Graphics2(int width, int height, bool rTargets = false);
+			// batchCapacity is the number of quads which can be drawn in one batch
+			Graphics2(int width, int height, bool rTargets = false, int batchCapacity = 4096);
 			~Graphics2();
 
 			mat3 transformation;
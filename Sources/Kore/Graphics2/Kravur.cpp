@@ -1,19 +1,52 @@
 #include "pch.h"
 
 #include "Kravur.h"
+#include "TrueType.h"
 
 #include <Kore/IO/FileReader.h>
+#include <Kore/Log.h>
+#include <algorithm>
 #include <map>
 #include <sstream>
+#include <stdlib.h>
 #include <string.h>
 
 using namespace Kore;
 
 #ifdef KORE_G4
 
+int Kravur::generation = 0;
+
 namespace {
 	std::map<std::string, Kravur*> fontCache;
 
+	// free pixels between glyphs keep bilinear filtering from bleeding into neighbours
+	const int padding = 1;
+
+	// cached text runs per font
+	const int runSets = 128;
+	const int runWays = 4;
+
+	AlignedQuad createQuad(const BakedChar& b, float xpos, float ypos, float ipw, float iph) {
+		int round_x = static_cast<int>(Kore::round(xpos + b.xoff));
+		int round_y = static_cast<int>(Kore::round(ypos + b.yoff));
+
+		AlignedQuad q;
+		q.x0 = static_cast<float>(round_x);
+		q.y0 = static_cast<float>(round_y);
+		q.x1 = static_cast<float>(round_x + b.x1 - b.x0);
+		q.y1 = static_cast<float>(round_y + b.y1 - b.y0);
+
+		q.s0 = b.x0 * ipw;
+		q.t0 = b.y0 * iph;
+		q.s1 = b.x1 * ipw;
+		q.t1 = b.y1 * iph;
+
+		q.xadvance = b.xadvance;
+
+		return q;
+	}
+
 	std::string createKey(const char* name, FontStyle style, float size) {
 		std::stringstream key;
 		key << name;
@@ -48,7 +81,47 @@ Kravur* Kravur::load(const char* name, FontStyle style, float size) {
 	}
 }
 
-Kravur::Kravur(Reader* reader) {
+Kravur* Kravur::loadTrueType(const char* filename, float size) {
+	std::stringstream key;
+	key << filename << "#" << size;
+	Kravur* kravur = fontCache[key.str()];
+	if (kravur == nullptr) {
+		FileReader reader(filename);
+		int dataSize = reader.size();
+		void* data = malloc(dataSize > 0 ? dataSize : 1);
+		memcpy(data, reader.readAll(), dataSize);
+		TrueTypeFont* font = new TrueTypeFont;
+		if (!font->init((u8*)data, dataSize)) {
+			log(Warning, "%s is not a TrueType font.", filename);
+			delete font;
+			free(data);
+			return nullptr;
+		}
+		kravur = new Kravur(data, font, size);
+		kravur->name = filename;
+		kravur->size = size;
+		fontCache[key.str()] = kravur;
+	}
+	return kravur;
+}
+
+Kravur::Kravur(void* fontData, TrueTypeFont* font, float size)
+    : fontData(fontData), fontInfo(font), dirtyX0(0), dirtyY0(0), dirtyX1(0), dirtyY1(0), atlasVersion(0), runUses(0) {
+	scale = font->scaleForPixelHeight(size);
+	int ascent, descent, lineGap;
+	font->verticalMetrics(ascent, descent, lineGap);
+	baseline = static_cast<float>(static_cast<int>(ascent * scale + 0.5f));
+
+	width = height = size <= 24.0f ? 512 : size <= 64.0f ? 1024 : 2048;
+	pixels.resize(width * height);
+	texture = new Graphics4::Texture(width, height, Graphics4::Image::Grey8, true);
+	u8* bytes = texture->lock();
+	for (int y = 0; y < height; ++y) memset(&bytes[y * texture->stride()], 0, width);
+	texture->unlock();
+}
+
+Kravur::Kravur(Reader* reader)
+    : fontData(nullptr), fontInfo(nullptr), scale(1.0f), dirtyX0(0), dirtyY0(0), dirtyX1(0), dirtyY1(0), atlasVersion(0), runUses(0) {
 	reader->readS32LE(); // size
 	int ascent = reader->readS32LE();
 	reader->readS32LE(); // descent
@@ -76,17 +149,7 @@ Kravur::Kravur(Reader* reader) {
 	}
 	texture = new Graphics4::Texture(w, h, Graphics4::Image::Grey8, true);
 	u8* bytes = texture->lock();
-	int pos = 0;
-	for (int y = 0; y < h; ++y)
-		for (int x = 0; x < w; ++x) {
-			bytes[pos] = reader->readU8();
-
-			// filter-test
-			// if ((x + y) % 2 == 0) bytes.set(pos, 0xff);
-			// else bytes.set(pos, 0);
-
-			++pos;
-		}
+	for (int y = 0; y < h; ++y) reader->read(&bytes[y * texture->stride()], w);
 	texture->unlock();
 	reader->seek(0);
 }
@@ -96,34 +159,226 @@ Graphics4::Texture* Kravur::getTexture() {
 }
 
 AlignedQuad Kravur::getBakedQuad(int char_index, float xpos, float ypos) {
-	if (char_index >= static_cast<int>(chars.size())) return AlignedQuad();
-	float ipw = 1.0f / width;
-	float iph = 1.0f / height;
+	if (char_index < 0 || char_index >= static_cast<int>(chars.size())) return AlignedQuad();
 	BakedChar b = chars[char_index];
 	if (b.x0 < 0) return AlignedQuad();
-	int round_x = static_cast<int>(Kore::round(xpos + b.xoff));
-	int round_y = static_cast<int>(Kore::round(ypos + b.yoff));
+	return createQuad(b, xpos, ypos, 1.0f / width, 1.0f / height);
+}
+
+bool Kravur::getGlyphQuad(int codepoint, float xpos, float ypos, AlignedQuad& quad) {
+	BakedChar* b = findGlyph(codepoint);
+	if (b == nullptr || b->x0 < 0) return false;
+	quad = createQuad(*b, xpos, ypos, 1.0f / width, 1.0f / height);
+	return true;
+}
+
+int Kravur::decodeUtf8(const char* text, int end, int& index) {
+	int lead = static_cast<unsigned char>(text[index]);
+	int count = (lead & 0xe0) == 0xc0 ? 1 : (lead & 0xf0) == 0xe0 ? 2 : (lead & 0xf8) == 0xf0 ? 3 : 0;
+	if (count == 0 || index + count >= end) {
+		++index;
+		return lead;
+	}
+	int codepoint = lead & (0x3f >> count);
+	for (int i = 1; i <= count; ++i) {
+		int next = static_cast<unsigned char>(text[index + i]);
+		if ((next & 0xc0) != 0x80) {
+			++index;
+			return lead;
+		}
+		codepoint = (codepoint << 6) | (next & 0x3f);
+	}
+	index += count + 1;
+	return codepoint;
+}
 
-	AlignedQuad q;
-	q.x0 = static_cast<float>(round_x);
-	q.y0 = static_cast<float>(round_y);
-	q.x1 = static_cast<float>(round_x + b.x1 - b.x0);
-	q.y1 = static_cast<float>(round_y + b.y1 - b.y0);
+void Kravur::nextGeneration() {
+	++generation;
+}
 
-	q.s0 = b.x0 * ipw;
-	q.t0 = b.y0 * iph;
-	q.s1 = b.x1 * ipw;
-	q.t1 = b.y1 * iph;
+BakedChar* Kravur::findGlyph(int codepoint, int* shelf) {
+	if (shelf != nullptr) *shelf = -1;
+	if (fontInfo == nullptr) {
+		if (codepoint < 32 || codepoint - 32 >= static_cast<int>(chars.size())) return nullptr;
+		return &chars[codepoint - 32];
+	}
+	std::map<int, CachedGlyph>::iterator glyph = glyphs.find(codepoint);
+	if (glyph == glyphs.end()) {
+		if (rasterizeGlyph(codepoint) == nullptr) return nullptr;
+		glyph = glyphs.find(codepoint);
+	}
+	if (glyph->second.shelf >= 0) shelves[glyph->second.shelf].lastUse = generation;
+	if (shelf != nullptr) *shelf = glyph->second.shelf;
+	return &glyph->second.baked;
+}
 
-	q.xadvance = b.xadvance;
+BakedChar* Kravur::rasterizeGlyph(int codepoint) {
+	CachedGlyph glyph;
+	int index = fontInfo->glyphIndex(codepoint);
+	if (index == 0) {
+		// remembered so that the font is not searched again, x0 < 0 marks glyphs which can not be drawn
+		glyph.baked.xadvance = 0;
+		glyph.shelf = -1;
+		CachedGlyph& cached = glyphs[codepoint];
+		cached = glyph;
+		return &cached.baked;
+	}
+	int advance, bearing;
+	fontInfo->horizontalMetrics(index, advance, bearing);
+	int x0, y0, x1, y1;
+	fontInfo->bitmapBox(index, scale, x0, y0, x1, y1);
+	int w = x1 - x0;
+	int h = y1 - y0;
 
-	return q;
+	glyph.baked.x0 = glyph.baked.y0 = glyph.baked.x1 = glyph.baked.y1 = 0;
+	glyph.baked.xoff = static_cast<float>(x0);
+	glyph.baked.yoff = y0 + baseline;
+	glyph.baked.xadvance = advance * scale;
+	glyph.shelf = -1;
+	if (w > 0 && h > 0) {
+		Shelf* shelf = findShelf(w + padding, h + padding);
+		if (shelf == nullptr) {
+			log(Warning, "Glyph %i does not fit into the font atlas.", codepoint);
+			return nullptr;
+		}
+		int x = shelf->x;
+		int y = shelf->y;
+		shelf->x += w + padding;
+		shelf->lastUse = generation;
+		shelf->codepoints.push_back(codepoint);
+		glyph.shelf = static_cast<int>(shelf - &shelves[0]);
+		fontInfo->rasterize(index, scale, &pixels[y * width + x], w, h, width);
+		glyph.baked.x0 = x;
+		glyph.baked.y0 = y;
+		glyph.baked.x1 = x + w;
+		glyph.baked.y1 = y + h;
+		if (dirtyX0 == dirtyX1) {
+			dirtyX0 = x;
+			dirtyY0 = y;
+			dirtyX1 = x + w;
+			dirtyY1 = y + h;
+		}
+		else {
+			dirtyX0 = Kore::min(dirtyX0, x);
+			dirtyY0 = Kore::min(dirtyY0, y);
+			dirtyX1 = Kore::max(dirtyX1, x + w);
+			dirtyY1 = Kore::max(dirtyY1, y + h);
+		}
+	}
+	CachedGlyph& cached = glyphs[codepoint];
+	cached = glyph;
+	return &cached.baked;
+}
+
+Kravur::Shelf* Kravur::findShelf(int width, int height) {
+	// shelves are reused for glyphs which are up to a third lower to not waste too much space
+	Shelf* best = nullptr;
+	for (size_t i = 0; i < shelves.size(); ++i) {
+		Shelf& shelf = shelves[i];
+		if (shelf.height >= height && shelf.height * 2 <= height * 3 && shelf.x + width <= this->width && (best == nullptr || shelf.height < best->height)) {
+			best = &shelf;
+		}
+	}
+	if (best != nullptr) return best;
+
+	int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+	int shelfHeight = (height + 3) & ~3;
+	if (top + shelfHeight <= this->height) {
+		Shelf shelf;
+		shelf.y = top;
+		shelf.height = shelfHeight;
+		shelf.x = 0;
+		shelf.lastUse = generation;
+		shelves.push_back(shelf);
+		return &shelves.back();
+	}
+
+	// the atlas is full, evict the least recently used shelf which is high enough
+	Shelf* victim = nullptr;
+	for (size_t i = 0; i < shelves.size(); ++i) {
+		if (shelves[i].height >= height && (victim == nullptr || shelves[i].lastUse < victim->lastUse)) victim = &shelves[i];
+	}
+	if (victim == nullptr) return nullptr;
+	if (victim->lastUse == generation) {
+		log(Warning, "The font atlas is too small for the text which is drawn at once, glyphs are overwritten while in use.");
+	}
+	for (size_t i = 0; i < victim->codepoints.size(); ++i) glyphs.erase(victim->codepoints[i]);
+	victim->codepoints.clear();
+	++atlasVersion;
+	victim->x = 0;
+	memset(&pixels[victim->y * this->width], 0, victim->height * this->width);
+	dirtyX0 = 0;
+	dirtyX1 = this->width;
+	dirtyY0 = dirtyY0 == dirtyY1 ? victim->y : Kore::min(dirtyY0, victim->y);
+	dirtyY1 = Kore::max(dirtyY1, victim->y + victim->height);
+	return victim;
+}
+
+void Kravur::uploadGlyphs() {
+	if (dirtyX0 == dirtyX1 || dirtyY0 == dirtyY1) return;
+	texture->uploadRegion(dirtyX0, dirtyY0, dirtyX1 - dirtyX0, dirtyY1 - dirtyY0, &pixels[dirtyY0 * width + dirtyX0], width);
+	dirtyX0 = dirtyY0 = dirtyX1 = dirtyY1 = 0;
+}
+
+const TextRun& Kravur::layout(const char* text, int length) {
+	if (runs.empty()) runs.resize(runSets * runWays);
+	unsigned hash = 2166136261u;
+	for (int i = 0; i < length; ++i) hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+
+	++runUses;
+	CachedRun* set = &runs[(hash & (runSets - 1)) * runWays];
+	CachedRun* victim = &set[0];
+	for (int way = 0; way < runWays; ++way) {
+		CachedRun& entry = set[way];
+		if (entry.lastUse > 0 && entry.hash == hash && entry.text.size() == static_cast<size_t>(length) && memcmp(entry.text.data(), text, length) == 0) {
+			entry.lastUse = runUses;
+			if (!touch(entry.run)) layoutRun(text, length, entry.run);
+			return entry.run;
+		}
+		if (entry.lastUse < victim->lastUse) victim = &entry;
+	}
+	victim->hash = hash;
+	victim->text.assign(text, length);
+	victim->lastUse = runUses;
+	layoutRun(text, length, victim->run);
+	return victim->run;
+}
+
+void Kravur::layoutRun(const char* text, int length, TextRun& run) {
+	run.font = this;
+	run.quads.clear();
+	run.shelves.clear();
+	float xpos = 0.0f;
+	bool kerning = fontInfo != nullptr && fontInfo->hasKerning();
+	// glyph index of the last character, only looked up when the font has kerning
+	int previous = 0;
+	for (int i = 0; i < length;) {
+		int codepoint = decodeUtf8(text, length, i);
+		int shelf;
+		BakedChar* b = findGlyph(codepoint, &shelf);
+		if (b == nullptr || b->x0 < 0) continue;
+		int glyph = kerning ? fontInfo->glyphIndex(codepoint) : 0;
+		if (previous != 0) xpos += fontInfo->kernAdvance(previous, glyph) * scale;
+		run.quads.push_back(createQuad(*b, xpos, 0.0f, 1.0f / width, 1.0f / height));
+		if (shelf >= 0 && std::find(run.shelves.begin(), run.shelves.end(), shelf) == run.shelves.end()) run.shelves.push_back(shelf);
+		xpos += b->xadvance;
+		previous = glyph;
+	}
+	run.width = xpos;
+	// glyphs which were evicted while laying out the run are overwritten, that was already warned about
+	run.atlasVersion = atlasVersion;
+}
+
+// Marks the glyphs of a run as used, returns false when some of them were evicted
+bool Kravur::touch(const TextRun& run) {
+	if (run.atlasVersion != atlasVersion) return false;
+	for (size_t i = 0; i < run.shelves.size(); ++i) shelves[run.shelves[i]].lastUse = generation;
+	return true;
 }
 
 float Kravur::getCharWidth(int charIndex) {
-	if (charIndex < 32) return 0;
-	if (charIndex - 32 >= static_cast<int>(chars.size())) return 0;
-	return chars[charIndex - 32].xadvance;
+	BakedChar* b = findGlyph(charIndex);
+	return b == nullptr ? 0 : b->xadvance;
 }
 
 float Kravur::getHeight() {
@@ -131,7 +386,7 @@ float Kravur::getHeight() {
 }
 
 float Kravur::charWidth(char ch) {
-	return getCharWidth(ch);
+	return getCharWidth(static_cast<unsigned char>(ch));
 }
 
 float Kravur::charsWidth(const char* ch, int offset, int length) {
@@ -139,12 +394,8 @@ float Kravur::charsWidth(const char* ch, int offset, int length) {
 }
 
 float Kravur::stringWidth(const char* string, int length) {
-	float width = 0;
 	if (length < 0) length = (int)strlen(string);
-	for (int c = 0; c < length; ++c) {
-		width += getCharWidth(string[c]);
-	}
-	return width;
+	return layout(string, length).width;
 }
 
 float Kravur::getBaselinePosition() {
@@ -2,6 +2,8 @@
 
 #include <Kore/Graphics4/Graphics.h>
 #include <Kore/IO/Reader.h>
+#include <map>
+#include <string>
 #include <vector>
 
 struct FontStyle {
@@ -50,9 +52,45 @@ struct AlignedQuad {
 };
 
 namespace Kore {
+	class Kravur;
+	class TrueTypeFont;
+
+	// A string which was laid out once, quads are relative to the origin of the string
+	struct TextRun {
+		Kravur* font;
+		std::vector<AlignedQuad> quads;
+		// atlas shelves which hold the glyphs of the run
+		std::vector<int> shelves;
+		int atlasVersion;
+		float width;
+	};
+
 	class Kravur {
 	private:
 		Kravur(Kore::Reader* reader);
+		Kravur(void* fontData, TrueTypeFont* font, float size);
+
+		// Glyphs which are rasterized on demand are packed into rows of the atlas, whole rows are evicted when it is full
+		struct Shelf {
+			int y;
+			int height;
+			int x;
+			int lastUse;
+			std::vector<int> codepoints;
+		};
+
+		struct CachedGlyph {
+			BakedChar baked;
+			// -1 for glyphs without pixels
+			int shelf;
+		};
+
+		struct CachedRun {
+			unsigned hash;
+			std::string text;
+			int lastUse;
+			TextRun run;
+		};
 
 		const char* name;
 		FontStyle style;
@@ -62,6 +100,29 @@ namespace Kore {
 		std::vector<BakedChar> chars;
 		Graphics4::Texture* texture;
 		float baseline;
+
+		void* fontData;
+		// nullptr for fonts which were baked into .kravur files
+		TrueTypeFont* fontInfo;
+		float scale;
+		std::map<int, CachedGlyph> glyphs;
+		std::vector<Shelf> shelves;
+		std::vector<u8> pixels;
+		int dirtyX0, dirtyY0, dirtyX1, dirtyY1;
+		// incremented when glyphs are evicted
+		int atlasVersion;
+
+		// recently laid out strings in sets of runWays entries
+		std::vector<CachedRun> runs;
+		int runUses;
+
+		static int generation;
+
+		void layoutRun(const char* text, int length, TextRun& run);
+		bool touch(const TextRun& run);
+		BakedChar* findGlyph(int codepoint, int* shelf = nullptr);
+		BakedChar* rasterizeGlyph(int codepoint);
+		Shelf* findShelf(int width, int height);
 		float getCharWidth(int charIndex);
 		float charWidth(char ch);
 
@@ -70,9 +131,25 @@ namespace Kore {
 		int height;
 
 		static Kravur* load(const char* name, FontStyle style, float size);
+		// Rasterizes the glyphs of a TrueType font when they are first used, returns nullptr for files which are no TrueType fonts
+		static Kravur* loadTrueType(const char* filename, float size);
+
+		// Decodes the UTF-8 code point at text[index] and moves index behind it.
+		// Bytes which are not valid UTF-8 are returned as they are so that Latin-1 text keeps working.
+		static int decodeUtf8(const char* text, int end, int& index);
+
+		// Called when all queued text was drawn, glyphs which were used before can then be evicted
+		static void nextGeneration();
 
 		Graphics4::Texture* getTexture();
 		AlignedQuad getBakedQuad(int char_index, float xpos, float ypos);
+		// Returns false for code points which the font can not draw
+		bool getGlyphQuad(int codepoint, float xpos, float ypos, AlignedQuad& quad);
+		// Uploads the part of the atlas which changed since the last call, has to be called before drawing glyphs
+		void uploadGlyphs();
+		// Lays out a string, the runs of recently laid out strings are reused.
+		// The run stays valid until the next call.
+		const TextRun& layout(const char* text, int length);
 
 		float getHeight();
 		float charsWidth(const char* ch, int offset, int length);
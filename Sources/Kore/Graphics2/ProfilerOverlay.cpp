@@ -0,0 +1,62 @@
+#include "pch.h"
+
+#include "ProfilerOverlay.h"
+
+#include "Graphics.h"
+
+#include <Kore/Profiler.h>
+
+#include <stdio.h>
+
+using namespace Kore;
+
+#ifdef KORE_G4
+
+void Graphics2::drawProfilerOverlay(Graphics2* g2, float x, float y) {
+	Kravur* font = g2->getFont();
+	if (font == nullptr) return;
+
+	const int maxZones = 32;
+	Profiler::ZoneSummary zones[maxZones];
+	double frameSeconds;
+	int count = Profiler::lastFrame(zones, maxZones, &frameSeconds);
+
+	const float padding = 4.0f;
+	const float barWidth = 100.0f;
+	float lineHeight = font->getHeight();
+	float indent = font->stringWidth("  ");
+	char lines[maxZones][128];
+	float textWidth = 0.0f;
+	for (int i = 0; i < count; ++i) {
+		snprintf(lines[i], sizeof(lines[i]), "%s  %.2f ms  %ix", zones[i].name, zones[i].seconds * 1000.0, zones[i].calls);
+		float width = zones[i].depth * indent + font->stringWidth(lines[i]);
+		if (width > textWidth) textWidth = width;
+	}
+	char title[64];
+	snprintf(title, sizeof(title), "frame %.2f ms", frameSeconds * 1000.0);
+	if (font->stringWidth(title) > textWidth) textWidth = font->stringWidth(title);
+
+	uint color = g2->getColor();
+	float opacity = g2->getOpacity();
+	uint fontColor = g2->getFontColor();
+
+	g2->setOpacity(0.75f);
+	g2->setColor(0xff202020);
+	g2->fillRect(x, y, textWidth + barWidth + padding * 3.0f, lineHeight * (count + 1) + padding * 2.0f);
+	g2->setOpacity(1.0f);
+	g2->setFontColor(Color::White);
+	g2->drawString(title, x + padding, y + padding);
+	g2->setColor(0xff40c040);
+	for (int i = 0; i < count; ++i) {
+		float lineY = y + padding + lineHeight * (i + 1);
+		g2->drawString(lines[i], x + padding + zones[i].depth * indent, lineY);
+		float share = frameSeconds > 0.0 ? (float)(zones[i].seconds / frameSeconds) : 0.0f;
+		g2->fillRect(x + textWidth + padding * 2.0f, lineY + lineHeight * 0.2f, barWidth * (share < 1.0f ? share : 1.0f), lineHeight * 0.6f);
+	}
+
+	g2->setColor(color);
+	g2->setOpacity(opacity);
+	g2->setFontColor(fontColor);
+}
+
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace Kore {
+	namespace Graphics2 {
+		class Graphics2;
+
+		// Draws the zones of the last frame of the calling thread as reported by Profiler::lastFrame.
+		// Uses the current font of g2, nothing is drawn when no font is set.
+		void drawProfilerOverlay(Graphics2* g2, float x, float y);
+	}
+}
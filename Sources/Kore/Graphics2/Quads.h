@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Kore/Math/Matrix.h>
+#include <Kore/Simd/float32x4.h>
+
+namespace Kore {
+	namespace Graphics2 {
+		// Corners in the order bottom-left, top-left, top-right, bottom-right, before they are transformed
+		struct Quad {
+			float x[4];
+			float y[4];
+			// texture coordinates
+			float left, top, right, bottom;
+		};
+
+		inline void setQuadRect(Quad& quad, float left, float top, float right, float bottom) {
+			quad.x[0] = quad.x[1] = left;
+			quad.x[2] = quad.x[3] = right;
+			quad.y[0] = quad.y[3] = bottom;
+			quad.y[1] = quad.y[2] = top;
+		}
+
+		inline void setQuadTexCoords(Quad& quad, float left, float top, float right, float bottom) {
+			quad.left = left;
+			quad.top = top;
+			quad.right = right;
+			quad.bottom = bottom;
+		}
+
+		// Offsets in floats of the attributes of a painter vertex, the position always comes first
+		struct QuadFormat {
+			int stride;
+			int texCoords; // -1 when there are none
+			int color;
+			int slot; // -1 when there is none
+		};
+
+		// Transforms the corners of count quads and writes four complete vertices for each of them.
+		// All quads share the color and the texture slot, the matrix is only divided by w when it is projective.
+		inline void emitQuads(const mat3& transformation, const Quad* quads, int count, const QuadFormat& format, float r, float g, float b, float a, float slot,
+		                      float* vertices) {
+			float32x4 _00 = loadAll(transformation.get(0, 0));
+			float32x4 _01 = loadAll(transformation.get(0, 1));
+			float32x4 _02 = loadAll(transformation.get(0, 2));
+			float32x4 _10 = loadAll(transformation.get(1, 0));
+			float32x4 _11 = loadAll(transformation.get(1, 1));
+			float32x4 _12 = loadAll(transformation.get(1, 2));
+			float32x4 _20 = loadAll(transformation.get(2, 0));
+			float32x4 _21 = loadAll(transformation.get(2, 1));
+			float32x4 _22 = loadAll(transformation.get(2, 2));
+			bool projective = transformation.get(2, 0) != 0.0f || transformation.get(2, 1) != 0.0f || transformation.get(2, 2) != 1.0f;
+			float32x4 color = load(r, g, b, a);
+
+			const int stride = format.stride;
+			for (int i = 0; i < count; ++i) {
+				const Quad& quad = quads[i];
+				float32x4 xx = loadUnaligned(quad.x);
+				float32x4 yy = loadUnaligned(quad.y);
+				float32x4 px = add(add(mul(_00, xx), mul(_01, yy)), _02);
+				float32x4 py = add(add(mul(_10, xx), mul(_11, yy)), _12);
+				if (projective) {
+					float32x4 w = add(add(mul(_20, xx), mul(_21, yy)), _22);
+					px = div(px, w);
+					py = div(py, w);
+				}
+				float32x4 low = interleaveLow(px, py);
+				float32x4 high = interleaveHigh(px, py);
+
+				float* vertex = vertices + i * stride * 4;
+				storeLow(vertex, low);
+				storeHigh(vertex + stride, low);
+				storeLow(vertex + stride * 2, high);
+				storeHigh(vertex + stride * 3, high);
+				for (int corner = 0; corner < 4; ++corner) {
+					vertex[corner * stride + 2] = -5.0f;
+					storeUnaligned(vertex + corner * stride + format.color, color);
+				}
+				if (format.texCoords >= 0) {
+					float* texCoords = vertex + format.texCoords;
+					texCoords[0] = quad.left;
+					texCoords[1] = quad.bottom;
+					texCoords[stride] = quad.left;
+					texCoords[stride + 1] = quad.top;
+					texCoords[stride * 2] = quad.right;
+					texCoords[stride * 2 + 1] = quad.top;
+					texCoords[stride * 3] = quad.right;
+					texCoords[stride * 3 + 1] = quad.bottom;
+				}
+				if (format.slot >= 0) {
+					for (int corner = 0; corner < 4; ++corner) vertex[corner * stride + format.slot] = slot;
+				}
+			}
+		}
+	}
+}
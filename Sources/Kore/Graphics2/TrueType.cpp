@@ -0,0 +1,526 @@
+#include "pch.h"
+
+#include "TrueType.h"
+
+#include <Kore/Math/Core.h>
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace Kore;
+
+namespace {
+	// composite glyphs which contain themselves are cut off
+	const int maxDepth = 8;
+	// curves are split until they differ from their lines by about a quarter pixel
+	const int maxCurveSegments = 32;
+
+	// Accumulates the signed area which lines cover in each pixel, the sum of a row up to a pixel is its coverage
+	class Rasterizer {
+	public:
+		Rasterizer(int width, int height) : width(width), height(height), area(width * height + 4, 0.0f) {}
+
+		void line(float x0, float y0, float x1, float y1) {
+			if (y0 == y1) return;
+			x0 = clampX(x0);
+			x1 = clampX(x1);
+			float direction = 1.0f;
+			if (y0 > y1) {
+				direction = -1.0f;
+				float swap = x0;
+				x0 = x1;
+				x1 = swap;
+				swap = y0;
+				y0 = y1;
+				y1 = swap;
+			}
+			float dxdy = (x1 - x0) / (y1 - y0);
+			float x = x0;
+			int yStart = 0;
+			if (y0 < 0.0f) x = clampX(x - y0 * dxdy);
+			else yStart = static_cast<int>(y0);
+			int yEnd = Kore::min(static_cast<int>(ceilf(y1)), height);
+			for (int y = yStart; y < yEnd; ++y) {
+				float* row = &area[y * width];
+				float dy = Kore::min(y + 1.0f, y1) - Kore::max(static_cast<float>(y), y0);
+				// steep lines drift out of the row through rounding
+				float xNext = clampX(x + dxdy * dy);
+				float d = dy * direction;
+				float left = x < xNext ? x : xNext;
+				float right = x < xNext ? xNext : x;
+				float leftFloor = floorf(left);
+				int leftIndex = static_cast<int>(leftFloor);
+				float rightCeil = ceilf(right);
+				int rightIndex = static_cast<int>(rightCeil);
+				if (rightIndex <= leftIndex + 1) {
+					// the line stays in one pixel of the row
+					float middle = 0.5f * (x + xNext) - leftFloor;
+					row[leftIndex] += d - d * middle;
+					row[leftIndex + 1] += d * middle;
+				}
+				else {
+					float s = 1.0f / (right - left);
+					float leftFraction = left - leftFloor;
+					float leftArea = 0.5f * s * (1.0f - leftFraction) * (1.0f - leftFraction);
+					float rightFraction = right - rightCeil + 1.0f;
+					float rightArea = 0.5f * s * rightFraction * rightFraction;
+					row[leftIndex] += d * leftArea;
+					if (rightIndex == leftIndex + 2) {
+						row[leftIndex + 1] += d * (1.0f - leftArea - rightArea);
+					}
+					else {
+						float firstArea = s * (1.5f - leftFraction);
+						row[leftIndex + 1] += d * (firstArea - leftArea);
+						for (int i = leftIndex + 2; i < rightIndex - 1; ++i) row[i] += d * s;
+						float lastArea = firstArea + (rightIndex - leftIndex - 3) * s;
+						row[rightIndex - 1] += d * (1.0f - lastArea - rightArea);
+					}
+					row[rightIndex] += d * rightArea;
+				}
+				x = xNext;
+			}
+		}
+
+		void curve(float x0, float y0, float cx, float cy, float x1, float y1) {
+			float ddx = x0 - 2.0f * cx + x1;
+			float ddy = y0 - 2.0f * cy + y1;
+			int segments = Kore::min(1 + static_cast<int>(sqrtf(sqrtf(ddx * ddx + ddy * ddy) * 2.0f)), maxCurveSegments);
+			float lastX = x0;
+			float lastY = y0;
+			for (int i = 1; i <= segments; ++i) {
+				float t = static_cast<float>(i) / segments;
+				float u = 1.0f - t;
+				float x = u * u * x0 + 2.0f * u * t * cx + t * t * x1;
+				float y = u * u * y0 + 2.0f * u * t * cy + t * t * y1;
+				line(lastX, lastY, x, y);
+				lastX = x;
+				lastY = y;
+			}
+		}
+
+		// Overlapping contours add up, the coverage is clamped
+		void write(u8* output, int stride) {
+			float sum = 0.0f;
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					sum += area[y * width + x];
+					float coverage = Kore::min(fabsf(sum), 1.0f);
+					output[y * stride + x] = static_cast<u8>(coverage * 255.0f + 0.5f);
+				}
+			}
+		}
+
+	private:
+		int width;
+		int height;
+		std::vector<float> area;
+
+		float clampX(float x) {
+			return x < 0.0f ? 0.0f : x > width ? static_cast<float>(width) : x;
+		}
+	};
+}
+
+// Points of all contours in font units, ends holds the index behind the last point of each contour
+struct TrueTypeFont::Outline {
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<bool> onCurve;
+	std::vector<int> ends;
+};
+
+TrueTypeFont::TrueTypeFont()
+    : data(nullptr), size(0), cmap(0), loca(0), glyf(0), hmtx(0), kern(0), locaFormat(0), glyphCount(0), hMetricCount(0), ascent(0), descent(0),
+      lineGap(0) {}
+
+u8 TrueTypeFont::readU8(int offset) {
+	if (offset < 0 || offset >= size) return 0;
+	return data[offset];
+}
+
+u16 TrueTypeFont::readU16(int offset) {
+	if (offset < 0 || offset > size - 2) return 0;
+	return static_cast<u16>((data[offset] << 8) | data[offset + 1]);
+}
+
+s16 TrueTypeFont::readS16(int offset) {
+	return static_cast<s16>(readU16(offset));
+}
+
+u32 TrueTypeFont::readU32(int offset) {
+	if (offset < 0 || offset > size - 4) return 0;
+	return (static_cast<u32>(data[offset]) << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+}
+
+// Returns 0 when the table is missing or does not fit into the data
+int TrueTypeFont::findTable(int font, const char* tag) {
+	int tableCount = readU16(font + 4);
+	for (int i = 0; i < tableCount; ++i) {
+		int record = font + 12 + i * 16;
+		if (record > size - 16) return 0;
+		if (memcmp(&data[record], tag, 4) != 0) continue;
+		u32 offset = readU32(record + 8);
+		u32 length = readU32(record + 12);
+		if (offset == 0 || offset > (u32)size || length > (u32)size - offset) return 0;
+		return static_cast<int>(offset);
+	}
+	return 0;
+}
+
+bool TrueTypeFont::init(const u8* data, int size) {
+	this->data = data;
+	this->size = size;
+
+	int font = 0;
+	// collections start with a list of fonts, the first one is used
+	if (size >= 16 && memcmp(data, "ttcf", 4) == 0) font = static_cast<int>(readU32(12));
+	u32 version = readU32(font);
+	if (version != 0x00010000 && version != 0x74727565) return false;
+
+	cmap = findTable(font, "cmap");
+	loca = findTable(font, "loca");
+	glyf = findTable(font, "glyf");
+	hmtx = findTable(font, "hmtx");
+	kern = findTable(font, "kern");
+	int head = findTable(font, "head");
+	int hhea = findTable(font, "hhea");
+	int maxp = findTable(font, "maxp");
+	if (cmap == 0 || loca == 0 || glyf == 0 || hmtx == 0 || head == 0 || hhea == 0 || maxp == 0) return false;
+
+	locaFormat = readS16(head + 50);
+	glyphCount = readU16(maxp + 4);
+	ascent = readS16(hhea + 4);
+	descent = readS16(hhea + 6);
+	lineGap = readS16(hhea + 8);
+	hMetricCount = readU16(hhea + 34);
+	if (ascent == descent || hMetricCount == 0) return false;
+
+	// Unicode subtables of Windows are preferred, full repertoire before the basic plane
+	int tableCount = readU16(cmap + 2);
+	int best = 0;
+	int bestRank = 0;
+	for (int i = 0; i < tableCount; ++i) {
+		int record = cmap + 4 + i * 8;
+		int platform = readU16(record);
+		int encoding = readU16(record + 2);
+		// encoding 5 of the Unicode platform only holds variation sequences
+		int rank = platform == 3 && encoding == 10 ? 4 : platform == 0 && encoding != 5 ? 3 : platform == 3 && encoding == 1 ? 2 : 0;
+		u32 offset = readU32(record + 4);
+		if (rank > bestRank && offset < (u32)(size - cmap)) {
+			best = cmap + static_cast<int>(offset);
+			bestRank = rank;
+		}
+	}
+	cmap = best;
+	return cmap != 0;
+}
+
+float TrueTypeFont::scaleForPixelHeight(float height) {
+	return height / (ascent - descent);
+}
+
+void TrueTypeFont::verticalMetrics(int& ascent, int& descent, int& lineGap) {
+	ascent = this->ascent;
+	descent = this->descent;
+	lineGap = this->lineGap;
+}
+
+int TrueTypeFont::glyphIndex(int codepoint) {
+	int format = readU16(cmap);
+	switch (format) {
+	case 0:
+		return codepoint >= 0 && codepoint < 256 ? readU8(cmap + 6 + codepoint) : 0;
+	case 6: {
+		int first = readU16(cmap + 6);
+		int count = readU16(cmap + 8);
+		return codepoint >= first && codepoint < first + count ? readU16(cmap + 10 + (codepoint - first) * 2) : 0;
+	}
+	case 4: {
+		if (codepoint < 0 || codepoint > 0xffff) return 0;
+		int segments = readU16(cmap + 6) / 2;
+		int endCodes = cmap + 14;
+		int startCodes = endCodes + segments * 2 + 2;
+		int deltas = startCodes + segments * 2;
+		int rangeOffsets = deltas + segments * 2;
+		// the segments are sorted by their end codes
+		int low = 0;
+		int high = segments;
+		while (low < high) {
+			int middle = (low + high) / 2;
+			if (readU16(endCodes + middle * 2) < codepoint) low = middle + 1;
+			else high = middle;
+		}
+		if (low == segments) return 0;
+		int start = readU16(startCodes + low * 2);
+		if (codepoint < start) return 0;
+		int delta = readU16(deltas + low * 2);
+		int rangeOffset = readU16(rangeOffsets + low * 2);
+		if (rangeOffset == 0) return (codepoint + delta) & 0xffff;
+		int glyph = readU16(rangeOffsets + low * 2 + rangeOffset + (codepoint - start) * 2);
+		return glyph == 0 ? 0 : (glyph + delta) & 0xffff;
+	}
+	case 12: {
+		u32 groups = readU32(cmap + 12);
+		u32 low = 0;
+		u32 high = groups;
+		while (low < high) {
+			u32 middle = low + (high - low) / 2;
+			int group = cmap + 16 + static_cast<int>(middle) * 12;
+			if (group < 0 || group > size - 12) return 0;
+			u32 startCode = readU32(group);
+			u32 endCode = readU32(group + 4);
+			if ((u32)codepoint < startCode) high = middle;
+			else if ((u32)codepoint > endCode) low = middle + 1;
+			else return static_cast<int>(readU32(group + 8) + ((u32)codepoint - startCode));
+		}
+		return 0;
+	}
+	}
+	return 0;
+}
+
+void TrueTypeFont::horizontalMetrics(int glyph, int& advance, int& leftBearing) {
+	if (glyph < hMetricCount) {
+		advance = readU16(hmtx + glyph * 4);
+		leftBearing = readS16(hmtx + glyph * 4 + 2);
+	}
+	else {
+		// the last advance is repeated for the following glyphs
+		advance = readU16(hmtx + (hMetricCount - 1) * 4);
+		leftBearing = readS16(hmtx + hMetricCount * 4 + (glyph - hMetricCount) * 2);
+	}
+}
+
+bool TrueTypeFont::hasKerning() {
+	return kern != 0;
+}
+
+int TrueTypeFont::kernAdvance(int glyph1, int glyph2) {
+	if (kern == 0) return 0;
+	// only the first subtable is used, it has to be horizontal and of format 0
+	if (readU16(kern + 2) < 1 || readU16(kern + 8) != 1) return 0;
+	int pairCount = readU16(kern + 10);
+	int pairs = kern + 18;
+	u32 key = (static_cast<u32>(glyph1) << 16) | static_cast<u32>(glyph2);
+	int low = 0;
+	int high = pairCount;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		u32 pair = readU32(pairs + middle * 6);
+		if (key < pair) high = middle;
+		else if (key > pair) low = middle + 1;
+		else return readS16(pairs + middle * 6 + 4);
+	}
+	return 0;
+}
+
+// Returns -1 for glyphs without an outline
+int TrueTypeFont::glyphOffset(int glyph) {
+	if (glyph < 0 || glyph >= glyphCount) return -1;
+	u32 start, end;
+	if (locaFormat == 0) {
+		start = readU16(loca + glyph * 2) * 2u;
+		end = readU16(loca + glyph * 2 + 2) * 2u;
+	}
+	else {
+		start = readU32(loca + glyph * 4);
+		end = readU32(loca + glyph * 4 + 4);
+	}
+	if (start >= end || end > (u32)(size - glyf)) return -1;
+	return glyf + static_cast<int>(start);
+}
+
+void TrueTypeFont::bitmapBox(int glyph, float scale, int& x0, int& y0, int& x1, int& y1) {
+	int offset = glyphOffset(glyph);
+	if (offset < 0) {
+		x0 = y0 = x1 = y1 = 0;
+		return;
+	}
+	x0 = static_cast<int>(floorf(readS16(offset + 2) * scale));
+	y0 = static_cast<int>(floorf(-readS16(offset + 8) * scale));
+	x1 = static_cast<int>(ceilf(readS16(offset + 6) * scale));
+	y1 = static_cast<int>(ceilf(-readS16(offset + 4) * scale));
+}
+
+// transform maps (x, y) to (t[0] * x + t[2] * y + t[4], t[1] * x + t[3] * y + t[5])
+void TrueTypeFont::appendGlyph(int glyph, const float* transform, int depth, Outline& outline) {
+	int offset = glyphOffset(glyph);
+	if (offset < 0 || depth > maxDepth) return;
+	int contourCount = readS16(offset);
+
+	if (contourCount >= 0) {
+		int endPoints = offset + 10;
+		int pointCount = contourCount > 0 ? readU16(endPoints + (contourCount - 1) * 2) + 1 : 0;
+		int position = endPoints + contourCount * 2;
+		position += 2 + readU16(position);
+
+		std::vector<u8> flags(pointCount);
+		for (int i = 0; i < pointCount; ++i) {
+			u8 flag = readU8(position++);
+			flags[i] = flag;
+			if (flag & 8) {
+				for (int repeat = readU8(position++); repeat > 0 && i + 1 < pointCount; --repeat) flags[++i] = flag;
+			}
+		}
+
+		size_t first = outline.xs.size();
+		int value = 0;
+		for (int i = 0; i < pointCount; ++i) {
+			if (flags[i] & 2) value += (flags[i] & 16) ? readU8(position++) : -readU8(position++);
+			else if (!(flags[i] & 16)) {
+				value += readS16(position);
+				position += 2;
+			}
+			outline.xs.push_back(static_cast<float>(value));
+			outline.onCurve.push_back((flags[i] & 1) != 0);
+		}
+		value = 0;
+		for (int i = 0; i < pointCount; ++i) {
+			if (flags[i] & 4) value += (flags[i] & 32) ? readU8(position++) : -readU8(position++);
+			else if (!(flags[i] & 32)) {
+				value += readS16(position);
+				position += 2;
+			}
+			outline.ys.push_back(static_cast<float>(value));
+		}
+
+		for (size_t i = first; i < outline.xs.size(); ++i) {
+			float x = outline.xs[i];
+			float y = outline.ys[i];
+			outline.xs[i] = transform[0] * x + transform[2] * y + transform[4];
+			outline.ys[i] = transform[1] * x + transform[3] * y + transform[5];
+		}
+
+		int last = -1;
+		for (int contour = 0; contour < contourCount; ++contour) {
+			int end = readU16(endPoints + contour * 2);
+			// contours have to be in order
+			if (end <= last || end >= pointCount) break;
+			outline.ends.push_back(static_cast<int>(first) + end + 1);
+			last = end;
+		}
+		// points behind the last valid contour are dropped
+		size_t valid = first + last + 1;
+		outline.xs.resize(valid);
+		outline.ys.resize(valid);
+		outline.onCurve.resize(valid);
+		return;
+	}
+
+	int position = offset + 10;
+	u16 flags;
+	do {
+		flags = readU16(position);
+		int component = readU16(position + 2);
+		position += 4;
+		float dx = 0.0f, dy = 0.0f;
+		if (flags & 1) {
+			if (flags & 2) {
+				dx = readS16(position);
+				dy = readS16(position + 2);
+			}
+			position += 4;
+		}
+		else {
+			if (flags & 2) {
+				dx = static_cast<s8>(readU8(position));
+				dy = static_cast<s8>(readU8(position + 1));
+			}
+			position += 2;
+		}
+		// components which are placed by matching points are not moved
+		float m[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+		if (flags & 8) {
+			m[0] = m[3] = readS16(position) / 16384.0f;
+			position += 2;
+		}
+		else if (flags & 0x40) {
+			m[0] = readS16(position) / 16384.0f;
+			m[3] = readS16(position + 2) / 16384.0f;
+			position += 4;
+		}
+		else if (flags & 0x80) {
+			for (int i = 0; i < 4; ++i) m[i] = readS16(position + i * 2) / 16384.0f;
+			position += 8;
+		}
+		float combined[6];
+		combined[0] = transform[0] * m[0] + transform[2] * m[1];
+		combined[1] = transform[1] * m[0] + transform[3] * m[1];
+		combined[2] = transform[0] * m[2] + transform[2] * m[3];
+		combined[3] = transform[1] * m[2] + transform[3] * m[3];
+		combined[4] = transform[0] * dx + transform[2] * dy + transform[4];
+		combined[5] = transform[1] * dx + transform[3] * dy + transform[5];
+		appendGlyph(component, combined, depth + 1, outline);
+	} while (flags & 0x20);
+}
+
+void TrueTypeFont::rasterize(int glyph, float scale, u8* output, int width, int height, int stride) {
+	if (width <= 0 || height <= 0) return;
+	int x0, y0, x1, y1;
+	bitmapBox(glyph, scale, x0, y0, x1, y1);
+
+	Outline outline;
+	// font units grow upwards, pixels downwards
+	float transform[6] = {scale, 0.0f, 0.0f, -scale, static_cast<float>(-x0), static_cast<float>(-y0)};
+	appendGlyph(glyph, transform, 0, outline);
+
+	Rasterizer rasterizer(width, height);
+	int start = 0;
+	for (size_t contour = 0; contour < outline.ends.size(); ++contour) {
+		int end = outline.ends[contour];
+		int count = end - start;
+		if (count < 2) {
+			start = end;
+			continue;
+		}
+		// off curve points between two off curve points imply an on curve point in their middle
+		int first = start;
+		float startX, startY;
+		if (outline.onCurve[start]) {
+			startX = outline.xs[start];
+			startY = outline.ys[start];
+			first = start + 1;
+		}
+		else if (outline.onCurve[end - 1]) {
+			startX = outline.xs[end - 1];
+			startY = outline.ys[end - 1];
+			--end;
+		}
+		else {
+			startX = (outline.xs[start] + outline.xs[end - 1]) * 0.5f;
+			startY = (outline.ys[start] + outline.ys[end - 1]) * 0.5f;
+		}
+
+		float x = startX, y = startY;
+		float controlX = 0.0f, controlY = 0.0f;
+		bool control = false;
+		for (int i = first; i < end; ++i) {
+			float px = outline.xs[i];
+			float py = outline.ys[i];
+			if (outline.onCurve[i]) {
+				if (control) rasterizer.curve(x, y, controlX, controlY, px, py);
+				else rasterizer.line(x, y, px, py);
+				x = px;
+				y = py;
+				control = false;
+			}
+			else {
+				if (control) {
+					float middleX = (controlX + px) * 0.5f;
+					float middleY = (controlY + py) * 0.5f;
+					rasterizer.curve(x, y, controlX, controlY, middleX, middleY);
+					x = middleX;
+					y = middleY;
+				}
+				controlX = px;
+				controlY = py;
+				control = true;
+			}
+		}
+		if (control) rasterizer.curve(x, y, controlX, controlY, startX, startY);
+		else rasterizer.line(x, y, startX, startY);
+		start = outline.ends[contour];
+	}
+	rasterizer.write(output, stride);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+namespace Kore {
+	// Reads the outlines, metrics and kerning of TrueType fonts and rasterizes glyphs with anti-aliasing.
+	// Supports glyf outlines (simple and composite glyphs), the cmap formats 0, 4, 6 and 12 and kern tables of format 0.
+	// Every read is checked against the size of the data so that broken fonts can not read past it.
+	class TrueTypeFont {
+	public:
+		TrueTypeFont();
+		// data has to stay alive as long as the font, returns false when it is not a TrueType font
+		bool init(const u8* data, int size);
+
+		// Scales font units so that the font is height pixels high from its descent to its ascent
+		float scaleForPixelHeight(float height);
+		// in font units, descent is negative
+		void verticalMetrics(int& ascent, int& descent, int& lineGap);
+
+		// 0 is the glyph for missing characters
+		int glyphIndex(int codepoint);
+		// in font units
+		void horizontalMetrics(int glyph, int& advance, int& leftBearing);
+		bool hasKerning();
+		int kernAdvance(int glyph1, int glyph2);
+
+		// Pixel bounds of the glyph relative to its origin on the baseline, y grows downwards
+		void bitmapBox(int glyph, float scale, int& x0, int& y0, int& x1, int& y1);
+		// Draws the glyph into a width * height area of 8 bit coverage values, use the size of bitmapBox
+		void rasterize(int glyph, float scale, u8* output, int width, int height, int stride);
+
+	private:
+		struct Outline;
+
+		const u8* data;
+		int size;
+		int cmap;
+		int loca;
+		int glyf;
+		int hmtx;
+		int kern;
+		int locaFormat;
+		int glyphCount;
+		int hMetricCount;
+		int ascent;
+		int descent;
+		int lineGap;
+
+		int findTable(int font, const char* tag);
+		u8 readU8(int offset);
+		u16 readU16(int offset);
+		s16 readS16(int offset);
+		u32 readU32(int offset);
+		int glyphOffset(int glyph);
+		void appendGlyph(int glyph, const float* transform, int depth, Outline& outline);
+	};
+}
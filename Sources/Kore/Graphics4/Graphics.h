@@ -13,13 +13,19 @@ namespace Kore {
 		class PipelineState;
 		class TextureArray;
 
+		// Dynamic buffers are meant to be rewritten every frame. They only keep
+		// the range that was locked last, everything else is undefined after unlock.
+		enum Usage { StaticUsage, DynamicUsage };
+
 		class VertexBuffer : public VertexBufferImpl {
 		public:
-			VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate = 0);
+			VertexBuffer(int count, const VertexStructure& structure, int instanceDataStepRate = 0, Usage usage = StaticUsage);
 			virtual ~VertexBuffer();
 			float* lock();
 			float* lock(int start, int count);
 			void unlock();
+			// Only the first count vertices of the locked range were written
+			void unlock(int count);
 			int count();
 			int stride();
 			int _set(int offset = 0); // Do not call this directly, use Graphics::setVertexBuffers
@@ -27,7 +33,7 @@ namespace Kore {
 
 		class IndexBuffer : public IndexBufferImpl {
 		public:
-			IndexBuffer(int count);
+			IndexBuffer(int count, Usage usage = StaticUsage);
 			virtual ~IndexBuffer();
 			int* lock();
 			void unlock();
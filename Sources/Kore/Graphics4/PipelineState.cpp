@@ -45,3 +45,8 @@ Graphics4::PipelineState::PipelineState() {
 }
 
 Graphics4::PipelineState::~PipelineState() {}
+
+void Graphics4::compilePipelines(PipelineState** pipelines, int count) {
+	for (int i = 0; i < count; ++i) pipelines[i]->compileAsync();
+	for (int i = 0; i < count; ++i) pipelines[i]->waitUntilReady();
+}
@@ -52,8 +52,17 @@ namespace Kore {
 			bool conservativeRasterization;
 
 			void compile();
+			// Starts compiling without waiting for it where the backend can, use it instead of compile.
+			// Using a pipeline which is not ready yet waits for it.
+			void compileAsync();
+			bool isReady();
+			// Blocks until compileAsync is done, the calling thread helps with the compilation where the backend can
+			void waitUntilReady();
 			ConstantLocation getConstantLocation(const char* name);
 			TextureUnit getTextureUnit(const char* name);
 		};
+
+		// Compiles all pipelines at once and returns when every one of them is ready
+		void compilePipelines(PipelineState** pipelines, int count);
 	}
 }
@@ -33,6 +33,9 @@ namespace Kore {
 			void _setImage(TextureUnit unit);
 			u8* lock();
 			void unlock();
+			// Copies a rectangle of pixels with rows of stride bytes to x, y of the first slice.
+			// Only the rectangle is uploaded where the backend allows it.
+			void uploadRegion(int x, int y, int width, int height, u8* data, int stride);
 			void clear(int x, int y, int z, int width, int height, int depth, uint color);
 #if defined(KORE_IOS) || defined(KORE_MACOS)
 			void upload(u8* data, int stride);
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include "ConstantBufferRing.h"
+
+#include "ConstantBuffer.h"
+
+using namespace Kore;
+
+Graphics5::ConstantBufferRing::ConstantBufferRing(int bufferSize, int framesInFlight)
+    : bufferSize(bufferSize), framesInFlight(framesInFlight), frame(0), current(-1), position(0) {}
+
+Graphics5::ConstantBufferRing::~ConstantBufferRing() {
+	for (int i = 0; i < (int)pages.size(); ++i) delete pages[i].buffer;
+}
+
+Graphics5::ConstantBuffer* Graphics5::ConstantBufferRing::allocate(int size, int* offset) {
+	int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+	if (current < 0 || position + alignedSize > pages[current].size) {
+		current = findPage(alignedSize);
+		position = 0;
+	}
+
+	Page& page = pages[current];
+	page.frame = frame;
+	*offset = position;
+	position += alignedSize;
+	page.buffer->lock(*offset, size);
+	return page.buffer;
+}
+
+void Graphics5::ConstantBufferRing::nextFrame() {
+	// the current buffer stays in use, ranges behind the position belong to frames which are still in flight
+	++frame;
+}
+
+int Graphics5::ConstantBufferRing::bufferCount() {
+	return (int)pages.size();
+}
+
+int Graphics5::ConstantBufferRing::findPage(int size) {
+	for (int i = 0; i < (int)pages.size(); ++i) {
+		if (i != current && pages[i].size >= size && frame - pages[i].frame >= framesInFlight) return i;
+	}
+
+	// allocations which are larger than bufferSize get a buffer of their own
+	Page page;
+	page.size = size > bufferSize ? size : bufferSize;
+	page.buffer = new ConstantBuffer(page.size);
+	page.frame = frame;
+	pages.push_back(page);
+	return (int)pages.size() - 1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+namespace Kore {
+	namespace Graphics5 {
+		class ConstantBuffer;
+
+		// Hands out aligned ranges of a few large constant buffers so that draws do not need a constant buffer each.
+		// A range can be reused framesInFlight frames after the frame that allocated it.
+		class ConstantBufferRing {
+		public:
+			// Dynamic offsets have to be aligned to 256 bytes on Direct3D12 and on most Vulkan drivers
+			static const int alignment = 256;
+
+			ConstantBufferRing(int bufferSize = 64 * 1024, int framesInFlight = 3);
+			~ConstantBufferRing();
+			// Returns a buffer that is locked at the allocated range, offsets of its setters are relative to the range.
+			// Unlock it before passing it and offset to CommandList::setVertexConstantBuffer or setFragmentConstantBuffer.
+			ConstantBuffer* allocate(int size, int* offset);
+			// Call once per frame after the command lists of the frame were executed
+			void nextFrame();
+			int bufferCount();
+
+		private:
+			struct Page {
+				ConstantBuffer* buffer;
+				int size;
+				int frame;
+			};
+
+			int findPage(int size);
+
+			std::vector<Page> pages;
+			int bufferSize;
+			int framesInFlight;
+			int frame;
+			int current;
+			int position;
+		};
+	}
+}
@@ -40,3 +40,8 @@ Graphics5::PipelineState::PipelineState() {
 }
 
 Graphics5::PipelineState::~PipelineState() {}
+
+void Graphics5::compilePipelines(PipelineState** pipelines, int count) {
+	for (int i = 0; i < count; ++i) pipelines[i]->compileAsync();
+	for (int i = 0; i < count; ++i) pipelines[i]->waitUntilReady();
+}
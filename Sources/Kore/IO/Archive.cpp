@@ -0,0 +1,251 @@
+#include "pch.h"
+
+#include "Archive.h"
+
+#include "lz4/lz4.h"
+#include "lz4/xxhash.h"
+
+#include <Kore/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	const int maxMounted = 16;
+	Archive* mounted[maxMounted];
+	int mountedCount = 0;
+
+	u32 hashName(const char* name, int length) {
+		return XXH32(name, length, 0);
+	}
+}
+
+Archive::Archive() : entries(nullptr), names(nullptr), count(0) {
+	mutex.create();
+}
+
+Archive::Archive(const char* filename) : entries(nullptr), names(nullptr), count(0) {
+	mutex.create();
+	if (!open(filename)) {
+		log(Warning, "Could not open archive %s.", filename);
+	}
+}
+
+Archive::~Archive() {
+	close();
+	mutex.destroy();
+}
+
+bool Archive::open(const char* filename) {
+	close();
+	if (!file.open(filename)) return false;
+
+	u8 header[archiveHeaderSize];
+	if (file.read(header, archiveHeaderSize) != archiveHeaderSize || memcmp(header, "KPAK", 4) != 0 || Reader::readU32LE(header + 4) != archiveVersion) {
+		log(Warning, "%s is not a kpak archive.", filename);
+		file.close();
+		return false;
+	}
+	int entryCount = Reader::readS32LE(header + 8);
+	int namesSize = Reader::readS32LE(header + 12);
+	if (entryCount < 0 || namesSize < 0 || archiveHeaderSize + (s64)entryCount * archiveEntrySize + namesSize > file.size()) {
+		log(Warning, "Archive %s is truncated.", filename);
+		file.close();
+		return false;
+	}
+
+	entries = new ArchiveEntry[entryCount];
+	for (int i = 0; i < entryCount; ++i) {
+		u8 data[archiveEntrySize];
+		file.read(data, archiveEntrySize);
+		entries[i].nameHash = Reader::readU32LE(data + 0);
+		entries[i].nameOffset = Reader::readU32LE(data + 4);
+		entries[i].nameLength = Reader::readU32LE(data + 8);
+		entries[i].compression = Reader::readU32LE(data + 12);
+		entries[i].offset = Reader::readU32LE(data + 16);
+		entries[i].compressedSize = Reader::readU32LE(data + 20);
+		entries[i].size = Reader::readU32LE(data + 24);
+		entries[i].checksum = Reader::readU32LE(data + 28);
+	}
+	names = new char[namesSize + 1];
+	file.read(names, namesSize);
+	names[namesSize] = 0;
+	count = entryCount;
+
+	// Everything that read and find rely on is checked once here
+	for (int i = 0; i < entryCount; ++i) {
+		const ArchiveEntry& entry = entries[i];
+		bool valid = (u64)entry.nameOffset + entry.nameLength <= (u64)namesSize && names[entry.nameOffset + entry.nameLength] == 0;
+		valid = valid && (u64)entry.offset + entry.compressedSize <= (u64)file.size() && entry.size <= 0x7fffffff;
+		if (entry.compression == ArchiveStored) {
+			valid = valid && entry.compressedSize == entry.size;
+		}
+		else {
+			valid = valid && (entry.compression == ArchiveLZ4 || entry.compression == ArchiveLZ4HC);
+		}
+		if (!valid) {
+			log(Warning, "Archive %s has a broken entry.", filename);
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void Archive::close() {
+	file.close();
+	delete[] entries;
+	entries = nullptr;
+	delete[] names;
+	names = nullptr;
+	count = 0;
+}
+
+int Archive::entryCount() const {
+	return count;
+}
+
+const char* Archive::entryName(int index) const {
+	return &names[entries[index].nameOffset];
+}
+
+const ArchiveEntry& Archive::entry(int index) const {
+	return entries[index];
+}
+
+int Archive::find(const char* name) const {
+	int length = (int)strlen(name);
+	u32 hash = hashName(name, length);
+
+	int low = 0;
+	int high = count;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (entries[middle].nameHash < hash) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	for (int i = low; i < count && entries[i].nameHash == hash; ++i) {
+		if ((int)entries[i].nameLength == length && strcmp(&names[entries[i].nameOffset], name) == 0) return i;
+	}
+	return -1;
+}
+
+bool Archive::read(int index, void* data) {
+	const ArchiveEntry& entry = entries[index];
+	u8* compressed = entry.compression == ArchiveStored ? (u8*)data : (u8*)malloc(entry.compressedSize);
+
+	mutex.lock();
+	file.seek(entry.offset);
+	int read = file.read(compressed, entry.compressedSize);
+	mutex.unlock();
+
+	bool success = read == (int)entry.compressedSize;
+	if (success && entry.compression != ArchiveStored) {
+		// LZ4HC only differs from LZ4 when compressing
+		success = LZ4_decompress_safe((char*)compressed, (char*)data, entry.compressedSize, entry.size) == (int)entry.size;
+	}
+	if (compressed != data) free(compressed);
+
+	if (success && XXH32(data, entry.size, 0) != entry.checksum) {
+		success = false;
+	}
+	if (!success) log(Warning, "Archive entry %s is corrupt.", entryName(index));
+	return success;
+}
+
+ArchiveReader::ArchiveReader() : buffer(nullptr), bufferSize(0), position(0) {}
+
+ArchiveReader::ArchiveReader(Archive* archive, const char* name) : buffer(nullptr), bufferSize(0), position(0) {
+	open(archive, name);
+}
+
+ArchiveReader::~ArchiveReader() {
+	close();
+}
+
+bool ArchiveReader::open(const char* name) {
+	Archive* archive = findArchive(name);
+	return archive != nullptr && open(archive, name);
+}
+
+bool ArchiveReader::open(Archive* archive, const char* name) {
+	close();
+	int index = archive->find(name);
+	if (index < 0) return false;
+	bufferSize = archive->entry(index).size;
+	buffer = (u8*)malloc(bufferSize > 0 ? bufferSize : 1);
+	if (!archive->read(index, buffer)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool ArchiveReader::isOpen() const {
+	return buffer != nullptr;
+}
+
+void ArchiveReader::close() {
+	free(buffer);
+	buffer = nullptr;
+	bufferSize = 0;
+	position = 0;
+}
+
+int ArchiveReader::read(void* data, int size) {
+	int bytesAvailable = bufferSize - position;
+	if (size > bytesAvailable) size = bytesAvailable;
+	memcpy(data, buffer + position, size);
+	position += size;
+	return size;
+}
+
+// the entry is decompressed into memory anyway, so no copy is needed
+void* ArchiveReader::readAll() {
+	position = bufferSize;
+	return buffer;
+}
+
+int ArchiveReader::size() const {
+	return bufferSize;
+}
+
+int ArchiveReader::pos() const {
+	return position;
+}
+
+void ArchiveReader::seek(int pos) {
+	position = pos < 0 ? 0 : (pos > bufferSize ? bufferSize : pos);
+}
+
+void Kore::mountArchive(Archive* archive) {
+	if (mountedCount < maxMounted) {
+		mounted[mountedCount++] = archive;
+	}
+	else {
+		log(Warning, "Too many mounted archives.");
+	}
+}
+
+void Kore::unmountArchive(Archive* archive) {
+	for (int i = 0; i < mountedCount; ++i) {
+		if (mounted[i] == archive) {
+			for (int j = i + 1; j < mountedCount; ++j) mounted[j - 1] = mounted[j];
+			--mountedCount;
+			return;
+		}
+	}
+}
+
+Archive* Kore::findArchive(const char* name) {
+	for (int i = mountedCount - 1; i >= 0; --i) {
+		if (mounted[i]->find(name) >= 0) return mounted[i];
+	}
+	return nullptr;
+}
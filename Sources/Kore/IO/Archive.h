@@ -0,0 +1,84 @@
+#pragma once
+
+#include "FileReader.h"
+#include "Reader.h"
+
+#include <Kore/Threads/Mutex.h>
+
+namespace Kore {
+	// .kpak layout, all values little endian:
+	//   header   "KPAK", u32 version, u32 entry count, u32 size of the name block
+	//   entries  ArchiveEntry[entry count], sorted by nameHash
+	//   names    zero terminated paths using '/', referenced by nameOffset
+	//   data     the (compressed) file contents, referenced by offset
+	// nameHash and checksum are XXH32 with seed 0, the checksum covers the uncompressed data.
+	enum ArchiveCompression { ArchiveStored = 0, ArchiveLZ4 = 1, ArchiveLZ4HC = 2 };
+
+	const u32 archiveVersion = 1;
+	const int archiveHeaderSize = 16;
+	const int archiveEntrySize = 32;
+
+	struct ArchiveEntry {
+		u32 nameHash;
+		u32 nameOffset;
+		u32 nameLength;
+		u32 compression;
+		u32 offset;
+		u32 compressedSize;
+		u32 size;
+		u32 checksum;
+	};
+
+	class Archive {
+	public:
+		Archive();
+		Archive(const char* filename);
+		~Archive();
+		bool open(const char* filename);
+		void close();
+		int entryCount() const;
+		const char* entryName(int index) const;
+		// -1 when the archive does not contain the file
+		int find(const char* name) const;
+		const ArchiveEntry& entry(int index) const;
+		// Decompresses and verifies an entry into data which needs room for entry(index).size bytes.
+		// Can be called from several threads at once.
+		bool read(int index, void* data);
+
+	private:
+		FileReader file;
+		Mutex mutex;
+		ArchiveEntry* entries;
+		char* names;
+		int count;
+	};
+
+	class ArchiveReader : public Reader {
+	public:
+		ArchiveReader();
+		ArchiveReader(Archive* archive, const char* name);
+		~ArchiveReader();
+		// searches all mounted archives
+		bool open(const char* name);
+		bool open(Archive* archive, const char* name);
+		bool isOpen() const;
+		void close();
+		int read(void* data, int size) override;
+		void* readAll() override;
+		int size() const override;
+		int pos() const override;
+		void seek(int pos) override;
+
+	private:
+		u8* buffer;
+		int bufferSize;
+		int position;
+	};
+
+	// Mounted archives are searched by FileReader before the file system,
+	// archives mounted later take precedence.
+	void mountArchive(Archive* archive);
+	void unmountArchive(Archive* archive);
+	// the mounted archive which contains name or nullptr
+	Archive* findArchive(const char* name);
+}
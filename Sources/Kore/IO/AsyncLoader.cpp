@@ -0,0 +1,293 @@
+#include "pch.h"
+
+#include "AsyncLoader.h"
+#include "FileReader.h"
+
+#include <Kore/Audio1/Sound.h>
+#include <Kore/Audio1/SoundStream.h>
+#include <Kore/Graphics1/Image.h>
+#include <Kore/Log.h>
+#include <Kore/Threads/Event.h>
+#include <Kore/Threads/Mutex.h>
+#ifndef KORE_HTML5
+#include <Kore/Threads/Thread.h>
+#endif
+#ifdef KORE_G4
+#include <Kore/Graphics4/Texture.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace Kore;
+
+namespace {
+	struct Request : public LoadRequest {
+		char* filename;
+		int priority;
+		u32 sequence;
+		bool readable;
+		bool looping;
+		bool cancelled;
+		bool released;
+	};
+
+	Mutex mutex;
+	Event wakeUp;
+	std::vector<Request*> queue;
+	u32 sequence = 0;
+#ifndef KORE_HTML5
+	Thread** loaderThreads = nullptr;
+#endif
+	// 0 where there are no threads, update loads the requests then
+	int loaderThreadCount = 0;
+	volatile bool running = false;
+
+	bool before(Request* a, Request* b) {
+		if (a->priority != b->priority) return a->priority > b->priority;
+		return (int)(a->sequence - b->sequence) < 0;
+	}
+
+	// mutex has to be locked
+	Request* takeNext() {
+		if (queue.empty()) return nullptr;
+		size_t best = 0;
+		for (size_t i = 1; i < queue.size(); ++i) {
+			if (before(queue[i], queue[best])) best = i;
+		}
+		Request* request = queue[best];
+		queue[best] = queue.back();
+		queue.pop_back();
+		return request;
+	}
+
+	// mutex has to be locked
+	bool removeQueued(Request* request) {
+		for (size_t i = 0; i < queue.size(); ++i) {
+			if (queue[i] == request) {
+				queue[i] = queue.back();
+				queue.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void destroy(Request* request) {
+		free(request->filename);
+		delete request;
+	}
+
+	void discardResults(Request* request) {
+		delete request->image;
+		request->image = nullptr;
+		delete request->sound;
+		request->sound = nullptr;
+		delete request->stream;
+		request->stream = nullptr;
+		free(request->data);
+		request->data = nullptr;
+		request->size = 0;
+	}
+
+	bool isFloat(Graphics1::Image* image) {
+		return image->format == Graphics1::Image::RGBA128 || image->format == Graphics1::Image::RGBA64 || image->format == Graphics1::Image::A32 ||
+		       image->format == Graphics1::Image::A16;
+	}
+
+	bool load(Request* request) {
+		// the loading constructors treat missing files as fatal errors
+		FileReader reader;
+		if (!reader.open(request->filename)) return false;
+
+		switch (request->type) {
+		case LoadRequest::ImageRequest:
+			request->image = new Graphics1::Image(reader, request->filename, true);
+			return isFloat(request->image) ? request->image->hdrData != nullptr : request->image->data != nullptr;
+		case LoadRequest::SoundRequest:
+			reader.close();
+			request->sound = new Sound(request->filename);
+			return request->sound->left != nullptr;
+		case LoadRequest::SoundStreamRequest:
+			reader.close();
+			request->stream = new SoundStream(request->filename, request->looping);
+			return true;
+		case LoadRequest::DataRequest:
+			request->size = reader.size();
+			request->data = malloc(request->size > 0 ? request->size : 1);
+			return reader.read(request->data, request->size) == request->size;
+		}
+		return false;
+	}
+
+	// Returns false when no request was queued
+	bool loadNext() {
+		mutex.lock();
+		Request* request = takeNext();
+		if (request != nullptr) request->status = LoadRequest::Loading;
+		mutex.unlock();
+
+		if (request == nullptr) return false;
+
+		bool success = load(request);
+
+		mutex.lock();
+		if (request->released) {
+			discardResults(request);
+			destroy(request);
+		}
+		else if (request->cancelled) {
+			discardResults(request);
+			request->status = LoadRequest::Cancelled;
+		}
+		else {
+			if (!success) {
+				log(Warning, "Could not load %s.", request->filename);
+				discardResults(request);
+			}
+			request->status = success ? LoadRequest::Finished : LoadRequest::Failed;
+		}
+		mutex.unlock();
+		return true;
+	}
+
+#ifndef KORE_HTML5
+	void worker(void*) {
+		while (running) {
+			if (!loadNext()) wakeUp.tryToWait(0.1);
+		}
+	}
+#endif
+
+	LoadRequest* enqueue(LoadRequest::Type type, const char* filename, int priority, bool readable, bool looping) {
+		Request* request = new Request;
+		request->type = type;
+		request->status = LoadRequest::Queued;
+		request->image = nullptr;
+		request->sound = nullptr;
+		request->stream = nullptr;
+		request->data = nullptr;
+		request->size = 0;
+		request->filename = (char*)malloc(strlen(filename) + 1);
+		strcpy(request->filename, filename);
+		request->priority = priority;
+		request->readable = readable;
+		request->looping = looping;
+		request->cancelled = false;
+		request->released = false;
+
+		mutex.lock();
+		request->sequence = sequence++;
+		queue.push_back(request);
+		mutex.unlock();
+		wakeUp.signal();
+		return request;
+	}
+}
+
+void AsyncLoader::init(int threads) {
+	mutex.create();
+	wakeUp.create();
+	running = true;
+#ifdef KORE_HTML5
+	loaderThreadCount = 0;
+#else
+	loaderThreadCount = threads > 0 ? threads : 1;
+	loaderThreads = new Thread*[loaderThreadCount];
+	for (int i = 0; i < loaderThreadCount; ++i) {
+		loaderThreads[i] = createAndRunThread(worker, nullptr);
+	}
+#endif
+}
+
+void AsyncLoader::quit() {
+	running = false;
+	for (int i = 0; i < loaderThreadCount; ++i) {
+		wakeUp.signal();
+	}
+#ifndef KORE_HTML5
+	for (int i = 0; i < loaderThreadCount; ++i) {
+		if (loaderThreads[i] != nullptr) waitForThreadStopThenFree(loaderThreads[i]);
+	}
+	delete[] loaderThreads;
+	loaderThreads = nullptr;
+#endif
+	loaderThreadCount = 0;
+
+	for (size_t i = 0; i < queue.size(); ++i) {
+		queue[i]->status = LoadRequest::Cancelled;
+	}
+	queue.clear();
+	wakeUp.destroy();
+	mutex.destroy();
+}
+
+void AsyncLoader::update() {
+	if (running && loaderThreadCount == 0) loadNext();
+}
+
+LoadRequest* AsyncLoader::loadImage(const char* filename, int priority, bool readable) {
+	return enqueue(LoadRequest::ImageRequest, filename, priority, readable, false);
+}
+
+LoadRequest* AsyncLoader::loadSound(const char* filename, int priority) {
+	return enqueue(LoadRequest::SoundRequest, filename, priority, false, false);
+}
+
+LoadRequest* AsyncLoader::loadSoundStream(const char* filename, bool looping, int priority) {
+	return enqueue(LoadRequest::SoundStreamRequest, filename, priority, false, looping);
+}
+
+LoadRequest* AsyncLoader::loadData(const char* filename, int priority) {
+	return enqueue(LoadRequest::DataRequest, filename, priority, false, false);
+}
+
+void AsyncLoader::setPriority(LoadRequest* request, int priority) {
+	mutex.lock();
+	((Request*)request)->priority = priority;
+	mutex.unlock();
+}
+
+void AsyncLoader::cancel(LoadRequest* request) {
+	Request* r = (Request*)request;
+	mutex.lock();
+	if (removeQueued(r)) {
+		r->status = LoadRequest::Cancelled;
+	}
+	else if (r->status == LoadRequest::Loading) {
+		r->cancelled = true;
+	}
+	mutex.unlock();
+}
+
+void AsyncLoader::release(LoadRequest* request) {
+	Request* r = (Request*)request;
+	mutex.lock();
+	removeQueued(r);
+	if (r->status == LoadRequest::Loading) {
+		// the worker frees it when it is done
+		r->released = true;
+		r = nullptr;
+	}
+	mutex.unlock();
+	if (r != nullptr) destroy(r);
+}
+
+#ifdef KORE_G4
+Graphics4::Texture* AsyncLoader::createTexture(LoadRequest* request) {
+	Graphics1::Image* image = request->image;
+	if (request->status != LoadRequest::Finished || image == nullptr) return nullptr;
+	if (image->compression != Graphics1::ImageCompressionNone) {
+		log(Warning, "Compressed images can not be turned into textures asynchronously.");
+		return nullptr;
+	}
+	void* pixels = isFloat(image) ? (void*)image->hdrData : (void*)image->data;
+	Graphics4::Texture* texture = new Graphics4::Texture(pixels, image->width, image->height, image->format, ((Request*)request)->readable);
+	image->data = nullptr;
+	image->hdrData = nullptr;
+	delete image;
+	request->image = nullptr;
+	return texture;
+}
+#endif
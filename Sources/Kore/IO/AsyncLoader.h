@@ -0,0 +1,66 @@
+#pragma once
+
+namespace Kore {
+	struct Sound;
+	class SoundStream;
+
+	namespace Graphics1 {
+		class Image;
+	}
+
+#ifdef KORE_G4
+	namespace Graphics4 {
+		class Texture;
+	}
+#endif
+
+	class LoadRequest {
+	public:
+		enum Type { ImageRequest, SoundRequest, SoundStreamRequest, DataRequest };
+		enum Status { Queued, Loading, Finished, Failed, Cancelled };
+
+		Type type;
+		volatile Status status;
+		// Filled in once status is Finished, from then on the results belong to the caller
+		Graphics1::Image* image;
+		Sound* sound;
+		SoundStream* stream;
+		void* data;
+		int size;
+
+		bool done() const {
+			return status == Finished || status == Failed || status == Cancelled;
+		}
+
+	protected:
+		LoadRequest() {}
+	};
+
+	// Reads and decodes files on background threads. Requests with a higher priority
+	// are started first, requests of the same priority in the order they were made.
+	// Without threads (HTML5) the requests are loaded one per update call instead.
+	namespace AsyncLoader {
+		void init(int threads = 2);
+		void quit();
+		// Loads the next request on the calling thread where there are no loader threads, call it once per frame
+		void update();
+
+		LoadRequest* loadImage(const char* filename, int priority = 0, bool readable = false);
+		LoadRequest* loadSound(const char* filename, int priority = 0);
+		LoadRequest* loadSoundStream(const char* filename, bool looping, int priority = 0);
+		// the raw file contents, free with free()
+		LoadRequest* loadData(const char* filename, int priority = 0);
+
+		void setPriority(LoadRequest* request, int priority);
+		// Queued requests are dropped, results of requests which are already loading are thrown away
+		void cancel(LoadRequest* request);
+		// Frees the request (but not the results it handed out), can be called at any time
+		void release(LoadRequest* request);
+
+#ifdef KORE_G4
+		// Turns a finished image into a texture on the calling thread, the image's pixels move into the texture
+		// and the image is deleted. Block compressed images are not supported.
+		Graphics4::Texture* createTexture(LoadRequest* request);
+#endif
+	}
+}
@@ -13,6 +13,8 @@ typedef __sFILE FILE;
 #endif
 
 namespace Kore {
+	class ArchiveReader;
+
 #ifdef KORE_ANDROID
 	struct FileReaderData {
 		int pos;
@@ -24,6 +26,11 @@ namespace Kore {
 	struct FileReaderData {
 		void* file;
 		int size;
+#ifdef KORE_POSIX
+		// the whole file when it could be memory mapped, file is nullptr then
+		u8* mapping;
+		int pos;
+#endif
 	};
 #endif
 
@@ -44,6 +51,8 @@ namespace Kore {
 
 		FileReaderData data;
 		void* readdata;
+		// set when the file was found in a mounted archive
+		ArchiveReader* archived;
 	};
 
 	void setFilesLocation(char* dir);
@@ -1,10 +1,12 @@
 #include "pch.h"
 
+#include "Archive.h"
 #include "FileReader.h"
 
 #include <Kore/Error.h>
 #include <Kore/Log.h>
 #include <Kore/Math/Core.h>
+#include <Kore/Profiler.h>
 #include <Kore/System.h>
 #ifdef KORE_ANDROID
 #include <Kore/Android.h>
@@ -46,6 +48,14 @@ const char* macgetresourcepath();
 #define KORE_LINUX
 #endif
 
+#if defined(KORE_POSIX) && !defined(KORE_ANDROID)
+#define KORE_FILEREADER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace Kore;
 
 namespace {
@@ -68,7 +78,7 @@ void initAndroidFileReader() {
 }
 #endif
 
-FileReader::FileReader() : readdata(nullptr) {
+FileReader::FileReader() : readdata(nullptr), archived(nullptr) {
 #ifdef KORE_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -78,9 +88,13 @@ FileReader::FileReader() : readdata(nullptr) {
 	data.file = nullptr;
 	data.size = 0;
 #endif
+#ifdef KORE_FILEREADER_MMAP
+	data.mapping = nullptr;
+	data.pos = 0;
+#endif
 }
 
-FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr) {
+FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr), archived(nullptr) {
 #ifdef KORE_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -89,14 +103,37 @@ FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr)
 #else
 	data.file = nullptr;
 	data.size = 0;
+#endif
+#ifdef KORE_FILEREADER_MMAP
+	data.mapping = nullptr;
+	data.pos = 0;
 #endif
 	if (!open(filename, type)) {
 		error("Could not open file %s.", filename);
 	}
 }
 
+namespace {
+	ArchiveReader* openArchived(const char* filename, FileReader::FileType type) {
+		if (type != FileReader::Asset) return nullptr;
+		Archive* archive = findArchive(filename);
+		if (archive == nullptr) return nullptr;
+		ArchiveReader* reader = new ArchiveReader(archive, filename);
+		if (!reader->isOpen()) {
+			delete reader;
+			return nullptr;
+		}
+		return reader;
+	}
+}
+
 #ifdef KORE_ANDROID
 bool FileReader::open(const char* filename, FileType type) {
+	archived = openArchived(filename, type);
+	if (archived != nullptr) {
+		data.size = archived->size();
+		return true;
+	}
 	data.pos = 0;
 	if (type == Save) {
 		char filepath[1001];
@@ -139,6 +176,12 @@ bool FileReader::open(const char* filename, FileType type) {
 
 #ifndef KORE_ANDROID
 bool FileReader::open(const char* filename, FileType type) {
+	archived = openArchived(filename, type);
+	if (archived != nullptr) {
+		data.size = archived->size();
+		return true;
+	}
+
 	char filepath[1001];
 #ifdef KORE_IOS
 	strcpy(filepath, type == Save ? System::savePath() : iphonegetresourcepath());
@@ -211,6 +254,26 @@ bool FileReader::open(const char* filename, FileType type) {
 		strcat(filepath, filename);
 	}
 
+#ifdef KORE_FILEREADER_MMAP
+	// read only mappings would break callers which modify the result of readAll,
+	// a private writable mapping only copies the pages they actually touch
+	int fd = ::open(filepath, O_RDONLY);
+	if (fd >= 0) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				::close(fd);
+				data.mapping = (u8*)mapping;
+				data.size = static_cast<int>(info.st_size);
+				data.pos = 0;
+				return true;
+			}
+		}
+		::close(fd);
+	}
+#endif
+
 	data.file = fopen(filepath, "rb");
 	if (data.file == nullptr) {
 		log(Warning, "Could not open file %s.", filepath);
@@ -224,6 +287,8 @@ bool FileReader::open(const char* filename, FileType type) {
 #endif
 
 int FileReader::read(void* data, int size) {
+	KORE_PROFILE_ZONE("FileReader::read");
+	if (archived != nullptr) return archived->read(data, size);
 #ifdef KORE_ANDROID
 	if (this->data.file != nullptr) {
 		return static_cast<int>(fread(data, 1, size, this->data.file));
@@ -234,11 +299,27 @@ int FileReader::read(void* data, int size) {
 		return read;
 	}
 #else
+#ifdef KORE_FILEREADER_MMAP
+	if (this->data.mapping != nullptr) {
+		int count = Kore::min(size, this->data.size - this->data.pos);
+		if (count <= 0) return 0;
+		memcpy(data, this->data.mapping + this->data.pos, count);
+		this->data.pos += count;
+		return count;
+	}
+#endif
 	return static_cast<int>(fread(data, 1, size, (FILE*)this->data.file));
 #endif
 }
 
 void* FileReader::readAll() {
+	if (archived != nullptr) return archived->readAll();
+#ifdef KORE_FILEREADER_MMAP
+	if (data.mapping != nullptr) {
+		data.pos = data.size;
+		return data.mapping;
+	}
+#endif
 	seek(0);
 	free(readdata);
 	readdata = malloc(this->data.size);
@@ -247,6 +328,10 @@ void* FileReader::readAll() {
 }
 
 void FileReader::seek(int pos) {
+	if (archived != nullptr) {
+		archived->seek(pos);
+		return;
+	}
 #ifdef KORE_ANDROID
 	if (data.file != nullptr) {
 		fseek(data.file, pos, SEEK_SET);
@@ -256,11 +341,22 @@ void FileReader::seek(int pos) {
 		data.pos = pos;
 	}
 #else
+#ifdef KORE_FILEREADER_MMAP
+	if (data.mapping != nullptr) {
+		data.pos = Kore::max(0, Kore::min(pos, data.size));
+		return;
+	}
+#endif
 	fseek((FILE*)data.file, pos, SEEK_SET);
 #endif
 }
 
 void FileReader::close() {
+	if (archived != nullptr) {
+		delete archived;
+		archived = nullptr;
+		return;
+	}
 #ifdef KORE_ANDROID
 	if (data.file != nullptr) {
 		fclose(data.file);
@@ -271,6 +367,14 @@ void FileReader::close() {
 		data.asset = nullptr;
 	}
 #else
+#ifdef KORE_FILEREADER_MMAP
+	if (data.mapping != nullptr) {
+		munmap(data.mapping, data.size);
+		data.mapping = nullptr;
+		data.pos = 0;
+		return;
+	}
+#endif
 	if (data.file == nullptr) return;
 	fclose((FILE*)data.file);
 	data.file = nullptr;
@@ -284,12 +388,16 @@ FileReader::~FileReader() {
 }
 
 int FileReader::pos() const {
+	if (archived != nullptr) return archived->pos();
 #ifdef KORE_ANDROID
 	if (data.file != nullptr)
 		return static_cast<int>(ftell(data.file));
 	else
 		return data.pos;
 #else
+#ifdef KORE_FILEREADER_MMAP
+	if (data.mapping != nullptr) return data.pos;
+#endif
 	return static_cast<int>(ftell((FILE*)data.file));
 #endif
 }
@@ -6,28 +6,80 @@
 #include <cassert>
 #include <cstring>
 
+#include <Kore/IO/lz4/lz4.h>
+#include <Kore/Log.h>
+#include <Kore/Math/Core.h>
 #include <Kore/System.h>
 
 using namespace Kore;
 
 namespace {
-	const u32 PROTOCOL_ID = 1346655563;
+	// changes with the header layout so that peers of older versions are ignored
+	const u32 PROTOCOL_ID = 1346655794;
+	const u32 PROTOCOL_MASK = 0xFFFFFF00; // the low bits are flags
 	const u32 REC_NR_WINDOW = ((u32)-1) / 4;
-	const int HEADER_SIZE = 12;
+	const int HEADER_SIZE = 16; // identifier, reliable ack, sequence number, selective acks
+	const int CACHE_HEADER = 16;
+	const int FRAGMENT_HEADER = 8; // message size, offset
+	const u32 FRAGMENT_FLAG = 4;
+	const u32 COMPRESSED_FLAG = 8;
+	const u32 BUNDLE_FLAG = 16;
+	// flags of a bundle entry, they are stored in the low bits of its length prefix
+	const u32 ENTRY_CONTROL = 1;
+	const u32 ENTRY_COMPRESSED = 2;
+	const int MAX_PREFIX = 5;
 	const double PNG_SMOOTHING = 0.1; // png = (value * old) + (1 - value) * new
+	const double MIN_RESEND = 0.01;
+	const int BATCH_SIZE = 32;
+
+	u32 hashPeer(unsigned address, int port) {
+		u32 hash = (address ^ ((u32)port << 16) ^ (u32)port) * 2654435761u;
+		return hash ^ (hash >> 15);
+	}
+
+	u8* reserve(u8*& buffer, int& capacity, int size) {
+		if (capacity < size) {
+			delete[] buffer;
+			buffer = new u8[size];
+			capacity = size;
+		}
+		return buffer;
+	}
+
+	// 7 bits per byte, the high bit marks that more bytes follow
+	int writePrefix(u8* output, u32 value) {
+		int size = 0;
+		while (value >= 0x80) {
+			output[size++] = (u8)(value | 0x80);
+			value >>= 7;
+		}
+		output[size++] = (u8)value;
+		return size;
+	}
 }
 
 Connection::Connection(int receivePort, int maxConns, double timeout, double pngInterv, double resndInterv, double congestPing, float congestShare,
                        int buffSize, int cacheCount)
     : recPort(receivePort), maxConns(maxConns), timeout(timeout), pngInterv(pngInterv), resndInterv(resndInterv), congestPing(congestPing),
-      congestShare(congestShare), buffSize(buffSize), cacheCount(cacheCount), activeConns(0), acceptConns(false) {
+      congestShare(congestShare), buffSize(buffSize), cacheCount(cacheCount), activeConns(0), maxMessageSize(1024 * 1024), acceptConns(false),
+      coalescing(false) {
 
 	socket.init();
 	socket.open(receivePort);
 
 	sndBuff = new u8[buffSize];
-	sndCache = new u8[(buffSize + 12) * cacheCount];
-	recBuff = new u8[buffSize];
+
+	recBatch = new Socket::Datagram[BATCH_SIZE];
+	recBatchBuffers = new u8[buffSize * BATCH_SIZE];
+	sndBatch = new Socket::Datagram[BATCH_SIZE];
+	sndBatchBuffers = new u8[buffSize * BATCH_SIZE];
+	for (int i = 0; i < BATCH_SIZE; ++i) {
+		recBatch[i].data = recBatchBuffers + i * buffSize;
+		sndBatch[i].data = sndBatchBuffers + i * buffSize;
+	}
+	recBatchCount = recBatchPos = 0;
+	sndBatchCount = 0;
+	recBuff = recBatchBuffers;
 
 	states = new State[maxConns];
 	pings = new double[maxConns];
@@ -42,9 +94,45 @@ Connection::Connection(int receivePort, int maxConns, double timeout, double png
 	lastRecNrsRel = new u32[maxConns];
 	lastRecNrsURel = new u32[maxConns];
 	congestBits = new u32[maxConns];
-	recCaches = new u8[(buffSize + 12) * cacheCount * maxConns];
-
+	congestSamples = new int[maxConns];
+	recSackBits = new u32[maxConns];
+	ackDue = new bool[maxConns];
+	sndCache = new u8[(buffSize + CACHE_HEADER) * cacheCount * maxConns];
+	recCaches = new u8[(buffSize + CACHE_HEADER) * cacheCount * maxConns];
+	deliverId = -1;
+	// recSackBits has 32 bits and lastRecNrsRel + 1 is never buffered
+	recWindow = cacheCount - 1 < 32 ? cacheCount - 1 : 32;
+	backlogs = new std::vector<u8>[maxConns];
+	backlogPositions = new int[maxConns];
+	assemblies = new u8*[maxConns];
+	assemblyCapacities = new int[maxConns];
+	assemblySizes = new int[maxConns];
+	for (int id = 0; id < maxConns; ++id) {
+		assemblies[id] = nullptr;
+		assemblyCapacities[id] = 0;
+	}
+	inflated = compressed = nullptr;
+	inflatedCapacity = compressedCapacity = 0;
+	bundles = new u8[buffSize * 2 * maxConns];
+	bundleSizes = new int[2 * maxConns];
+	bundleRead = bundleEnd = nullptr;
+	bundleId = -1;
+
+	// at most half of the buckets are used
+	int buckets = 2;
+	while (buckets < maxConns * 2) buckets *= 2;
+	lookup = new int[buckets];
+	lookupMask = buckets - 1;
+	for (int bucket = 0; bucket < buckets; ++bucket) lookup[bucket] = -1;
+
+	activeIds = new int[maxConns];
+	activeSlots = new int[maxConns];
+	freeIds = new int[maxConns];
+	freeCount = maxConns;
 	for (int id = 0; id < maxConns; ++id) {
+		// the lowest ids are handed out first
+		freeIds[id] = maxConns - 1 - id;
+		activeSlots[id] = -1;
 		reset(id, false);
 	}
 	// TODO: There is a synchronization issue if a new client connects before the last connection has timed out
@@ -53,8 +141,21 @@ Connection::Connection(int receivePort, int maxConns, double timeout, double png
 Connection::~Connection() {
 	delete[] sndBuff;
 	delete[] sndCache;
-	delete[] recBuff;
+	delete[] recBatch;
+	delete[] recBatchBuffers;
+	delete[] sndBatch;
+	delete[] sndBatchBuffers;
 	delete[] recCaches;
+	delete[] backlogs;
+	delete[] backlogPositions;
+	for (int id = 0; id < maxConns; ++id) delete[] assemblies[id];
+	delete[] assemblies;
+	delete[] assemblyCapacities;
+	delete[] assemblySizes;
+	delete[] inflated;
+	delete[] compressed;
+	delete[] bundles;
+	delete[] bundleSizes;
 
 	delete[] states;
 	delete[] pings;
@@ -67,16 +168,61 @@ Connection::~Connection() {
 	delete[] lastRecNrsRel;
 	delete[] lastRecNrsURel;
 	delete[] congestBits;
+	delete[] congestSamples;
+	delete[] recSackBits;
+	delete[] ackDue;
 	delete[] lastRecs;
+	delete[] lookup;
+	delete[] activeIds;
+	delete[] activeSlots;
+	delete[] freeIds;
 }
 
 int Connection::getID(unsigned int recAddr, unsigned int recPort) {
-	for (int id = 0; id < maxConns; ++id) {
-		if (connAdds[id] == recAddr && connPorts[id] == recPort) {
-			return id;
+	for (int bucket = hashPeer(recAddr, recPort) & lookupMask;; bucket = (bucket + 1) & lookupMask) {
+		int id = lookup[bucket];
+		if (id < 0) return -1;
+		if (connAdds[id] == recAddr && connPorts[id] == (int)recPort) return id;
+	}
+}
+
+int Connection::addConnection(unsigned address, int port) {
+	int id = getID(address, port);
+	if (id >= 0) return id;
+	if (freeCount == 0) return -1;
+
+	id = freeIds[--freeCount];
+	states[id] = Connecting;
+	connAdds[id] = address;
+	connPorts[id] = port;
+
+	int bucket = hashPeer(address, port) & lookupMask;
+	while (lookup[bucket] >= 0) bucket = (bucket + 1) & lookupMask;
+	lookup[bucket] = id;
+
+	activeSlots[id] = activeConns;
+	activeIds[activeConns] = id;
+	activeConns++;
+
+	lastRecs[id] = System::time(); // Prevent premature timeout
+	lastPng = 0;                   // Force ping immediately
+	return id;
+}
+
+void Connection::removeID(int id) {
+	int hole = hashPeer(connAdds[id], connPorts[id]) & lookupMask;
+	while (lookup[hole] != id) hole = (hole + 1) & lookupMask;
+
+	// Move following entries back into the hole unless that would place them before their home bucket
+	for (int bucket = (hole + 1) & lookupMask; lookup[bucket] >= 0; bucket = (bucket + 1) & lookupMask) {
+		int other = lookup[bucket];
+		int home = hashPeer(connAdds[other], connPorts[other]) & lookupMask;
+		if (((bucket - home) & lookupMask) >= ((bucket - hole) & lookupMask)) {
+			lookup[hole] = other;
+			hole = bucket;
 		}
 	}
-	return -1;
+	lookup[hole] = -1;
 }
 
 inline bool Connection::checkSeqNr(u32 next, u32 last) {
@@ -88,20 +234,7 @@ void Connection::listen() {
 }
 
 void Connection::connect(unsigned address, int port) {
-	for (int id = 0; id < maxConns; ++id) {
-		if (states[id] == Disconnected) {
-
-			states[id] = Connecting;
-			connAdds[id] = address;
-			connPorts[id] = port;
-
-			lastRecs[id] = System::time(); // Prevent premature timeout
-			lastPng = 0;                   // Force ping immediately
-			activeConns++;
-
-			return;
-		}
-	}
+	if (addConnection(address, port) >= 0) return;
 
 	// All connection slots used?
 	// Just returning a bool value could be seen as misleading since connect == true would not mean that an end point has been reached
@@ -112,52 +245,261 @@ void Connection::connect(const char* url, int port) {
 	connect(socket.urlToInt(url, port), port);
 }
 
-void Connection::send(const u8* data, int size, int connId, bool reliable) {
-	sendPacket(data, size, connId, reliable, false);
+void Connection::send(const u8* data, int size, int connId, bool reliable, bool compress) {
+	if (size > maxMessageSize) {
+		log(Warning, "Not sending a message of %i bytes, maxMessageSize is %i", size, maxMessageSize);
+		return;
+	}
+
+	u32 flags = reliable;
+	if (compress) {
+		// original size, LZ4 block
+		int bound = LZ4_compressBound(size);
+		reserve(compressed, compressedCapacity, 4 + bound);
+		int compressedSize = LZ4_compress_default((const char*)data, (char*)compressed + 4, size, bound);
+		if (compressedSize > 0 && 4 + compressedSize < size) {
+			*((u32*)compressed) = size;
+			data = compressed;
+			size = 4 + compressedSize;
+			flags |= COMPRESSED_FLAG;
+		}
+	}
+
+	if (coalescing && HEADER_SIZE + MAX_PREFIX + size <= buffSize) {
+		bundle(data, size, connId, reliable, (flags & COMPRESSED_FLAG) ? ENTRY_COMPRESSED : 0);
+		return;
+	}
+
+	if (coalescing && reliable) {
+		// Keep the order of reliable messages
+		if (connId >= 0) {
+			flushBundle(connId, true);
+		}
+		else {
+			for (int i = 0; i < activeConns; ++i) {
+				flushBundle(activeIds[i], true);
+			}
+		}
+	}
+
+	if (size + HEADER_SIZE <= buffSize) {
+		memcpy(sndBuff + HEADER_SIZE, data, size);
+		sendBuffer(size, connId, flags, true);
+		return;
+	}
+
+	// Fragments of a reliable message arrive in order so the receiver can append them
+	if (!reliable) {
+		log(Warning, "Not sending an unreliable message of %i bytes, it does not fit into buffSize", size);
+		return;
+	}
+	int fragmentSize = buffSize - HEADER_SIZE - FRAGMENT_HEADER;
+	for (int offset = 0; offset < size; offset += fragmentSize) {
+		int chunk = Kore::min(fragmentSize, size - offset);
+		*((u32*)(sndBuff + HEADER_SIZE)) = size;
+		*((u32*)(sndBuff + HEADER_SIZE + 4)) = offset;
+		memcpy(sndBuff + HEADER_SIZE + FRAGMENT_HEADER, data + offset, chunk);
+		sendBuffer(FRAGMENT_HEADER + chunk, connId, flags | FRAGMENT_FLAG, false);
+	}
+	flushDatagrams();
 }
 
-void Connection::sendPacket(const u8* data, int size, int connId, bool reliable, bool control) {
+void Connection::sendPacket(const u8* data, int size, int connId, bool reliable, bool control, bool flush) {
 	assert(size + HEADER_SIZE <= buffSize);
 
+	if (coalescing) {
+		bundle(data, size, connId, reliable, control ? ENTRY_CONTROL : 0);
+		return;
+	}
+
 	memcpy(sndBuff + HEADER_SIZE, data, size);
+	sendBuffer(size, connId, reliable + 2 * control, flush);
+}
+
+void Connection::sendAck(int id) {
+	sndBuff[HEADER_SIZE] = Ack;
+	sendBuffer(1, id, 2, false);
+}
+
+void Connection::bundle(const u8* data, int size, int connId, bool reliable, u32 entryFlags) {
+	u8 prefix[MAX_PREFIX];
+	int prefixSize = writePrefix(prefix, ((u32)size << 2) | entryFlags);
+	int count = connId >= 0 ? 1 : activeConns;
+	for (int i = 0; i < count; ++i) {
+		int id = connId >= 0 ? connId : activeIds[i];
+		int& bundleSize = bundleSizes[id * 2 + reliable];
+		if (HEADER_SIZE + bundleSize + prefixSize + size > buffSize) flushBundle(id, reliable);
+		u8* entry = bundles + (id * 2 + reliable) * buffSize + bundleSize;
+		memcpy(entry, prefix, prefixSize);
+		memcpy(entry + prefixSize, data, size);
+		bundleSize += prefixSize + size;
+	}
+}
+
+void Connection::flushBundle(int id, bool reliable) {
+	int& bundleSize = bundleSizes[id * 2 + reliable];
+	if (bundleSize == 0) return;
+	memcpy(sndBuff + HEADER_SIZE, bundles + (id * 2 + reliable) * buffSize, bundleSize);
+	sendBuffer(bundleSize, id, reliable | BUNDLE_FLAG, false);
+	bundleSize = 0;
+}
+
+void Connection::setCoalescing(bool coalesce) {
+	if (coalescing && !coalesce) flush();
+	coalescing = coalesce;
+}
+
+void Connection::flush() {
+	for (int i = 0; i < activeConns; ++i) {
+		int id = activeIds[i];
+		flushBundle(id, false);
+		flushBundle(id, true);
+		if (ackDue[id]) sendAck(id);
+	}
+	flushDatagrams();
+}
+
+void Connection::sendBuffer(int size, int connId, u32 flags, bool flush) {
+	bool reliable = (flags & 1) != 0;
 
 	// Identifier
-	*((u32*)(sndBuff)) = (PROTOCOL_ID & 0xFFFFFFF0) + reliable + 2 * control;
+	*((u32*)(sndBuff)) = (PROTOCOL_ID & PROTOCOL_MASK) + flags;
 
 	if (connId >= 0) {
 		sendPreparedBuffer(size, reliable, connId);
 	}
 	else {
-		for (int id = 0; id < maxConns; ++id) {
-			if (states[id] == Disconnected) continue;
-
-			sendPreparedBuffer(size, reliable, id);
+		for (int i = 0; i < activeConns; ++i) {
+			sendPreparedBuffer(size, reliable, activeIds[i]);
 		}
 	}
+	if (flush) flushDatagrams();
 }
 
 void Connection::sendPreparedBuffer(int size, bool reliable, int id) {
+	// Wait when the peer did not acknowledge enough packets to free a slot of the send cache
+	if (reliable && (lastSndNrsRel[id] - lastAckNrsRel[id] >= (u32)cacheCount || backlogPositions[id] < (int)backlogs[id].size())) {
+		std::vector<u8>& backlog = backlogs[id];
+		int offset = (int)backlog.size();
+		backlog.resize(offset + 4 + HEADER_SIZE + size);
+		*((int*)&backlog[offset]) = HEADER_SIZE + size;
+		memcpy(&backlog[offset + 4], sndBuff, HEADER_SIZE + size);
+		return;
+	}
+	sendDatagram(size, reliable, id);
+}
+
+void Connection::sendBacklog(int id) {
+	std::vector<u8>& backlog = backlogs[id];
+	while (backlogPositions[id] < (int)backlog.size() && lastSndNrsRel[id] - lastAckNrsRel[id] < (u32)cacheCount) {
+		int size = *((int*)&backlog[backlogPositions[id]]);
+		memcpy(sndBuff, &backlog[backlogPositions[id] + 4], size);
+		backlogPositions[id] += 4 + size;
+		sendDatagram(size - HEADER_SIZE, true, id);
+	}
+	if (backlogPositions[id] == (int)backlog.size()) {
+		backlog.clear();
+		backlogPositions[id] = 0;
+	}
+}
+
+void Connection::sendDatagram(int size, bool reliable, int id) {
+	// Every connection gets its own copy as the header differs
+	u8* packet = queueDatagram(HEADER_SIZE + size, id);
+	memcpy(packet, sndBuff, HEADER_SIZE + size);
+
 	// Reliable ack
-	*((u32*)(sndBuff + 4)) = lastRecNrsRel[id];
+	*((u32*)(packet + 4)) = lastRecNrsRel[id];
+	*((u32*)(packet + 12)) = recSackBits[id];
+	ackDue[id] = false;
 	// Reliability via sequence numbers (wrap around via overflow)
 	if (reliable) {
-		*((u32*)(sndBuff + 8)) = ++lastSndNrsRel[id];
+		*((u32*)(packet + 8)) = ++lastSndNrsRel[id];
 		// Cache message for potential resend
-		*((double*)(sndCache + (lastSndNrsRel[id] % cacheCount) * buffSize)) = System::time();
-		*((int*)(sndCache + (lastSndNrsRel[id] % cacheCount) * buffSize + 8)) = HEADER_SIZE + size;
-		memcpy(sndCache + (lastSndNrsRel[id] % cacheCount) * buffSize + 12, sndBuff, HEADER_SIZE + size);
+		u8* slot = sndSlot(id, lastSndNrsRel[id]);
+		*((double*)slot) = System::time();
+		*((int*)(slot + 8)) = HEADER_SIZE + size;
+		*((u32*)(slot + 12)) = lastSndNrsRel[id];
+		memcpy(slot + CACHE_HEADER, packet, HEADER_SIZE + size);
 	}
 	else {
-		*((u32*)(sndBuff + 8)) = ++lastSndNrsURel[id];
+		*((u32*)(packet + 8)) = ++lastSndNrsURel[id];
 	}
 
 	// DEBUG ONLY: Introduce packet drop
 	// if (!reliable || lastSndNrRel % 2)
-	socket.send(connAdds[id], connPorts[id], sndBuff, HEADER_SIZE + size);
 }
 
-// Must be called regularily as it also keeps the connection alive
+// Cache entry of a sent reliable packet: send time, size (0 once it was selectively acknowledged), sequence number, packet
+u8* Connection::sndSlot(int id, u32 nr) {
+	return sndCache + (id * cacheCount + nr % cacheCount) * (buffSize + CACHE_HEADER);
+}
+
+// Cache entry of a reliable packet which arrived early: size, packet
+u8* Connection::recSlot(int id, u32 nr) {
+	return recCaches + (id * cacheCount + nr % cacheCount) * (buffSize + CACHE_HEADER);
+}
+
+void Connection::advanceReliable(int id) {
+	++lastRecNrsRel[id]; // Wrap around handled by overflow
+	if (recSackBits[id] & 1) deliverId = id;
+	recSackBits[id] >>= 1;
+}
+
+// Resends the packets whose timer ran out, the timeout follows the smoothed ping.
+// A congested connection waits twice as long and only gets its oldest packet resent per call.
+void Connection::resend(int id) {
+	double resendTime = pings[id] < 0 ? resndInterv : Kore::max(pings[id] * 2, MIN_RESEND);
+	int budget = cacheCount;
+	if (congests[id]) {
+		resendTime *= 2;
+		budget = 1;
+	}
+
+	u32 pending = lastSndNrsRel[id] - lastAckNrsRel[id]; // Wrap around handled by overflow
+	if (pending > (u32)cacheCount) pending = cacheCount;
+	for (u32 nr = lastSndNrsRel[id] - pending + 1; nr != lastSndNrsRel[id] + 1 && budget > 0; ++nr) {
+		u8* slot = sndSlot(id, nr);
+		int size = *((int*)(slot + 8));
+		if (*((u32*)(slot + 12)) != nr || size == 0) continue;
+		double* sndTime = (double*)slot;
+		if (System::time() - *sndTime > resendTime) {
+			u8* packet = queueDatagram(size, id);
+			memcpy(packet, slot + CACHE_HEADER, size);
+			*((u32*)(packet + 4)) = lastRecNrsRel[id];
+			*((u32*)(packet + 12)) = recSackBits[id];
+			ackDue[id] = false;
+			*sndTime = System::time();
+			--budget;
+		}
+	}
+}
+
+// Returns the buffer of a datagram to id which is sent by the next flushDatagrams
+u8* Connection::queueDatagram(int size, int id) {
+	if (sndBatchCount == BATCH_SIZE) flushDatagrams();
+	Socket::Datagram& datagram = sndBatch[sndBatchCount++];
+	datagram.size = size;
+	datagram.address = connAdds[id];
+	datagram.port = connPorts[id];
+	return datagram.data;
+}
+
+void Connection::flushDatagrams() {
+	if (sndBatchCount > 0) socket.send(sndBatch, sndBatchCount);
+	sndBatchCount = 0;
+}
+
 int Connection::receive(u8* data, int& id) {
+	int size;
+	const u8* message = receiveMessage(size, id);
+	if (message == nullptr) return 0;
+	memcpy(data, message, size);
+	return size;
+}
+
+// Must be called regularily as it also keeps the connection alive
+const u8* Connection::receiveMessage(int& messageSize, int& id) {
 	unsigned int recAddr;
 	unsigned int recPort;
 
@@ -173,68 +515,118 @@ int Connection::receive(u8* data, int& id) {
 		}
 	}
 
-	// Receive pending packets
-	{
-		int size = 0;
-		while ((size = socket.receive(recBuff, buffSize, recAddr, recPort)) > 0) {
-			assert(size < buffSize);
-
-			id = getID(recAddr, recPort);
-			// Unknown sender?
-			if (id < 0) {
-				if (acceptConns && activeConns < maxConns)
-					connect(recAddr, recPort);
-				else
-					continue;
+	// Receive pending packets, a batch can hold more messages than one call returns
+	for (;;) {
+		// Return the rest of a bundle first
+		if (bundleRead < bundleEnd) {
+			id = bundleId;
+			const u8* message = unbundle(messageSize);
+			if (message != nullptr) return message;
+		}
+
+		// Deliver a buffered packet when the one before it was delivered
+		if (deliverId >= 0) {
+			id = deliverId;
+			deliverId = -1;
+			recBuff = recSlot(id, lastRecNrsRel[id] + 1) + CACHE_HEADER;
+			int size = *((int*)(recBuff - CACHE_HEADER));
+			advanceReliable(id);
+			if ((recBuff[0] & 2) != 0) {
+				processControlMessage(id, recBuff + HEADER_SIZE, size - HEADER_SIZE);
+				continue;
 			}
+			const u8* message = processMessage(id, size, messageSize);
+			if (message != nullptr) return message;
+			continue;
+		}
+
+		if (recBatchPos == recBatchCount) {
+			recBatchPos = 0;
+			recBatchCount = socket.receive(recBatch, BATCH_SIZE, buffSize);
+			if (recBatchCount <= 0) {
+				recBatchCount = 0;
+				break;
+			}
+		}
 
-			u32 header = *((u32*)(recBuff));
-			// Check for prefix (stray packets)
-			if ((header & 0xFFFFFFF0) != (PROTOCOL_ID & 0xFFFFFFF0)) continue;
+		Socket::Datagram& datagram = recBatch[recBatchPos++];
+		recBuff = datagram.data;
+		int size = datagram.size;
+		recAddr = datagram.address;
+		recPort = datagram.port;
+		assert(size <= buffSize);
+		// a datagram without a complete header can not be processed
+		if (size < HEADER_SIZE) continue;
+
+		u32 header = *((u32*)(recBuff));
+		// Check for prefix (stray packets)
+		if ((header & PROTOCOL_MASK) != (PROTOCOL_ID & PROTOCOL_MASK)) continue;
+
+		id = getID(recAddr, recPort);
+		// Unknown sender?
+		if (id < 0) {
+			if (!acceptConns) continue;
+			id = addConnection(recAddr, recPort);
+			if (id < 0) continue;
+		}
 
-			states[id] = Connected;
-			lastRecs[id] = System::time();
+		states[id] = Connected;
+		lastRecs[id] = System::time();
 
-			bool reliable = (header & 1) != 0;
-			bool control = (header & 2) != 0;
+		bool reliable = (header & 1) != 0;
+		bool control = (header & 2) != 0;
 
-			u32 ackNrRel = *((u32*)(recBuff + 4));
-			if (checkSeqNr(ackNrRel, lastAckNrsRel[id])) { // Usage of range function is intentional as multiple packets can be acknowledged at the same time,
-				                                           // stepwise increment handled by client
-				lastAckNrsRel[id] = ackNrRel;
-			}
+		u32 ackNrRel = *((u32*)(recBuff + 4));
+		if (checkSeqNr(ackNrRel, lastAckNrsRel[id])) { // Usage of range function is intentional as multiple packets can be acknowledged at the same time,
+			                                           // stepwise increment handled by client
+			lastAckNrsRel[id] = ackNrRel;
+		}
+		// Packets which the peer buffered out of order are not resent
+		u32 nr = ackNrRel + 2;
+		for (u32 sack = *((u32*)(recBuff + 12)); sack != 0; sack >>= 1, ++nr) {
+			u8* slot = sndSlot(id, nr);
+			if ((sack & 1) && *((u32*)(slot + 12)) == nr) *((int*)(slot + 8)) = 0;
+		}
 
-			u32 recNr = *((u32*)(recBuff + 8));
-			if (reliable) {
-				if (recNr == lastRecNrsRel[id] + 1) { // Wrap around handled by overflow
-					lastRecNrsRel[id] = recNr;
-
-					// Process message
-					if (control) {
-						processControlMessage(id);
-					}
-					else {
-						// Leave loop and return to caller
-						return processMessage(size, data);
-					}
+		u32 recNr = *((u32*)(recBuff + 8));
+		if (reliable) {
+			// Duplicates are acknowledged again as the last acknowledgement might have been lost
+			ackDue[id] = true;
+			u32 distance = recNr - lastRecNrsRel[id]; // Wrap around handled by overflow
+			if (distance == 1) {
+				advanceReliable(id);
+
+				// Process message
+				if (control) {
+					processControlMessage(id, recBuff + HEADER_SIZE, size - HEADER_SIZE);
 				}
 				else {
-					// TODO (Currently naive resend of everything): Store new packets, request resend on missing ones, process pending if resend on old
+					// Leave loop and return to caller unless more fragments are missing
+					const u8* message = processMessage(id, size, messageSize);
+					if (message != nullptr) return message;
 				}
 			}
-			else {
-				// Ignore old packets, no resend
-				if (checkSeqNr(recNr, lastRecNrsURel[id])) {
-					lastRecNrsURel[id] = recNr;
-
-					// Process message
-					if (control) {
-						processControlMessage(id);
-					}
-					else {
-						// Leave loop and return to caller
-						return processMessage(size, data);
-					}
+			else if (distance > 1 && distance - 2 < (u32)recWindow) {
+				// Keep it until the missing packets before it were resent
+				u8* slot = recSlot(id, recNr);
+				*((int*)slot) = size;
+				memcpy(slot + CACHE_HEADER, recBuff, size);
+				recSackBits[id] |= 1u << (distance - 2);
+			}
+		}
+		else {
+			// Ignore old packets, no resend
+			if (checkSeqNr(recNr, lastRecNrsURel[id])) {
+				lastRecNrsURel[id] = recNr;
+
+				// Process message
+				if (control) {
+					processControlMessage(id, recBuff + HEADER_SIZE, size - HEADER_SIZE);
+				}
+				else {
+					// Leave loop and return to caller unless more fragments are missing
+					const u8* message = processMessage(id, size, messageSize);
+					if (message != nullptr) return message;
 				}
 			}
 		}
@@ -242,45 +634,50 @@ int Connection::receive(u8* data, int& id) {
 
 	// Connection maintenance
 	{
-		for (int id = 0; id < maxConns; ++id) {
-			if (states[id] == Disconnected) continue;
+		// Backwards because reset moves the last active connection into the slot of the removed one
+		for (int i = activeConns - 1; i >= 0; --i) {
+			int id = activeIds[i];
 
 			// Connection timeout?
 			if ((System::time() - lastRecs[id]) > timeout) {
 				reset(id, true);
 			}
-			// Trigger resend if last paket is overdue
-			else if (lastSndNrsRel[id] != lastAckNrsRel[id]) {
-				u8* cachedPacket = sndCache + ((lastAckNrsRel[id] + 1) % cacheCount) * buffSize;
-				double* sndTime = ((double*)cachedPacket);
-				if (System::time() - *sndTime > resndInterv) {
-					int size = *((int*)(cachedPacket + 8));
-					memcpy(sndBuff, cachedPacket + 12, size);
-					socket.send(connAdds[id], connPorts[id], sndBuff, size);
-					*sndTime += resndInterv;
-				}
+			else {
+				if (lastSndNrsRel[id] != lastAckNrsRel[id]) resend(id);
+				if (!backlogs[id].empty()) sendBacklog(id);
+				// Acknowledge explicitly if no resend carried the acknowledgement, flush does that when coalescing
+				if (ackDue[id] && !coalescing) sendAck(id);
 			}
 		}
+		flushDatagrams();
 	}
 
-	return 0;
+	return nullptr;
 }
 
-void Connection::processControlMessage(int id) {
-	ControlType controlType = (ControlType)recBuff[HEADER_SIZE];
+void Connection::processControlMessage(int id, const u8* message, int size) {
+	// Ping and pong carry their send time
+	if (size < 1 || ((message[0] == Ping || message[0] == Pong) && size < 9)) {
+		log(Warning, "Dropping a broken control message from connection %i", id);
+		return;
+	}
+	ControlType controlType = (ControlType)message[0];
 	switch (controlType) {
 	case Ping: {
 		// Send back as pong
 		u8 data[9];
 		data[0] = Pong;
-		*((double*)(data + 1)) = *((double*)(recBuff + HEADER_SIZE + 1));
+		*((double*)(data + 1)) = *((double*)(message + 1));
 
 		sendPacket(data, 9, id, false, true);
 		break;
 	}
+	case Ack:
+		// Acknowledgements are part of the header
+		break;
 	case Pong:
 		// Measure ping
-		double recPing = System::time() - *((double*)(recBuff + HEADER_SIZE + 1));
+		double recPing = System::time() - *((double*)(message + 1));
 		// Don't smooth first ping
 		if (pings[id] == -1)
 			pings[id] = recPing;
@@ -290,26 +687,110 @@ void Connection::processControlMessage(int id) {
 		// Congestion check
 		bool nowCongest = pings[id] > congestPing;
 		congestBits[id] = (congestBits[id] << 1) + nowCongest;
+		if (congestSamples[id] < 32) ++congestSamples[id];
 
 		// Method by Brian Kernighan
-		unsigned int set = congestBits[id];
-		unsigned int all;
-		for (all = 0; set; all++) {
-			set &= set - 1;
+		int congested = 0;
+		for (u32 set = congestBits[id]; set; set &= set - 1) {
+			++congested;
 		}
 
-		congests[id] = ((float)set) / all > congestShare;
+		congests[id] = ((float)congested) / congestSamples[id] > congestShare;
 
 		break;
 	}
 }
 
-int Connection::processMessage(int size, u8* returnBuffer) {
-	// Prepare output
-	int msgSize = size - HEADER_SIZE;
-	memcpy(returnBuffer, recBuff + HEADER_SIZE, msgSize);
+// Returns nullptr while fragments of the message are missing or when a bundle only contained control messages
+const u8* Connection::processMessage(int id, int size, int& messageSize) {
+	u32 header = *((u32*)(recBuff));
+	const u8* message = recBuff + HEADER_SIZE;
+	messageSize = size - HEADER_SIZE;
 
-	return msgSize;
+	if (header & FRAGMENT_FLAG) {
+		if ((header & 1) == 0 || messageSize <= FRAGMENT_HEADER) {
+			log(Warning, "Dropping a broken fragment from connection %i", id);
+			return nullptr;
+		}
+		int total = *((u32*)(message));
+		int offset = *((u32*)(message + 4));
+		int chunk = messageSize - FRAGMENT_HEADER;
+		if (total <= 0 || total > maxMessageSize) {
+			log(Warning, "Dropping a message of %i bytes from connection %i, maxMessageSize is %i", total, id, maxMessageSize);
+			return nullptr;
+		}
+		if (offset == 0) {
+			reserve(assemblies[id], assemblyCapacities[id], total);
+			assemblySizes[id] = 0;
+		}
+		if (offset != assemblySizes[id] || chunk > total - offset || total > assemblyCapacities[id]) {
+			log(Warning, "Dropping fragment of a message from connection %i", id);
+			return nullptr;
+		}
+		memcpy(assemblies[id] + offset, message + FRAGMENT_HEADER, chunk);
+		assemblySizes[id] += chunk;
+		if (assemblySizes[id] < total) return nullptr;
+		message = assemblies[id];
+		messageSize = total;
+	}
+
+	if (header & BUNDLE_FLAG) {
+		bundleRead = message;
+		bundleEnd = message + messageSize;
+		bundleId = id;
+		return unbundle(messageSize);
+	}
+
+	if (header & COMPRESSED_FLAG) return inflate(id, message, messageSize);
+	return message;
+}
+
+// Returns the next message of the received bundle, control messages in it are processed on the way
+const u8* Connection::unbundle(int& messageSize) {
+	while (bundleRead < bundleEnd) {
+		u32 prefix = 0;
+		for (int shift = 0; bundleRead < bundleEnd && shift < 7 * MAX_PREFIX; shift += 7) {
+			u8 value = *bundleRead++;
+			prefix |= (u32)(value & 0x7f) << shift;
+			if ((value & 0x80) == 0) break;
+		}
+		int size = prefix >> 2;
+		if (size > bundleEnd - bundleRead) {
+			log(Warning, "Dropping a broken bundle from connection %i", bundleId);
+			bundleRead = bundleEnd;
+			return nullptr;
+		}
+		const u8* entry = bundleRead;
+		bundleRead += size;
+
+		if (prefix & ENTRY_CONTROL) {
+			processControlMessage(bundleId, entry, size);
+			continue;
+		}
+		messageSize = size;
+		if (prefix & ENTRY_COMPRESSED) return inflate(bundleId, entry, messageSize);
+		return entry;
+	}
+	return nullptr;
+}
+
+const u8* Connection::inflate(int id, const u8* message, int& messageSize) {
+	if (messageSize < 4) {
+		log(Warning, "Dropping a broken compressed message from connection %i", id);
+		return nullptr;
+	}
+	int original = *((u32*)(message));
+	if (original <= 0 || original > maxMessageSize) {
+		log(Warning, "Dropping a message of %i bytes from connection %i, maxMessageSize is %i", original, id, maxMessageSize);
+		return nullptr;
+	}
+	reserve(inflated, inflatedCapacity, original);
+	if (LZ4_decompress_safe((const char*)message + 4, (char*)inflated, messageSize - 4, original) != original) {
+		log(Warning, "Could not decompress a message from connection %i", id);
+		return nullptr;
+	}
+	messageSize = original;
+	return inflated;
 }
 
 void Connection::reset(int id, bool decCount) {
@@ -319,13 +800,27 @@ void Connection::reset(int id, bool decCount) {
 	lastRecNrsRel[id] = 0;
 	lastRecNrsURel[id] = 0;
 	congestBits[id] = 0;
+	congestSamples[id] = 0;
+	recSackBits[id] = 0;
+	ackDue[id] = false;
+	if (deliverId == id) deliverId = -1;
+	backlogs[id].clear();
+	backlogPositions[id] = 0;
+	bundleSizes[id * 2] = bundleSizes[id * 2 + 1] = 0;
+	if (bundleId == id) bundleRead = bundleEnd;
+	assemblySizes[id] = 0;
 
 	states[id] = Disconnected;
 	pings[id] = -1;
 	lastRecs[id] = 0;
 	congests[id] = false;
 
-	if (decCount) {
-		--activeConns;
+	if (decCount && activeSlots[id] >= 0) {
+		removeID(id);
+		int last = activeIds[--activeConns];
+		activeIds[activeSlots[id]] = last;
+		activeSlots[last] = activeSlots[id];
+		activeSlots[id] = -1;
+		freeIds[freeCount++] = id;
 	}
 }
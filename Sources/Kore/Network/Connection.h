@@ -2,6 +2,8 @@
 
 #include <Kore/Network/Socket.h>
 
+#include <vector>
+
 namespace Kore {
 
 	class Connection {
@@ -14,6 +16,8 @@ namespace Kore {
 
 		int maxConns;
 		int activeConns;
+		// Larger messages are neither sent nor accepted, it bounds the memory a peer can make a connection allocate
+		int maxMessageSize;
 
 		// For each connected entity
 		State* states;
@@ -27,13 +31,23 @@ namespace Kore {
 		void listen();
 		void connect(unsigned address, int port);
 		void connect(const char* url, int port);
-		void send(const u8* data, int size, int connId = -1, bool reliable = true);
+		// Reliable messages which do not fit into buffSize are split into fragments, use a buffSize of about 1200 bytes for large messages.
+		// Compressed messages are packed with LZ4 when that makes them smaller.
+		void send(const u8* data, int size, int connId = -1, bool reliable = true, bool compress = false);
+		// data has to be large enough for the largest message that is received
 		int receive(u8* data, int& fromId);
+		// Like receive but returns the message without copying it or nullptr, it stays valid until the next receive call
+		const u8* receiveMessage(int& size, int& fromId);
+		// Packs the messages, pings and acknowledgements to a peer into as few datagrams as possible until flush is called.
+		// Call flush once per tick while it is enabled.
+		void setCoalescing(bool coalesce);
+		void flush();
 
 	private:
-		enum ControlType { Ping = 0, Pong = 1 };
+		enum ControlType { Ping = 0, Pong = 1, Ack = 2 };
 
 		bool acceptConns;
+		bool coalescing;
 		const int recPort;
 		Kore::Socket socket;
 
@@ -46,14 +60,62 @@ namespace Kore {
 		u32* lastAckNrsRel;
 		u32* lastRecNrsRel;
 		u32* lastRecNrsURel;
+		// one bit per pong, set when the ping was above congestPing
 		u32* congestBits;
+		// how many of the bits in congestBits are pongs, at most 32
+		int* congestSamples;
+		// bit i is set when the reliable packet lastRecNrsRel + 2 + i waits in recCaches
+		u32* recSackBits;
+		// a reliable packet was received and no packet carried the acknowledgement back yet
+		bool* ackDue;
+		u8* sndCache;
 		u8* recCaches;
+		// id whose next reliable packet is buffered and can be delivered, -1 if there is none
+		int deliverId;
+		// how far reliable packets can arrive ahead of the next expected one and still be buffered
+		int recWindow;
+		// reliable packets which wait for space in the send window: size, packet
+		std::vector<u8>* backlogs;
+		int* backlogPositions;
+		// fragments are reassembled in a buffer of each connection which is kept for the next large message
+		u8** assemblies;
+		int* assemblyCapacities;
+		int* assemblySizes;
+		u8* inflated;
+		int inflatedCapacity;
+		u8* compressed;
+		int compressedCapacity;
+		// messages which wait for flush, an unreliable and a reliable bundle of buffSize for each connection
+		u8* bundles;
+		int* bundleSizes;
+		// the rest of the received bundle which is returned by the next receive calls
+		const u8* bundleRead;
+		const u8* bundleEnd;
+		int bundleId;
+
+		// (address, port) -> id with linear probing, -1 marks empty buckets
+		int* lookup;
+		int lookupMask;
+		// ids which are not Disconnected, activeSlots[id] is the index of id in activeIds
+		int* activeIds;
+		int* activeSlots;
+		int* freeIds;
+		int freeCount;
 
 		int buffSize;
 		int cacheCount;
+		// the packet which is processed, it points into recBatchBuffers or recCaches
 		u8* recBuff;
 		u8* sndBuff;
-		u8* sndCache;
+
+		// Datagrams are received and sent in batches to save system calls
+		Socket::Datagram* recBatch;
+		u8* recBatchBuffers;
+		int recBatchCount;
+		int recBatchPos;
+		Socket::Datagram* sndBatch;
+		u8* sndBatchBuffers;
+		int sndBatchCount;
 
 		float congestShare;
 		double timeout;
@@ -63,11 +125,27 @@ namespace Kore {
 		double lastPng;
 
 		int getID(unsigned int recAddr, unsigned int recPort);
-		void sendPacket(const u8* data, int size, int connId, bool reliable, bool control);
+		int addConnection(unsigned address, int port);
+		void removeID(int id);
+		void sendPacket(const u8* data, int size, int connId, bool reliable, bool control, bool flush = true);
+		void sendBuffer(int size, int connId, u32 flags, bool flush);
 		void sendPreparedBuffer(int size, bool reliable, int id);
+		void sendDatagram(int size, bool reliable, int id);
+		void sendBacklog(int id);
+		void sendAck(int id);
+		void bundle(const u8* data, int size, int connId, bool reliable, u32 entryFlags);
+		void flushBundle(int id, bool reliable);
+		const u8* unbundle(int& messageSize);
+		const u8* inflate(int id, const u8* message, int& messageSize);
+		u8* sndSlot(int id, u32 nr);
+		u8* recSlot(int id, u32 nr);
+		void advanceReliable(int id);
+		void resend(int id);
+		u8* queueDatagram(int size, int id);
+		void flushDatagrams();
 		bool checkSeqNr(u32 next, u32 last);
-		void processControlMessage(int id);
-		int processMessage(int size, u8* returnBuffer);
+		void processControlMessage(int id, const u8* message, int size);
+		const u8* processMessage(int id, int size, int& messageSize);
 		void reset(int id, bool decCount);
 	};
 }
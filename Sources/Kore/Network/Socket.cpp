@@ -5,6 +5,7 @@
 #include <Kore/Log.h>
 
 #include <stdio.h>
+#include <string.h>
 
 #if defined(KORE_WINDOWS) || defined(KORE_WINDOWSAPP)
 #include <Ws2tcpip.h>
@@ -17,6 +18,10 @@
 #include <unistd.h>
 #endif
 
+#ifdef KORE_LINUX
+#include <errno.h>
+#endif
+
 using namespace Kore;
 
 namespace {
@@ -44,6 +49,11 @@ namespace {
 #endif
 	}
 #endif
+
+#ifdef KORE_LINUX
+	// datagrams per system call
+	const int maxBatch = 64;
+#endif
 }
 
 Socket::Socket() {}
@@ -216,3 +226,92 @@ int Socket::receive(u8* data, int maxSize, unsigned& fromAddress, unsigned& from
 	return 0;
 #endif
 }
+
+int Socket::send(const Datagram* datagrams, int count) {
+#ifdef KORE_LINUX
+	mmsghdr messages[maxBatch];
+	iovec vectors[maxBatch];
+	sockaddr_in addresses[maxBatch];
+	int sent = 0;
+	while (sent < count) {
+		int batch = count - sent < maxBatch ? count - sent : maxBatch;
+		for (int i = 0; i < batch; ++i) {
+			const Datagram& datagram = datagrams[sent + i];
+			addresses[i].sin_family = AF_INET;
+			addresses[i].sin_addr.s_addr = htonl(datagram.address);
+			addresses[i].sin_port = htons(datagram.port);
+			vectors[i].iov_base = datagram.data;
+			vectors[i].iov_len = datagram.size;
+			memset(&messages[i], 0, sizeof(messages[i]));
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		int result = sendmmsg(handle, messages, batch, 0);
+		if (result < 0 && errno == EINTR) continue;
+		if (result <= 0) {
+			log(Kore::Error, "Could not send packet.");
+			// Errors of the socket also hit the remaining datagrams, others only concern the failed datagram
+			if (result == 0 || errno == EBADF || errno == ENOTSOCK || errno == EFAULT || errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ||
+			    errno == ENOMEM) {
+				break;
+			}
+			result = 1;
+		}
+		sent += result;
+	}
+	return sent;
+#else
+	for (int i = 0; i < count; ++i) send(datagrams[i].address, datagrams[i].port, datagrams[i].data, datagrams[i].size);
+	return count;
+#endif
+}
+
+int Socket::receive(Datagram* datagrams, int count, int maxSize) {
+#ifdef KORE_LINUX
+	mmsghdr messages[maxBatch];
+	iovec vectors[maxBatch];
+	sockaddr_in addresses[maxBatch];
+	int received = 0;
+	while (received < count) {
+		int batch = count - received < maxBatch ? count - received : maxBatch;
+		for (int i = 0; i < batch; ++i) {
+			vectors[i].iov_base = datagrams[received + i].data;
+			vectors[i].iov_len = maxSize;
+			memset(&messages[i], 0, sizeof(messages[i]));
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		int result = recvmmsg(handle, messages, batch, MSG_DONTWAIT, nullptr);
+		if (result <= 0) {
+			if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) log(Kore::Error, "Could not receive packets.");
+			break;
+		}
+		for (int i = 0; i < result; ++i) {
+			Datagram& datagram = datagrams[received + i];
+			datagram.size = messages[i].msg_len;
+			datagram.address = ntohl(addresses[i].sin_addr.s_addr);
+			datagram.port = ntohs(addresses[i].sin_port);
+		}
+		received += result;
+		// the socket is drained
+		if (result < batch) break;
+	}
+	return received;
+#else
+	int received = 0;
+	while (received < count) {
+		Datagram& datagram = datagrams[received];
+		unsigned port;
+		int size = receive(datagram.data, maxSize, datagram.address, port);
+		if (size <= 0) break;
+		datagram.size = size;
+		datagram.port = port;
+		++received;
+	}
+	return received;
+#endif
+}
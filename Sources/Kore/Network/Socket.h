@@ -3,6 +3,14 @@
 namespace Kore {
 	class Socket {
 	public:
+		// One datagram of a batch, data is a buffer of the caller
+		struct Datagram {
+			u8* data;
+			int size;
+			unsigned address;
+			int port;
+		};
+
 		Socket();
 		~Socket();
 		void init();
@@ -13,6 +21,11 @@ namespace Kore {
 		void send(const char* url, int port, const unsigned char* data, int size);
 		int receive(unsigned char* data, int maxSize, unsigned& fromAddress, unsigned& fromPort);
 
+		// Batches use one system call for many datagrams on Linux (sendmmsg and recvmmsg) and one per datagram elsewhere.
+		// Both return how many datagrams were handled, received datagrams get their size, address and port set.
+		int send(const Datagram* datagrams, int count);
+		int receive(Datagram* datagrams, int count, int maxSize);
+
 	private:
 		int handle;
 	};
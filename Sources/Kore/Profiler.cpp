@@ -0,0 +1,308 @@
+#include "pch.h"
+
+#include "Profiler.h"
+
+#include <Kore/IO/FileWriter.h>
+#include <Kore/Log.h>
+#include <Kore/Threads/Atomic.h>
+
+#include <map>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Kore::ThreadLocal is not available in every system backend, HTML5 has none
+#if defined(_MSC_VER)
+#define KORE_THREAD_LOCAL __declspec(thread)
+#else
+#define KORE_THREAD_LOCAL __thread
+#endif
+
+using namespace Kore;
+
+bool Profiler::enabled = false;
+
+namespace {
+	const int maxThreads = 64;
+	const int maxDepth = 64;
+	// zones per thread, has to be a power of two
+	const unsigned capacity = 16384;
+
+	// Only the owning thread writes zones, other threads read completed zones up to written.
+	struct ThreadBuffer {
+		int id;
+		int depth;
+		const char* openNames[maxDepth];
+		System::ticks openStarts[maxDepth];
+		volatile unsigned written;
+		unsigned cleared;
+		Profiler::ZoneRecord records[capacity];
+	};
+
+	ThreadBuffer* buffers[maxThreads];
+	volatile int bufferCount = 0;
+	KORE_THREAD_LOCAL ThreadBuffer* currentBuffer = nullptr;
+
+	ThreadBuffer* threadBuffer() {
+		ThreadBuffer* buffer = currentBuffer;
+		if (buffer != nullptr) return buffer;
+
+		buffer = (ThreadBuffer*)calloc(1, sizeof(ThreadBuffer));
+		buffer->id = KORE_ATOMIC_INCREMENT(&bufferCount);
+		currentBuffer = buffer;
+		// zones of further threads are recorded but never read
+		if (buffer->id < maxThreads) {
+			buffers[buffer->id] = buffer;
+			KORE_MEMORY_BARRIER();
+		}
+		else if (buffer->id == maxThreads) {
+			log(Warning, "The profiler only records zones of %i threads.", maxThreads);
+		}
+		return buffer;
+	}
+
+	int threadCount() {
+		return bufferCount < maxThreads ? bufferCount : maxThreads;
+	}
+
+	// Copies the zones of a thread which were completed since the last clear
+	void snapshot(ThreadBuffer* buffer, std::vector<Profiler::ZoneRecord>& records) {
+		records.clear();
+		if (buffer == nullptr) return;
+		unsigned written = buffer->written;
+		KORE_MEMORY_BARRIER();
+		unsigned count = written - buffer->cleared;
+		if (count > capacity) count = capacity;
+		unsigned first = written - count;
+		records.resize(count);
+		for (unsigned i = 0; i < count; ++i) records[i] = buffer->records[(first + i) & (capacity - 1)];
+		KORE_MEMORY_BARRIER();
+		// drop zones which were overwritten while copying
+		unsigned after = buffer->written;
+		if (after - first > capacity) {
+			unsigned overwritten = after - first - capacity;
+			records.erase(records.begin(), records.begin() + (overwritten < count ? overwritten : count));
+		}
+	}
+
+	System::ticks firstTick() {
+		System::ticks first = 0;
+		bool found = false;
+		std::vector<Profiler::ZoneRecord> records;
+		for (int thread = 0; thread < threadCount(); ++thread) {
+			snapshot(buffers[thread], records);
+			for (size_t i = 0; i < records.size(); ++i) {
+				if (!found || records[i].start < first) first = records[i].start;
+				found = true;
+			}
+		}
+		return first;
+	}
+
+	// Buffers formatted text for a FileWriter
+	class TextOutput {
+	public:
+		TextOutput(FileWriter& writer) : writer(writer), size(0) {}
+
+		~TextOutput() {
+			flush();
+		}
+
+		void print(const char* format, ...) {
+			if (size > (int)sizeof(buffer) - 512) flush();
+			va_list args;
+			va_start(args, format);
+			int length = vsnprintf(buffer + size, sizeof(buffer) - size, format, args);
+			va_end(args);
+			if (length > 0) size += length < (int)sizeof(buffer) - size ? length : (int)sizeof(buffer) - size - 1;
+		}
+
+		void printEscaped(const char* text) {
+			for (const char* c = text; *c != 0; ++c) {
+				if (*c == '"' || *c == '\\') print("\\%c", *c);
+				else if ((unsigned char)*c < 0x20) print("\\u%04x", *c);
+				else print("%c", *c);
+			}
+		}
+
+		void flush() {
+			if (size > 0) writer.write(buffer, size);
+			size = 0;
+		}
+
+	private:
+		FileWriter& writer;
+		char buffer[4096];
+		int size;
+	};
+}
+
+void Profiler::setEnabled(bool enabled) {
+	Profiler::enabled = enabled;
+}
+
+bool Profiler::isEnabled() {
+	return enabled;
+}
+
+void Profiler::begin(const char* name) {
+	ThreadBuffer* buffer = threadBuffer();
+	if (buffer->depth < maxDepth) {
+		buffer->openNames[buffer->depth] = name;
+		buffer->openStarts[buffer->depth] = System::timestamp();
+	}
+	++buffer->depth;
+}
+
+void Profiler::end() {
+	ThreadBuffer* buffer = threadBuffer();
+	if (buffer->depth <= 0) return;
+	--buffer->depth;
+	if (buffer->depth >= maxDepth) return;
+	ZoneRecord& record = buffer->records[buffer->written & (capacity - 1)];
+	record.name = buffer->openNames[buffer->depth];
+	record.start = buffer->openStarts[buffer->depth];
+	record.end = System::timestamp();
+	record.depth = buffer->depth;
+	KORE_MEMORY_BARRIER();
+	buffer->written = buffer->written + 1;
+}
+
+void Profiler::clear() {
+	for (int thread = 0; thread < threadCount(); ++thread) {
+		if (buffers[thread] != nullptr) buffers[thread]->cleared = buffers[thread]->written;
+	}
+}
+
+bool Profiler::writeChromeTrace(const char* filename) {
+	FileWriter writer;
+	if (!writer.open(filename)) return false;
+
+	System::ticks first = firstTick();
+	double microseconds = 1000000.0 / System::frequency();
+	std::vector<ZoneRecord> records;
+	bool comma = false;
+	TextOutput out(writer);
+	out.print("{\"traceEvents\":[\n");
+	for (int thread = 0; thread < threadCount(); ++thread) {
+		snapshot(buffers[thread], records);
+		for (size_t i = 0; i < records.size(); ++i) {
+			out.print(comma ? ",\n{\"name\":\"" : "{\"name\":\"");
+			out.printEscaped(records[i].name);
+			out.print("\",\"ph\":\"X\",\"pid\":0,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}", thread, (records[i].start - first) * microseconds,
+			          (records[i].end - records[i].start) * microseconds);
+			comma = true;
+		}
+	}
+	out.print("\n],\"displayTimeUnit\":\"ms\"}\n");
+	return true;
+}
+
+// Layout in the byte order of the writing machine:
+// char magic[4] = "KPRF", int version = 1, double ticksPerSecond, int nameCount
+// nameCount times: int length, char name[length]
+// int recordCount
+// recordCount times: int nameIndex, short thread, short depth, unsigned long long start, unsigned long long end
+bool Profiler::writeBinary(const char* filename) {
+	FileWriter writer;
+	if (!writer.open(filename)) return false;
+
+	std::vector<ZoneRecord> records;
+	std::vector<short> threads;
+	for (int thread = 0; thread < threadCount(); ++thread) {
+		std::vector<ZoneRecord> threadRecords;
+		snapshot(buffers[thread], threadRecords);
+		records.insert(records.end(), threadRecords.begin(), threadRecords.end());
+		threads.insert(threads.end(), threadRecords.size(), (short)thread);
+	}
+
+	std::map<const char*, int> nameIndices;
+	std::vector<const char*> names;
+	for (size_t i = 0; i < records.size(); ++i) {
+		if (nameIndices.find(records[i].name) == nameIndices.end()) {
+			nameIndices[records[i].name] = (int)names.size();
+			names.push_back(records[i].name);
+		}
+	}
+
+	char magic[4] = {'K', 'P', 'R', 'F'};
+	int version = 1;
+	double ticksPerSecond = System::frequency();
+	int nameCount = (int)names.size();
+	writer.write(magic, 4);
+	writer.write(&version, sizeof(version));
+	writer.write(&ticksPerSecond, sizeof(ticksPerSecond));
+	writer.write(&nameCount, sizeof(nameCount));
+	for (int i = 0; i < nameCount; ++i) {
+		int length = (int)strlen(names[i]);
+		writer.write(&length, sizeof(length));
+		writer.write((void*)names[i], length);
+	}
+
+	int recordCount = (int)records.size();
+	writer.write(&recordCount, sizeof(recordCount));
+	for (int i = 0; i < recordCount; ++i) {
+		int nameIndex = nameIndices[records[i].name];
+		short depth = (short)records[i].depth;
+		unsigned long long start = records[i].start;
+		unsigned long long end = records[i].end;
+		writer.write(&nameIndex, sizeof(nameIndex));
+		writer.write(&threads[i], sizeof(short));
+		writer.write(&depth, sizeof(depth));
+		writer.write(&start, sizeof(start));
+		writer.write(&end, sizeof(end));
+	}
+	return true;
+}
+
+int Profiler::lastFrame(ZoneSummary* summaries, int maxSummaries, double* frameSeconds) {
+	if (frameSeconds != nullptr) *frameSeconds = 0.0;
+	std::vector<ZoneRecord> records;
+	snapshot(threadBuffer(), records);
+
+	// zones are recorded when they end so the zones of a frame directly precede its top level zone
+	int root = (int)records.size() - 1;
+	while (root >= 0 && records[root].depth != 0) --root;
+	if (root < 0) return 0;
+	int first = root;
+	while (first > 0 && records[first - 1].depth != 0) --first;
+
+	double seconds = 1.0 / System::frequency();
+	if (frameSeconds != nullptr) *frameSeconds = (records[root].end - records[root].start) * seconds;
+
+	std::vector<System::ticks> starts;
+	int count = 0;
+	for (int i = first; i <= root; ++i) {
+		int index = 0;
+		while (index < count && (summaries[index].name != records[i].name || summaries[index].depth != records[i].depth)) ++index;
+		if (index == count) {
+			if (count == maxSummaries) continue;
+			summaries[index].name = records[i].name;
+			summaries[index].depth = records[i].depth;
+			summaries[index].calls = 0;
+			summaries[index].seconds = 0.0;
+			starts.push_back(records[i].start);
+			++count;
+		}
+		++summaries[index].calls;
+		summaries[index].seconds += (records[i].end - records[i].start) * seconds;
+		if (records[i].start < starts[index]) starts[index] = records[i].start;
+	}
+
+	// insertion sort by start, parents start before their children
+	for (int i = 1; i < count; ++i) {
+		ZoneSummary summary = summaries[i];
+		System::ticks start = starts[i];
+		int j = i - 1;
+		while (j >= 0 && (starts[j] > start || (starts[j] == start && summaries[j].depth > summary.depth))) {
+			summaries[j + 1] = summaries[j];
+			starts[j + 1] = starts[j];
+			--j;
+		}
+		summaries[j + 1] = summary;
+		starts[j + 1] = start;
+	}
+	return count;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Kore/System.h>
+
+namespace Kore {
+	// Records nested zones per thread into fixed size rings, old zones are overwritten.
+	// Zone names are not copied, they have to stay alive as long as the profiler is used.
+	namespace Profiler {
+		struct ZoneRecord {
+			const char* name;
+			System::ticks start;
+			System::ticks end;
+			int depth;
+		};
+
+		// Zones which are summed up over one frame
+		struct ZoneSummary {
+			const char* name;
+			int depth;
+			int calls;
+			double seconds;
+		};
+
+		// Zones are only recorded while the profiler is enabled, which it is not by default
+		void setEnabled(bool enabled);
+		bool isEnabled();
+
+		void begin(const char* name);
+		void end();
+
+		// Forgets all recorded zones
+		void clear();
+
+		// Writes the recorded zones in the trace event format of chrome://tracing and Perfetto
+		bool writeChromeTrace(const char* filename);
+		// Writes the recorded zones in a compact binary format, see Profiler.cpp for the layout
+		bool writeBinary(const char* filename);
+
+		// Summarizes the last completed top level zone of the calling thread, usually System::frame.
+		// Summaries are sorted by start time so that depth can be used for indentation.
+		int lastFrame(ZoneSummary* summaries, int maxSummaries, double* frameSeconds = nullptr);
+
+		extern bool enabled;
+
+		class Zone {
+		public:
+			Zone(const char* name) : active(enabled) {
+				if (active) begin(name);
+			}
+
+			~Zone() {
+				if (active) end();
+			}
+
+		private:
+			bool active;
+		};
+	}
+}
+
+#define KORE_PROFILE_CONCAT2(a, b) a##b
+#define KORE_PROFILE_CONCAT(a, b) KORE_PROFILE_CONCAT2(a, b)
+
+#ifdef KORE_NO_PROFILER
+#define KORE_PROFILE_ZONE(name)
+#else
+// Records the rest of the enclosing scope as a zone
+#define KORE_PROFILE_ZONE(name) Kore::Profiler::Zone KORE_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
@@ -58,6 +58,42 @@ namespace Kore {
 		return _mm_sub_ps(a, b);
 	}
 
+	inline float32x4 loadUnaligned(const float* values) {
+		return _mm_loadu_ps(values);
+	}
+
+	inline void storeUnaligned(float* destination, float32x4 value) {
+		_mm_storeu_ps(destination, value);
+	}
+
+	// a0 b0 a1 b1
+	inline float32x4 interleaveLow(float32x4 a, float32x4 b) {
+		return _mm_unpacklo_ps(a, b);
+	}
+
+	// a2 b2 a3 b3
+	inline float32x4 interleaveHigh(float32x4 a, float32x4 b) {
+		return _mm_unpackhi_ps(a, b);
+	}
+
+	// Stores the first two elements
+	inline void storeLow(float* destination, float32x4 value) {
+		_mm_storel_pi((__m64*)destination, value);
+	}
+
+	// Stores the last two elements
+	inline void storeHigh(float* destination, float32x4 value) {
+		_mm_storeh_pi((__m64*)destination, value);
+	}
+
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		return _mm_max_ps(a, b);
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		return _mm_min_ps(a, b);
+	}
+
 	inline float32x4 sqrt(float32x4 t) {
 		return _mm_sqrt_ps(t);
 	}
@@ -121,6 +157,38 @@ namespace Kore {
 		return vsubq_f32(a, b);
 	}
 
+	inline float32x4 loadUnaligned(const float* values) {
+		return vld1q_f32(values);
+	}
+
+	inline void storeUnaligned(float* destination, float32x4 value) {
+		vst1q_f32(destination, value);
+	}
+
+	inline float32x4 interleaveLow(float32x4 a, float32x4 b) {
+		return vzipq_f32(a, b).val[0];
+	}
+
+	inline float32x4 interleaveHigh(float32x4 a, float32x4 b) {
+		return vzipq_f32(a, b).val[1];
+	}
+
+	inline void storeLow(float* destination, float32x4 value) {
+		vst1_f32(destination, vget_low_f32(value));
+	}
+
+	inline void storeHigh(float* destination, float32x4 value) {
+		vst1_f32(destination, vget_high_f32(value));
+	}
+
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		return vmaxq_f32(a, b);
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		return vminq_f32(a, b);
+	}
+
 	inline float32x4 sqrt(float32x4 t) {
 #ifdef ARM64
 		return vsqrtq_f32(t);
@@ -233,6 +301,58 @@ namespace Kore {
 		return value;
 	}
 
+	inline float32x4 loadUnaligned(const float* values) {
+		float32x4 value;
+		value.values[0] = values[0];
+		value.values[1] = values[1];
+		value.values[2] = values[2];
+		value.values[3] = values[3];
+		return value;
+	}
+
+	inline void storeUnaligned(float* destination, float32x4 value) {
+		destination[0] = value.values[0];
+		destination[1] = value.values[1];
+		destination[2] = value.values[2];
+		destination[3] = value.values[3];
+	}
+
+	inline float32x4 interleaveLow(float32x4 a, float32x4 b) {
+		return load(a.values[0], b.values[0], a.values[1], b.values[1]);
+	}
+
+	inline float32x4 interleaveHigh(float32x4 a, float32x4 b) {
+		return load(a.values[2], b.values[2], a.values[3], b.values[3]);
+	}
+
+	inline void storeLow(float* destination, float32x4 value) {
+		destination[0] = value.values[0];
+		destination[1] = value.values[1];
+	}
+
+	inline void storeHigh(float* destination, float32x4 value) {
+		destination[0] = value.values[2];
+		destination[1] = value.values[3];
+	}
+
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		float32x4 value;
+		value.values[0] = Kore::max(a.values[0], b.values[0]);
+		value.values[1] = Kore::max(a.values[1], b.values[1]);
+		value.values[2] = Kore::max(a.values[2], b.values[2]);
+		value.values[3] = Kore::max(a.values[3], b.values[3]);
+		return value;
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		float32x4 value;
+		value.values[0] = Kore::min(a.values[0], b.values[0]);
+		value.values[1] = Kore::min(a.values[1], b.values[1]);
+		value.values[2] = Kore::min(a.values[2], b.values[2]);
+		value.values[3] = Kore::min(a.values[3], b.values[3]);
+		return value;
+	}
+
 	inline float32x4 sqrt(float32x4 t) {
 		float32x4 value;
 		value.values[0] = Kore::sqrt(t.values[0]);
@@ -3,6 +3,9 @@
 #include "System.h"
 
 #include <Kore/Math/Random.h>
+#include <Kore/Profiler.h>
+#include <Kore/Threads/Atomic.h>
+#include <Kore/Threads/Event.h>
 
 #include <limits>
 #include <string.h>
@@ -205,8 +208,58 @@ const char* Kore::System::name() {
 void Kore::System::_shutdown() {}
 #endif
 
+#ifndef KORE_LINUX
+void Kore::System::_waitForMessages(double seconds) {}
+
+void Kore::System::_wakeUp() {}
+#endif
+
+namespace {
+	namespace pacing {
+		double frameRate = 0.0;
+		bool idle = false;
+		volatile int redrawRequested = 0;
+#if !defined(KORE_HTML5) && !defined(KORE_TIZEN) && !defined(KORE_XBOX_ONE)
+		// never signaled, waiting on it is a portable sleep
+		Kore::Event sleeper;
+
+		// Sleeps until shortly before the deadline and spins for the rest because sleeps tend to overshoot
+		void waitUntil(double deadline) {
+			const double spinTime = 0.002;
+			double remaining = deadline - Kore::System::time();
+			if (remaining > spinTime) sleeper.tryToWait(remaining - spinTime);
+			while (Kore::System::time() < deadline) {
+			}
+		}
+#endif
+	}
+}
+
+void Kore::System::setFrameRate(double framesPerSecond) {
+	pacing::frameRate = framesPerSecond > 0.0 ? framesPerSecond : 0.0;
+}
+
+double Kore::System::frameRate() {
+	return pacing::frameRate;
+}
+
+void Kore::System::setIdleMode(bool idle) {
+	pacing::idle = idle;
+	if (!idle) _wakeUp();
+}
+
+bool Kore::System::isIdleMode() {
+	return pacing::idle;
+}
+
+void Kore::System::redraw() {
+	KORE_ATOMIC_EXCHANGE(&pacing::redrawRequested, 1);
+	_wakeUp();
+}
+
 void Kore::System::stop() {
 	appstate::running = false;
+	_wakeUp();
 
 	// TODO (DK) destroy graphics + windows, but afaik Application::~Application() was never called, so it's the same behavior now as well
 
@@ -216,6 +269,7 @@ void Kore::System::stop() {
 }
 
 bool Kore::System::frame() {
+	KORE_PROFILE_ZONE("System::frame");
 	callback();
 	handleMessages();
 	return appstate::running;
@@ -227,8 +281,23 @@ void Kore::System::start() {
 #if !defined(KORE_HTML5) && !defined(KORE_TIZEN) && !defined(KORE_XBOX_ONE)
 	// if (Graphics::hasWindow()) Graphics::swapBuffers();
 
+	pacing::sleeper.create();
+	double next = time();
 	while (frame()) {
+		if (pacing::idle && KORE_ATOMIC_EXCHANGE(&pacing::redrawRequested, 0) == 0) {
+			_waitForMessages(-1.0);
+			KORE_ATOMIC_EXCHANGE(&pacing::redrawRequested, 0);
+		}
+		if (pacing::frameRate > 0.0) {
+			double period = 1.0 / pacing::frameRate;
+			double now = time();
+			next += period;
+			// frames which were missed are dropped instead of being run in a burst
+			if (next < now - period) next = now;
+			else pacing::waitUntil(next);
+		}
 	}
+	pacing::sleeper.destroy();
 	_shutdown();
 #endif
 }
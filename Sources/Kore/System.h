@@ -66,8 +66,22 @@ namespace Kore {
 		bool frame();
 		void stop();
 		void _shutdown();
+		// Blocks until window messages are pending, _wakeUp is called or seconds passed (no limit when seconds < 0).
+		// Returns immediately on platforms which can not wait for messages.
+		void _waitForMessages(double seconds);
+		void _wakeUp();
 		bool isFullscreen();
 
+		// Paces the frames of start() to framesPerSecond, 0 runs them back to back
+		void setFrameRate(double framesPerSecond);
+		double frameRate();
+		// In idle mode start() only runs a frame after window messages arrived or redraw was called.
+		// Gamepads are not polled while idling.
+		void setIdleMode(bool idle);
+		bool isIdleMode();
+		// Requests a frame in idle mode, can be called from any thread
+		void redraw();
+
 		void setCallback(void (*value)());
 		void setForegroundCallback(void (*value)());
 		void setResumeCallback(void (*value)());
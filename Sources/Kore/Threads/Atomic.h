@@ -0,0 +1,41 @@
+#pragma once
+
+// All operations work on aligned 32 bit integers and act as full memory barriers.
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define KORE_ATOMIC_COMPARE_EXCHANGE(pointer, oldValue, newValue) (_InterlockedCompareExchange((volatile long*)(pointer), (long)(newValue), (long)(oldValue)) == (long)(oldValue))
+#define KORE_ATOMIC_INCREMENT(pointer) (_InterlockedIncrement((volatile long*)(pointer)) - 1)
+#define KORE_ATOMIC_DECREMENT(pointer) (_InterlockedDecrement((volatile long*)(pointer)) + 1)
+#define KORE_ATOMIC_ADD(pointer, value) (_InterlockedExchangeAdd((volatile long*)(pointer), (long)(value)))
+#define KORE_ATOMIC_EXCHANGE(pointer, value) (_InterlockedExchange((volatile long*)(pointer), (long)(value)))
+namespace Kore {
+	inline void memoryBarrier() {
+		// interlocked operations imply a full barrier on every Microsoft target
+		volatile long dummy = 0;
+		_InterlockedExchange(&dummy, 0);
+	}
+}
+
+#define KORE_MEMORY_BARRIER() Kore::memoryBarrier()
+
+#else
+
+#define KORE_ATOMIC_COMPARE_EXCHANGE(pointer, oldValue, newValue) (__sync_bool_compare_and_swap(pointer, oldValue, newValue))
+#define KORE_ATOMIC_INCREMENT(pointer) (__sync_fetch_and_add(pointer, 1))
+#define KORE_ATOMIC_DECREMENT(pointer) (__sync_fetch_and_sub(pointer, 1))
+#define KORE_ATOMIC_ADD(pointer, value) (__sync_fetch_and_add(pointer, value))
+namespace Kore {
+	template <typename T> inline T atomicExchange(volatile T* pointer, T value) {
+		T old = __sync_lock_test_and_set(pointer, value);
+		__sync_synchronize();
+		return old;
+	}
+}
+
+#define KORE_ATOMIC_EXCHANGE(pointer, value) (Kore::atomicExchange(pointer, value))
+#define KORE_MEMORY_BARRIER() __sync_synchronize()
+
+#endif
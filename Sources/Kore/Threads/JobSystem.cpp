@@ -0,0 +1,326 @@
+#include "pch.h"
+
+#include "JobSystem.h"
+
+#include <Kore/Threads/Atomic.h>
+#include <Kore/Threads/Event.h>
+#include <Kore/Threads/Mutex.h>
+#ifndef KORE_HTML5
+#include <Kore/Threads/Thread.h>
+#endif
+
+#if defined(_MSC_VER)
+#define KORE_THREAD_LOCAL __declspec(thread)
+#else
+#define KORE_THREAD_LOCAL __thread
+#endif
+
+using namespace Kore;
+
+namespace {
+	struct Job {
+		JobSystem::JobFunction function;
+		void* data;
+		JobSystem::Counter* counter;
+		JobSystem::Counter* dependency;
+	};
+
+	const u32 queueSize = 2048;
+	const u32 queueMask = queueSize - 1;
+	const int spinCount = 64;
+
+	// Chase-Lev work stealing deque, the owning thread pushes and pops
+	// at the bottom, all other threads steal from the top
+	struct Queue {
+		volatile u32 top;
+		char padding0[60];
+		volatile u32 bottom;
+		char padding1[60];
+		Job jobs[queueSize];
+	};
+
+	bool push(Queue& queue, const Job& job) {
+		u32 bottom = queue.bottom;
+		u32 top = queue.top;
+		if ((int)(bottom - top) >= (int)queueSize) return false;
+		queue.jobs[bottom & queueMask] = job;
+		KORE_MEMORY_BARRIER();
+		queue.bottom = bottom + 1;
+		return true;
+	}
+
+	bool pop(Queue& queue, Job& job) {
+		u32 bottom = queue.bottom - 1;
+		queue.bottom = bottom;
+		KORE_MEMORY_BARRIER();
+		u32 top = queue.top;
+		int size = (int)(bottom - top);
+		if (size < 0) {
+			queue.bottom = top;
+			return false;
+		}
+		job = queue.jobs[bottom & queueMask];
+		if (size > 0) return true;
+		// last job, race against the thieves
+		bool won = KORE_ATOMIC_COMPARE_EXCHANGE(&queue.top, top, top + 1);
+		queue.bottom = top + 1;
+		return won;
+	}
+
+	bool steal(Queue& queue, Job& job) {
+		u32 top = queue.top;
+		KORE_MEMORY_BARRIER();
+		u32 bottom = queue.bottom;
+		if ((int)(bottom - top) <= 0) return false;
+		job = queue.jobs[top & queueMask];
+		return KORE_ATOMIC_COMPARE_EXCHANGE(&queue.top, top, top + 1);
+	}
+
+	// queue 0 belongs to the thread that called init, queue i + 1 to worker i
+	Queue* queues = nullptr;
+	int queueCount = 0;
+#ifndef KORE_HTML5
+	// HTML5 has no threads, every job runs on the calling thread there
+	Thread** threads = nullptr;
+#endif
+	int workers = 0;
+	bool initialized = false;
+	volatile int running = 0;
+	volatile int sleeping = 0;
+	Event wakeUp;
+
+	// jobs run from threads which are not known to the job system
+	Mutex externalMutex;
+	Job externalJobs[queueSize];
+	volatile u32 externalTop = 0;
+	volatile u32 externalBottom = 0;
+
+	KORE_THREAD_LOCAL int threadIndex = -1;
+
+	bool pushExternal(const Job& job) {
+		externalMutex.lock();
+		bool pushed = false;
+		if (externalBottom - externalTop < queueSize) {
+			externalJobs[externalBottom & queueMask] = job;
+			KORE_MEMORY_BARRIER();
+			++externalBottom;
+			pushed = true;
+		}
+		externalMutex.unlock();
+		return pushed;
+	}
+
+	bool popExternal(Job& job) {
+		if (externalBottom == externalTop) return false;
+		externalMutex.lock();
+		bool popped = false;
+		if (externalBottom != externalTop) {
+			job = externalJobs[externalTop & queueMask];
+			++externalTop;
+			popped = true;
+		}
+		externalMutex.unlock();
+		return popped;
+	}
+
+	bool hasWork() {
+		if (externalBottom != externalTop) return true;
+		for (int i = 0; i < queueCount; ++i) {
+			if ((int)(queues[i].bottom - queues[i].top) > 0) return true;
+		}
+		return false;
+	}
+
+	bool next(int index, Job& job) {
+		if (index >= 0 && pop(queues[index], job)) return true;
+		for (int i = 1; i <= queueCount; ++i) {
+			int victim = (index + i) % queueCount;
+			if (victim < 0) victim += queueCount;
+			if (victim != index && steal(queues[victim], job)) return true;
+		}
+		return popExternal(job);
+	}
+
+	void execute(const Job& job) {
+		if (job.dependency != nullptr) JobSystem::wait(job.dependency);
+		job.function(job.data);
+		// wake up waits for the counter
+		if (job.counter != nullptr && KORE_ATOMIC_DECREMENT(&job.counter->value) == 1 && sleeping > 0) wakeUp.signal();
+	}
+
+	bool executeNext(int index) {
+		if (queueCount == 0) return false;
+		Job job;
+		if (next(index, job)) {
+			execute(job);
+			return true;
+		}
+		return false;
+	}
+
+#ifndef KORE_HTML5
+	void worker(void* param) {
+		threadIndex = (int)(spint)param;
+		while (running) {
+			if (executeNext(threadIndex)) continue;
+
+			bool found = false;
+			for (int i = 0; i < spinCount && !found; ++i) {
+				found = executeNext(threadIndex);
+			}
+			if (found) continue;
+
+			KORE_ATOMIC_INCREMENT(&sleeping);
+			// run checks the sleeping count after pushing, so a job pushed
+			// before the increment is always seen here
+			if (running && !hasWork()) {
+				wakeUp.tryToWait(0.01);
+			}
+			KORE_ATOMIC_DECREMENT(&sleeping);
+		}
+	}
+#endif
+
+	struct Range {
+		int start;
+		int end;
+		JobSystem::ParallelForFunction function;
+		void* data;
+	};
+
+	void runRange(void* data) {
+		Range* range = (Range*)data;
+		range->function(range->start, range->end, range->data);
+	}
+}
+
+void JobSystem::init(int workerCount) {
+	if (initialized) return;
+	initialized = true;
+#if defined(KORE_HTML5)
+	workerCount = 0;
+#else
+	if (workerCount < 0) workerCount = cpuCores() - 1;
+#endif
+	workers = workerCount > 0 ? workerCount : 0;
+	threadIndex = 0;
+	if (workers == 0) return;
+
+	externalMutex.create();
+	wakeUp.create();
+	queueCount = workers + 1;
+	queues = new Queue[queueCount];
+	for (int i = 0; i < queueCount; ++i) {
+		queues[i].top = queues[i].bottom = 0;
+	}
+	externalTop = externalBottom = 0;
+	running = 1;
+	KORE_MEMORY_BARRIER();
+#ifndef KORE_HTML5
+	threads = new Thread*[workers];
+	for (int i = 0; i < workers; ++i) {
+		threads[i] = createAndRunThread(worker, (void*)(spint)(i + 1));
+	}
+#endif
+}
+
+void JobSystem::quit() {
+	initialized = false;
+	if (workers == 0) return;
+
+	while (executeNext(threadIndex)) {
+	}
+	running = 0;
+	KORE_MEMORY_BARRIER();
+	for (int i = 0; i < workers; ++i) {
+		wakeUp.signal();
+	}
+#ifndef KORE_HTML5
+	for (int i = 0; i < workers; ++i) {
+		if (threads[i] != nullptr) waitForThreadStopThenFree(threads[i]);
+	}
+	delete[] threads;
+	threads = nullptr;
+#endif
+	delete[] queues;
+	queues = nullptr;
+	queueCount = 0;
+	workers = 0;
+	wakeUp.destroy();
+	externalMutex.destroy();
+}
+
+int JobSystem::workerCount() {
+	return workers;
+}
+
+void JobSystem::run(JobFunction function, void* data, Counter* counter, Counter* dependency) {
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.counter = counter;
+	job.dependency = dependency;
+	if (counter != nullptr) KORE_ATOMIC_INCREMENT(&counter->value);
+
+	bool pushed = false;
+	if (workers > 0) {
+		pushed = threadIndex >= 0 ? push(queues[threadIndex], job) : pushExternal(job);
+	}
+	if (!pushed) {
+		execute(job);
+		return;
+	}
+
+	KORE_MEMORY_BARRIER();
+	if (sleeping > 0) wakeUp.signal();
+}
+
+bool JobSystem::isDone(Counter* counter) {
+	return counter->value <= 0;
+}
+
+void JobSystem::wait(Counter* counter) {
+	while (counter->value > 0) {
+		if (executeNext(threadIndex)) continue;
+
+		bool found = false;
+		for (int i = 0; i < spinCount && !found && counter->value > 0; ++i) {
+			found = executeNext(threadIndex);
+		}
+		if (found || counter->value <= 0 || workers == 0) continue;
+
+		// Sleep until a job is pushed or a counter reaches zero, the timeout
+		// covers signals which a worker consumed instead
+		KORE_ATOMIC_INCREMENT(&sleeping);
+		if (counter->value > 0 && !hasWork()) {
+			wakeUp.tryToWait(0.001);
+		}
+		KORE_ATOMIC_DECREMENT(&sleeping);
+	}
+}
+
+void JobSystem::parallelFor(int count, int batchSize, ParallelForFunction function, void* data) {
+	if (count <= 0) return;
+	if (batchSize <= 0) {
+		// a few batches per thread to balance uneven work
+		int batches = (workers + 1) * 4;
+		batchSize = (count + batches - 1) / batches;
+	}
+	int batchCount = (count + batchSize - 1) / batchSize;
+	if (workers == 0 || batchCount == 1) {
+		function(0, count, data);
+		return;
+	}
+
+	Range* ranges = new Range[batchCount];
+	Counter counter;
+	for (int i = 0; i < batchCount; ++i) {
+		ranges[i].start = i * batchSize;
+		ranges[i].end = ranges[i].start + batchSize < count ? ranges[i].start + batchSize : count;
+		ranges[i].function = function;
+		ranges[i].data = data;
+		run(runRange, &ranges[i], &counter);
+	}
+	wait(&counter);
+	delete[] ranges;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+namespace Kore {
+	namespace JobSystem {
+		typedef void (*JobFunction)(void* data);
+		typedef void (*ParallelForFunction)(int start, int end, void* data);
+
+		// Counts the unfinished jobs it was handed to
+		struct Counter {
+			Counter() : value(0) {}
+			volatile int value;
+		};
+
+		// workers < 0 starts one worker per additional cpu core,
+		// workers == 0 runs every job directly on the calling thread.
+		// Calling init again before quit does nothing.
+		void init(int workers = -1);
+		void quit();
+		int workerCount();
+
+		// The job does not start before dependency (if any) reached zero.
+		// Can be called from any thread, jobs can spawn more jobs.
+		void run(JobFunction function, void* data, Counter* counter = nullptr, Counter* dependency = nullptr);
+		bool isDone(Counter* counter);
+		// Executes other jobs while waiting
+		void wait(Counter* counter);
+
+		// Splits [0, count) into batches of batchSize (or an automatic size when batchSize <= 0)
+		// and returns after all of them were executed
+		void parallelFor(int count, int batchSize, ParallelForFunction function, void* data);
+	}
+}
@@ -13,4 +13,6 @@ namespace Kore {
 	Thread* createAndRunThread(void (*thread)(void* param), void* param);
 	void waitForThreadStopThenFree(Thread* sr);
 	bool isThreadStoppedThenFree(Thread* sr);
+
+	int cpuCores();
 }
@@ -0,0 +1,27 @@
+#version 450
+
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform sampler2D tex2;
+uniform sampler2D tex3;
+in vec2 texCoord;
+in vec4 color;
+in float slot;
+out vec4 FragColor;
+
+// 0 is untextured, 1 to 4 are images and 5 to 8 are font textures which only provide coverage
+vec4 sampleSlot(float index) {
+	if (index < 0.5) return texture(tex0, texCoord);
+	if (index < 1.5) return texture(tex1, texCoord);
+	if (index < 2.5) return texture(tex2, texCoord);
+	return texture(tex3, texCoord);
+}
+
+void main() {
+	vec4 texcolor = vec4(1.0);
+	if (slot > 4.5) texcolor = vec4(sampleSlot(slot - 5.0).r);
+	else if (slot > 0.5) texcolor = sampleSlot(slot - 1.0);
+	texcolor *= color;
+	texcolor.rgb *= color.a;
+	FragColor = texcolor;
+}
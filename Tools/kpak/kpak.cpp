@@ -0,0 +1,237 @@
+// Creates, lists and benchmarks .kpak archives, see Sources/Kore/IO/Archive.h for the format.
+//
+// Build from this directory with something like (KORE_NO_PROFILER as Profiler.cpp is not part of the build)
+//   c++ -O2 -DKORE_LINUX -DKORE_POSIX -DKORE_NO_PROFILER -I../../Sources -I../../Backends/System/POSIX/Sources kpak.cpp
+//       ../../Sources/Kore/IO/Archive.cpp ../../Sources/Kore/IO/FileReader.winrt.cpp ../../Sources/Kore/IO/Reader.cpp
+//       ../../Sources/Kore/Log.cpp ../../Sources/Kore/Error.cpp ../../Backends/System/POSIX/Sources/Kore/Mutex.cpp
+//       ../../Sources/Kore/IO/lz4/lz4.c ../../Sources/Kore/IO/lz4/lz4hc.c ../../Sources/Kore/IO/lz4/xxhash.c -lpthread -o kpak
+//
+// kpak create <archive> <directory> [--hc] [--store]
+//   packs all files below directory, names are relative to it
+// kpak list <archive>
+// kpak bench <archive> <directory>
+//   compares reading every entry through Kore::Archive against reading the loose files
+
+#include <Kore/pch.h>
+
+#include <Kore/IO/Archive.h>
+#include <Kore/IO/lz4/lz4.h>
+#include <Kore/IO/lz4/lz4hc.h>
+#include <Kore/IO/lz4/xxhash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Kore;
+
+namespace {
+	struct File {
+		std::string name;
+		std::vector<u8> data;
+		std::vector<u8> compressed;
+		ArchiveEntry entry;
+	};
+
+	void listFiles(const std::string& root, const std::string& relative, std::vector<std::string>& files) {
+		std::string directory = relative.empty() ? root : root + "/" + relative;
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &data);
+		if (handle == INVALID_HANDLE_VALUE) return;
+		do {
+			std::string name = data.cFileName;
+			if (name == "." || name == "..") continue;
+			std::string path = relative.empty() ? name : relative + "/" + name;
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) listFiles(root, path, files);
+			else files.push_back(path);
+		} while (FindNextFileA(handle, &data));
+		FindClose(handle);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir == nullptr) return;
+		while (dirent* ent = readdir(dir)) {
+			std::string name = ent->d_name;
+			if (name == "." || name == "..") continue;
+			std::string path = relative.empty() ? name : relative + "/" + name;
+			struct stat info;
+			if (stat((root + "/" + path).c_str(), &info) != 0) continue;
+			if (S_ISDIR(info.st_mode)) listFiles(root, path, files);
+			else if (S_ISREG(info.st_mode)) files.push_back(path);
+		}
+		closedir(dir);
+#endif
+	}
+
+	bool loadFile(const std::string& path, std::vector<u8>& data) {
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == nullptr) return false;
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(size);
+		bool success = size == 0 || fread(&data[0], 1, size, file) == (size_t)size;
+		fclose(file);
+		return success;
+	}
+
+	void writeU32(FILE* file, u32 value) {
+		u8 bytes[4] = {(u8)value, (u8)(value >> 8), (u8)(value >> 16), (u8)(value >> 24)};
+		fwrite(bytes, 1, 4, file);
+	}
+
+	bool byHash(const File* a, const File* b) {
+		if (a->entry.nameHash != b->entry.nameHash) return a->entry.nameHash < b->entry.nameHash;
+		return a->name < b->name;
+	}
+
+	int create(const char* archiveName, const char* directory, ArchiveCompression compression) {
+		std::vector<std::string> names;
+		listFiles(directory, "", names);
+		std::vector<File> files(names.size());
+		std::vector<File*> sorted;
+		u32 namesSize = 0;
+		for (size_t i = 0; i < names.size(); ++i) {
+			File& file = files[i];
+			file.name = names[i];
+			if (!loadFile(std::string(directory) + "/" + file.name, file.data)) {
+				fprintf(stderr, "Could not read %s.\n", file.name.c_str());
+				return 1;
+			}
+			int size = (int)file.data.size();
+			const char* source = size > 0 ? (const char*)&file.data[0] : "";
+			file.entry.nameHash = XXH32(file.name.c_str(), file.name.size(), 0);
+			file.entry.nameOffset = namesSize;
+			file.entry.nameLength = (u32)file.name.size();
+			file.entry.size = size;
+			file.entry.checksum = XXH32(source, size, 0);
+			file.entry.compression = ArchiveStored;
+			if (compression != ArchiveStored && size > 0) {
+				file.compressed.resize(LZ4_compressBound(size));
+				int compressedSize = compression == ArchiveLZ4HC
+				                         ? LZ4_compress_HC(source, (char*)&file.compressed[0], size, (int)file.compressed.size(), LZ4HC_CLEVEL_MAX)
+				                         : LZ4_compress_default(source, (char*)&file.compressed[0], size, (int)file.compressed.size());
+				// incompressible files are stored as they are
+				if (compressedSize > 0 && compressedSize < size) {
+					file.compressed.resize(compressedSize);
+					file.entry.compression = compression;
+				}
+			}
+			if (file.entry.compression == ArchiveStored) file.compressed = file.data;
+			file.entry.compressedSize = (u32)file.compressed.size();
+			namesSize += (u32)file.name.size() + 1;
+			sorted.push_back(&file);
+		}
+		std::sort(sorted.begin(), sorted.end(), byHash);
+
+		u32 offset = archiveHeaderSize + (u32)sorted.size() * archiveEntrySize + namesSize;
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			sorted[i]->entry.offset = offset;
+			offset += sorted[i]->entry.compressedSize;
+		}
+
+		FILE* out = fopen(archiveName, "wb");
+		if (out == nullptr) {
+			fprintf(stderr, "Could not write %s.\n", archiveName);
+			return 1;
+		}
+		fwrite("KPAK", 1, 4, out);
+		writeU32(out, archiveVersion);
+		writeU32(out, (u32)sorted.size());
+		writeU32(out, namesSize);
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			const ArchiveEntry& entry = sorted[i]->entry;
+			writeU32(out, entry.nameHash);
+			writeU32(out, entry.nameOffset);
+			writeU32(out, entry.nameLength);
+			writeU32(out, entry.compression);
+			writeU32(out, entry.offset);
+			writeU32(out, entry.compressedSize);
+			writeU32(out, entry.size);
+			writeU32(out, entry.checksum);
+		}
+		for (size_t i = 0; i < files.size(); ++i) {
+			fwrite(files[i].name.c_str(), 1, files[i].name.size() + 1, out);
+		}
+		u64 total = 0;
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			if (!sorted[i]->compressed.empty()) fwrite(&sorted[i]->compressed[0], 1, sorted[i]->compressed.size(), out);
+			total += sorted[i]->entry.size;
+		}
+		fclose(out);
+		printf("Packed %d files, %llu bytes into %u bytes.\n", (int)sorted.size(), (unsigned long long)total, offset);
+		return 0;
+	}
+
+	int list(const char* archiveName) {
+		Archive archive;
+		if (!archive.open(archiveName)) return 1;
+		const char* compressions[] = {"stored", "lz4", "lz4hc"};
+		for (int i = 0; i < archive.entryCount(); ++i) {
+			const ArchiveEntry& entry = archive.entry(i);
+			printf("%10u %10u %-6s %s\n", entry.size, entry.compressedSize, entry.compression <= ArchiveLZ4HC ? compressions[entry.compression] : "?",
+			       archive.entryName(i));
+		}
+		return 0;
+	}
+
+	double now() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int bench(const char* archiveName, const char* directory) {
+		double start = now();
+		Archive archive;
+		if (!archive.open(archiveName)) return 1;
+		mountArchive(&archive);
+		u64 archived = 0;
+		for (int i = 0; i < archive.entryCount(); ++i) {
+			FileReader reader(archive.entryName(i));
+			archived += reader.size();
+			reader.readAll();
+		}
+		double archiveTime = now() - start;
+		unmountArchive(&archive);
+
+		start = now();
+		u64 loose = 0;
+		for (int i = 0; i < archive.entryCount(); ++i) {
+			FileReader reader((std::string(directory) + "/" + archive.entryName(i)).c_str());
+			loose += reader.size();
+			reader.readAll();
+		}
+		double looseTime = now() - start;
+
+		printf("%d files\n", archive.entryCount());
+		printf("archive: %8.2f ms, %llu bytes\n", archiveTime * 1000.0, (unsigned long long)archived);
+		printf("loose:   %8.2f ms, %llu bytes\n", looseTime * 1000.0, (unsigned long long)loose);
+		printf("Drop the page cache between runs to measure cold starts.\n");
+		return 0;
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc >= 4 && strcmp(argv[1], "create") == 0) {
+		ArchiveCompression compression = ArchiveLZ4;
+		for (int i = 4; i < argc; ++i) {
+			if (strcmp(argv[i], "--hc") == 0) compression = ArchiveLZ4HC;
+			else if (strcmp(argv[i], "--store") == 0) compression = ArchiveStored;
+		}
+		return create(argv[2], argv[3], compression);
+	}
+	if (argc == 3 && strcmp(argv[1], "list") == 0) return list(argv[2]);
+	if (argc == 4 && strcmp(argv[1], "bench") == 0) return bench(argv[2], argv[3]);
+	fprintf(stderr, "Usage:\n  kpak create <archive> <directory> [--hc] [--store]\n  kpak list <archive>\n  kpak bench <archive> <directory>\n");
+	return 1;
+}
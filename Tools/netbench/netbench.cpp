@@ -0,0 +1,144 @@
+// Measures how the receive cost of Kore::Connection depends on its slot count, see Sources/Kore/Network/Connection.h.
+//
+// Build from this directory with something like (KORE_NO_PROFILER as Profiler.cpp is not part of the build)
+//   c++ -O2 -DKORE_LINUX -DKORE_POSIX -DKORE_NO_PROFILER -I../../Sources -I../../Backends/System/Linux/Sources -I../../Backends/System/POSIX/Sources
+//       netbench.cpp ../../Sources/Kore/Network/Connection.cpp ../../Sources/Kore/Network/Socket.cpp ../../Sources/Kore/Log.cpp
+//       ../../Sources/Kore/IO/lz4/lz4.c -o netbench
+//
+// netbench [peers] [slots...]
+//   connects peers client Connections (1000 by default) over loopback to a server Connection with each of the slot counts
+//   (peers, 4 * peers and 16 * peers by default) and reports what a receive call costs without and with traffic.
+//   Every peer uses a socket of its own, the open file limit is raised as far as allowed.
+//   Both costs should follow the number of active peers and not the slot count. The cost per message includes the
+//   maintenance pass over all active peers which ends each drain of the socket.
+
+#include <Kore/pch.h>
+
+#include <Kore/Network/Connection.h>
+#include <Kore/System.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace Kore;
+
+namespace {
+	const unsigned loopback = 0x7f000001;
+	const int serverPort = 27000;
+	const int buffSize = 256;
+	const int cacheCount = 4;
+	// no pings and no timeouts during a run, only the messages of the peers are received
+	const double never = 1e9;
+	const int idleCalls = 10000;
+	const int rounds = 10;
+	// peers which send before the server drains its socket, more would overflow the socket buffer
+	const int chunk = 64;
+
+	double now() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double startTime = now();
+
+	bool raiseFileLimit(int peers) {
+#ifndef _WIN32
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return false;
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return false;
+		if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < (rlim_t)peers + 64) {
+			fprintf(stderr, "%d peers need %d open files but only %llu are allowed.\n", peers, peers + 64, (unsigned long long)limit.rlim_cur);
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	// Receives until the socket is drained, the last call also does the maintenance of all connections
+	int drain(Connection& server) {
+		int messages = 0;
+		int size, id;
+		while (server.receiveMessage(size, id) != nullptr) ++messages;
+		return messages;
+	}
+
+	void bench(std::vector<Connection*>& peers, int slots) {
+		int count = (int)peers.size();
+		Connection server(serverPort, slots, never, never, 0.2, 0.2, 0.5f, buffSize, cacheCount);
+		for (int i = 0; i < count; ++i) server.connect(loopback, serverPort + 1 + i);
+
+		u8 message[32] = {};
+		// Every peer is received once so that all of them are connected
+		for (int i = 0; i < count; i += chunk) {
+			for (int j = i; j < i + chunk && j < count; ++j) peers[j]->send(message, sizeof(message), 0, false);
+			drain(server);
+		}
+
+		double idleStart = now();
+		for (int i = 0; i < idleCalls; ++i) drain(server);
+		double idleTime = now() - idleStart;
+
+		double trafficTime = 0;
+		int received = 0;
+		for (int round = 0; round < rounds; ++round) {
+			for (int i = 0; i < count; i += chunk) {
+				for (int j = i; j < i + chunk && j < count; ++j) peers[j]->send(message, sizeof(message), 0, false);
+				double trafficStart = now();
+				received += drain(server);
+				trafficTime += now() - trafficStart;
+			}
+		}
+
+		printf("%9d %9d %14.2f %14.2f %9d/%d\n", slots, server.activeConns, idleTime / idleCalls * 1e6, received > 0 ? trafficTime / received * 1e6 : 0.0,
+		       received, count * rounds);
+	}
+}
+
+// Connection only needs the clock of the system layer, the Linux one would pull in the window system
+double Kore::System::time() {
+	return now() - startTime;
+}
+
+int main(int argc, char** argv) {
+	int peerCount = argc > 1 ? atoi(argv[1]) : 1000;
+	if (peerCount <= 0) {
+		fprintf(stderr, "Usage:\n  netbench [peers] [slots...]\n");
+		return 1;
+	}
+	std::vector<int> slots;
+	for (int i = 2; i < argc; ++i) {
+		int slotCount = atoi(argv[i]);
+		if (slotCount < peerCount) {
+			fprintf(stderr, "A server with %d slots can not hold %d peers.\n", slotCount, peerCount);
+			return 1;
+		}
+		slots.push_back(slotCount);
+	}
+	if (slots.empty()) {
+		slots.push_back(peerCount);
+		slots.push_back(peerCount * 4);
+		slots.push_back(peerCount * 16);
+	}
+	if (!raiseFileLimit(peerCount)) return 1;
+
+	std::vector<Connection*> peers;
+	for (int i = 0; i < peerCount; ++i) {
+		Connection* peer = new Connection(serverPort + 1 + i, 1, never, never, 0.2, 0.2, 0.5f, buffSize, cacheCount);
+		peer->connect(loopback, serverPort);
+		peers.push_back(peer);
+	}
+
+	printf("%d peers, receive cost in microseconds\n", peerCount);
+	printf("%9s %9s %14s %14s %9s\n", "slots", "active", "idle call", "per message", "received");
+	for (size_t i = 0; i < slots.size(); ++i) bench(peers, slots[i]);
+
+	for (int i = 0; i < peerCount; ++i) delete peers[i];
+	return 0;
+}
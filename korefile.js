@@ -294,6 +294,12 @@ else if (platform === Platform.Linux) {
 		project.addLib('Xinerama');
 		project.addDefine('KORE_OPENGL');
 	}
+	else if (graphics === 'software') {
+		// headless, frames can be read back with Kore::Software::backbuffer
+		g4 = true;
+		addBackend('Graphics4/Software');
+		project.addDefine('KORE_SOFTWARE');
+	}
 	else {
 		throw new Error('Graphics API ' + graphics + ' is not available for Linux.');
 	}